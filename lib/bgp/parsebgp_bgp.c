@@ -147,6 +147,24 @@ parsebgp_error_t parsebgp_bgp_decode(parsebgp_opts_t *opts,
   return parsebgp_bgp_decode_ext(opts, msg, buf, len, 0);
 }
 
+parsebgp_error_t parsebgp_bgp_frame(const parsebgp_opts_t *opts,
+                                    const uint8_t *buf, size_t len,
+                                    size_t *msg_len)
+{
+  // the length follows the marker (if present), and counts the whole message
+  size_t len_offset = opts->bgp.marker_omitted ? 0 : BGP_HDR_LEN - 3;
+
+  if (len < len_offset + 3) {
+    *msg_len = len_offset + 3;
+    return PARSEBGP_PARTIAL_MSG;
+  }
+  *msg_len = nptohs(buf + len_offset);
+  if (*msg_len < len_offset + 3) {
+    PARSEBGP_RETURN_INVALID_MSG_ERR;
+  }
+  return PARSEBGP_OK;
+}
+
 void parsebgp_bgp_destroy_msg(parsebgp_bgp_msg_t *msg)
 {
   if (msg == NULL) {
@@ -198,6 +216,58 @@ void parsebgp_bgp_clear_msg(parsebgp_bgp_msg_t *msg)
   }
 }
 
+void parsebgp_bgp_mem_usage(const parsebgp_bgp_msg_t *msg,
+                            parsebgp_mem_usage_t *usage)
+{
+  if (msg == NULL) {
+    return;
+  }
+
+  PARSEBGP_MEM_ADD(usage, structs, sizeof(*msg));
+
+  // structures for other message types are kept for reuse, so count them all
+  parsebgp_bgp_open_mem_usage(msg->types.open, usage);
+  parsebgp_bgp_update_mem_usage(msg->types.update, usage);
+  parsebgp_bgp_notification_mem_usage(msg->types.notification, usage);
+  parsebgp_bgp_route_refresh_mem_usage(msg->types.route_refresh, usage);
+}
+
+void parsebgp_bgp_trim_msg(parsebgp_bgp_msg_t *msg)
+{
+  if (msg == NULL) {
+    return;
+  }
+
+  // free the structures of other message types, and trim the current one
+  if (msg->type == PARSEBGP_BGP_TYPE_OPEN) {
+    parsebgp_bgp_open_trim(msg->types.open);
+  } else {
+    parsebgp_bgp_open_destroy(msg->types.open);
+    msg->types.open = NULL;
+  }
+
+  if (msg->type == PARSEBGP_BGP_TYPE_UPDATE) {
+    parsebgp_bgp_update_trim(msg->types.update);
+  } else {
+    parsebgp_bgp_update_destroy(msg->types.update);
+    msg->types.update = NULL;
+  }
+
+  if (msg->type == PARSEBGP_BGP_TYPE_NOTIFICATION) {
+    parsebgp_bgp_notification_trim(msg->types.notification);
+  } else {
+    parsebgp_bgp_notification_destroy(msg->types.notification);
+    msg->types.notification = NULL;
+  }
+
+  if (msg->type == PARSEBGP_BGP_TYPE_ROUTE_REFRESH) {
+    parsebgp_bgp_route_refresh_trim(msg->types.route_refresh);
+  } else {
+    parsebgp_bgp_route_refresh_destroy(msg->types.route_refresh);
+    msg->types.route_refresh = NULL;
+  }
+}
+
 void parsebgp_bgp_dump_msg(const parsebgp_bgp_msg_t *msg, int depth)
 {
   PARSEBGP_DUMP_STRUCT_HDR(parsebgp_bgp_msg_t, depth);
@@ -32,6 +32,7 @@
 #include "parsebgp_bgp_route_refresh.h"
 #include "parsebgp_bgp_update.h"
 #include "parsebgp_error.h"
+#include "parsebgp_mem.h"
 #include "parsebgp_opts.h"
 #include <inttypes.h>
 #include <stddef.h>
@@ -109,6 +110,27 @@ parsebgp_error_t parsebgp_bgp_decode(parsebgp_opts_t *opts,
                                      parsebgp_bgp_msg_t *msg, const uint8_t *buffer,
                                      size_t *len);
 
+/**
+ * Determine the length of the BGP message at the start of the given buffer
+ *
+ * @param [in] opts     Options for the parser
+ * @param [in] buf      Pointer to the start of a raw BGP message
+ * @param [in] len      Number of bytes available in the buffer
+ * @param [out] msg_len Set to the total length of the message if successful,
+ *                      or to the minimum number of bytes needed to determine
+ *                      the length if PARSEBGP_PARTIAL_MSG is returned
+ * @return PARSEBGP_OK (0) if the length was determined, or an error code
+ * otherwise
+ *
+ * Only the header is examined, so this is cheap enough to call every time more
+ * data arrives. Once len is at least msg_len, the message can be decoded
+ * without PARSEBGP_PARTIAL_MSG being returned, so stream readers can wait for
+ * the whole message and decode it exactly once.
+ */
+parsebgp_error_t parsebgp_bgp_frame(const parsebgp_opts_t *opts,
+                                    const uint8_t *buf, size_t len,
+                                    size_t *msg_len);
+
 /**
  * Decode (parse) a single BGP message from the given buffer into the given BGP
  * message structure.
@@ -143,6 +165,22 @@ void parsebgp_bgp_destroy_msg(parsebgp_bgp_msg_t *msg);
  */
 void parsebgp_bgp_clear_msg(parsebgp_bgp_msg_t *msg);
 
+/** Add the memory held by the given BGP message structure to the given usage
+ * counters
+ *
+ * @param msg           Pointer to message structure
+ * @param usage         Pointer to the usage counters to add to
+ */
+void parsebgp_bgp_mem_usage(const parsebgp_bgp_msg_t *msg,
+                            parsebgp_mem_usage_t *usage);
+
+/** Release memory held by the given BGP message structure beyond what the
+ * message it currently holds uses
+ *
+ * @param msg           Pointer to message structure to trim
+ */
+void parsebgp_bgp_trim_msg(parsebgp_bgp_msg_t *msg);
+
 /**
  * Dump a human-readable version of the message to stdout
  *
@@ -26,6 +26,265 @@
 
 #include "parsebgp_bgp_common_impl.h"
 #include "parsebgp_utils.h"
+#include <stdlib.h>
+#include <string.h>
+
+// The prefix list loops are instantiated once per Path Identifier setting
+// (add_path is a constant in each inlined copy), so the choice is made once
+// per list rather than once per prefix.
+
+static inline int prefixes_validate(const uint8_t *buf, size_t len,
+                                    uint8_t max_pfx_len, const int add_path)
+{
+  const size_t hdr_len = add_path ? 5 : 1;
+  size_t nread = 0;
+  uint8_t pfx_len;
+  int cnt = 0;
+
+  while (nread < len) {
+    if ((len - nread) < hdr_len) {
+      return -1;
+    }
+    // the length follows the (optional) path identifier
+    pfx_len = buf[nread + hdr_len - 1];
+    if (pfx_len > max_pfx_len) {
+      return -1;
+    }
+    nread += hdr_len + (pfx_len + 7) / 8;
+    cnt++;
+  }
+
+  return (nread == len) ? cnt : -1;
+}
+
+static inline void prefixes_decode(parsebgp_bgp_prefix_t *prefixes,
+                                   int prefixes_cnt, uint8_t type,
+                                   uint16_t afi, uint8_t safi,
+                                   const int add_path, const uint8_t *buf)
+{
+  parsebgp_bgp_prefix_t *tuple;
+  uint8_t bytes, junk;
+  int i;
+
+  for (i = 0; i < prefixes_cnt; i++) {
+    tuple = &prefixes[i];
+
+    tuple->type = type;
+    tuple->afi = afi;
+    tuple->safi = safi;
+
+    if (add_path) {
+      tuple->path_id = nptohl(buf);
+      buf += sizeof(tuple->path_id);
+    } else {
+      tuple->path_id = 0;
+    }
+
+    tuple->len = *(buf++);
+    bytes = (tuple->len + 7) / 8;
+    memset(tuple->addr, 0, sizeof(tuple->addr));
+    memcpy(tuple->addr, buf, bytes);
+    // zero the trailing bits, as parsebgp_decode_prefix does
+    if ((junk = (tuple->len % 8)) != 0) {
+      tuple->addr[bytes - 1] &= 0xFF << (8 - junk);
+    }
+    buf += bytes;
+  }
+}
+
+int parsebgp_bgp_prefixes_validate(const uint8_t *buf, size_t len,
+                                   uint8_t max_pfx_len, int add_path)
+{
+  return add_path ? prefixes_validate(buf, len, max_pfx_len, 1)
+                  : prefixes_validate(buf, len, max_pfx_len, 0);
+}
+
+int parsebgp_bgp_prefixes_budget(parsebgp_opts_t *opts, const uint8_t *buf,
+                                 int prefixes_cnt, int add_path)
+{
+  size_t nread = 0, bytes;
+  int i;
+
+  if ((opts->budget.prefixes == 0 && opts->budget.bytes == 0) ||
+      opts->_budget_state == NULL) {
+    return prefixes_cnt;
+  }
+  for (i = 0; i < prefixes_cnt; i++) {
+    bytes = add_path ? sizeof(uint32_t) : 0;
+    bytes += 1 + (buf[nread + bytes] + 7) / 8;
+    if (PARSEBGP_BUDGET_TAKE(opts, prefixes, PARSEBGP_BUDGET_PREFIXES, 1,
+                             buf + nread) < 1 ||
+        PARSEBGP_BUDGET_TAKE(opts, bytes, PARSEBGP_BUDGET_BYTES, bytes,
+                             buf + nread) < bytes) {
+      break;
+    }
+    nread += bytes;
+  }
+  return i;
+}
+
+void parsebgp_bgp_prefixes_decode_trusted(parsebgp_bgp_prefix_t *prefixes,
+                                          int prefixes_cnt, uint8_t type,
+                                          uint16_t afi, uint8_t safi,
+                                          int add_path, const uint8_t *buf)
+{
+  if (add_path) {
+    prefixes_decode(prefixes, prefixes_cnt, type, afi, safi, 1, buf);
+  } else {
+    prefixes_decode(prefixes, prefixes_cnt, type, afi, safi, 0, buf);
+  }
+}
+
+static inline parsebgp_error_t
+prefixes_compact_decode(parsebgp_bgp_prefixes_compact_t *pfxs, int prefixes_cnt,
+                        const int add_path, const uint8_t *buf)
+{
+  uint32_t addr;
+  uint8_t len, bytes, junk;
+  int i, j;
+
+  PARSEBGP_MAYBE_REALLOC(pfxs->lens, pfxs->_lens_alloc_cnt, prefixes_cnt);
+  if (add_path) {
+    PARSEBGP_MAYBE_REALLOC(pfxs->path_ids, pfxs->_path_ids_alloc_cnt,
+                           prefixes_cnt);
+  }
+
+  if (pfxs->afi == PARSEBGP_BGP_AFI_IPV4) {
+    PARSEBGP_MAYBE_REALLOC(pfxs->addrs4, pfxs->_addrs4_alloc_cnt,
+                           prefixes_cnt);
+    for (i = 0; i < prefixes_cnt; i++) {
+      if (add_path) {
+        pfxs->path_ids[i] = nptohl(buf);
+        buf += sizeof(uint32_t);
+      }
+      pfxs->lens[i] = len = *(buf++);
+      bytes = (len + 7) / 8;
+      addr = 0;
+      for (j = 0; j < bytes; j++) {
+        addr |= (uint32_t)buf[j] << (24 - (8 * j));
+      }
+      // zero the trailing bits, as parsebgp_decode_prefix does
+      pfxs->addrs4[i] = (len == 0) ? 0 : addr & (UINT32_MAX << (32 - len));
+      buf += bytes;
+    }
+    return PARSEBGP_OK;
+  }
+
+  PARSEBGP_MAYBE_REALLOC(pfxs->addrs6, pfxs->_addrs6_alloc_cnt, prefixes_cnt);
+  for (i = 0; i < prefixes_cnt; i++) {
+    if (add_path) {
+      pfxs->path_ids[i] = nptohl(buf);
+      buf += sizeof(uint32_t);
+    }
+    pfxs->lens[i] = len = *(buf++);
+    bytes = (len + 7) / 8;
+    memset(pfxs->addrs6[i], 0, sizeof(pfxs->addrs6[i]));
+    memcpy(pfxs->addrs6[i], buf, bytes);
+    if ((junk = (len % 8)) != 0) {
+      pfxs->addrs6[i][bytes - 1] &= 0xFF << (8 - junk);
+    }
+    buf += bytes;
+  }
+  return PARSEBGP_OK;
+}
+
+parsebgp_error_t parsebgp_bgp_prefixes_compact_decode_trusted(
+  parsebgp_bgp_prefixes_compact_t *pfxs, int prefixes_cnt, uint8_t type,
+  uint16_t afi, uint8_t safi, int add_path, const uint8_t *buf)
+{
+  parsebgp_error_t err;
+
+  pfxs->type = type;
+  pfxs->afi = afi;
+  pfxs->safi = safi;
+  pfxs->has_path_ids = (add_path != 0);
+  pfxs->cnt = 0;
+
+  err = add_path ? prefixes_compact_decode(pfxs, prefixes_cnt, 1, buf)
+                 : prefixes_compact_decode(pfxs, prefixes_cnt, 0, buf);
+  if (err != PARSEBGP_OK) {
+    return err;
+  }
+  pfxs->cnt = prefixes_cnt;
+  return PARSEBGP_OK;
+}
+
+void
+parsebgp_bgp_prefixes_compact_get(const parsebgp_bgp_prefixes_compact_t *pfxs,
+                                  int idx, parsebgp_bgp_prefix_t *pfx)
+{
+  uint32_t addr;
+
+  pfx->type = pfxs->type;
+  pfx->afi = pfxs->afi;
+  pfx->safi = pfxs->safi;
+  pfx->len = pfxs->lens[idx];
+  if (pfxs->afi == PARSEBGP_BGP_AFI_IPV4) {
+    addr = pfxs->addrs4[idx];
+    memset(pfx->addr, 0, sizeof(pfx->addr));
+    pfx->addr[0] = addr >> 24;
+    pfx->addr[1] = addr >> 16;
+    pfx->addr[2] = addr >> 8;
+    pfx->addr[3] = addr;
+  } else {
+    memcpy(pfx->addr, pfxs->addrs6[idx], sizeof(pfx->addr));
+  }
+  pfx->path_id = pfxs->has_path_ids ? pfxs->path_ids[idx] : 0;
+}
+
+void
+parsebgp_bgp_prefixes_compact_destroy(parsebgp_bgp_prefixes_compact_t *pfxs)
+{
+  free(pfxs->lens);
+  free(pfxs->addrs4);
+  free(pfxs->addrs6);
+  free(pfxs->path_ids);
+  memset(pfxs, 0, sizeof(*pfxs));
+}
+
+void parsebgp_bgp_prefixes_compact_mem_usage(
+  const parsebgp_bgp_prefixes_compact_t *pfxs, parsebgp_mem_usage_t *usage)
+{
+  PARSEBGP_MEM_ADD(usage, prefixes,
+                   (sizeof(*pfxs->lens) * pfxs->_lens_alloc_cnt) +
+                     (sizeof(*pfxs->addrs4) * pfxs->_addrs4_alloc_cnt) +
+                     (sizeof(*pfxs->addrs6) * pfxs->_addrs6_alloc_cnt) +
+                     (sizeof(*pfxs->path_ids) * pfxs->_path_ids_alloc_cnt));
+}
+
+void parsebgp_bgp_prefixes_compact_trim(parsebgp_bgp_prefixes_compact_t *pfxs)
+{
+  // only the address array of the current AFI is in use
+  PARSEBGP_MAYBE_SHRINK(pfxs->lens, pfxs->_lens_alloc_cnt, pfxs->cnt);
+  PARSEBGP_MAYBE_SHRINK(pfxs->addrs4, pfxs->_addrs4_alloc_cnt,
+                        pfxs->afi == PARSEBGP_BGP_AFI_IPV4 ? pfxs->cnt : 0);
+  PARSEBGP_MAYBE_SHRINK(pfxs->addrs6, pfxs->_addrs6_alloc_cnt,
+                        pfxs->afi == PARSEBGP_BGP_AFI_IPV6 ? pfxs->cnt : 0);
+  PARSEBGP_MAYBE_SHRINK(pfxs->path_ids, pfxs->_path_ids_alloc_cnt,
+                        pfxs->has_path_ids ? pfxs->cnt : 0);
+}
+
+void parsebgp_bgp_prefixes_compact_dump(
+  const parsebgp_bgp_prefixes_compact_t *pfxs, int depth)
+{
+  parsebgp_bgp_prefix_t pfx;
+  int i;
+
+  PARSEBGP_DUMP_STRUCT_HDR(parsebgp_bgp_prefixes_compact_t, depth);
+
+  PARSEBGP_DUMP_INT(depth, "Type", pfxs->type);
+  PARSEBGP_DUMP_INT(depth, "AFI", pfxs->afi);
+  PARSEBGP_DUMP_INT(depth, "SAFI", pfxs->safi);
+  PARSEBGP_DUMP_INT(depth, "Prefixes Count", pfxs->cnt);
+
+  for (i = 0; i < pfxs->cnt; i++) {
+    parsebgp_bgp_prefixes_compact_get(pfxs, i, &pfx);
+    PARSEBGP_DUMP_PFX(depth, "Prefix", pfx.afi, pfx.addr, pfx.len);
+    if (pfxs->has_path_ids) {
+      PARSEBGP_DUMP_INT(depth, "Path ID", pfx.path_id);
+    }
+  }
+}
 
 void parsebgp_bgp_prefixes_dump(parsebgp_bgp_prefix_t *prefixes,
                                 int prefixes_cnt, int depth)
@@ -41,5 +300,6 @@ void parsebgp_bgp_prefixes_dump(parsebgp_bgp_prefix_t *prefixes,
     PARSEBGP_DUMP_INT(depth, "AFI", tuple->afi);
     PARSEBGP_DUMP_INT(depth, "SAFI", tuple->safi);
     PARSEBGP_DUMP_PFX(depth, "Prefix", tuple->afi, tuple->addr, tuple->len);
+    PARSEBGP_DUMP_INT(depth, "Path ID", tuple->path_id);
   }
 }
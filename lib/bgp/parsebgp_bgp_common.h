@@ -102,6 +102,76 @@ typedef struct parsebgp_bgp_prefix {
   /** Prefix Address */
   uint8_t addr[16];
 
+  /** ADD-PATH Path Identifier (RFC 7911), or 0 if the NLRI did not carry one
+      (see the add_path BGP option) */
+  uint32_t path_id;
+
 } parsebgp_bgp_prefix_t;
 
+/**
+ * Compact array of prefixes that share a type, AFI and SAFI
+ *
+ * When the compact_prefixes BGP option is set, NLRI are decoded into this
+ * structure instead of an array of parsebgp_bgp_prefix_t. The type, AFI and
+ * SAFI are stored once, and the addresses are stored in a separate array per
+ * AFI, so each IPv4 prefix takes 5 bytes (and each IPv6 prefix 17 bytes),
+ * plus 4 bytes for the Path Identifier when ADD-PATH is in use.
+ */
+typedef struct parsebgp_bgp_prefixes_compact {
+
+  /** Prefix Type (parsebgp_bgp_prefix_type_t) of all prefixes */
+  uint8_t type;
+
+  /** AFI of all prefixes */
+  uint16_t afi;
+
+  /** SAFI of all prefixes */
+  uint8_t safi;
+
+  /** Do the prefixes have ADD-PATH Path Identifiers (in path_ids)? */
+  uint8_t has_path_ids;
+
+  /** Number of prefixes */
+  int cnt;
+
+  /** Array of (cnt) prefix lengths */
+  uint8_t *lens;
+
+  /** Number of allocated prefix lengths (INTERNAL) */
+  int _lens_alloc_cnt;
+
+  /** Array of (cnt) IPv4 addresses in host byte order, with the bits past the
+      prefix length cleared (only used if afi is PARSEBGP_BGP_AFI_IPV4) */
+  uint32_t *addrs4;
+
+  /** Number of allocated IPv4 addresses (INTERNAL) */
+  int _addrs4_alloc_cnt;
+
+  /** Array of (cnt) IPv6 addresses, with the bits past the prefix length
+      cleared (only used if afi is PARSEBGP_BGP_AFI_IPV6) */
+  uint8_t (*addrs6)[16];
+
+  /** Number of allocated IPv6 addresses (INTERNAL) */
+  int _addrs6_alloc_cnt;
+
+  /** Array of (cnt) ADD-PATH Path Identifiers (only used if has_path_ids is
+      set) */
+  uint32_t *path_ids;
+
+  /** Number of allocated Path Identifiers (INTERNAL) */
+  int _path_ids_alloc_cnt;
+
+} parsebgp_bgp_prefixes_compact_t;
+
+/**
+ * Get a prefix from a compact array of prefixes
+ *
+ * @param pfxs          Pointer to the compact array
+ * @param idx           Index of the prefix to get (less than pfxs->cnt)
+ * @param [out] pfx     Filled with the prefix
+ */
+void
+parsebgp_bgp_prefixes_compact_get(const parsebgp_bgp_prefixes_compact_t *pfxs,
+                                  int idx, parsebgp_bgp_prefix_t *pfx);
+
 #endif /* __PARSEBGP_BGP_COMMON_H */
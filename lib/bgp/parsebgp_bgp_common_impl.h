@@ -28,6 +28,61 @@
 #define __PARSEBGP_BGP_COMMON_IMPL_H
 
 #include "parsebgp_bgp_common.h"
+#include "parsebgp_error.h"
+#include "parsebgp_mem.h"
+#include "parsebgp_opts.h"
+#include <stddef.h>
+
+/**
+ * Check the framing of a list of prefixes without decoding it
+ *
+ * @param buf           Pointer to the first prefix
+ * @param len           Length of the list (all of which must be in the buffer)
+ * @param max_pfx_len   Maximum prefix length (32 or 128)
+ * @param add_path      Is each prefix preceded by a 4-byte Path Identifier?
+ * @return the number of prefixes in the list, or -1 if a prefix is too long
+ * or the prefixes do not exactly fill the list
+ *
+ * This is a single pass over the prefix lengths, so malformed lists are
+ * rejected before anything is allocated or copied.
+ */
+int parsebgp_bgp_prefixes_validate(const uint8_t *buf, size_t len,
+                                   uint8_t max_pfx_len, int add_path);
+
+/**
+ * Charge a list of prefixes that has been checked by
+ * parsebgp_bgp_prefixes_validate against the decode budgets
+ *
+ * @param opts          Options for the current decode
+ * @param buf           Pointer to the first prefix
+ * @param prefixes_cnt  Number of prefixes (as returned by the validation)
+ * @param add_path      Is each prefix preceded by a 4-byte Path Identifier?
+ * @return the number of prefixes (from the start of the list) to decode
+ *
+ * If this is less than prefixes_cnt, the caller should decode only that many,
+ * and then return PARSEBGP_BUDGET_EXCEEDED.
+ */
+int parsebgp_bgp_prefixes_budget(parsebgp_opts_t *opts, const uint8_t *buf,
+                                 int prefixes_cnt, int add_path);
+
+/**
+ * Decode a list of prefixes that has been checked by
+ * parsebgp_bgp_prefixes_validate
+ *
+ * @param prefixes      Array to decode into (with room for prefixes_cnt)
+ * @param prefixes_cnt  Number of prefixes (as returned by the validation)
+ * @param type          Prefix type to set (parsebgp_bgp_prefix_type_t)
+ * @param afi           AFI to set
+ * @param safi          SAFI to set
+ * @param add_path      Is each prefix preceded by a 4-byte Path Identifier?
+ * @param buf           Pointer to the first prefix
+ *
+ * No bounds checks are done, so this MUST only be used on a validated list.
+ */
+void parsebgp_bgp_prefixes_decode_trusted(parsebgp_bgp_prefix_t *prefixes,
+                                          int prefixes_cnt, uint8_t type,
+                                          uint16_t afi, uint8_t safi,
+                                          int add_path, const uint8_t *buf);
 
 /**
  * Dump a human-readable version of the given array of prefixes to stdout
@@ -39,4 +94,49 @@
 void parsebgp_bgp_prefixes_dump(parsebgp_bgp_prefix_t *prefixes,
                                 int prefixes_cnt, int depth);
 
+/**
+ * Decode a list of prefixes that has been checked by
+ * parsebgp_bgp_prefixes_validate into a compact array
+ *
+ * @param pfxs          Compact array to decode into
+ * @param prefixes_cnt  Number of prefixes (as returned by the validation)
+ * @param type          Prefix type to set (parsebgp_bgp_prefix_type_t)
+ * @param afi           AFI to set (PARSEBGP_BGP_AFI_IPV4 or _IPV6)
+ * @param safi          SAFI to set
+ * @param add_path      Is each prefix preceded by a 4-byte Path Identifier?
+ * @param buf           Pointer to the first prefix
+ * @return PARSEBGP_OK, or PARSEBGP_MALLOC_FAILURE
+ *
+ * No bounds checks are done, so this MUST only be used on a validated list.
+ */
+parsebgp_error_t parsebgp_bgp_prefixes_compact_decode_trusted(
+  parsebgp_bgp_prefixes_compact_t *pfxs, int prefixes_cnt, uint8_t type,
+  uint16_t afi, uint8_t safi, int add_path, const uint8_t *buf);
+
+/**
+ * Free the arrays of the given compact array of prefixes (but not the
+ * structure itself)
+ *
+ * @param pfxs          Compact array to destroy
+ */
+void
+parsebgp_bgp_prefixes_compact_destroy(parsebgp_bgp_prefixes_compact_t *pfxs);
+
+/** Add the memory held by a compact array of prefixes to the given usage
+    counters */
+void parsebgp_bgp_prefixes_compact_mem_usage(
+  const parsebgp_bgp_prefixes_compact_t *pfxs, parsebgp_mem_usage_t *usage);
+
+/** Shrink the arrays of a compact array of prefixes to its current length */
+void parsebgp_bgp_prefixes_compact_trim(parsebgp_bgp_prefixes_compact_t *pfxs);
+
+/**
+ * Dump a human-readable version of the given compact array of prefixes
+ *
+ * @param pfxs          Compact array to dump
+ * @param depth         Depth of the message within the overall message
+ */
+void parsebgp_bgp_prefixes_compact_dump(
+  const parsebgp_bgp_prefixes_compact_t *pfxs, int depth);
+
 #endif /* __PARSEBGP_BGP_COMMON_IMPL_H */
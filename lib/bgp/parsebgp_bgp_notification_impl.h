@@ -29,6 +29,7 @@
 
 #include "parsebgp_bgp_notification.h"
 #include "parsebgp_error.h"
+#include "parsebgp_mem.h"
 #include "parsebgp_opts.h"
 #include <stddef.h>
 
@@ -44,6 +45,14 @@ void parsebgp_bgp_notification_destroy(parsebgp_bgp_notification_t *msg);
 /** Clear a NOTIFICATION message */
 void parsebgp_bgp_notification_clear(parsebgp_bgp_notification_t *msg);
 
+/** Add the memory held by a NOTIFICATION message to the given usage counters */
+void parsebgp_bgp_notification_mem_usage(const parsebgp_bgp_notification_t *msg,
+                                         parsebgp_mem_usage_t *usage);
+
+/** Release memory held by a NOTIFICATION message beyond what it currently
+    uses */
+void parsebgp_bgp_notification_trim(parsebgp_bgp_notification_t *msg);
+
 /**
  * Dump a human-readable version of the message to stdout
  *
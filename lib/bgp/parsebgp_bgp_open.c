@@ -38,12 +38,16 @@ static parsebgp_error_t parse_capabilities(parsebgp_opts_t *opts,
 {
   size_t len = *lenp, nread = 0;
   parsebgp_bgp_open_capability_t *cap;
+  parsebgp_bgp_open_capability_add_path_afi_safi_t *as;
+  int i;
 
   while ((remain - nread) > 0) {
 
     PARSEBGP_MAYBE_REALLOC(msg->capabilities,
       msg->_capabilities_alloc_cnt, msg->capabilities_cnt + 1);
     cap = &msg->capabilities[msg->capabilities_cnt++];
+    // (clear/destroy look at the values of a partially parsed capability)
+    memset(&cap->values, 0, sizeof(cap->values));
 
     // Code
     PARSEBGP_DESERIALIZE_UINT8(buf, len, nread, cap->code);
@@ -82,6 +86,37 @@ static parsebgp_error_t parse_capabilities(parsebgp_opts_t *opts,
       PARSEBGP_DESERIALIZE_UINT32(buf, len, nread, cap->values.asn);
       break;
 
+    case PARSEBGP_BGP_OPEN_CAPABILITY_ADD_PATH:
+      if ((cap->len % 4) != 0) {
+        PARSEBGP_SKIP_INVALID_MSG(opts, buf, nread, cap->len,
+                                  "Unexpected ADD-PATH OPEN Capability length "
+                                  "(%d), expecting a multiple of 4 bytes",
+                                  cap->len);
+        continue;
+      }
+      if (cap->len == 0) {
+        break;
+      }
+      if ((cap->values.add_path.afi_safis =
+             malloc((cap->len / 4) * sizeof(*as))) == NULL) {
+        return PARSEBGP_MALLOC_FAILURE;
+      }
+      for (i = 0; i < cap->len / 4; i++) {
+        as = &cap->values.add_path.afi_safis[i];
+
+        // AFI
+        PARSEBGP_DESERIALIZE_UINT16(buf, len, nread, as->afi);
+
+        // SAFI
+        PARSEBGP_DESERIALIZE_UINT8(buf, len, nread, as->safi);
+
+        // Send/Receive
+        PARSEBGP_DESERIALIZE_UINT8(buf, len, nread, as->send_receive);
+
+        cap->values.add_path.afi_safis_cnt++;
+      }
+      break;
+
     case PARSEBGP_BGP_OPEN_CAPABILITY_ROUTE_REFRESH:
     case PARSEBGP_BGP_OPEN_CAPABILITY_ROUTE_REFRESH_ENHANCED:
     case PARSEBGP_BGP_OPEN_CAPABILITY_ROUTE_REFRESH_OLD:
@@ -219,6 +254,8 @@ void parsebgp_bgp_open_destroy(parsebgp_bgp_open_t *msg)
       (cap)->len > sizeof(cap->values.databuf) && (cap)->values.datap)
     {
       free(cap->values.datap);
+    } else if (cap->code == PARSEBGP_BGP_OPEN_CAPABILITY_ADD_PATH) {
+      free(cap->values.add_path.afi_safis);
     }
   }
   free(msg->capabilities);
@@ -241,13 +278,62 @@ void parsebgp_bgp_open_clear(parsebgp_bgp_open_t *msg)
     {
       free(cap->values.datap);
       cap->values.datap = NULL;
+    } else if (cap->code == PARSEBGP_BGP_OPEN_CAPABILITY_ADD_PATH) {
+      free(cap->values.add_path.afi_safis);
+      cap->values.add_path.afi_safis = NULL;
+      cap->values.add_path.afi_safis_cnt = 0;
     }
   }
   msg->capabilities_cnt = 0;
 }
 
+void parsebgp_bgp_open_mem_usage(const parsebgp_bgp_open_t *msg,
+                                 parsebgp_mem_usage_t *usage)
+{
+  const parsebgp_bgp_open_capability_t *cap;
+  int i;
+
+  if (msg == NULL) {
+    return;
+  }
+
+  PARSEBGP_MEM_ADD(usage, structs, sizeof(*msg));
+  PARSEBGP_MEM_ADD(usage, other,
+                   sizeof(*msg->capabilities) * msg->_capabilities_alloc_cnt);
+
+  // only capabilities that are in use hold dynamic memory (see clear)
+  for (i = 0; i < msg->capabilities_cnt; i++) {
+    cap = &msg->capabilities[i];
+    if (BGPSTREAM_OPEN_CAPABILITY_IS_RAW(cap) &&
+      (cap)->len > sizeof(cap->values.databuf) && (cap)->values.datap)
+    {
+      PARSEBGP_MEM_ADD(usage, raw, cap->len);
+    } else if (cap->code == PARSEBGP_BGP_OPEN_CAPABILITY_ADD_PATH) {
+      PARSEBGP_MEM_ADD(usage, other,
+                       sizeof(*cap->values.add_path.afi_safis) *
+                         cap->values.add_path.afi_safis_cnt);
+    }
+  }
+}
+
+void parsebgp_bgp_open_trim(parsebgp_bgp_open_t *msg)
+{
+  if (msg == NULL) {
+    return;
+  }
+
+  // capability data is allocated to size, so only the array can shrink
+  PARSEBGP_MAYBE_SHRINK(msg->capabilities, msg->_capabilities_alloc_cnt,
+                        msg->capabilities_cnt);
+}
+
 void parsebgp_bgp_open_dump(const parsebgp_bgp_open_t *msg, int depth)
 {
+  parsebgp_bgp_open_capability_t *cap;
+  const parsebgp_bgp_open_capability_add_path_afi_safi_t *as;
+  uint8_t *data;
+  int i, j;
+
   PARSEBGP_DUMP_STRUCT_HDR(parsebgp_bgp_open_t, depth);
 
   PARSEBGP_DUMP_INT(depth, "Version", msg->version);
@@ -257,9 +343,7 @@ void parsebgp_bgp_open_dump(const parsebgp_bgp_open_t *msg, int depth)
   PARSEBGP_DUMP_INT(depth, "Parameters Length", msg->param_len);
   PARSEBGP_DUMP_INT(depth, "Capabilities Count", msg->capabilities_cnt);
   depth++;
-  parsebgp_bgp_open_capability_t *cap;
-  uint8_t *data;
-  for (int i = 0; i < msg->capabilities_cnt; i++) {
+  for (i = 0; i < msg->capabilities_cnt; i++) {
     cap = &msg->capabilities[i];
 
     PARSEBGP_DUMP_STRUCT_HDR(parsebgp_bgp_open_capability_t, depth);
@@ -281,6 +365,19 @@ void parsebgp_bgp_open_dump(const parsebgp_bgp_open_t *msg, int depth)
       PARSEBGP_DUMP_INT(depth, "AS4 ASN", cap->values.asn);
       break;
 
+    case PARSEBGP_BGP_OPEN_CAPABILITY_ADD_PATH:
+      for (j = 0; j < cap->values.add_path.afi_safis_cnt; j++) {
+        as = &cap->values.add_path.afi_safis[j];
+
+        PARSEBGP_DUMP_STRUCT_HDR(
+          parsebgp_bgp_open_capability_add_path_afi_safi_t, depth);
+
+        PARSEBGP_DUMP_INT(depth, "AFI", as->afi);
+        PARSEBGP_DUMP_INT(depth, "SAFI", as->safi);
+        PARSEBGP_DUMP_INT(depth, "Send/Receive", as->send_receive);
+      }
+      break;
+
     default:
       data = BGPSTREAM_OPEN_CAPABILITY_RAW_DATA(cap);
       if (data) {
@@ -53,7 +53,8 @@ typedef enum {
   /** Multisession BGP Capability */
   PARSEBGP_BGP_OPEN_CAPABILITY_MULTI_SESSION = 68,
 
-  // TODO: add ADD-PATH capability
+  /** Advertisement of Multiple Paths (ADD-PATH) Capability */
+  PARSEBGP_BGP_OPEN_CAPABILITY_ADD_PATH = 69,
 
   /** Enhanced Route Refresh Capability */
   PARSEBGP_BGP_OPEN_CAPABILITY_ROUTE_REFRESH_ENHANCED = 70,
@@ -82,6 +83,51 @@ typedef struct parsebgp_bgp_open_capability_mpbgp {
 
 } parsebgp_bgp_open_capability_mpbgp_t;
 
+/**
+ * ADD-PATH Send/Receive values (RFC 7911)
+ */
+typedef enum {
+
+  /** Able to receive multiple paths */
+  PARSEBGP_BGP_OPEN_ADD_PATH_RECEIVE = 1,
+
+  /** Able to send multiple paths */
+  PARSEBGP_BGP_OPEN_ADD_PATH_SEND = 2,
+
+  /** Able to both send and receive multiple paths */
+  PARSEBGP_BGP_OPEN_ADD_PATH_SEND_RECEIVE = 3,
+
+} parsebgp_bgp_open_add_path_send_receive_t;
+
+/**
+ * ADD-PATH Capability AFI/SAFI
+ */
+typedef struct parsebgp_bgp_open_capability_add_path_afi_safi {
+
+  /** AFI */
+  uint16_t afi;
+
+  /** SAFI */
+  uint8_t safi;
+
+  /** Send/Receive (parsebgp_bgp_open_add_path_send_receive_t) */
+  uint8_t send_receive;
+
+} parsebgp_bgp_open_capability_add_path_afi_safi_t;
+
+/**
+ * ADD-PATH Capability
+ */
+typedef struct parsebgp_bgp_open_capability_add_path {
+
+  /** Array of (afi_safis_cnt) AFI/SAFIs */
+  parsebgp_bgp_open_capability_add_path_afi_safi_t *afi_safis;
+
+  /** Number of AFI/SAFIs */
+  int afi_safis_cnt;
+
+} parsebgp_bgp_open_capability_add_path_t;
+
 /**
  * BGP Capability
  */
@@ -102,6 +148,9 @@ typedef struct parsebgp_bgp_open_capability {
     /** AS4 Capability */
     uint32_t asn;
 
+    /** ADD-PATH Capability */
+    parsebgp_bgp_open_capability_add_path_t add_path;
+
     /** Raw data; access via BGPSTREAM_OPEN_CAPABILITY_RAW_DATA() */
     uint8_t *datap;
 
@@ -116,7 +165,8 @@ typedef struct parsebgp_bgp_open_capability {
 #define BGPSTREAM_OPEN_CAPABILITY_IS_RAW(cap)                                  \
   ((cap)->len > 0 &&                                                           \
    (cap)->code != PARSEBGP_BGP_OPEN_CAPABILITY_MPBGP &&                        \
-   (cap)->code != PARSEBGP_BGP_OPEN_CAPABILITY_AS4)
+   (cap)->code != PARSEBGP_BGP_OPEN_CAPABILITY_AS4 &&                          \
+   (cap)->code != PARSEBGP_BGP_OPEN_CAPABILITY_ADD_PATH)
 
 /** Get pointer to capability's raw data, or NULL if capability does not have
  * raw data. */
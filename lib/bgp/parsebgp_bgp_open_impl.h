@@ -29,6 +29,7 @@
 
 #include "parsebgp_bgp_open.h"
 #include "parsebgp_error.h"
+#include "parsebgp_mem.h"
 #include "parsebgp_opts.h"
 #include <stddef.h>
 
@@ -44,6 +45,13 @@ void parsebgp_bgp_open_destroy(parsebgp_bgp_open_t *msg);
 /** Clear an OPEN message */
 void parsebgp_bgp_open_clear(parsebgp_bgp_open_t *msg);
 
+/** Add the memory held by an OPEN message to the given usage counters */
+void parsebgp_bgp_open_mem_usage(const parsebgp_bgp_open_t *msg,
+                                 parsebgp_mem_usage_t *usage);
+
+/** Release memory held by an OPEN message beyond what it currently uses */
+void parsebgp_bgp_open_trim(parsebgp_bgp_open_t *msg);
+
 /**
  * Dump a human-readable version of the message to stdout
  *
@@ -25,9 +25,49 @@
  */
 
 #include "parsebgp_bgp_opts.h"
+#include "parsebgp_bgp_opts_impl.h"
 #include <string.h>
 
 void parsebgp_bgp_opts_init(parsebgp_bgp_opts_t *opts)
 {
   memset(opts, 0, sizeof(*opts));
 }
+
+void parsebgp_bgp_path_attr_actions_init(uint8_t *actions,
+                                         const parsebgp_bgp_opts_t *opts)
+{
+  int type;
+
+  // the filter and raw arrays have no entry for the last type
+  for (type = 0; type < PARSEBGP_BGP_PATH_ATTR_TYPE_CNT; type++) {
+    if (opts->path_attr_filter_enabled &&
+        (type >= UINT8_MAX || opts->path_attr_filter[type] == 0)) {
+      actions[type] = PARSEBGP_BGP_PATH_ATTR_ACTION_SKIP;
+    } else if (opts->path_attr_raw_enabled && type < UINT8_MAX &&
+               opts->path_attr_raw[type] != 0) {
+      actions[type] = PARSEBGP_BGP_PATH_ATTR_ACTION_RAW;
+    } else {
+      actions[type] = PARSEBGP_BGP_PATH_ATTR_ACTION_DECODE;
+    }
+  }
+}
+
+void parsebgp_bgp_path_attr_table_init(parsebgp_bgp_path_attr_table_t *table,
+                                       const parsebgp_bgp_opts_t *opts)
+{
+  memset(table, 0, sizeof(*table));
+  parsebgp_bgp_path_attr_actions_init(table->opts_actions, opts);
+  memcpy(table->actions, table->opts_actions, sizeof(table->actions));
+}
+
+void parsebgp_bgp_path_attr_table_set_handler(
+  parsebgp_bgp_path_attr_table_t *table, uint8_t type,
+  parsebgp_bgp_path_attr_handler_t *handler, void *user)
+{
+  table->handlers[type] = handler;
+  table->handler_users[type] = user;
+  // without a handler, go back to what the options say to do with the type
+  table->actions[type] = (handler != NULL)
+                           ? PARSEBGP_BGP_PATH_ATTR_ACTION_HANDLER
+                           : table->opts_actions[type];
+}
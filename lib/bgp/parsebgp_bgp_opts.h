@@ -27,7 +27,90 @@
 #ifndef __PARSEBGP_BGP_OPTS_H
 #define __PARSEBGP_BGP_OPTS_H
 
+#include "parsebgp_error.h"
 #include <inttypes.h>
+#include <stddef.h>
+
+/** Size of each dimension of the ADD-PATH table (indexed by AFI and SAFI, so
+    IPv4/IPv6 Unicast/Multicast fit, and index 0 is unused) */
+#define PARSEBGP_BGP_OPTS_ADD_PATH_CNT 3
+
+/** Do NLRI of the given AFI/SAFI carry ADD-PATH Path Identifiers? */
+#define PARSEBGP_BGP_OPTS_ADD_PATH(bgp_opts, afi, safi)                        \
+  ((afi) < PARSEBGP_BGP_OPTS_ADD_PATH_CNT &&                                   \
+   (safi) < PARSEBGP_BGP_OPTS_ADD_PATH_CNT && (bgp_opts)->add_path[afi][safi])
+
+/** Number of Path Attribute types (the type is a single byte) */
+#define PARSEBGP_BGP_PATH_ATTR_TYPE_CNT (UINT8_MAX + 1)
+
+/**
+ * What to do with a Path Attribute of a given type (see
+ * parsebgp_bgp_path_attr_table_t)
+ */
+typedef enum {
+
+  /** Decode the attribute into the parsed message (the default). Types that
+      the library does not know are skipped. */
+  PARSEBGP_BGP_PATH_ATTR_ACTION_DECODE = 0,
+
+  /** Store a copy of the raw attribute data (for the types that support this,
+      see path_attr_raw_enabled), otherwise decode the attribute */
+  PARSEBGP_BGP_PATH_ATTR_ACTION_RAW = 1,
+
+  /** Skip the attribute */
+  PARSEBGP_BGP_PATH_ATTR_ACTION_SKIP = 2,
+
+  /** Pass the attribute to the handler registered for its type. The attribute
+      is not stored in the parsed message. */
+  PARSEBGP_BGP_PATH_ATTR_ACTION_HANDLER = 3,
+
+} parsebgp_bgp_path_attr_action_t;
+
+/**
+ * Path Attribute handler
+ *
+ * @param user          User pointer given when the handler was registered
+ * @param flags         Attribute Flags
+ * @param type          Attribute Type
+ * @param buf           Pointer to the attribute data
+ * @param len           Length of the attribute data (which is always entirely
+ *                      in the buffer)
+ * @return PARSEBGP_OK if the attribute was handled, or an error code, which
+ * aborts decoding of the message and is returned to the caller
+ */
+typedef parsebgp_error_t(parsebgp_bgp_path_attr_handler_t)(void *user,
+                                                           uint8_t flags,
+                                                           uint8_t type,
+                                                           const uint8_t *buf,
+                                                           size_t len);
+
+/**
+ * Path Attribute dispatch table
+ *
+ * Gives the action to take for each Path Attribute type, so that decoding an
+ * attribute costs a single lookup whatever the options are. Initialize it with
+ * parsebgp_bgp_path_attr_table_init (which compiles the filter and raw
+ * options), adjust it, and then set the path_attr_table option to point to it.
+ */
+typedef struct parsebgp_bgp_path_attr_table {
+
+  /** Action for each type (parsebgp_bgp_path_attr_action_t) */
+  uint8_t actions[PARSEBGP_BGP_PATH_ATTR_TYPE_CNT];
+
+  /** Action for each type that the filter and raw options given to
+      parsebgp_bgp_path_attr_table_init imply (restored when a handler is
+      removed) */
+  uint8_t opts_actions[PARSEBGP_BGP_PATH_ATTR_TYPE_CNT];
+
+  /** Handler for each type whose action is HANDLER (decoding a message fails
+      with PARSEBGP_INVALID_OPTS if an attribute's action is HANDLER but it has
+      no handler) */
+  parsebgp_bgp_path_attr_handler_t *handlers[PARSEBGP_BGP_PATH_ATTR_TYPE_CNT];
+
+  /** User pointer passed to each handler */
+  void *handler_users[PARSEBGP_BGP_PATH_ATTR_TYPE_CNT];
+
+} parsebgp_bgp_path_attr_table_t;
 
 /**
  * BGP Parsing Options
@@ -62,6 +145,16 @@ typedef struct parsebgp_bgp_opts {
    */
   int asn_4_byte;
 
+  /**
+   * Is the asn_4_byte setting known to be correct?
+   *
+   * By default, if an AS_PATH attribute fails to parse with 4-byte AS numbers,
+   * it is parsed again with 2-byte AS numbers in case the caller was mistaken.
+   * If this is set (e.g., because 4-byte support was negotiated on the
+   * session), the AS_PATH is only parsed once.
+   */
+  int asn_4_byte_trusted;
+
   /**
    * Has the AFI and SAFI been omitted from the MP_REACH attribute?
    *
@@ -99,6 +192,20 @@ typedef struct parsebgp_bgp_opts {
    */
   uint8_t path_attr_filter[UINT8_MAX];
 
+  /**
+   * Path Attribute dispatch table
+   *
+   * If set, the action to take for each Path Attribute type is read from this
+   * table, and the path_attr_filter and path_attr_raw options are ignored (but
+   * see parsebgp_bgp_path_attr_table_init). The table is owned by the caller,
+   * and must not be changed while messages are being decoded with it.
+   *
+   * If not set, but path_attr_filter_enabled or path_attr_raw_enabled is, those
+   * options are compiled into actions for every UPDATE decoded, so callers that
+   * decode many messages with them should build a table once instead.
+   */
+  const parsebgp_bgp_path_attr_table_t *path_attr_table;
+
   /**
    * Should some (select) UPDATE Path Attributes be parsed only in a superficial
    * manner?
@@ -128,6 +235,43 @@ typedef struct parsebgp_bgp_opts {
    */
   uint8_t path_attr_raw[UINT8_MAX];
 
+  /**
+   * Copy the raw Path Attributes data into the parsed message structure.
+   *
+   * If set, the raw bytes of all Path Attributes (other than MP_REACH_NLRI and
+   * MP_UNREACH_NLRI) are copied to the raw field of the Path Attributes
+   * structure. This allows users to cheaply compare or hash the attributes of
+   * a path (e.g., to intern them) without visiting the parsed attributes.
+   */
+  int path_attrs_copy_raw;
+
+  /**
+   * AFI/SAFIs whose NLRI carry ADD-PATH Path Identifiers (RFC 7911)
+   *
+   * If add_path[AFI][SAFI] is set, each prefix of that AFI/SAFI (in the
+   * withdrawn routes, NLRI, MP_REACH_NLRI and MP_UNREACH_NLRI fields) is
+   * expected to be preceded by a 4-byte Path Identifier, which is stored in the
+   * path_id field of the prefix. Whether Path Identifiers are sent is
+   * negotiated per session, so this must be set by the caller (or by the BMP
+   * decoder, if it has a peer table).
+   */
+  uint8_t add_path[PARSEBGP_BGP_OPTS_ADD_PATH_CNT]
+                  [PARSEBGP_BGP_OPTS_ADD_PATH_CNT];
+
+  /**
+   * Decode NLRI into compact prefix arrays.
+   *
+   * If set, the prefixes of the withdrawn routes, NLRI, MP_REACH_NLRI and
+   * MP_UNREACH_NLRI fields are stored in the compact field of the
+   * corresponding structure (see parsebgp_bgp_prefixes_compact_t) rather than
+   * in an array of parsebgp_bgp_prefix_t (whose count is then always 0). Since
+   * all prefixes of a field share an AFI and SAFI, this stores IPv4 prefixes
+   * in about a quarter of the memory. Note that in this mode a truncated
+   * prefix list is not decoded at all (the PARTIAL_MSG error is returned
+   * before any prefix is stored).
+   */
+  int compact_prefixes;
+
 } parsebgp_bgp_opts_t;
 
 /**
@@ -137,4 +281,31 @@ typedef struct parsebgp_bgp_opts {
  */
 void parsebgp_bgp_opts_init(parsebgp_bgp_opts_t *opts);
 
+/**
+ * Initialize a Path Attribute dispatch table from the given options
+ *
+ * @param table         pointer to the table to initialize
+ * @param opts          pointer to the options whose path_attr_filter and
+ *                      path_attr_raw settings are compiled into the table
+ *
+ * Types that are filtered out are set to SKIP, types that are raw-parsed are
+ * set to RAW, and all other types are set to DECODE.
+ */
+void parsebgp_bgp_path_attr_table_init(parsebgp_bgp_path_attr_table_t *table,
+                                       const parsebgp_bgp_opts_t *opts);
+
+/**
+ * Register a handler for a Path Attribute type
+ *
+ * @param table         pointer to the table to update
+ * @param type          Path Attribute type to handle
+ * @param handler       handler to call for each attribute of the type, or NULL
+ *                      to go back to the action that the options given to
+ *                      parsebgp_bgp_path_attr_table_init imply for the type
+ * @param user          user pointer to pass to the handler
+ */
+void parsebgp_bgp_path_attr_table_set_handler(
+  parsebgp_bgp_path_attr_table_t *table, uint8_t type,
+  parsebgp_bgp_path_attr_handler_t *handler, void *user);
+
 #endif /* __PARSEBGP_BGP_OPTS_H */
@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) 2017 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __PARSEBGP_BGP_OPTS_IMPL_H
+#define __PARSEBGP_BGP_OPTS_IMPL_H
+
+#include "parsebgp_bgp_opts.h"
+#include <stdint.h>
+
+/**
+ * Compile the path_attr_filter and path_attr_raw options into an action for
+ * each Path Attribute type
+ *
+ * @param actions       array of PARSEBGP_BGP_PATH_ATTR_TYPE_CNT actions to fill
+ * @param opts          pointer to the options to compile
+ *
+ * This is the only place that the options are mapped to actions, both for
+ * parsebgp_bgp_path_attr_table_init and for decoding without a table.
+ */
+void parsebgp_bgp_path_attr_actions_init(uint8_t *actions,
+                                         const parsebgp_bgp_opts_t *opts);
+
+#endif /* __PARSEBGP_BGP_OPTS_IMPL_H */
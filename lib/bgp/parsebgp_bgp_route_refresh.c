@@ -76,6 +76,26 @@ void parsebgp_bgp_route_refresh_clear(parsebgp_bgp_route_refresh_t *msg)
   msg->data_len = 0;
 }
 
+void parsebgp_bgp_route_refresh_mem_usage(
+  const parsebgp_bgp_route_refresh_t *msg, parsebgp_mem_usage_t *usage)
+{
+  if (msg == NULL) {
+    return;
+  }
+
+  PARSEBGP_MEM_ADD(usage, structs, sizeof(*msg));
+  PARSEBGP_MEM_ADD(usage, raw, msg->_data_alloc_len);
+}
+
+void parsebgp_bgp_route_refresh_trim(parsebgp_bgp_route_refresh_t *msg)
+{
+  if (msg == NULL) {
+    return;
+  }
+
+  PARSEBGP_MAYBE_SHRINK(msg->data, msg->_data_alloc_len, msg->data_len);
+}
+
 void parsebgp_bgp_route_refresh_dump(const parsebgp_bgp_route_refresh_t *msg,
                                      int depth)
 {
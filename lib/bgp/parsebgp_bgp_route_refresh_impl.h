@@ -29,6 +29,7 @@
 
 #include "parsebgp_bgp_route_refresh.h"
 #include "parsebgp_error.h"
+#include "parsebgp_mem.h"
 #include "parsebgp_opts.h"
 #include <stddef.h>
 
@@ -44,6 +45,15 @@ void parsebgp_bgp_route_refresh_destroy(parsebgp_bgp_route_refresh_t *msg);
 /** Clear a ROUTE REFRESH message */
 void parsebgp_bgp_route_refresh_clear(parsebgp_bgp_route_refresh_t *msg);
 
+/** Add the memory held by a ROUTE-REFRESH message to the given usage
+    counters */
+void parsebgp_bgp_route_refresh_mem_usage(
+  const parsebgp_bgp_route_refresh_t *msg, parsebgp_mem_usage_t *usage);
+
+/** Release memory held by a ROUTE-REFRESH message beyond what it currently
+    uses */
+void parsebgp_bgp_route_refresh_trim(parsebgp_bgp_route_refresh_t *msg);
+
 /**
  * Dump a human-readable version of the message to stdout
  *
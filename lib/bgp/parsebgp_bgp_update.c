@@ -25,6 +25,7 @@
  */
 
 #include "parsebgp_bgp_common_impl.h"
+#include "parsebgp_bgp_opts_impl.h"
 #include "parsebgp_bgp_update_impl.h"
 #include "parsebgp_error.h"
 #include "parsebgp_utils.h"
@@ -34,29 +35,65 @@
 #include <stdio.h>
 #include <string.h>
 
-static parsebgp_error_t parse_nlris(parsebgp_bgp_update_nlris_t *nlris,
+static parsebgp_error_t parse_nlris(parsebgp_opts_t *opts,
+                                    parsebgp_bgp_update_nlris_t *nlris,
                                     const uint8_t *buf, size_t *lenp, size_t remain)
 {
-  size_t len = *lenp, nread = 0, slen, parsable;
+  size_t len = *lenp, nread = 0, slen;
+  const uint8_t *start;
   parsebgp_bgp_prefix_t *tuple;
   parsebgp_error_t err;
+  int add_path = PARSEBGP_BGP_OPTS_ADD_PATH(&opts->bgp, PARSEBGP_BGP_AFI_IPV4,
+                                            PARSEBGP_BGP_SAFI_UNICAST);
+  int cnt, valid_cnt;
 
   nlris->prefixes_cnt = 0;
+  nlris->compact.cnt = 0;
+
+  if (nlris->len <= len) {
+    // the whole list is in the buffer, so check its framing in one pass and
+    // then decode it without per-field bounds checks
+    PARSEBGP_ASSERT(nlris->len <= remain);
+    if ((valid_cnt = parsebgp_bgp_prefixes_validate(buf, nlris->len, 32,
+                                                    add_path)) < 0) {
+      PARSEBGP_RETURN_INVALID_MSG_ERR;
+    }
+    // only decode as many as the budgets allow
+    cnt = parsebgp_bgp_prefixes_budget(opts, buf, valid_cnt, add_path);
+    if (opts->bgp.compact_prefixes) {
+      if ((err = parsebgp_bgp_prefixes_compact_decode_trusted(
+             &nlris->compact, cnt, PARSEBGP_BGP_PREFIX_UNICAST_IPV4,
+             PARSEBGP_BGP_AFI_IPV4, PARSEBGP_BGP_SAFI_UNICAST, add_path,
+             buf)) != PARSEBGP_OK) {
+        return err;
+      }
+    } else {
+      PARSEBGP_MAYBE_REALLOC(nlris->prefixes, nlris->_prefixes_alloc_cnt, cnt);
+      parsebgp_bgp_prefixes_decode_trusted(
+        nlris->prefixes, cnt, PARSEBGP_BGP_PREFIX_UNICAST_IPV4,
+        PARSEBGP_BGP_AFI_IPV4, PARSEBGP_BGP_SAFI_UNICAST, add_path, buf);
+      nlris->prefixes_cnt = cnt;
+    }
+    if (cnt < valid_cnt) {
+      return PARSEBGP_BUDGET_EXCEEDED;
+    }
+    *lenp = nlris->len;
+    return PARSEBGP_OK;
+  }
 
-  if (nlris->len > len) {
-    // The list is truncated, but we'll parse what we can, ensuring that
-    // the contents of *nlris are valid at any point that might return
-    // PARTIAL_MSG.
-    parsable = len;
-  } else {
-    parsable = nlris->len;
+  if (opts->bgp.compact_prefixes) {
+    // compact arrays are only filled from a complete list
+    return PARSEBGP_PARTIAL_MSG;
   }
 
-  // read until we run out of message
-  while (nread < parsable) {
+  // The list is truncated, but we'll parse what we can, ensuring that
+  // the contents of *nlris are valid at any point that might return
+  // PARTIAL_MSG.
+  while (nread < len) {
     PARSEBGP_MAYBE_REALLOC(nlris->prefixes,
                            nlris->_prefixes_alloc_cnt, nlris->prefixes_cnt + 1);
     tuple = &nlris->prefixes[nlris->prefixes_cnt];
+    start = buf;
 
     // Fix the prefix type to v4 unicast
     tuple->type = PARSEBGP_BGP_PREFIX_UNICAST_IPV4;
@@ -64,22 +101,33 @@ static parsebgp_error_t parse_nlris(parsebgp_bgp_update_nlris_t *nlris,
     tuple->safi = PARSEBGP_BGP_SAFI_UNICAST;
     size_t max_pfx = 32;
 
+    // Path Identifier
+    if (add_path) {
+      PARSEBGP_DESERIALIZE_UINT32(buf, len, nread, tuple->path_id);
+    } else {
+      tuple->path_id = 0;
+    }
+
     // Read the prefix length
     PARSEBGP_DESERIALIZE_UINT8(buf, len, nread, tuple->len);
 
     // Prefix
-    slen = parsable - nread;
+    slen = len - nread;
     err = parsebgp_decode_prefix(tuple->len, tuple->addr, buf, &slen, max_pfx);
     if (err != PARSEBGP_OK) {
-      if (err == PARSEBGP_PARTIAL_MSG && nlris->len <= len) {
-        // decode_prefix() reached the end of the nlris, not the buffer
-        PARSEBGP_RETURN_INVALID_MSG_ERR;
-      }
       return err;
     }
-    nlris->prefixes_cnt++; // increment now that we have a complete valid nlri
     nread += slen;
     buf += slen;
+    // the same budgets as a complete list, charged as each prefix is decoded
+    if (PARSEBGP_BUDGET_TAKE(opts, prefixes, PARSEBGP_BUDGET_PREFIXES, 1,
+                             start) < 1 ||
+        PARSEBGP_BUDGET_TAKE(opts, bytes, PARSEBGP_BUDGET_BYTES,
+                             (uint32_t)(buf - start),
+                             start) < (uint32_t)(buf - start)) {
+      return PARSEBGP_BUDGET_EXCEEDED;
+    }
+    nlris->prefixes_cnt++; // increment now that we have a complete valid nlri
   }
 
   if (nread < nlris->len) {
@@ -95,11 +143,28 @@ static void destroy_nlris(parsebgp_bgp_update_nlris_t *nlris)
   free(nlris->prefixes);
   nlris->prefixes_cnt = 0;
   nlris->_prefixes_alloc_cnt = 0;
+  parsebgp_bgp_prefixes_compact_destroy(&nlris->compact);
 }
 
 static void clear_nlris(parsebgp_bgp_update_nlris_t *nlris)
 {
   nlris->prefixes_cnt = 0;
+  nlris->compact.cnt = 0;
+}
+
+static void mem_usage_nlris(const parsebgp_bgp_update_nlris_t *nlris,
+                            parsebgp_mem_usage_t *usage)
+{
+  PARSEBGP_MEM_ADD(usage, prefixes,
+                   sizeof(*nlris->prefixes) * nlris->_prefixes_alloc_cnt);
+  parsebgp_bgp_prefixes_compact_mem_usage(&nlris->compact, usage);
+}
+
+static void trim_nlris(parsebgp_bgp_update_nlris_t *nlris)
+{
+  PARSEBGP_MAYBE_SHRINK(nlris->prefixes, nlris->_prefixes_alloc_cnt,
+                        nlris->prefixes_cnt);
+  parsebgp_bgp_prefixes_compact_trim(&nlris->compact);
 }
 
 static void dump_nlris(const parsebgp_bgp_update_nlris_t *nlris, int depth)
@@ -109,14 +174,19 @@ static void dump_nlris(const parsebgp_bgp_update_nlris_t *nlris, int depth)
   PARSEBGP_DUMP_INT(depth, "Prefixes Count", nlris->prefixes_cnt);
 
   parsebgp_bgp_prefixes_dump(nlris->prefixes, nlris->prefixes_cnt, depth + 1);
+  if (nlris->compact.cnt > 0) {
+    parsebgp_bgp_prefixes_compact_dump(&nlris->compact, depth + 1);
+  }
 }
 
 static parsebgp_error_t
-parse_path_attr_as_path(int asn_4_byte, parsebgp_bgp_update_as_path_t *msg,
+parse_path_attr_as_path(parsebgp_opts_t *opts, int asn_4_byte,
+                        parsebgp_bgp_update_as_path_t *msg,
                         const uint8_t *buf, size_t *lenp, size_t remain, int raw)
 {
   size_t len = *lenp, nread = 0;
   parsebgp_bgp_update_as_path_seg_t *seg;
+  uint32_t *asns;
   int i;
   uint8_t asn_size;
 
@@ -129,6 +199,7 @@ parse_path_attr_as_path(int asn_4_byte, parsebgp_bgp_update_as_path_t *msg,
   msg->asn_4_byte = asn_4_byte;
   msg->segs_cnt = 0;
   msg->asns_cnt = 0;
+  msg->asns_total_cnt = 0;
 
   if (raw) {
     PARSEBGP_MAYBE_REALLOC(msg->raw, msg->_raw_alloc_len,
@@ -138,6 +209,11 @@ parse_path_attr_as_path(int asn_4_byte, parsebgp_bgp_update_as_path_t *msg,
     return PARSEBGP_OK;
   }
 
+  // the ASNs of all segments are stored in one array (as 4-byte regardless of
+  // what the path encoding is), so make sure it can hold as many as could fit
+  // in the attribute up front
+  PARSEBGP_MAYBE_REALLOC(msg->asns, msg->_asns_alloc_cnt, remain / asn_size);
+
   while ((remain - nread) > 0) {
     // create a new segment
     PARSEBGP_MAYBE_REALLOC(msg->segs, msg->_segs_alloc_cnt, msg->segs_cnt + 1);
@@ -147,6 +223,9 @@ parse_path_attr_as_path(int asn_4_byte, parsebgp_bgp_update_as_path_t *msg,
     if ((len - nread) < 2) {
       return PARSEBGP_PARTIAL_MSG;
     }
+    if ((remain - nread) < 2) {
+      PARSEBGP_RETURN_INVALID_MSG_ERR;
+    }
 
     // Segment Type
     seg->type = *(buf++);
@@ -160,6 +239,18 @@ parse_path_attr_as_path(int asn_4_byte, parsebgp_bgp_update_as_path_t *msg,
     if ((len - nread) < (asn_size * seg->asns_cnt)) {
       return PARSEBGP_PARTIAL_MSG;
     }
+    // the segment must not run past the end of the attribute (the ASN array
+    // is only large enough for the attribute)
+    if ((remain - nread) < (asn_size * seg->asns_cnt)) {
+      PARSEBGP_RETURN_INVALID_MSG_ERR;
+    }
+
+    // stop before this segment if its ASNs don't fit in the budget
+    if (PARSEBGP_BUDGET_TAKE(opts, as_path_asns, PARSEBGP_BUDGET_AS_PATH_ASNS,
+                             seg->asns_cnt, buf - 2) < seg->asns_cnt) {
+      msg->segs_cnt--;
+      return PARSEBGP_BUDGET_EXCEEDED;
+    }
 
     if (seg->type == PARSEBGP_BGP_UPDATE_AS_PATH_SEG_AS_SEQ) {
       msg->asns_cnt += seg->asns_cnt;
@@ -168,18 +259,20 @@ parse_path_attr_as_path(int asn_4_byte, parsebgp_bgp_update_as_path_t *msg,
       msg->asns_cnt++;
     } // else: don't count confederations as per RFC 5065
 
-    // ensure there is enough space to store the ASNs (we store as 4-byte
-    // regardless of what the path encoding is)
-    PARSEBGP_MAYBE_REALLOC(seg->asns, seg->_asns_alloc_cnt, seg->asns_cnt);
-    // Segment ASNs
-    for (i = 0; i < seg->asns_cnt; i++) {
-      if (asn_4_byte) {
-        seg->asns[i] = nptohl(buf);
-      } else {
-        seg->asns[i] = nptohs(buf);
+    // Segment ASNs (one loop per ASN size, so the copy loop does not branch)
+    seg->asns_offset = msg->asns_total_cnt;
+    asns = &msg->asns[seg->asns_offset];
+    if (asn_4_byte) {
+      for (i = 0; i < seg->asns_cnt; i++) {
+        asns[i] = nptohl(buf + (i * sizeof(uint32_t)));
+      }
+    } else {
+      for (i = 0; i < seg->asns_cnt; i++) {
+        asns[i] = nptohs(buf + (i * sizeof(uint16_t)));
       }
-      buf += asn_size;
     }
+    msg->asns_total_cnt += seg->asns_cnt;
+    buf += asn_size * seg->asns_cnt;
     nread += asn_size * seg->asns_cnt;
   }
 
@@ -189,46 +282,71 @@ parse_path_attr_as_path(int asn_4_byte, parsebgp_bgp_update_as_path_t *msg,
   return PARSEBGP_OK;
 }
 
+int parsebgp_bgp_update_as_path_fits(const uint8_t *buf, size_t len,
+                                     size_t asn_size)
+{
+  size_t off = 0;
+
+  while (off + 2 <= len) {
+    off += 2 + (buf[off + 1] * asn_size);
+  }
+  return off == len;
+}
+
 static parsebgp_error_t
-parse_path_attr_as_path_safe(int asn_4_byte, parsebgp_bgp_update_as_path_t *msg,
+parse_path_attr_as_path_safe(parsebgp_opts_t *opts, int asn_4_byte,
+                             int trusted, parsebgp_bgp_update_as_path_t *msg,
                              const uint8_t *buf, size_t *lenp, size_t remain, int raw)
 {
-  parsebgp_error_t err;
-  // first we try just parsing as-is
-  if ((err = parse_path_attr_as_path(asn_4_byte, msg, buf, lenp, remain,
-                                     raw)) != PARSEBGP_OK &&
-      asn_4_byte != 0) {
-    // if we've been asked to do 4-byte parsing, then maybe the caller made a
-    // mistake
-    return parse_path_attr_as_path(0, msg, buf, lenp, remain, raw);
+  // if we've been asked to do 4-byte parsing, then maybe the caller made a
+  // mistake, so check the shape of the whole path first and use 2-byte ASNs if
+  // it doesn't fit (deciding up front means that only the decode with the
+  // right ASN size is charged against the budgets)
+  if (asn_4_byte != 0 && trusted == 0 && raw == 0 &&
+      !parsebgp_bgp_update_as_path_fits(buf, remain < *lenp ? remain : *lenp,
+                                        sizeof(uint32_t))) {
+    asn_4_byte = 0;
   }
-  return err;
+  return parse_path_attr_as_path(opts, asn_4_byte, msg, buf, lenp, remain, raw);
 }
 
 static void destroy_attr_as_path(parsebgp_bgp_update_as_path_t *msg)
 {
-  int i;
   if (msg == NULL) {
     return;
   }
 
   free(msg->raw);
-
-  for (i = 0; i < msg->_segs_alloc_cnt; i++) {
-    free(msg->segs[i].asns);
-  }
   free(msg->segs);
+  free(msg->asns);
 
   free(msg);
 }
 
-static void clear_attr_as_path(parsebgp_bgp_update_as_path_t *msg)
+static void mem_usage_attr_as_path(const parsebgp_bgp_update_as_path_t *msg,
+                                   parsebgp_mem_usage_t *usage)
 {
-  int i;
-  for (i = 0; i < msg->segs_cnt; i++) {
-    msg->segs[i].asns_cnt = 0;
+  if (msg == NULL) {
+    return;
   }
-  msg->segs_cnt = 0;
+
+  PARSEBGP_MEM_ADD(usage, structs, sizeof(*msg));
+  PARSEBGP_MEM_ADD(usage, raw, msg->_raw_alloc_len);
+
+  PARSEBGP_MEM_ADD(usage, path_attrs,
+                   sizeof(*msg->segs) * msg->_segs_alloc_cnt);
+  PARSEBGP_MEM_ADD(usage, path_attrs,
+                   sizeof(*msg->asns) * msg->_asns_alloc_cnt);
+}
+
+static void trim_attr_as_path(parsebgp_bgp_update_as_path_t *msg,
+                              uint16_t attr_len)
+{
+  // the raw copy (if it is in use) is the whole attribute
+  PARSEBGP_MAYBE_SHRINK(msg->raw, msg->_raw_alloc_len, attr_len);
+
+  PARSEBGP_MAYBE_SHRINK(msg->segs, msg->_segs_alloc_cnt, msg->segs_cnt);
+  PARSEBGP_MAYBE_SHRINK(msg->asns, msg->_asns_alloc_cnt, msg->asns_total_cnt);
 }
 
 static void dump_attr_as_path(const parsebgp_bgp_update_as_path_t *msg,
@@ -253,11 +371,12 @@ static void dump_attr_as_path(const parsebgp_bgp_update_as_path_t *msg,
     int j;
     for (j = 0; j < seg->asns_cnt; j++) {
       if (j != 0) {
-        fputs(" ", stdout);
+        fputs(" ", PARSEBGP_DUMP_FP);
       }
-      printf("%" PRIu32, seg->asns[j]);
+      fprintf(PARSEBGP_DUMP_FP, "%" PRIu32,
+              PARSEBGP_BGP_UPDATE_AS_PATH_SEG_ASNS(msg, seg)[j]);
     }
-    fputs("\n", stdout);
+    fputs("\n", PARSEBGP_DUMP_FP);
   }
 }
 
@@ -328,9 +447,25 @@ static void destroy_attr_communities(parsebgp_bgp_update_communities_t *msg)
   free(msg);
 }
 
-static void clear_attr_communities(parsebgp_bgp_update_communities_t *msg)
+static void
+mem_usage_attr_communities(const parsebgp_bgp_update_communities_t *msg,
+                           parsebgp_mem_usage_t *usage)
 {
-  msg->communities_cnt = 0;
+  if (msg == NULL) {
+    return;
+  }
+  PARSEBGP_MEM_ADD(usage, structs, sizeof(*msg));
+  PARSEBGP_MEM_ADD(usage, path_attrs,
+                   sizeof(*msg->communities) * msg->_communities_alloc_cnt);
+  PARSEBGP_MEM_ADD(usage, raw, msg->_raw_alloc_len);
+}
+
+static void trim_attr_communities(parsebgp_bgp_update_communities_t *msg,
+                                  uint16_t attr_len)
+{
+  PARSEBGP_MAYBE_SHRINK(msg->communities, msg->_communities_alloc_cnt,
+                        msg->communities_cnt);
+  PARSEBGP_MAYBE_SHRINK(msg->raw, msg->_raw_alloc_len, attr_len);
 }
 
 static void dump_attr_communities(const parsebgp_bgp_update_communities_t *msg,
@@ -344,12 +479,13 @@ static void dump_attr_communities(const parsebgp_bgp_update_communities_t *msg,
   int i;
   for (i = 0; i < msg->communities_cnt; i++) {
     if (i != 0) {
-      fputs(" ", stdout);
+      fputs(" ", PARSEBGP_DUMP_FP);
     }
-    printf("%" PRIu16 ":%" PRIu16, (uint16_t)(msg->communities[i] >> 16),
-           (uint16_t)msg->communities[i]);
+    fprintf(PARSEBGP_DUMP_FP, "%" PRIu16 ":%" PRIu16,
+            (uint16_t)(msg->communities[i] >> 16),
+            (uint16_t)msg->communities[i]);
   }
-  fputs("\n", stdout);
+  fputs("\n", PARSEBGP_DUMP_FP);
 }
 
 static parsebgp_error_t
@@ -382,9 +518,22 @@ static void destroy_attr_cluster_list(parsebgp_bgp_update_cluster_list_t *msg)
   free(msg);
 }
 
-static void clear_attr_cluster_list(parsebgp_bgp_update_cluster_list_t *msg)
+static void
+mem_usage_attr_cluster_list(const parsebgp_bgp_update_cluster_list_t *msg,
+                            parsebgp_mem_usage_t *usage)
 {
-  msg->cluster_ids_cnt = 0;
+  if (msg == NULL) {
+    return;
+  }
+  PARSEBGP_MEM_ADD(usage, structs, sizeof(*msg));
+  PARSEBGP_MEM_ADD(usage, path_attrs,
+                   sizeof(*msg->cluster_ids) * msg->_cluster_ids_alloc_cnt);
+}
+
+static void trim_attr_cluster_list(parsebgp_bgp_update_cluster_list_t *msg)
+{
+  PARSEBGP_MAYBE_SHRINK(msg->cluster_ids, msg->_cluster_ids_alloc_cnt,
+                        msg->cluster_ids_cnt);
 }
 
 static void dump_attr_cluster_list(
@@ -398,11 +547,11 @@ static void dump_attr_cluster_list(
   int i;
   for (i = 0; i < msg->cluster_ids_cnt; i++) {
     if (i != 0) {
-      fputs(" ", stdout);
+      fputs(" ", PARSEBGP_DUMP_FP);
     }
-    printf("%" PRIu32, msg->cluster_ids[i]);
+    fprintf(PARSEBGP_DUMP_FP, "%" PRIu32, msg->cluster_ids[i]);
   }
-  fputs("\n", stdout);
+  fputs("\n", PARSEBGP_DUMP_FP);
 }
 
 static parsebgp_error_t
@@ -464,10 +613,23 @@ destroy_attr_large_communities(parsebgp_bgp_update_large_communities_t *msg)
   free(msg);
 }
 
+static void mem_usage_attr_large_communities(
+  const parsebgp_bgp_update_large_communities_t *msg,
+  parsebgp_mem_usage_t *usage)
+{
+  if (msg == NULL) {
+    return;
+  }
+  PARSEBGP_MEM_ADD(usage, structs, sizeof(*msg));
+  PARSEBGP_MEM_ADD(usage, path_attrs,
+                   sizeof(*msg->communities) * msg->_communities_alloc_cnt);
+}
+
 static void
-clear_attr_large_communities(parsebgp_bgp_update_large_communities_t *msg)
+trim_attr_large_communities(parsebgp_bgp_update_large_communities_t *msg)
 {
-  msg->communities_cnt = 0;
+  PARSEBGP_MAYBE_SHRINK(msg->communities, msg->_communities_alloc_cnt,
+                        msg->communities_cnt);
 }
 
 static void
@@ -484,25 +646,36 @@ dump_attr_large_communities(const parsebgp_bgp_update_large_communities_t *msg,
   for (i = 0; i < msg->communities_cnt; i++) {
     comm = &msg->communities[i];
     if (i != 0) {
-      fputs(" ", stdout);
+      fputs(" ", PARSEBGP_DUMP_FP);
     }
-    printf("%" PRIu32 ":%" PRIu32 ":%" PRIu32 " ", comm->global_admin,
-           comm->local_1, comm->local_2);
+    fprintf(PARSEBGP_DUMP_FP, "%" PRIu32 ":%" PRIu32 ":%" PRIu32 " ",
+            comm->global_admin, comm->local_1, comm->local_2);
   }
-  fputs("\n", stdout);
+  fputs("\n", PARSEBGP_DUMP_FP);
 }
 
+// without a table or filter and raw options, every type is decoded
+static const uint8_t decode_actions[PARSEBGP_BGP_PATH_ATTR_TYPE_CNT];
+
 parsebgp_error_t parsebgp_bgp_update_path_attrs_decode(
   parsebgp_opts_t *opts, parsebgp_bgp_update_path_attrs_t *path_attrs,
   const uint8_t *buf, size_t *lenp, size_t remain)
 {
-  size_t len = *lenp, nread = 0, slen = 0;
+  size_t len = *lenp, nread = 0, slen = 0, attr_bytes;
   parsebgp_bgp_update_path_attr_t *attr;
+  const parsebgp_bgp_path_attr_table_t *table = opts->bgp.path_attr_table;
+  uint8_t opts_actions[PARSEBGP_BGP_PATH_ATTR_TYPE_CNT];
+  const uint8_t *actions;
+  parsebgp_bgp_path_attr_action_t action;
+  const uint8_t *attr_start;
   uint8_t flags_tmp, type_tmp;
   uint16_t len_tmp;
+  int raw, dup, skip;
   parsebgp_error_t err = PARSEBGP_OK;
 
-  path_attrs->attrs_cnt = 0;
+  // start a new epoch, so that attributes from a previous message (or
+  // duplicates in this one) are recognized
+  parsebgp_bgp_update_path_attrs_clear(path_attrs);
 
   // Path Attributes Length
   PARSEBGP_DESERIALIZE_UINT16(buf, len, nread, path_attrs->len);
@@ -517,6 +690,23 @@ parsebgp_error_t parsebgp_bgp_update_path_attrs_decode(
   PARSEBGP_ASSERT(nread + path_attrs->len <= remain);
   remain = nread + path_attrs->len; // remaining within path attributes
 
+  // each attribute's action is a single lookup in the table that applies
+  if (table != NULL) {
+    actions = table->actions;
+  } else if (opts->bgp.path_attr_filter_enabled ||
+             opts->bgp.path_attr_raw_enabled) {
+    parsebgp_bgp_path_attr_actions_init(opts_actions, &opts->bgp);
+    actions = opts_actions;
+  } else {
+    actions = decode_actions;
+  }
+
+  if (opts->bgp.path_attrs_copy_raw) {
+    // the copy can be no longer than the attributes themselves
+    PARSEBGP_MAYBE_REALLOC(path_attrs->raw, path_attrs->_raw_alloc_len,
+                           path_attrs->len);
+  }
+
   // read until we run out of attributes
   while (nread < remain) {
 
@@ -541,6 +731,7 @@ parsebgp_error_t parsebgp_bgp_update_path_attrs_decode(
 
     /* Optimization: since the length was already checked above, we can skip
      * the PARSEBGP_DESERIALIZE_* calls and read the buf directly. */
+    attr_start = buf;
     flags_tmp = *(buf++); // Attribute Flags
     type_tmp = *(buf++);  // Attribute Type
     if (flags_tmp & PARSEBGP_BGP_PATH_ATTR_FLAG_EXTENDED) {
@@ -569,30 +760,76 @@ parsebgp_error_t parsebgp_bgp_update_path_attrs_decode(
       return PARSEBGP_OK;
     }
 
-    // if this type is beyond the max type that we understand, skip it now
-    if (type_tmp >= PARSEBGP_BGP_PATH_ATTRS_LEN) {
-        /*
-      PARSEBGP_SKIP_NOT_IMPLEMENTED(
-        opts, buf, nread, len_tmp,
-        "BGP UPDATE Path Attribute %d is not yet implemented", type_tmp);
-        */
+    action = actions[type_tmp];
+
+    // the NLRI of MP_REACH and MP_UNREACH are charged prefix by prefix as they
+    // are decoded, so only the attribute header is charged for those here
+    if (action != PARSEBGP_BGP_PATH_ATTR_ACTION_HANDLER &&
+        (type_tmp == PARSEBGP_BGP_PATH_ATTR_TYPE_MP_REACH_NLRI ||
+         type_tmp == PARSEBGP_BGP_PATH_ATTR_TYPE_MP_UNREACH_NLRI)) {
+      attr_bytes = buf - attr_start;
+    } else {
+      attr_bytes = (buf - attr_start) + len_tmp;
+    }
+
+    // attributes that are not decoded (those that the user skips, those of
+    // types beyond the max type that we understand, and duplicates) are free
+    dup = action != PARSEBGP_BGP_PATH_ATTR_ACTION_HANDLER &&
+          type_tmp < PARSEBGP_BGP_PATH_ATTRS_LEN &&
+          PARSEBGP_BGP_UPDATE_ATTR_PRESENT(path_attrs, type_tmp);
+    skip = dup || action == PARSEBGP_BGP_PATH_ATTR_ACTION_SKIP ||
+           (action != PARSEBGP_BGP_PATH_ATTR_ACTION_HANDLER &&
+            type_tmp >= PARSEBGP_BGP_PATH_ATTRS_LEN);
+
+    // stop before this attribute if it doesn't fit in the budgets
+    if (!skip &&
+        (PARSEBGP_BUDGET_TAKE(opts, path_attrs, PARSEBGP_BUDGET_PATH_ATTRS, 1,
+                              attr_start) < 1 ||
+         PARSEBGP_BUDGET_TAKE(opts, bytes, PARSEBGP_BUDGET_BYTES, attr_bytes,
+                              attr_start) < attr_bytes)) {
+      return PARSEBGP_BUDGET_EXCEEDED;
+    }
+
+    // a duplicate is not part of the path, so it is not in the copy either
+    if (opts->bgp.path_attrs_copy_raw && !dup &&
+        type_tmp != PARSEBGP_BGP_PATH_ATTR_TYPE_MP_REACH_NLRI &&
+        type_tmp != PARSEBGP_BGP_PATH_ATTR_TYPE_MP_UNREACH_NLRI) {
+      memcpy(path_attrs->raw + path_attrs->raw_len, attr_start,
+             (buf - attr_start) + len_tmp);
+      path_attrs->raw_len += (buf - attr_start) + len_tmp;
+    }
+
+    // the user has their own decoder for this type (which may be one that we
+    // don't understand)
+    if (action == PARSEBGP_BGP_PATH_ATTR_ACTION_HANDLER) {
+      if (table->handlers[type_tmp] == NULL) {
+        fprintf(stderr,
+                "ERROR: No handler for Path Attribute (%d) set to HANDLER\n",
+                type_tmp);
+        return PARSEBGP_INVALID_OPTS;
+      }
+      if ((err = table->handlers[type_tmp](table->handler_users[type_tmp],
+                                           flags_tmp, type_tmp, buf,
+                                           len_tmp)) != PARSEBGP_OK) {
+        return err;
+      }
+      nread += len_tmp;
+      buf += len_tmp;
       continue;
     }
 
-    // has the user enabled the filter, and have they (implicitly) filtered out
-    // this type of attribute
-    if (opts->bgp.path_attr_filter_enabled &&
-        opts->bgp.path_attr_filter[type_tmp] == 0) {
-      // they don't want it. skip over the rest of the attribute
+    // skip the attribute if the user doesn't want it, or if this type is
+    // beyond the max type that we understand
+    if (action == PARSEBGP_BGP_PATH_ATTR_ACTION_SKIP ||
+        type_tmp >= PARSEBGP_BGP_PATH_ATTRS_LEN) {
       nread += len_tmp;
       buf += len_tmp;
       continue;
     }
+    raw = (action == PARSEBGP_BGP_PATH_ATTR_ACTION_RAW);
 
     attr = &path_attrs->attrs[type_tmp];
-    if (attr->type != 0) {
-      assert(attr->type == type_tmp);
-
+    if (dup) {
       fprintf(stderr, "WARN: Duplicate Path Attribute (%d) found. Skipping\n",
               type_tmp);
       nread += len_tmp;
@@ -611,13 +848,11 @@ parsebgp_error_t parsebgp_bgp_update_path_attrs_decode(
 
     // Attribute Type
     attr->type = type_tmp;
+    attr->_epoch = path_attrs->_epoch;
 
     // Attribute Length
     attr->len = len_tmp;
 
-#define RAW(opts, attr) \
-    (opts->bgp.path_attr_raw_enabled && opts->bgp.path_attr_raw[attr->type])
-
     slen = len - nread;
     switch (attr->type) {
 
@@ -634,10 +869,11 @@ parsebgp_error_t parsebgp_bgp_update_path_attrs_decode(
     // Type 2:
     case PARSEBGP_BGP_PATH_ATTR_TYPE_AS_PATH:
       PARSEBGP_MAYBE_MALLOC_ZERO(attr->data.as_path);
-      if ((err = parse_path_attr_as_path_safe(opts->bgp.asn_4_byte,
+      if ((err = parse_path_attr_as_path_safe(opts, opts->bgp.asn_4_byte,
+                                              opts->bgp.asn_4_byte_trusted,
                                               attr->data.as_path, buf, &slen,
-                                              attr->len, RAW(opts, attr)))
-                                              != PARSEBGP_OK) {
+                                              attr->len, raw)) !=
+          PARSEBGP_OK) {
         return err;
       }
       nread += slen;
@@ -686,8 +922,8 @@ parsebgp_error_t parsebgp_bgp_update_path_attrs_decode(
     case PARSEBGP_BGP_PATH_ATTR_TYPE_COMMUNITIES:
       PARSEBGP_MAYBE_MALLOC_ZERO(attr->data.communities);
       if ((err = parse_path_attr_communities(attr->data.communities, buf, &slen,
-                                             attr->len, RAW(opts, attr)))
-                                             != PARSEBGP_OK) {
+                                             attr->len, raw)) !=
+          PARSEBGP_OK) {
         return err;
       }
       nread += slen;
@@ -754,9 +990,9 @@ parsebgp_error_t parsebgp_bgp_update_path_attrs_decode(
     case PARSEBGP_BGP_PATH_ATTR_TYPE_AS4_PATH:
       // same as AS_PATH, but force 4-byte AS parsing
       PARSEBGP_MAYBE_MALLOC_ZERO(attr->data.as_path);
-      if ((err = parse_path_attr_as_path(1, attr->data.as_path, buf, &slen,
-                                         attr->len, RAW(opts, attr)))
-                                         != PARSEBGP_OK) {
+      if ((err = parse_path_attr_as_path(opts, 1, attr->data.as_path, buf,
+                                         &slen, attr->len, raw)) !=
+          PARSEBGP_OK) {
         return err;
       }
       nread += slen;
@@ -907,9 +1143,92 @@ void parsebgp_bgp_update_path_attrs_destroy(
   }
 
   free(msg->attrs_used);
+  free(msg->raw);
 }
 
 void parsebgp_bgp_update_path_attrs_clear(parsebgp_bgp_update_path_attrs_t *msg)
+{
+  int i;
+
+  if (msg == NULL) {
+    return;
+  }
+
+  // attributes are only present if they were decoded in the current epoch, so
+  // there is no need to visit them (their decoders reset any counts). The
+  // first clear of a zeroed structure moves it from epoch 0 to 1.
+  if (++msg->_epoch == 0) {
+    // the epoch has wrapped, so make sure that no stale attribute matches
+    for (i = 0; i < PARSEBGP_BGP_PATH_ATTRS_LEN; i++) {
+      msg->attrs[i].type = 0;
+      msg->attrs[i]._epoch = 0;
+    }
+    msg->_epoch = 1;
+  }
+
+  msg->attrs_cnt = 0;
+  msg->raw_len = 0;
+}
+
+void parsebgp_bgp_update_path_attrs_mem_usage(
+  const parsebgp_bgp_update_path_attrs_t *msg, parsebgp_mem_usage_t *usage)
+{
+  int i;
+  const parsebgp_bgp_update_path_attr_t *attr;
+
+  if (msg == NULL) {
+    return;
+  }
+
+  // the attrs array is part of the enclosing structure, but attributes that
+  // are no longer present may still hold memory
+  for (i = 0; i < PARSEBGP_BGP_PATH_ATTRS_LEN; i++) {
+    attr = &msg->attrs[i];
+
+    switch (i) {
+    case PARSEBGP_BGP_PATH_ATTR_TYPE_AS_PATH:
+    case PARSEBGP_BGP_PATH_ATTR_TYPE_AS4_PATH:
+      mem_usage_attr_as_path(attr->data.as_path, usage);
+      break;
+
+    case PARSEBGP_BGP_PATH_ATTR_TYPE_COMMUNITIES:
+      mem_usage_attr_communities(attr->data.communities, usage);
+      break;
+
+    case PARSEBGP_BGP_PATH_ATTR_TYPE_CLUSTER_LIST:
+      mem_usage_attr_cluster_list(attr->data.cluster_list, usage);
+      break;
+
+    case PARSEBGP_BGP_PATH_ATTR_TYPE_MP_REACH_NLRI:
+      parsebgp_bgp_update_mp_reach_mem_usage(attr->data.mp_reach, usage);
+      break;
+
+    case PARSEBGP_BGP_PATH_ATTR_TYPE_MP_UNREACH_NLRI:
+      parsebgp_bgp_update_mp_unreach_mem_usage(attr->data.mp_unreach, usage);
+      break;
+
+    case PARSEBGP_BGP_PATH_ATTR_TYPE_EXT_COMMUNITIES:
+    case PARSEBGP_BGP_PATH_ATTR_TYPE_IPV6_EXT_COMMUNITIES:
+      parsebgp_bgp_update_ext_communities_mem_usage(attr->data.ext_communities,
+                                                    usage);
+      break;
+
+    case PARSEBGP_BGP_PATH_ATTR_TYPE_LARGE_COMMUNITIES:
+      mem_usage_attr_large_communities(attr->data.large_communities, usage);
+      break;
+
+    default:
+      // no dynamic memory
+      break;
+    }
+  }
+
+  PARSEBGP_MEM_ADD(usage, path_attrs,
+                   sizeof(*msg->attrs_used) * msg->_attrs_used_alloc_cnt);
+  PARSEBGP_MEM_ADD(usage, raw, msg->_raw_alloc_len);
+}
+
+void parsebgp_bgp_update_path_attrs_trim(parsebgp_bgp_update_path_attrs_t *msg)
 {
   int i;
   parsebgp_bgp_update_path_attr_t *attr;
@@ -918,65 +1237,97 @@ void parsebgp_bgp_update_path_attrs_clear(parsebgp_bgp_update_path_attrs_t *msg)
     return;
   }
 
-  for (i = 0; i < msg->attrs_cnt; i++) {
-    attr = &msg->attrs[msg->attrs_used[i]];
+  for (i = 0; i < PARSEBGP_BGP_PATH_ATTRS_LEN; i++) {
+    attr = &msg->attrs[i];
 
-    if (attr->type == 0) {
+    // attributes that are not present are freed entirely
+    if (!PARSEBGP_BGP_UPDATE_ATTR_PRESENT(msg, i)) {
+      switch (i) {
+      case PARSEBGP_BGP_PATH_ATTR_TYPE_AS_PATH:
+      case PARSEBGP_BGP_PATH_ATTR_TYPE_AS4_PATH:
+        destroy_attr_as_path(attr->data.as_path);
+        attr->data.as_path = NULL;
+        break;
+
+      case PARSEBGP_BGP_PATH_ATTR_TYPE_COMMUNITIES:
+        destroy_attr_communities(attr->data.communities);
+        attr->data.communities = NULL;
+        break;
+
+      case PARSEBGP_BGP_PATH_ATTR_TYPE_CLUSTER_LIST:
+        destroy_attr_cluster_list(attr->data.cluster_list);
+        attr->data.cluster_list = NULL;
+        break;
+
+      case PARSEBGP_BGP_PATH_ATTR_TYPE_MP_REACH_NLRI:
+        parsebgp_bgp_update_mp_reach_destroy(attr->data.mp_reach);
+        attr->data.mp_reach = NULL;
+        break;
+
+      case PARSEBGP_BGP_PATH_ATTR_TYPE_MP_UNREACH_NLRI:
+        parsebgp_bgp_update_mp_unreach_destroy(attr->data.mp_unreach);
+        attr->data.mp_unreach = NULL;
+        break;
+
+      case PARSEBGP_BGP_PATH_ATTR_TYPE_EXT_COMMUNITIES:
+      case PARSEBGP_BGP_PATH_ATTR_TYPE_IPV6_EXT_COMMUNITIES:
+        parsebgp_bgp_update_ext_communities_destroy(
+          attr->data.ext_communities);
+        attr->data.ext_communities = NULL;
+        break;
+
+      case PARSEBGP_BGP_PATH_ATTR_TYPE_LARGE_COMMUNITIES:
+        destroy_attr_large_communities(attr->data.large_communities);
+        attr->data.large_communities = NULL;
+        break;
+
+      default:
+        // no dynamic memory
+        break;
+      }
       continue;
     }
 
-    switch (attr->type) {
-    // Types with no dynamic memory:
-    case PARSEBGP_BGP_PATH_ATTR_TYPE_ORIGIN:
-    case PARSEBGP_BGP_PATH_ATTR_TYPE_NEXT_HOP:
-    case PARSEBGP_BGP_PATH_ATTR_TYPE_MED:
-    case PARSEBGP_BGP_PATH_ATTR_TYPE_LOCAL_PREF:
-    case PARSEBGP_BGP_PATH_ATTR_TYPE_ATOMIC_AGGREGATE:
-    case PARSEBGP_BGP_PATH_ATTR_TYPE_AGGREGATOR:
-    case PARSEBGP_BGP_PATH_ATTR_TYPE_ORIGINATOR_ID:
-    case PARSEBGP_BGP_PATH_ATTR_TYPE_AS4_AGGREGATOR:
-    case PARSEBGP_BGP_PATH_ATTR_TYPE_AS_PATHLIMIT:
-      break;
-
+    switch (i) {
     case PARSEBGP_BGP_PATH_ATTR_TYPE_AS_PATH:
     case PARSEBGP_BGP_PATH_ATTR_TYPE_AS4_PATH:
-      clear_attr_as_path(attr->data.as_path);
+      trim_attr_as_path(attr->data.as_path, attr->len);
       break;
 
     case PARSEBGP_BGP_PATH_ATTR_TYPE_COMMUNITIES:
-      clear_attr_communities(attr->data.communities);
+      trim_attr_communities(attr->data.communities, attr->len);
       break;
 
     case PARSEBGP_BGP_PATH_ATTR_TYPE_CLUSTER_LIST:
-      clear_attr_cluster_list(attr->data.cluster_list);
+      trim_attr_cluster_list(attr->data.cluster_list);
       break;
 
     case PARSEBGP_BGP_PATH_ATTR_TYPE_MP_REACH_NLRI:
-      parsebgp_bgp_update_mp_reach_clear(attr->data.mp_reach);
+      parsebgp_bgp_update_mp_reach_trim(attr->data.mp_reach);
       break;
 
     case PARSEBGP_BGP_PATH_ATTR_TYPE_MP_UNREACH_NLRI:
-      parsebgp_bgp_update_mp_unreach_clear(attr->data.mp_unreach);
+      parsebgp_bgp_update_mp_unreach_trim(attr->data.mp_unreach);
       break;
 
     case PARSEBGP_BGP_PATH_ATTR_TYPE_EXT_COMMUNITIES:
     case PARSEBGP_BGP_PATH_ATTR_TYPE_IPV6_EXT_COMMUNITIES:
-      parsebgp_bgp_update_ext_communities_clear(attr->data.ext_communities);
+      parsebgp_bgp_update_ext_communities_trim(attr->data.ext_communities);
       break;
 
-    case PARSEBGP_BGP_PATH_ATTR_TYPE_BGP_LS:
-      // TODO: add support for BGP-LS
+    case PARSEBGP_BGP_PATH_ATTR_TYPE_LARGE_COMMUNITIES:
+      trim_attr_large_communities(attr->data.large_communities);
       break;
 
-    case PARSEBGP_BGP_PATH_ATTR_TYPE_LARGE_COMMUNITIES:
-      clear_attr_large_communities(attr->data.large_communities);
+    default:
+      // no dynamic memory
       break;
     }
-
-    attr->type = 0;
   }
 
-  msg->attrs_cnt = 0;
+  PARSEBGP_MAYBE_SHRINK(msg->attrs_used, msg->_attrs_used_alloc_cnt,
+                        msg->attrs_cnt);
+  PARSEBGP_MAYBE_SHRINK(msg->raw, msg->_raw_alloc_len, msg->raw_len);
 }
 
 void parsebgp_bgp_update_path_attrs_dump(
@@ -993,7 +1344,7 @@ void parsebgp_bgp_update_path_attrs_dump(
   for (i = 0; i < PARSEBGP_BGP_PATH_ATTRS_LEN; i++) {
     attr = &msg->attrs[i];
 
-    if (attr->type == 0) {
+    if (attr->type == 0 || !PARSEBGP_BGP_UPDATE_ATTR_PRESENT(msg, i)) {
       continue;
     }
 
@@ -1096,12 +1447,16 @@ parsebgp_error_t parsebgp_bgp_update_decode(parsebgp_opts_t *opts,
   size_t len = *lenp, nread = 0, slen = 0;
   parsebgp_error_t err;
 
+  // start empty, so that the update is consistent wherever decoding stops
+  // (e.g., when a budget runs out)
+  parsebgp_bgp_update_clear(msg);
+
   // Withdrawn Routes Length
   PARSEBGP_DESERIALIZE_UINT16(buf, len, nread, msg->withdrawn_nlris.len);
 
   // Withdrawn Routes
   slen = len - nread;
-  err = parse_nlris(&msg->withdrawn_nlris, buf, &slen, remain - nread);
+  err = parse_nlris(opts, &msg->withdrawn_nlris, buf, &slen, remain - nread);
   if (err != PARSEBGP_OK) {
     return err;
   }
@@ -1122,7 +1477,8 @@ parsebgp_error_t parsebgp_bgp_update_decode(parsebgp_opts_t *opts,
   // NLRIs
   slen = len - nread;
   msg->announced_nlris.len = remain - nread;
-  err = parse_nlris(&msg->announced_nlris, buf, &slen, msg->announced_nlris.len);
+  err = parse_nlris(opts, &msg->announced_nlris, buf, &slen,
+                    msg->announced_nlris.len);
   if (err != PARSEBGP_OK) {
     return err;
   }
@@ -1158,6 +1514,30 @@ void parsebgp_bgp_update_clear(parsebgp_bgp_update_t *msg)
   parsebgp_bgp_update_path_attrs_clear(&msg->path_attrs);
 }
 
+void parsebgp_bgp_update_mem_usage(const parsebgp_bgp_update_t *msg,
+                                   parsebgp_mem_usage_t *usage)
+{
+  if (msg == NULL) {
+    return;
+  }
+
+  PARSEBGP_MEM_ADD(usage, structs, sizeof(*msg));
+  mem_usage_nlris(&msg->withdrawn_nlris, usage);
+  mem_usage_nlris(&msg->announced_nlris, usage);
+  parsebgp_bgp_update_path_attrs_mem_usage(&msg->path_attrs, usage);
+}
+
+void parsebgp_bgp_update_trim(parsebgp_bgp_update_t *msg)
+{
+  if (msg == NULL) {
+    return;
+  }
+
+  trim_nlris(&msg->withdrawn_nlris);
+  trim_nlris(&msg->announced_nlris);
+  parsebgp_bgp_update_path_attrs_trim(&msg->path_attrs);
+}
+
 void parsebgp_bgp_update_dump(const parsebgp_bgp_update_t *msg, int depth)
 {
   PARSEBGP_DUMP_STRUCT_HDR(parsebgp_bgp_update_t, depth);
@@ -73,6 +73,10 @@ typedef enum {
 
 /**
  * AS Path Segment (supports both 2 and 4-byte ASNs)
+ *
+ * The ASNs of all segments are stored (in path order) in the asns array of the
+ * AS Path. Use PARSEBGP_BGP_UPDATE_AS_PATH_SEG_ASNS to find those of a given
+ * segment.
  */
 typedef struct parsebgp_bgp_update_as_path_seg {
 
@@ -82,13 +86,10 @@ typedef struct parsebgp_bgp_update_as_path_seg {
   /** Number of ASNs in the segment */
   uint8_t asns_cnt;
 
-  /** Array of (asn_cnt) ASNs */
-  uint32_t *asns;
-
-  /** Number of allocated ASNs (INTERNAL) */
-  uint8_t _asns_alloc_cnt;
+  /** Index of the first ASN of the segment in the asns array of the path */
+  uint16_t asns_offset;
 
-} __attribute__((packed)) parsebgp_bgp_update_as_path_seg_t;
+} parsebgp_bgp_update_as_path_seg_t;
 
 /**
  * AS Path (supports both 2 and 4-byte ASNs)
@@ -99,10 +100,10 @@ typedef struct parsebgp_bgp_update_as_path {
   parsebgp_bgp_update_as_path_seg_t *segs;
 
   /** Number of allocated segments (INTERNAL) */
-  uint8_t _segs_alloc_cnt;
+  uint16_t _segs_alloc_cnt;
 
   /** Number of Segments in the AS Path */
-  uint8_t segs_cnt;
+  uint16_t segs_cnt;
 
   /** Number of ASNs in the AS Path
    *
@@ -115,13 +116,28 @@ typedef struct parsebgp_bgp_update_as_path {
   /** Does the path contain 4-byte ASNs (instead of 2-byte)? */
   uint8_t asn_4_byte;
 
+  /** Number of ASNs in all segments (i.e., the length of the asns array) */
+  uint16_t asns_total_cnt;
+
+  /** Number of allocated ASNs (INTERNAL) */
+  uint16_t _asns_alloc_cnt;
+
+  /** Array of (asns_total_cnt) ASNs of all segments, in path order (may be
+      NULL if shallow parsing is enabled) */
+  uint32_t *asns;
+
   /** Pointer to the a copy of the raw AS Path data */
   uint8_t *raw;
 
   /** Allocated length of the raw data (INTERNAL) */
   uint16_t _raw_alloc_len;
 
-} __attribute__((packed)) parsebgp_bgp_update_as_path_t;
+} parsebgp_bgp_update_as_path_t;
+
+/** Pointer to the (seg->asns_cnt) ASNs of the given segment of the given AS
+    Path */
+#define PARSEBGP_BGP_UPDATE_AS_PATH_SEG_ASNS(path, seg)                        \
+  (&(path)->asns[(seg)->asns_offset])
 
 /**
  * AGGREGATOR (supports both 2- and 4-byte ASNs)
@@ -325,6 +341,10 @@ typedef struct parsebgp_bgp_update_path_attr {
   /** Attribute Length (in bytes) */
   uint16_t len;
 
+  /** Epoch of the enclosing Path Attributes structure in which this attribute
+      was decoded (INTERNAL) */
+  uint32_t _epoch;
+
   /** Union of all support Path Attribute data */
   union {
 
@@ -386,12 +406,30 @@ typedef struct parsebgp_bgp_update_path_attrs {
   /** Length of the (raw) Path Attributes data (in bytes) */
   uint16_t len;
 
+  /** Copy of the raw Path Attributes data, without any MP_REACH_NLRI and
+      MP_UNREACH_NLRI attributes (since they carry prefixes rather than
+      attributes of the path). Only set if the path_attrs_copy_raw option is
+      set. */
+  uint8_t *raw;
+
+  /** Length of the raw data (in bytes) */
+  uint16_t raw_len;
+
+  /** Allocated length of the raw data (INTERNAL) */
+  uint16_t _raw_alloc_len;
+
   /** Array of Path Attributes
    *
    * Attributes are stored at attrs[ATTR_TYPE] to allow access to specific
    * attributes without having to do a linear search. Users should check that
-   * attrs[ATTR_TYPE].type is set (to ATTR_TYPE) before accessing any other
-   * fields of the attribute.
+   * the attribute is present (using PARSEBGP_BGP_UPDATE_ATTR_PRESENT) before
+   * accessing any of its fields.
+   *
+   * Note: this is a change from earlier versions, in which clearing the
+   * structure reset the type of every attribute. Attributes left over from a
+   * previous message now keep their type, so code that checks
+   * attrs[ATTR_TYPE].type == ATTR_TYPE sees those stale attributes, and must
+   * use PARSEBGP_BGP_UPDATE_ATTR_PRESENT instead.
    */
   parsebgp_bgp_update_path_attr_t attrs[PARSEBGP_BGP_PATH_ATTRS_LEN];
 
@@ -405,8 +443,21 @@ typedef struct parsebgp_bgp_update_path_attrs {
   /** Number of populated Path Attributes in the attrs field */
   int attrs_cnt;
 
+  /** Current epoch (INTERNAL). Clearing the structure starts a new epoch, which
+      makes all attributes decoded in earlier epochs absent without visiting
+      them. Epochs start at 1: a zeroed structure that has never been cleared
+      is in epoch 0, in which no attribute is present. */
+  uint32_t _epoch;
+
 } parsebgp_bgp_update_path_attrs_t;
 
+/** Is the given Path Attribute type populated in the given Path Attributes
+    structure */
+#define PARSEBGP_BGP_UPDATE_ATTR_PRESENT(path_attrs, attr_type)                \
+  ((path_attrs)->_epoch != 0 &&                                                \
+   (path_attrs)->attrs[(attr_type)].type == (attr_type) &&                     \
+   (path_attrs)->attrs[(attr_type)]._epoch == (path_attrs)->_epoch)
+
 /**
  * BGP UPDATE NLRIs
  */
@@ -424,6 +475,10 @@ typedef struct parsebgp_bgp_update_nlris {
   /** (Inferred) number of prefixes in the prefixes field */
   int prefixes_cnt;
 
+  /** Compact array of prefixes (only used if the compact_prefixes option is
+      set, in which case prefixes_cnt is 0) */
+  parsebgp_bgp_prefixes_compact_t compact;
+
 } parsebgp_bgp_update_nlris_t;
 
 /**
@@ -189,10 +189,26 @@ void parsebgp_bgp_update_ext_communities_destroy(
   free(msg);
 }
 
-void parsebgp_bgp_update_ext_communities_clear(
+void parsebgp_bgp_update_ext_communities_mem_usage(
+  const parsebgp_bgp_update_ext_communities_t *msg,
+  parsebgp_mem_usage_t *usage)
+{
+  if (msg == NULL) {
+    return;
+  }
+  PARSEBGP_MEM_ADD(usage, structs, sizeof(*msg));
+  PARSEBGP_MEM_ADD(usage, path_attrs,
+                   sizeof(*msg->communities) * msg->_communities_alloc_cnt);
+}
+
+void parsebgp_bgp_update_ext_communities_trim(
   parsebgp_bgp_update_ext_communities_t *msg)
 {
-  msg->communities_cnt = 0;
+  if (msg == NULL) {
+    return;
+  }
+  PARSEBGP_MAYBE_SHRINK(msg->communities, msg->_communities_alloc_cnt,
+                        msg->communities_cnt);
 }
 
 static void dump_ext_community(const parsebgp_bgp_update_ext_community_t *comm,
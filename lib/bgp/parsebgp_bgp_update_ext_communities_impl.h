@@ -29,6 +29,7 @@
 
 #include "parsebgp_bgp_update_ext_communities.h"
 #include "parsebgp_error.h"
+#include "parsebgp_mem.h"
 #include "parsebgp_opts.h"
 #include <stddef.h>
 
@@ -60,8 +61,15 @@ void parsebgp_bgp_update_ext_communities_dump(
 void parsebgp_bgp_update_ext_communities_destroy(
   parsebgp_bgp_update_ext_communities_t *msg);
 
-/** Clear an EXTENDED COMMUNITIES message */
-void parsebgp_bgp_update_ext_communities_clear(
+/** Add the memory held by an EXTENDED COMMUNITIES message to the given usage
+    counters */
+void parsebgp_bgp_update_ext_communities_mem_usage(
+  const parsebgp_bgp_update_ext_communities_t *msg,
+  parsebgp_mem_usage_t *usage);
+
+/** Release memory held by an EXTENDED COMMUNITIES message beyond what it
+    currently uses */
+void parsebgp_bgp_update_ext_communities_trim(
   parsebgp_bgp_update_ext_communities_t *msg);
 
 #endif /* __PARSEBGP_BGP_UPDATE_EXT_COMMUNITIES_IMPL_H */
@@ -29,6 +29,7 @@
 
 #include "parsebgp_bgp_update.h"
 #include "parsebgp_error.h"
+#include "parsebgp_mem.h"
 #include "parsebgp_opts.h"
 #include <stddef.h>
 
@@ -44,6 +45,13 @@ void parsebgp_bgp_update_destroy(parsebgp_bgp_update_t *msg);
 /** Clear an UPDATE message */
 void parsebgp_bgp_update_clear(parsebgp_bgp_update_t *msg);
 
+/** Add the memory held by an UPDATE message to the given usage counters */
+void parsebgp_bgp_update_mem_usage(const parsebgp_bgp_update_t *msg,
+                                   parsebgp_mem_usage_t *usage);
+
+/** Release memory held by an UPDATE message beyond what it currently uses */
+void parsebgp_bgp_update_trim(parsebgp_bgp_update_t *msg);
+
 /**
  * Dump a human-readable version of the message to stdout
  *
@@ -70,6 +78,17 @@ void parsebgp_bgp_update_path_attrs_destroy(
 void parsebgp_bgp_update_path_attrs_clear(
   parsebgp_bgp_update_path_attrs_t *msg);
 
+/** Add the memory held by a Path Attributes message to the given usage
+    counters (not including the structure itself, which is always embedded in
+    another structure) */
+void parsebgp_bgp_update_path_attrs_mem_usage(
+  const parsebgp_bgp_update_path_attrs_t *msg, parsebgp_mem_usage_t *usage);
+
+/** Release memory held by a Path Attributes message beyond what it currently
+    uses */
+void parsebgp_bgp_update_path_attrs_trim(
+  parsebgp_bgp_update_path_attrs_t *msg);
+
 /**
  * Dump a human-readable version of the message to stdout
  *
@@ -84,4 +103,17 @@ void parsebgp_bgp_update_path_attrs_clear(
 void parsebgp_bgp_update_path_attrs_dump(
     const parsebgp_bgp_update_path_attrs_t *msg, int depth);
 
+/**
+ * Check whether AS path data is exactly filled by segments of ASNs of the given
+ * size
+ *
+ * @param buf           Pointer to the AS path data
+ * @param len           Length of the AS path data (all of which must be in the
+ *                      buffer)
+ * @param asn_size      Size of each ASN (2 or 4)
+ * @return 1 if the segments exactly fill the data, 0 otherwise
+ */
+int parsebgp_bgp_update_as_path_fits(const uint8_t *buf, size_t len,
+                                     size_t asn_size);
+
 #endif /* __PARSEBGP_BGP_UPDATE_IMPL_H */
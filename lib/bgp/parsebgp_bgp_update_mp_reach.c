@@ -35,13 +35,15 @@
 static parsebgp_error_t parse_afi_ipv4_ipv6_nlri(
   parsebgp_opts_t *opts, parsebgp_bgp_afi_t afi, parsebgp_bgp_safi_t safi,
   parsebgp_bgp_prefix_t **nlris, int *nlris_alloc_cnt, int *nlris_cnt,
-  const uint8_t *buf, size_t *lenp, size_t remain)
+  parsebgp_bgp_prefixes_compact_t *compact, const uint8_t *buf, size_t *lenp,
+  size_t remain)
 {
-  size_t len = *lenp, nread = 0, slen;
-  size_t max_pfx;
+  size_t len = *lenp, nread = 0;
+  uint8_t max_pfx = 0;
   uint8_t p_type = 0;
-  parsebgp_bgp_prefix_t *tuple;
+  int add_path = PARSEBGP_BGP_OPTS_ADD_PATH(&opts->bgp, afi, safi);
   parsebgp_error_t err;
+  int cnt, valid_cnt;
 
   switch (afi) {
   case PARSEBGP_BGP_AFI_IPV4:
@@ -84,30 +86,36 @@ static parsebgp_error_t parse_afi_ipv4_ipv6_nlri(
   }
 
   *nlris_cnt = 0;
+  compact->cnt = 0;
 
-  while ((remain - nread) > 0) {
-    PARSEBGP_MAYBE_REALLOC(*nlris, *nlris_alloc_cnt, *nlris_cnt + 1);
-    tuple = &(*nlris)[*nlris_cnt];
-    (*nlris_cnt)++;
-
-    tuple->type = p_type;
-    tuple->afi = afi;
-    tuple->safi = safi;
-
-    // Read the prefix length
-    PARSEBGP_DESERIALIZE_UINT8(buf, len, nread, tuple->len);
-
-    // Prefix
-    slen = len - nread;
-    err = parsebgp_decode_prefix(tuple->len, tuple->addr, buf, &slen, max_pfx);
-    if (err != PARSEBGP_OK) {
+  // the attribute is normally entirely in the buffer (see
+  // parsebgp_bgp_update_path_attrs_decode), so the NLRI can be checked in one
+  // pass and then decoded without per-field bounds checks
+  if ((remain - nread) > (len - nread)) {
+    return PARSEBGP_PARTIAL_MSG;
+  }
+  if ((valid_cnt = parsebgp_bgp_prefixes_validate(buf, remain - nread, max_pfx,
+                                                  add_path)) < 0) {
+    PARSEBGP_RETURN_INVALID_MSG_ERR;
+  }
+  // only decode as many as the budgets allow
+  cnt = parsebgp_bgp_prefixes_budget(opts, buf, valid_cnt, add_path);
+  if (opts->bgp.compact_prefixes) {
+    if ((err = parsebgp_bgp_prefixes_compact_decode_trusted(
+           compact, cnt, p_type, afi, safi, add_path, buf)) != PARSEBGP_OK) {
       return err;
     }
-    nread += slen;
-    buf += slen;
+  } else {
+    PARSEBGP_MAYBE_REALLOC(*nlris, *nlris_alloc_cnt, cnt);
+    parsebgp_bgp_prefixes_decode_trusted(*nlris, cnt, p_type, afi, safi,
+                                         add_path, buf);
+    *nlris_cnt = cnt;
+  }
+  if (cnt < valid_cnt) {
+    return PARSEBGP_BUDGET_EXCEEDED;
   }
 
-  *lenp = nread;
+  *lenp = remain;
   return PARSEBGP_OK;
 }
 
@@ -196,7 +204,8 @@ parse_reach_afi_ipv4_ipv6(parsebgp_opts_t *opts,
     slen = len - nread;
     if ((err = parse_afi_ipv4_ipv6_nlri(
            opts, msg->afi, msg->safi, &msg->nlris, &msg->_nlris_alloc_cnt,
-           &msg->nlris_cnt, buf, &slen, remain - nread)) != PARSEBGP_OK) {
+           &msg->nlris_cnt, &msg->compact_nlris, buf, &slen,
+           remain - nread)) != PARSEBGP_OK) {
       return err;
     }
     nread += slen;
@@ -230,8 +239,9 @@ parse_unreach_afi_ipv4_ipv6(parsebgp_opts_t *opts,
     // Parse the NLRIs
     if ((err = parse_afi_ipv4_ipv6_nlri(
            opts, msg->afi, msg->safi, &msg->withdrawn_nlris,
-           &msg->_withdrawn_nlris_alloc_cnt, &msg->withdrawn_nlris_cnt, buf,
-           &slen, remain - nread)) != PARSEBGP_OK) {
+           &msg->_withdrawn_nlris_alloc_cnt, &msg->withdrawn_nlris_cnt,
+           &msg->compact_withdrawn_nlris, buf, &slen, remain - nread)) !=
+        PARSEBGP_OK) {
       return err;
     }
     nread += slen;
@@ -257,6 +267,10 @@ parsebgp_bgp_update_mp_reach_decode(parsebgp_opts_t *opts,
   size_t len = *lenp, nread = 0, slen;
   parsebgp_error_t err;
 
+  // this structure may hold NLRIs from a previous message (see
+  // parsebgp_bgp_update_path_attrs_clear)
+  parsebgp_bgp_update_mp_reach_clear(msg);
+
   // MRT TABLE_DUMP_V2 is annoying and can "compress" the MP_REACH header to
   // remove AFI, SAFI, and (allegedly) reserved fields
   //
@@ -313,12 +327,35 @@ void parsebgp_bgp_update_mp_reach_destroy(parsebgp_bgp_update_mp_reach_t *msg)
   }
 
   free(msg->nlris);
+  parsebgp_bgp_prefixes_compact_destroy(&msg->compact_nlris);
   free(msg);
 }
 
 void parsebgp_bgp_update_mp_reach_clear(parsebgp_bgp_update_mp_reach_t *msg)
 {
   msg->nlris_cnt = 0;
+  msg->compact_nlris.cnt = 0;
+}
+
+void parsebgp_bgp_update_mp_reach_mem_usage(
+  const parsebgp_bgp_update_mp_reach_t *msg, parsebgp_mem_usage_t *usage)
+{
+  if (msg == NULL) {
+    return;
+  }
+  PARSEBGP_MEM_ADD(usage, structs, sizeof(*msg));
+  PARSEBGP_MEM_ADD(usage, prefixes,
+                   sizeof(*msg->nlris) * msg->_nlris_alloc_cnt);
+  parsebgp_bgp_prefixes_compact_mem_usage(&msg->compact_nlris, usage);
+}
+
+void parsebgp_bgp_update_mp_reach_trim(parsebgp_bgp_update_mp_reach_t *msg)
+{
+  if (msg == NULL) {
+    return;
+  }
+  PARSEBGP_MAYBE_SHRINK(msg->nlris, msg->_nlris_alloc_cnt, msg->nlris_cnt);
+  parsebgp_bgp_prefixes_compact_trim(&msg->compact_nlris);
 }
 
 void parsebgp_bgp_update_mp_reach_dump(
@@ -349,6 +386,9 @@ void parsebgp_bgp_update_mp_reach_dump(
     PARSEBGP_DUMP_INT(depth, "NLRIs Count", msg->nlris_cnt);
 
     parsebgp_bgp_prefixes_dump(msg->nlris, msg->nlris_cnt, depth + 1);
+    if (msg->compact_nlris.cnt > 0) {
+      parsebgp_bgp_prefixes_compact_dump(&msg->compact_nlris, depth + 1);
+    }
     break;
 
   default:
@@ -365,6 +405,10 @@ parsebgp_bgp_update_mp_unreach_decode(parsebgp_opts_t *opts,
   size_t len = *lenp, nread = 0, slen;
   parsebgp_error_t err;
 
+  // this structure may hold NLRIs from a previous message (see
+  // parsebgp_bgp_update_path_attrs_clear)
+  parsebgp_bgp_update_mp_unreach_clear(msg);
+
   // AFI
   PARSEBGP_DESERIALIZE_UINT16(buf, len, nread, msg->afi);
 
@@ -401,12 +445,36 @@ void parsebgp_bgp_update_mp_unreach_destroy(
     return;
   }
   free(msg->withdrawn_nlris);
+  parsebgp_bgp_prefixes_compact_destroy(&msg->compact_withdrawn_nlris);
   free(msg);
 }
 
 void parsebgp_bgp_update_mp_unreach_clear(parsebgp_bgp_update_mp_unreach_t *msg)
 {
   msg->withdrawn_nlris_cnt = 0;
+  msg->compact_withdrawn_nlris.cnt = 0;
+}
+
+void parsebgp_bgp_update_mp_unreach_mem_usage(
+  const parsebgp_bgp_update_mp_unreach_t *msg, parsebgp_mem_usage_t *usage)
+{
+  if (msg == NULL) {
+    return;
+  }
+  PARSEBGP_MEM_ADD(usage, structs, sizeof(*msg));
+  PARSEBGP_MEM_ADD(usage, prefixes, sizeof(*msg->withdrawn_nlris) *
+                                      msg->_withdrawn_nlris_alloc_cnt);
+  parsebgp_bgp_prefixes_compact_mem_usage(&msg->compact_withdrawn_nlris, usage);
+}
+
+void parsebgp_bgp_update_mp_unreach_trim(parsebgp_bgp_update_mp_unreach_t *msg)
+{
+  if (msg == NULL) {
+    return;
+  }
+  PARSEBGP_MAYBE_SHRINK(msg->withdrawn_nlris, msg->_withdrawn_nlris_alloc_cnt,
+                        msg->withdrawn_nlris_cnt);
+  parsebgp_bgp_prefixes_compact_trim(&msg->compact_withdrawn_nlris);
 }
 
 void parsebgp_bgp_update_mp_unreach_dump(
@@ -430,6 +498,10 @@ void parsebgp_bgp_update_mp_unreach_dump(
 
     parsebgp_bgp_prefixes_dump(msg->withdrawn_nlris, msg->withdrawn_nlris_cnt,
                                depth + 1);
+    if (msg->compact_withdrawn_nlris.cnt > 0) {
+      parsebgp_bgp_prefixes_compact_dump(&msg->compact_withdrawn_nlris,
+                                         depth + 1);
+    }
     break;
 
   default:
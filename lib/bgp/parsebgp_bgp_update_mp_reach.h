@@ -63,6 +63,10 @@ typedef struct parsebgp_bgp_update_mp_reach {
   /** (Inferred) number of NLRIs */
   int nlris_cnt;
 
+  /** Compact array of NLRIs (only used if the compact_prefixes option is set,
+      in which case nlris_cnt is 0) */
+  parsebgp_bgp_prefixes_compact_t compact_nlris;
+
 } parsebgp_bgp_update_mp_reach_t;
 
 /**
@@ -85,6 +89,10 @@ typedef struct parsebgp_bgp_update_mp_unreach {
   /** (Inferred) number of Withdrawn NLRIs */
   int withdrawn_nlris_cnt;
 
+  /** Compact array of Withdrawn NLRIs (only used if the compact_prefixes
+      option is set, in which case withdrawn_nlris_cnt is 0) */
+  parsebgp_bgp_prefixes_compact_t compact_withdrawn_nlris;
+
 } parsebgp_bgp_update_mp_unreach_t;
 
 #endif /* __PARSEBGP_BGP_UPDATE_MP_REACH_H */
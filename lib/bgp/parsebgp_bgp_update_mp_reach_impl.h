@@ -29,6 +29,7 @@
 
 #include "parsebgp_bgp_update_mp_reach.h"
 #include "parsebgp_error.h"
+#include "parsebgp_mem.h"
 #include "parsebgp_opts.h"
 #include <stddef.h>
 
@@ -44,6 +45,13 @@ void parsebgp_bgp_update_mp_reach_destroy(parsebgp_bgp_update_mp_reach_t *msg);
 /** Clear an MP_REACH message */
 void parsebgp_bgp_update_mp_reach_clear(parsebgp_bgp_update_mp_reach_t *msg);
 
+/** Add the memory held by an MP_REACH message to the given usage counters */
+void parsebgp_bgp_update_mp_reach_mem_usage(
+  const parsebgp_bgp_update_mp_reach_t *msg, parsebgp_mem_usage_t *usage);
+
+/** Release memory held by an MP_REACH message beyond what it currently uses */
+void parsebgp_bgp_update_mp_reach_trim(parsebgp_bgp_update_mp_reach_t *msg);
+
 /**
  * Dump a human-readable version of the message to stdout
  *
@@ -71,6 +79,15 @@ void parsebgp_bgp_update_mp_unreach_destroy(
 void parsebgp_bgp_update_mp_unreach_clear(
   parsebgp_bgp_update_mp_unreach_t *msg);
 
+/** Add the memory held by an MP_UNREACH message to the given usage counters */
+void parsebgp_bgp_update_mp_unreach_mem_usage(
+  const parsebgp_bgp_update_mp_unreach_t *msg, parsebgp_mem_usage_t *usage);
+
+/** Release memory held by an MP_UNREACH message beyond what it currently
+    uses */
+void parsebgp_bgp_update_mp_unreach_trim(
+  parsebgp_bgp_update_mp_unreach_t *msg);
+
 /**
  * Dump a human-readable version of the message to stdout
  *
@@ -25,6 +25,7 @@
  */
 
 #include "parsebgp_bmp.h"
+#include "parsebgp_bmp_peers.h"
 #include "parsebgp_utils.h"
 #include <arpa/inet.h>
 #include <assert.h>
@@ -105,6 +106,42 @@ static void clear_info_tlvs(parsebgp_bmp_info_tlv_t **tlvs, int *tlvs_cnt)
   *tlvs_cnt = 0;
 }
 
+static void mem_usage_info_tlvs(const parsebgp_bmp_info_tlv_t *tlvs,
+                                int tlvs_alloc_cnt,
+                                parsebgp_mem_usage_t *usage)
+{
+  int i;
+  if (tlvs == NULL) {
+    return;
+  }
+
+  PARSEBGP_MEM_ADD(usage, other, sizeof(*tlvs) * tlvs_alloc_cnt);
+  for (i = 0; i < tlvs_alloc_cnt; i++) {
+    PARSEBGP_MEM_ADD(usage, raw, tlvs[i]._info_alloc_len);
+  }
+}
+
+static void trim_info_tlvs(parsebgp_bmp_info_tlv_t **tlvs, int *tlvs_alloc_cnt,
+                           int tlvs_cnt)
+{
+  int i;
+  if (*tlvs == NULL) {
+    return;
+  }
+
+  for (i = 0; i < *tlvs_alloc_cnt; i++) {
+    if (i < tlvs_cnt) {
+      PARSEBGP_MAYBE_SHRINK((*tlvs)[i].info, (*tlvs)[i]._info_alloc_len,
+                            (*tlvs)[i].len);
+    } else {
+      free((*tlvs)[i].info);
+      (*tlvs)[i].info = NULL;
+      (*tlvs)[i]._info_alloc_len = 0;
+    }
+  }
+  PARSEBGP_MAYBE_SHRINK(*tlvs, *tlvs_alloc_cnt, tlvs_cnt);
+}
+
 static void dump_info_tlvs(const parsebgp_bmp_info_tlv_t *tlvs, int tlvs_cnt,
                            int depth)
 {
@@ -231,6 +268,26 @@ static void clear_stats_report(parsebgp_bmp_stats_report_t *msg)
   msg->stats_count = 0;
 }
 
+static void mem_usage_stats_report(const parsebgp_bmp_stats_report_t *msg,
+                                   parsebgp_mem_usage_t *usage)
+{
+  if (msg == NULL) {
+    return;
+  }
+  PARSEBGP_MEM_ADD(usage, structs, sizeof(*msg));
+  PARSEBGP_MEM_ADD(usage, other,
+                   sizeof(*msg->counters) * msg->_counters_alloc_cnt);
+}
+
+static void trim_stats_report(parsebgp_bmp_stats_report_t *msg)
+{
+  if (msg == NULL) {
+    return;
+  }
+  PARSEBGP_MAYBE_SHRINK(msg->counters, msg->_counters_alloc_cnt,
+                        msg->stats_count);
+}
+
 static void dump_stats_report(const parsebgp_bmp_stats_report_t *msg, int depth)
 {
   PARSEBGP_DUMP_STRUCT_HDR(parsebgp_bmp_stats_report_t, depth);
@@ -362,6 +419,36 @@ static void clear_peer_down(parsebgp_bmp_peer_down_t *msg)
   }
 }
 
+static void mem_usage_peer_down(const parsebgp_bmp_peer_down_t *msg,
+                                parsebgp_mem_usage_t *usage)
+{
+  if (msg == NULL) {
+    return;
+  }
+  PARSEBGP_MEM_ADD(usage, structs, sizeof(*msg));
+  parsebgp_bgp_mem_usage(msg->data.notification, usage);
+}
+
+static void trim_peer_down(parsebgp_bmp_peer_down_t *msg)
+{
+  if (msg == NULL) {
+    return;
+  }
+
+  switch (msg->reason) {
+  // Reasons with a BGP NOTIFICATION message
+  case PARSEBGP_BMP_PEER_DOWN_LOCAL_CLOSE_WITH_NOTIF:
+  case PARSEBGP_BMP_PEER_DOWN_REMOTE_CLOSE_WITH_NOTIF:
+    parsebgp_bgp_trim_msg(msg->data.notification);
+    break;
+
+  default:
+    parsebgp_bgp_destroy_msg(msg->data.notification);
+    msg->data.notification = NULL;
+    break;
+  }
+}
+
 static void dump_peer_down(const parsebgp_bmp_peer_down_t *msg, int depth)
 {
   PARSEBGP_DUMP_STRUCT_HDR(parsebgp_bmp_peer_down_t, depth);
@@ -465,6 +552,28 @@ static void clear_peer_up(parsebgp_bmp_peer_up_t *msg)
   clear_info_tlvs(&msg->tlvs, &msg->tlvs_cnt);
 }
 
+static void mem_usage_peer_up(const parsebgp_bmp_peer_up_t *msg,
+                              parsebgp_mem_usage_t *usage)
+{
+  if (msg == NULL) {
+    return;
+  }
+  PARSEBGP_MEM_ADD(usage, structs, sizeof(*msg));
+  parsebgp_bgp_mem_usage(msg->sent_open, usage);
+  parsebgp_bgp_mem_usage(msg->recv_open, usage);
+  mem_usage_info_tlvs(msg->tlvs, msg->_tlvs_alloc_cnt, usage);
+}
+
+static void trim_peer_up(parsebgp_bmp_peer_up_t *msg)
+{
+  if (msg == NULL) {
+    return;
+  }
+  parsebgp_bgp_trim_msg(msg->sent_open);
+  parsebgp_bgp_trim_msg(msg->recv_open);
+  trim_info_tlvs(&msg->tlvs, &msg->_tlvs_alloc_cnt, msg->tlvs_cnt);
+}
+
 static void dump_peer_up(const parsebgp_bmp_peer_up_t *msg, int depth)
 {
   PARSEBGP_DUMP_STRUCT_HDR(parsebgp_bmp_peer_up_t, depth);
@@ -509,6 +618,24 @@ static void clear_init_msg(parsebgp_bmp_init_msg_t *msg)
   clear_info_tlvs(&msg->tlvs, &msg->tlvs_cnt);
 }
 
+static void mem_usage_init_msg(const parsebgp_bmp_init_msg_t *msg,
+                               parsebgp_mem_usage_t *usage)
+{
+  if (msg == NULL) {
+    return;
+  }
+  PARSEBGP_MEM_ADD(usage, structs, sizeof(*msg));
+  mem_usage_info_tlvs(msg->tlvs, msg->_tlvs_alloc_cnt, usage);
+}
+
+static void trim_init_msg(parsebgp_bmp_init_msg_t *msg)
+{
+  if (msg == NULL) {
+    return;
+  }
+  trim_info_tlvs(&msg->tlvs, &msg->_tlvs_alloc_cnt, msg->tlvs_cnt);
+}
+
 static void dump_init_msg(const parsebgp_bmp_init_msg_t *msg, int depth)
 {
   PARSEBGP_DUMP_STRUCT_HDR(parsebgp_bmp_init_msg_t, depth);
@@ -601,6 +728,45 @@ static void clear_term_msg(parsebgp_bmp_term_msg_t *msg)
   msg->tlvs_cnt = 0;
 }
 
+static void mem_usage_term_msg(const parsebgp_bmp_term_msg_t *msg,
+                               parsebgp_mem_usage_t *usage)
+{
+  int i;
+  if (msg == NULL) {
+    return;
+  }
+
+  PARSEBGP_MEM_ADD(usage, structs, sizeof(*msg));
+  PARSEBGP_MEM_ADD(usage, other, sizeof(*msg->tlvs) * msg->_tlvs_alloc_cnt);
+  for (i = 0; i < msg->_tlvs_alloc_cnt; i++) {
+    PARSEBGP_MEM_ADD(usage, raw, msg->tlvs[i].info._string_alloc_len);
+  }
+}
+
+static void trim_term_msg(parsebgp_bmp_term_msg_t *msg)
+{
+  int i;
+  parsebgp_bmp_term_tlv_t *tlv;
+
+  if (msg == NULL) {
+    return;
+  }
+
+  for (i = 0; i < msg->_tlvs_alloc_cnt; i++) {
+    tlv = &msg->tlvs[i];
+    if (i < msg->tlvs_cnt && tlv->type == PARSEBGP_BMP_TERM_INFO_TYPE_STRING) {
+      // (including the nul terminator)
+      PARSEBGP_MAYBE_SHRINK(tlv->info.string, tlv->info._string_alloc_len,
+                            tlv->len + 1);
+    } else {
+      free(tlv->info.string);
+      tlv->info.string = NULL;
+      tlv->info._string_alloc_len = 0;
+    }
+  }
+  PARSEBGP_MAYBE_SHRINK(msg->tlvs, msg->_tlvs_alloc_cnt, msg->tlvs_cnt);
+}
+
 static void dump_term_msg(const parsebgp_bmp_term_msg_t *msg, int depth)
 {
   PARSEBGP_DUMP_STRUCT_HDR(parsebgp_bmp_term_msg_t, depth);
@@ -738,6 +904,43 @@ static void clear_route_mirror_msg(parsebgp_bmp_route_mirror_t *msg)
   msg->tlvs_cnt = 0;
 }
 
+static void mem_usage_route_mirror_msg(const parsebgp_bmp_route_mirror_t *msg,
+                                       parsebgp_mem_usage_t *usage)
+{
+  int i;
+  if (msg == NULL) {
+    return;
+  }
+
+  PARSEBGP_MEM_ADD(usage, structs, sizeof(*msg));
+  PARSEBGP_MEM_ADD(usage, other, sizeof(*msg->tlvs) * msg->_tlvs_alloc_cnt);
+  for (i = 0; i < msg->_tlvs_alloc_cnt; i++) {
+    parsebgp_bgp_mem_usage(msg->tlvs[i].values.bgp_msg, usage);
+  }
+}
+
+static void trim_route_mirror_msg(parsebgp_bmp_route_mirror_t *msg)
+{
+  int i;
+  parsebgp_bmp_route_mirror_tlv_t *tlv;
+
+  if (msg == NULL) {
+    return;
+  }
+
+  for (i = 0; i < msg->_tlvs_alloc_cnt; i++) {
+    tlv = &msg->tlvs[i];
+    if (i < msg->tlvs_cnt &&
+        tlv->type == PARSEBGP_BMP_ROUTE_MIRROR_TYPE_BGP_MSG) {
+      parsebgp_bgp_trim_msg(tlv->values.bgp_msg);
+    } else {
+      parsebgp_bgp_destroy_msg(tlv->values.bgp_msg);
+      tlv->values.bgp_msg = NULL;
+    }
+  }
+  PARSEBGP_MAYBE_SHRINK(msg->tlvs, msg->_tlvs_alloc_cnt, msg->tlvs_cnt);
+}
+
 static void dump_route_mirror_msg(const parsebgp_bmp_route_mirror_t *msg,
     int depth)
 {
@@ -1061,9 +1264,10 @@ parsebgp_error_t parsebgp_bmp_decode(parsebgp_opts_t *opts,
 
   switch (msg->type) {
   case PARSEBGP_BMP_TYPE_ROUTE_MON:
-    // TODO: understand if it is sufficient to believe this flag
-    opts->bgp.asn_4_byte =
-      !(msg->peer_hdr.flags & PARSEBGP_BMP_PEER_FLAG_2_BYTE_AS_PATH);
+    // the flag is only trusted if the peer table confirms that 4-byte AS
+    // numbers were negotiated, otherwise the BGP parser may fall back to
+    // 2-byte parsing
+    parsebgp_bmp_peers_set_opts(opts->bmp.peers, &msg->peer_hdr, opts);
     PARSEBGP_MAYBE_MALLOC_ZERO(msg->types.route_mon);
     err = parsebgp_bgp_decode(opts, msg->types.route_mon, buf + nread, &slen);
     break;
@@ -1107,6 +1311,30 @@ parsebgp_error_t parsebgp_bmp_decode(parsebgp_opts_t *opts,
   }
   nread += slen;
 
+  if (opts->bmp.peers != NULL) {
+    switch (msg->type) {
+    case PARSEBGP_BMP_TYPE_PEER_UP:
+      if ((err = parsebgp_bmp_peers_up(opts->bmp.peers, &msg->peer_hdr,
+                                       msg->types.peer_up)) != PARSEBGP_OK) {
+        return err;
+      }
+      break;
+
+    case PARSEBGP_BMP_TYPE_PEER_DOWN:
+      parsebgp_bmp_peers_down(opts->bmp.peers, &msg->peer_hdr);
+      break;
+
+    case PARSEBGP_BMP_TYPE_INIT_MSG:
+    case PARSEBGP_BMP_TYPE_TERM_MSG:
+      // the router (re)started or is going away
+      parsebgp_bmp_peers_clear(opts->bmp.peers);
+      break;
+
+    default:
+      break;
+    }
+  }
+
   if (nread != msg->len) {
     // we didn't parse all the bytes in the BMP message (according to
     // the length in the header).
@@ -1122,6 +1350,47 @@ parsebgp_error_t parsebgp_bmp_decode(parsebgp_opts_t *opts,
   return PARSEBGP_OK;
 }
 
+parsebgp_error_t parsebgp_bmp_frame(const parsebgp_opts_t *opts,
+                                    const uint8_t *buf, size_t len,
+                                    size_t *msg_len)
+{
+  parsebgp_opts_t hdr_opts;
+  parsebgp_bmp_msg_t hdr;
+  parsebgp_error_t err;
+  size_t slen = len;
+
+  if (len < 1) {
+    *msg_len = 1;
+    return PARSEBGP_PARTIAL_MSG;
+  }
+
+  if (buf[0] == 3) {
+    // version, then the length of the whole message
+    if (len < 5) {
+      *msg_len = 5;
+      return PARSEBGP_PARTIAL_MSG;
+    }
+    *msg_len = nptohl(buf + 1);
+    if (*msg_len < BMP_HDR_V3_LEN) {
+      PARSEBGP_RETURN_INVALID_MSG_ERR;
+    }
+    return PARSEBGP_OK;
+  }
+
+  // v1/v2 messages have no length field, so parse the headers to infer it (the
+  // header parser sets some options, so give it a copy)
+  memcpy(&hdr_opts, opts, sizeof(hdr_opts));
+  memset(&hdr, 0, sizeof(hdr));
+  if ((err = parse_common_hdr(&hdr_opts, &hdr, buf, &slen)) != PARSEBGP_OK) {
+    if (err == PARSEBGP_PARTIAL_MSG) {
+      *msg_len = len + 1;
+    }
+    return err;
+  }
+  *msg_len = hdr.len;
+  return PARSEBGP_OK;
+}
+
 void parsebgp_bmp_destroy_msg(parsebgp_bmp_msg_t *msg)
 {
   if (msg == NULL) {
@@ -1179,6 +1448,86 @@ void parsebgp_bmp_clear_msg(parsebgp_bmp_msg_t *msg)
   }
 }
 
+void parsebgp_bmp_mem_usage(const parsebgp_bmp_msg_t *msg,
+                            parsebgp_mem_usage_t *usage)
+{
+  if (msg == NULL) {
+    return;
+  }
+
+  PARSEBGP_MEM_ADD(usage, structs, sizeof(*msg));
+
+  // structures for other message types are kept for reuse, so count them all
+  parsebgp_bgp_mem_usage(msg->types.route_mon, usage);
+  mem_usage_stats_report(msg->types.stats_report, usage);
+  mem_usage_peer_down(msg->types.peer_down, usage);
+  mem_usage_peer_up(msg->types.peer_up, usage);
+  mem_usage_init_msg(msg->types.init_msg, usage);
+  mem_usage_term_msg(msg->types.term_msg, usage);
+  mem_usage_route_mirror_msg(msg->types.route_mirror, usage);
+}
+
+void parsebgp_bmp_trim_msg(parsebgp_bmp_msg_t *msg)
+{
+  int type;
+
+  if (msg == NULL) {
+    return;
+  }
+
+  // free the structures of other message types, and trim the current one
+  type = msg->types_valid ? msg->type : -1;
+
+  if (type == PARSEBGP_BMP_TYPE_ROUTE_MON) {
+    parsebgp_bgp_trim_msg(msg->types.route_mon);
+  } else {
+    parsebgp_bgp_destroy_msg(msg->types.route_mon);
+    msg->types.route_mon = NULL;
+  }
+
+  if (type == PARSEBGP_BMP_TYPE_STATS_REPORT) {
+    trim_stats_report(msg->types.stats_report);
+  } else {
+    destroy_stats_report(msg->types.stats_report);
+    msg->types.stats_report = NULL;
+  }
+
+  if (type == PARSEBGP_BMP_TYPE_PEER_DOWN) {
+    trim_peer_down(msg->types.peer_down);
+  } else {
+    destroy_peer_down(msg->types.peer_down);
+    msg->types.peer_down = NULL;
+  }
+
+  if (type == PARSEBGP_BMP_TYPE_PEER_UP) {
+    trim_peer_up(msg->types.peer_up);
+  } else {
+    destroy_peer_up(msg->types.peer_up);
+    msg->types.peer_up = NULL;
+  }
+
+  if (type == PARSEBGP_BMP_TYPE_INIT_MSG) {
+    trim_init_msg(msg->types.init_msg);
+  } else {
+    destroy_init_msg(msg->types.init_msg);
+    msg->types.init_msg = NULL;
+  }
+
+  if (type == PARSEBGP_BMP_TYPE_TERM_MSG) {
+    trim_term_msg(msg->types.term_msg);
+  } else {
+    destroy_term_msg(msg->types.term_msg);
+    msg->types.term_msg = NULL;
+  }
+
+  if (type == PARSEBGP_BMP_TYPE_ROUTE_MIRROR_MSG) {
+    trim_route_mirror_msg(msg->types.route_mirror);
+  } else {
+    destroy_route_mirror_msg(msg->types.route_mirror);
+    msg->types.route_mirror = NULL;
+  }
+}
+
 void parsebgp_bmp_dump_msg(const parsebgp_bmp_msg_t *msg, int depth)
 {
   PARSEBGP_DUMP_STRUCT_HDR(parsebgp_bmp_msg_t, depth);
@@ -29,6 +29,7 @@
 
 #include "parsebgp_bgp.h"   // BMP encapsulates BGP messages
 #include "parsebgp_error.h" // for parsebgp_error_t
+#include "parsebgp_mem.h"   // for parsebgp_mem_usage_t
 #include <inttypes.h>
 #include <stddef.h>
 
@@ -593,6 +594,31 @@ parsebgp_error_t parsebgp_bmp_decode(parsebgp_opts_t *opts,
                                      parsebgp_bmp_msg_t *msg, const uint8_t *buffer,
                                      size_t *len);
 
+/**
+ * Determine the length of the BMP message at the start of the given buffer
+ *
+ * @param [in] opts     Options for the parser
+ * @param [in] buf      Pointer to the start of a raw BMP message
+ * @param [in] len      Number of bytes available in the buffer
+ * @param [out] msg_len Set to the total length of the message if successful,
+ *                      or to the minimum number of bytes needed to determine
+ *                      the length if PARSEBGP_PARTIAL_MSG is returned
+ * @return PARSEBGP_OK (0) if the length was determined, or an error code
+ * otherwise
+ *
+ * Only the header is examined, so this is cheap enough to call every time more
+ * data arrives. Once len is at least msg_len, the message can be decoded
+ * without PARSEBGP_PARTIAL_MSG being returned, so stream readers can wait for
+ * the whole message and decode it exactly once.
+ *
+ * BMP v3 messages carry their length in the common header. For v1/v2 messages
+ * the length is inferred from the headers (including that of an encapsulated
+ * BGP message), and msg_len may be set to len + 1 if more data is needed.
+ */
+parsebgp_error_t parsebgp_bmp_frame(const parsebgp_opts_t *opts,
+                                    const uint8_t *buf, size_t len,
+                                    size_t *msg_len);
+
 /** Destroy the given BMP message structure
  *
  * @param msg           Pointer to message structure to destroy
@@ -605,6 +631,22 @@ void parsebgp_bmp_destroy_msg(parsebgp_bmp_msg_t *msg);
  */
 void parsebgp_bmp_clear_msg(parsebgp_bmp_msg_t *msg);
 
+/** Add the memory held by the given BMP message structure to the given usage
+ * counters
+ *
+ * @param msg           Pointer to message structure
+ * @param usage         Pointer to the usage counters to add to
+ */
+void parsebgp_bmp_mem_usage(const parsebgp_bmp_msg_t *msg,
+                            parsebgp_mem_usage_t *usage);
+
+/** Release memory held by the given BMP message structure beyond what the
+ * message it currently holds uses
+ *
+ * @param msg           Pointer to message structure to trim
+ */
+void parsebgp_bmp_trim_msg(parsebgp_bmp_msg_t *msg);
+
 /**
  * Dump a human-readable version of the message to stdout
  *
@@ -30,6 +30,8 @@
 #include "parsebgp_bgp_common.h"
 #include <inttypes.h>
 
+struct parsebgp_bmp_peers;
+
 /**
  * BMP Parsing Options
  */
@@ -53,6 +55,17 @@ typedef struct parsebgp_bmp_opts {
    */
   int parse_headers_only;
 
+  /**
+   * Peer Table
+   *
+   * If set, the capabilities negotiated with each peer are recorded from
+   * PEER_UP messages and used to configure the BGP parser for ROUTE_MON
+   * messages (see parsebgp_bmp_peers.h). The table must only hold peers of the
+   * router that sent the messages being parsed. Not updated when
+   * parse_headers_only is set.
+   */
+  struct parsebgp_bmp_peers *peers;
+
 } parsebgp_bmp_opts_t;
 
 /**
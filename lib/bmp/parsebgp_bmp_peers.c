@@ -0,0 +1,381 @@
+/*
+ * Copyright (C) 2017 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "parsebgp_bmp_peers.h"
+#include "parsebgp_bgp.h"
+#include "parsebgp_error.h"
+#include "parsebgp_utils.h"
+#include <stdlib.h>
+#include <string.h>
+
+/** Initial number of hash buckets (a power of two) */
+#define BUCKETS_CNT 64
+
+/** A peer in the table */
+typedef struct peer {
+
+  /** Route distinguisher */
+  uint64_t dist_id;
+
+  /** Address (IPv4 addresses only use the first 4 bytes, the rest are
+      zero) */
+  uint8_t addr[16];
+
+  /** Address family */
+  parsebgp_bgp_afi_t afi;
+
+  /** Hash of the key fields */
+  uint32_t hash;
+
+  /** Negotiated capabilities */
+  parsebgp_bmp_peer_caps_t caps;
+
+  /** Next peer in the same bucket */
+  struct peer *next;
+
+} peer_t;
+
+struct parsebgp_bmp_peers {
+
+  /** Hash buckets */
+  peer_t **buckets;
+
+  /** Number of buckets (a power of two) */
+  uint32_t buckets_cnt;
+
+  /** Number of peers in the table */
+  uint32_t peers_cnt;
+};
+
+// the per-peer header leaves garbage after IPv4 addresses, so only the bytes
+// that belong to the address are used
+static int addr_len(const parsebgp_bmp_peer_hdr_t *hdr)
+{
+  return (hdr->afi == PARSEBGP_BGP_AFI_IPV4) ? 4 : 16;
+}
+
+static uint32_t hash_peer(const parsebgp_bmp_peer_hdr_t *hdr)
+{
+  uint64_t hash = 0xCBF29CE484222325ULL ^ hdr->dist_id;
+  int i;
+
+  for (i = 0; i < addr_len(hdr); i++) {
+    hash = (hash ^ hdr->addr[i]) * 0x100000001B3ULL;
+  }
+  return hash ^ (hash >> 32);
+}
+
+static peer_t **find_peer(const parsebgp_bmp_peers_t *peers,
+                          const parsebgp_bmp_peer_hdr_t *hdr, uint32_t hash)
+{
+  peer_t **pp = &peers->buckets[hash & (peers->buckets_cnt - 1)];
+
+  for (; *pp != NULL; pp = &(*pp)->next) {
+    if ((*pp)->hash == hash && (*pp)->dist_id == hdr->dist_id &&
+        (*pp)->afi == hdr->afi &&
+        memcmp((*pp)->addr, hdr->addr, addr_len(hdr)) == 0) {
+      break;
+    }
+  }
+  return pp;
+}
+
+static parsebgp_error_t grow(parsebgp_bmp_peers_t *peers)
+{
+  uint32_t cnt = peers->buckets_cnt * 2, i;
+  peer_t **buckets, *peer, *next;
+
+  if ((buckets = calloc(cnt, sizeof(peer_t *))) == NULL) {
+    return PARSEBGP_MALLOC_FAILURE;
+  }
+  for (i = 0; i < peers->buckets_cnt; i++) {
+    for (peer = peers->buckets[i]; peer != NULL; peer = next) {
+      next = peer->next;
+      peer->next = buckets[peer->hash & (cnt - 1)];
+      buckets[peer->hash & (cnt - 1)] = peer;
+    }
+  }
+  free(peers->buckets);
+  peers->buckets = buckets;
+  peers->buckets_cnt = cnt;
+  return PARSEBGP_OK;
+}
+
+static const parsebgp_bgp_open_t *get_open(const parsebgp_bgp_msg_t *msg)
+{
+  if (msg == NULL || msg->type != PARSEBGP_BGP_TYPE_OPEN) {
+    return NULL;
+  }
+  return msg->types.open;
+}
+
+static int has_as4(const parsebgp_bgp_open_t *open)
+{
+  int i;
+
+  for (i = 0; i < open->capabilities_cnt; i++) {
+    if (open->capabilities[i].code == PARSEBGP_BGP_OPEN_CAPABILITY_AS4) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static int has_mp(const parsebgp_bgp_open_t *open, uint16_t afi, uint8_t safi)
+{
+  const parsebgp_bgp_open_capability_t *cap;
+  int i;
+
+  for (i = 0; i < open->capabilities_cnt; i++) {
+    cap = &open->capabilities[i];
+    if (cap->code == PARSEBGP_BGP_OPEN_CAPABILITY_MPBGP &&
+        cap->values.mpbgp.afi == afi && cap->values.mpbgp.safi == safi) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// get the ADD-PATH Send/Receive value advertised for the AFI/SAFI (or 0)
+static int get_add_path(const parsebgp_bgp_open_t *open, uint16_t afi,
+                        uint8_t safi)
+{
+  const parsebgp_bgp_open_capability_t *cap;
+  const parsebgp_bgp_open_capability_add_path_afi_safi_t *as;
+  int i, j;
+
+  for (i = 0; i < open->capabilities_cnt; i++) {
+    cap = &open->capabilities[i];
+    if (cap->code != PARSEBGP_BGP_OPEN_CAPABILITY_ADD_PATH) {
+      continue;
+    }
+    for (j = 0; j < cap->values.add_path.afi_safis_cnt; j++) {
+      as = &cap->values.add_path.afi_safis[j];
+      if (as->afi == afi && as->safi == safi) {
+        return as->send_receive;
+      }
+    }
+  }
+  return 0;
+}
+
+static void add_afi_safi(parsebgp_bmp_peer_caps_t *caps, uint16_t afi,
+                         uint8_t safi, int mp, int add_path)
+{
+  parsebgp_bmp_peer_afi_safi_t *as;
+  int i;
+
+  for (i = 0; i < caps->afi_safis_cnt; i++) {
+    if (caps->afi_safis[i].afi == afi && caps->afi_safis[i].safi == safi) {
+      return;
+    }
+  }
+  if (caps->afi_safis_cnt == PARSEBGP_BMP_PEER_AFI_SAFIS_MAX) {
+    return;
+  }
+  as = &caps->afi_safis[caps->afi_safis_cnt++];
+  as->afi = afi;
+  as->safi = safi;
+  as->mp = mp;
+  as->add_path = add_path;
+}
+
+// work out what was negotiated from the OPEN messages sent by the router and
+// received from the peer
+static void negotiate(parsebgp_bmp_peer_caps_t *caps,
+                      const parsebgp_bgp_open_t *sent,
+                      const parsebgp_bgp_open_t *recv)
+{
+  const parsebgp_bgp_open_capability_t *cap;
+  uint16_t afi;
+  uint8_t safi;
+  int i, j, mp, add_path;
+
+  memset(caps, 0, sizeof(*caps));
+  if (sent == NULL || recv == NULL) {
+    return;
+  }
+
+  caps->as4 = has_as4(sent) && has_as4(recv);
+
+  for (i = 0; i < recv->capabilities_cnt; i++) {
+    cap = &recv->capabilities[i];
+    if (cap->code == PARSEBGP_BGP_OPEN_CAPABILITY_MPBGP) {
+      afi = cap->values.mpbgp.afi;
+      safi = cap->values.mpbgp.safi;
+      mp = has_mp(sent, afi, safi);
+      add_path = (get_add_path(recv, afi, safi) &
+                  PARSEBGP_BGP_OPEN_ADD_PATH_SEND) &&
+                 (get_add_path(sent, afi, safi) &
+                  PARSEBGP_BGP_OPEN_ADD_PATH_RECEIVE);
+      if (mp || add_path) {
+        add_afi_safi(caps, afi, safi, mp, add_path);
+      }
+    } else if (cap->code == PARSEBGP_BGP_OPEN_CAPABILITY_ADD_PATH) {
+      // ADD-PATH may be used without MP (i.e., for IPv4 unicast)
+      for (j = 0; j < cap->values.add_path.afi_safis_cnt; j++) {
+        afi = cap->values.add_path.afi_safis[j].afi;
+        safi = cap->values.add_path.afi_safis[j].safi;
+        add_path = (get_add_path(recv, afi, safi) &
+                    PARSEBGP_BGP_OPEN_ADD_PATH_SEND) &&
+                   (get_add_path(sent, afi, safi) &
+                    PARSEBGP_BGP_OPEN_ADD_PATH_RECEIVE);
+        if (add_path) {
+          add_afi_safi(caps, afi, safi, has_mp(recv, afi, safi) &&
+                                          has_mp(sent, afi, safi),
+                       add_path);
+        }
+      }
+    }
+  }
+}
+
+parsebgp_bmp_peers_t *parsebgp_bmp_peers_create(void)
+{
+  parsebgp_bmp_peers_t *peers;
+
+  if ((peers = malloc_zero(sizeof(parsebgp_bmp_peers_t))) == NULL) {
+    return NULL;
+  }
+  if ((peers->buckets = calloc(BUCKETS_CNT, sizeof(peer_t *))) == NULL) {
+    free(peers);
+    return NULL;
+  }
+  peers->buckets_cnt = BUCKETS_CNT;
+  return peers;
+}
+
+void parsebgp_bmp_peers_destroy(parsebgp_bmp_peers_t *peers)
+{
+  if (peers == NULL) {
+    return;
+  }
+  parsebgp_bmp_peers_clear(peers);
+  free(peers->buckets);
+  free(peers);
+}
+
+void parsebgp_bmp_peers_clear(parsebgp_bmp_peers_t *peers)
+{
+  peer_t *peer, *next;
+  uint32_t i;
+
+  for (i = 0; i < peers->buckets_cnt; i++) {
+    for (peer = peers->buckets[i]; peer != NULL; peer = next) {
+      next = peer->next;
+      free(peer);
+    }
+    peers->buckets[i] = NULL;
+  }
+  peers->peers_cnt = 0;
+}
+
+parsebgp_error_t parsebgp_bmp_peers_up(parsebgp_bmp_peers_t *peers,
+                                       const parsebgp_bmp_peer_hdr_t *hdr,
+                                       const parsebgp_bmp_peer_up_t *peer_up)
+{
+  uint32_t hash = hash_peer(hdr);
+  peer_t **pp = find_peer(peers, hdr, hash), *peer;
+  parsebgp_error_t err;
+
+  if ((peer = *pp) == NULL) {
+    if (peers->peers_cnt >= peers->buckets_cnt) {
+      if ((err = grow(peers)) != PARSEBGP_OK) {
+        return err;
+      }
+      pp = find_peer(peers, hdr, hash);
+    }
+    if ((peer = malloc_zero(sizeof(peer_t))) == NULL) {
+      return PARSEBGP_MALLOC_FAILURE;
+    }
+    peer->dist_id = hdr->dist_id;
+    memcpy(peer->addr, hdr->addr, addr_len(hdr));
+    peer->afi = hdr->afi;
+    peer->hash = hash;
+    *pp = peer;
+    peers->peers_cnt++;
+  }
+
+  negotiate(&peer->caps, get_open(peer_up->sent_open),
+            get_open(peer_up->recv_open));
+  return PARSEBGP_OK;
+}
+
+void parsebgp_bmp_peers_down(parsebgp_bmp_peers_t *peers,
+                             const parsebgp_bmp_peer_hdr_t *hdr)
+{
+  peer_t **pp = find_peer(peers, hdr, hash_peer(hdr)), *peer;
+
+  if ((peer = *pp) == NULL) {
+    return;
+  }
+  *pp = peer->next;
+  free(peer);
+  peers->peers_cnt--;
+}
+
+const parsebgp_bmp_peer_caps_t *
+parsebgp_bmp_peers_get(const parsebgp_bmp_peers_t *peers,
+                       const parsebgp_bmp_peer_hdr_t *hdr)
+{
+  peer_t *peer = *find_peer(peers, hdr, hash_peer(hdr));
+
+  return (peer != NULL) ? &peer->caps : NULL;
+}
+
+void parsebgp_bmp_peers_set_opts(const parsebgp_bmp_peers_t *peers,
+                                 const parsebgp_bmp_peer_hdr_t *hdr,
+                                 parsebgp_opts_t *opts)
+{
+  const parsebgp_bmp_peer_caps_t *caps;
+  const parsebgp_bmp_peer_afi_safi_t *as;
+  int i;
+
+  opts->bgp.asn_4_byte = !(hdr->flags & PARSEBGP_BMP_PEER_FLAG_2_BYTE_AS_PATH);
+  opts->bgp.asn_4_byte_trusted = 0;
+  if (peers == NULL) {
+    return;
+  }
+  // the table is authoritative, so a peer that it has no PEER_UP for (e.g.,
+  // after a restart) is assumed not to send Path Identifiers
+  memset(opts->bgp.add_path, 0, sizeof(opts->bgp.add_path));
+  if ((caps = parsebgp_bmp_peers_get(peers, hdr)) == NULL) {
+    return;
+  }
+  if (opts->bgp.asn_4_byte && caps->as4) {
+    // the router says the path uses 4-byte ASNs, and the session can carry
+    // them, so there is no need to second-guess it
+    opts->bgp.asn_4_byte_trusted = 1;
+  }
+
+  for (i = 0; i < caps->afi_safis_cnt; i++) {
+    as = &caps->afi_safis[i];
+    if (as->add_path && as->afi < PARSEBGP_BGP_OPTS_ADD_PATH_CNT &&
+        as->safi < PARSEBGP_BGP_OPTS_ADD_PATH_CNT) {
+      opts->bgp.add_path[as->afi][as->safi] = 1;
+    }
+  }
+}
@@ -0,0 +1,167 @@
+/*
+ * Copyright (C) 2017 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __PARSEBGP_BMP_PEERS_H
+#define __PARSEBGP_BMP_PEERS_H
+
+#include "parsebgp_bmp.h"
+#include "parsebgp_error.h"
+#include "parsebgp_opts.h"
+#include <inttypes.h>
+
+/**
+ * BMP Peer Table
+ *
+ * Caches what was negotiated on each BGP session monitored by a single BMP
+ * session (i.e., router), as learned from the OPEN messages in PEER_UP
+ * messages. Peers are identified by the route distinguisher and address in the
+ * per-peer header.
+ *
+ * If a table is set in the BMP parsing options (opts->bmp.peers), the BMP
+ * decoder maintains it (PEER_UP adds a peer, PEER_DOWN removes it, and
+ * INITIATION and TERMINATION messages clear the table), and uses it to set the
+ * BGP options for each ROUTE_MON message with a single hash lookup. One table
+ * must be used per router session, and it must only be used by one thread at a
+ * time.
+ */
+typedef struct parsebgp_bmp_peers parsebgp_bmp_peers_t;
+
+/** Maximum number of AFI/SAFIs recorded per peer */
+#define PARSEBGP_BMP_PEER_AFI_SAFIS_MAX 16
+
+/**
+ * AFI/SAFI negotiated with a peer
+ */
+typedef struct parsebgp_bmp_peer_afi_safi {
+
+  /** AFI */
+  uint16_t afi;
+
+  /** SAFI */
+  uint8_t safi;
+
+  /** Was the Multiprotocol capability negotiated for this AFI/SAFI */
+  uint8_t mp;
+
+  /** Does the peer send ADD-PATH Path Identifiers for this AFI/SAFI (i.e., it
+      advertised that it would send them, and the router advertised that it
+      would receive them) */
+  uint8_t add_path;
+
+} parsebgp_bmp_peer_afi_safi_t;
+
+/**
+ * Capabilities negotiated with a peer
+ */
+typedef struct parsebgp_bmp_peer_caps {
+
+  /** Was support for 4-byte AS numbers negotiated (i.e., advertised by both
+      the router and the peer) */
+  int as4;
+
+  /** AFI/SAFIs with MP or ADD-PATH capabilities negotiated */
+  parsebgp_bmp_peer_afi_safi_t afi_safis[PARSEBGP_BMP_PEER_AFI_SAFIS_MAX];
+
+  /** Number of AFI/SAFIs */
+  int afi_safis_cnt;
+
+} parsebgp_bmp_peer_caps_t;
+
+/**
+ * Create a peer table
+ *
+ * @return pointer to a new table, or NULL if an error occurred
+ */
+parsebgp_bmp_peers_t *parsebgp_bmp_peers_create(void);
+
+/**
+ * Destroy the given peer table
+ *
+ * @param peers         Pointer to the table to destroy
+ */
+void parsebgp_bmp_peers_destroy(parsebgp_bmp_peers_t *peers);
+
+/**
+ * Remove all peers from the given table (e.g., when the router reconnects)
+ *
+ * @param peers         Pointer to the table to clear
+ */
+void parsebgp_bmp_peers_clear(parsebgp_bmp_peers_t *peers);
+
+/**
+ * Record the capabilities negotiated in the given PEER_UP message
+ *
+ * @param peers         Pointer to the table
+ * @param hdr           Per-peer header of the PEER_UP message
+ * @param peer_up       Decoded PEER_UP message
+ * @return PARSEBGP_OK if successful, or an error code otherwise
+ *
+ * Replaces any capabilities already recorded for the peer.
+ */
+parsebgp_error_t parsebgp_bmp_peers_up(parsebgp_bmp_peers_t *peers,
+                                       const parsebgp_bmp_peer_hdr_t *hdr,
+                                       const parsebgp_bmp_peer_up_t *peer_up);
+
+/**
+ * Forget the given peer (e.g., after a PEER_DOWN message)
+ *
+ * @param peers         Pointer to the table
+ * @param hdr           Per-peer header identifying the peer
+ */
+void parsebgp_bmp_peers_down(parsebgp_bmp_peers_t *peers,
+                             const parsebgp_bmp_peer_hdr_t *hdr);
+
+/**
+ * Get the capabilities negotiated with the given peer
+ *
+ * @param peers         Pointer to the table
+ * @param hdr           Per-peer header identifying the peer
+ * @return borrowed pointer to the capabilities of the peer, or NULL if no
+ * PEER_UP message has been seen for it
+ */
+const parsebgp_bmp_peer_caps_t *
+parsebgp_bmp_peers_get(const parsebgp_bmp_peers_t *peers,
+                       const parsebgp_bmp_peer_hdr_t *hdr);
+
+/**
+ * Set the BGP options used to decode a ROUTE_MON message from the given peer
+ *
+ * @param peers         Pointer to the table
+ * @param hdr           Per-peer header of the ROUTE_MON message
+ * @param opts          Options to update
+ *
+ * The AS number size is taken from the peer header flag, as without a table.
+ * If the flag indicates 4-byte AS numbers and 4-byte support was negotiated
+ * with the peer, the size is also marked as trusted (so the decoder does not
+ * retry a failed AS_PATH with 2-byte AS numbers). If a table is given, the
+ * ADD-PATH table of the BGP options is also set to the AFI/SAFIs for which the
+ * peer sends Path Identifiers (none if the peer is not in the table).
+ */
+void parsebgp_bmp_peers_set_opts(const parsebgp_bmp_peers_t *peers,
+                                 const parsebgp_bmp_peer_hdr_t *hdr,
+                                 parsebgp_opts_t *opts);
+
+#endif /* __PARSEBGP_BMP_PEERS_H */
@@ -0,0 +1,780 @@
+/*
+ * Copyright (C) 2017 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "parsebgp_bmp_station.h"
+#include "parsebgp_bmp_peers.h"
+#include "parsebgp_error.h"
+#include "parsebgp_utils.h"
+#include <stdlib.h>
+
+#ifdef HAVE_SYS_EPOLL_H
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/** Initial size of a session receive buffer */
+#define RECV_BUF_LEN (64 * 1024)
+
+/** Largest message that a session will buffer. Anything bigger is assumed to
+    be garbage (BMP messages carry at most one BGP message, plus headers). */
+#define MSG_LEN_MAX (16 * 1024 * 1024)
+
+/** Number of epoll events handled per wakeup */
+#define EVENTS_CNT 64
+
+/** Maximum number of listening sockets */
+#define LISTEN_CNT 16
+
+/** Router session */
+typedef struct session {
+
+  /** Public router information (passed to callbacks) */
+  parsebgp_bmp_station_router_t router;
+
+  /** Connected socket */
+  int fd;
+
+  /** Receive buffer. Bytes between head and tail have been received but not
+      yet consumed. */
+  uint8_t *buf;
+
+  /** Allocated length of the receive buffer */
+  size_t buf_len;
+
+  /** Offset of the first unconsumed byte */
+  size_t head;
+
+  /** Offset of the end of the received data */
+  size_t tail;
+
+  /** Has the start of the session been reported */
+  int reported;
+
+  /** Capabilities negotiated with the peers of the router */
+  parsebgp_bmp_peers_t *peers;
+
+  /** Sessions are kept in a (doubly-linked) list by their worker */
+  struct session *prev;
+  struct session *next;
+
+} session_t;
+
+/** Worker thread state */
+typedef struct worker {
+
+  /** Station the worker belongs to */
+  struct parsebgp_bmp_station *station;
+
+  /** Index of the worker */
+  int idx;
+
+  /** Thread running the worker (if started) */
+  pthread_t thread;
+  int started;
+
+  /** Epoll instance used to wait on the worker's sessions */
+  int epfd;
+
+  /** Pipe used to wake up the worker (the read end is registered with epoll
+      using a NULL pointer) */
+  int wake_fds[2];
+
+  /** Protects the pending list and the shutdown flag */
+  pthread_mutex_t mutex;
+
+  /** Sessions handed to the worker but not yet adopted by it */
+  session_t *pending;
+
+  /** Set when the worker should close all sessions and exit */
+  int shutdown;
+
+  /** Sessions owned by the worker */
+  session_t *sessions;
+
+  /** Options used to decode the current message (the decoder modifies them,
+      e.g., with the ADD-PATH table of the peer, so they are reset from the
+      station options for each message) */
+  parsebgp_opts_t opts;
+
+  /** Message structure reused for every message */
+  parsebgp_bmp_msg_t *msg;
+
+} worker_t;
+
+struct parsebgp_bmp_station {
+
+  /** Options to use when decoding messages */
+  parsebgp_opts_t opts;
+
+  /** Callbacks */
+  parsebgp_bmp_station_msg_cb_t *msg_cb;
+  parsebgp_bmp_station_session_cb_t *session_cb;
+  void *user;
+
+  /** Worker threads */
+  worker_t *workers;
+  int workers_cnt;
+
+  /** Epoll instance used by the accepting thread */
+  int epfd;
+
+  /** Pipe used to stop the station (see parsebgp_bmp_station_stop) */
+  int stop_fds[2];
+
+  /** Listening sockets */
+  int listen_fds[LISTEN_CNT];
+  int listen_cnt;
+
+  /** ID of the next session */
+  uint64_t next_id;
+  pthread_mutex_t id_mutex;
+};
+
+/* ========== UTILITIES ========== */
+
+static int set_nonblock(int fd)
+{
+  int flags;
+
+  if ((flags = fcntl(fd, F_GETFL)) < 0 ||
+      fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+    return -1;
+  }
+  return 0;
+}
+
+static int make_pipe(int fds[2])
+{
+  if (pipe(fds) != 0) {
+    fds[0] = fds[1] = -1;
+    return -1;
+  }
+  if (set_nonblock(fds[0]) != 0 || set_nonblock(fds[1]) != 0) {
+    return -1;
+  }
+  return 0;
+}
+
+static void close_pipe(int fds[2])
+{
+  if (fds[0] >= 0) {
+    close(fds[0]);
+  }
+  if (fds[1] >= 0) {
+    close(fds[1]);
+  }
+  fds[0] = fds[1] = -1;
+}
+
+// write a byte to the pipe (async-signal-safe)
+static void poke(int fds[2])
+{
+  const char c = 0;
+  ssize_t unused;
+
+  unused = write(fds[1], &c, 1);
+  (void)unused;
+}
+
+static void drain(int fds[2])
+{
+  char buf[64];
+
+  while (read(fds[0], buf, sizeof(buf)) > 0)
+    ;
+}
+
+// register fd with the epoll instance using the given pointer as its data
+static int watch(int epfd, int fd, void *ptr)
+{
+  struct epoll_event ev;
+
+  memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLIN;
+  ev.data.ptr = ptr;
+  return epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+// pick the worker for a router, so that all sessions from a router are handled
+// by the same worker
+static int shard(const parsebgp_bmp_station_t *station,
+                 const struct sockaddr_storage *ss)
+{
+  const uint8_t *addr = NULL;
+  size_t len = 0, i;
+  uint32_t hash = 2166136261U;
+
+  if (ss->ss_family == AF_INET) {
+    addr = (const uint8_t *)&((const struct sockaddr_in *)ss)->sin_addr;
+    len = 4;
+  } else if (ss->ss_family == AF_INET6) {
+    addr = (const uint8_t *)&((const struct sockaddr_in6 *)ss)->sin6_addr;
+    len = 16;
+  }
+  for (i = 0; i < len; i++) {
+    hash = (hash ^ addr[i]) * 16777619U;
+  }
+  return hash % station->workers_cnt;
+}
+
+/* ========== SESSIONS ========== */
+
+static session_t *session_create(parsebgp_bmp_station_t *station, int fd)
+{
+  struct sockaddr_storage ss;
+  socklen_t ss_len = sizeof(ss);
+  session_t *sess;
+  int one = 1;
+
+  if (set_nonblock(fd) != 0 || (sess = malloc_zero(sizeof(*sess))) == NULL) {
+    return NULL;
+  }
+  if ((sess->peers = parsebgp_bmp_peers_create()) == NULL) {
+    free(sess);
+    return NULL;
+  }
+  sess->fd = fd;
+  // BMP is one-way, so there is nothing to be gained from delaying ACKs
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+  memset(&ss, 0, sizeof(ss));
+  if (getpeername(fd, (struct sockaddr *)&ss, &ss_len) == 0) {
+    if (ss.ss_family == AF_INET) {
+      inet_ntop(AF_INET, &((struct sockaddr_in *)&ss)->sin_addr,
+                sess->router.addr, sizeof(sess->router.addr));
+      sess->router.port = ntohs(((struct sockaddr_in *)&ss)->sin_port);
+    } else if (ss.ss_family == AF_INET6) {
+      inet_ntop(AF_INET6, &((struct sockaddr_in6 *)&ss)->sin6_addr,
+                sess->router.addr, sizeof(sess->router.addr));
+      sess->router.port = ntohs(((struct sockaddr_in6 *)&ss)->sin6_port);
+    }
+  }
+  sess->router.worker = shard(station, &ss);
+
+  pthread_mutex_lock(&station->id_mutex);
+  sess->router.id = ++station->next_id;
+  pthread_mutex_unlock(&station->id_mutex);
+
+  return sess;
+}
+
+// close the session, reporting its end (if its start was reported)
+static void session_close(worker_t *w, session_t *sess, parsebgp_error_t err)
+{
+  parsebgp_bmp_station_t *station = w->station;
+
+  if (sess->reported && station->session_cb != NULL) {
+    station->session_cb(station->user, &sess->router, 0, err);
+  }
+  close(sess->fd);
+  parsebgp_bmp_peers_destroy(sess->peers);
+  free(sess->buf);
+  free(sess);
+}
+
+// make room in the receive buffer for more data
+static int session_make_room(session_t *sess)
+{
+  size_t len;
+  uint8_t *tmp;
+
+  if (sess->tail < sess->buf_len) {
+    return 0;
+  }
+  if (sess->head > 0) {
+    // move the partial message to the start of the buffer
+    memmove(sess->buf, sess->buf + sess->head, sess->tail - sess->head);
+    sess->tail -= sess->head;
+    sess->head = 0;
+    return 0;
+  }
+  // the buffer holds a single partial message, so it must grow
+  len = (sess->buf_len > 0) ? sess->buf_len * 2 : RECV_BUF_LEN;
+  if (len > MSG_LEN_MAX) {
+    return -1;
+  }
+  if ((tmp = realloc(sess->buf, len)) == NULL) {
+    return -1;
+  }
+  sess->buf = tmp;
+  sess->buf_len = len;
+  return 0;
+}
+
+// decode and dispatch all complete messages in the receive buffer
+static parsebgp_error_t session_process(worker_t *w, session_t *sess)
+{
+  parsebgp_bmp_station_t *station = w->station;
+  parsebgp_error_t err;
+  size_t avail, need, len;
+
+  while ((avail = sess->tail - sess->head) > 0) {
+    // don't bother decoding until the whole message is here
+    err = parsebgp_bmp_frame(&w->opts, sess->buf + sess->head, avail, &need);
+    if (err != PARSEBGP_OK && err != PARSEBGP_PARTIAL_MSG) {
+      return err;
+    }
+    if (need > MSG_LEN_MAX) {
+      return PARSEBGP_INVALID_MSG;
+    }
+    if (err == PARSEBGP_PARTIAL_MSG || need > avail) {
+      break;
+    }
+
+    len = avail;
+    memcpy(&w->opts, &station->opts, sizeof(w->opts));
+    w->opts.bmp.peers = sess->peers;
+    err = parsebgp_bmp_decode(&w->opts, w->msg, sess->buf + sess->head, &len);
+    if (err == PARSEBGP_PARTIAL_MSG) {
+      // the length inferred for a v1/v2 message was too short
+      parsebgp_bmp_clear_msg(w->msg);
+      break;
+    }
+    if (err != PARSEBGP_OK) {
+      parsebgp_bmp_clear_msg(w->msg);
+      return err;
+    }
+
+    station->msg_cb(station->user, &sess->router, w->msg);
+    parsebgp_bmp_clear_msg(w->msg);
+    sess->head += len;
+  }
+
+  if (sess->head == sess->tail) {
+    sess->head = sess->tail = 0;
+  }
+  return PARSEBGP_OK;
+}
+
+// read from the session socket, returning -1 if the session should be closed
+// (with *errp set to the reason)
+static int session_read(worker_t *w, session_t *sess, parsebgp_error_t *errp)
+{
+  ssize_t rlen;
+
+  if (session_make_room(sess) != 0) {
+    *errp = (sess->buf_len * 2 > MSG_LEN_MAX) ? PARSEBGP_INVALID_MSG
+                                              : PARSEBGP_MALLOC_FAILURE;
+    return -1;
+  }
+
+  rlen = read(sess->fd, sess->buf + sess->tail, sess->buf_len - sess->tail);
+  if (rlen < 0) {
+    if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+      return 0;
+    }
+    // connection reset, etc.
+    *errp = PARSEBGP_TRUNCATED_MSG;
+    return -1;
+  }
+  if (rlen == 0) {
+    // end of stream: clean unless a message was cut short
+    *errp = (sess->head == sess->tail) ? PARSEBGP_OK : PARSEBGP_TRUNCATED_MSG;
+    return -1;
+  }
+  sess->tail += rlen;
+
+  if ((*errp = session_process(w, sess)) != PARSEBGP_OK) {
+    return -1;
+  }
+  return 0;
+}
+
+/* ========== WORKERS ========== */
+
+static void worker_remove(worker_t *w, session_t *sess)
+{
+  if (sess->prev != NULL) {
+    sess->prev->next = sess->next;
+  } else {
+    w->sessions = sess->next;
+  }
+  if (sess->next != NULL) {
+    sess->next->prev = sess->prev;
+  }
+}
+
+// take ownership of sessions handed to the worker
+static void worker_adopt(worker_t *w, session_t *pending)
+{
+  parsebgp_bmp_station_t *station = w->station;
+  session_t *sess;
+
+  while ((sess = pending) != NULL) {
+    pending = sess->next;
+
+    sess->prev = NULL;
+    sess->next = w->sessions;
+    if (watch(w->epfd, sess->fd, sess) != 0) {
+      session_close(w, sess, PARSEBGP_MALLOC_FAILURE);
+      continue;
+    }
+    if (w->sessions != NULL) {
+      w->sessions->prev = sess;
+    }
+    w->sessions = sess;
+
+    sess->reported = 1;
+    if (station->session_cb != NULL) {
+      station->session_cb(station->user, &sess->router, 1, PARSEBGP_OK);
+    }
+  }
+}
+
+static void *worker_thread(void *user)
+{
+  worker_t *w = user;
+  struct epoll_event events[EVENTS_CNT];
+  session_t *sess, *pending;
+  parsebgp_error_t err;
+  int i, n, shutdown = 0;
+
+  while (!shutdown) {
+    if ((n = epoll_wait(w->epfd, events, EVENTS_CNT, -1)) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      break;
+    }
+
+    for (i = 0; i < n; i++) {
+      if ((sess = events[i].data.ptr) == NULL) {
+        // woken up: new sessions, or shutdown
+        drain(w->wake_fds);
+        pthread_mutex_lock(&w->mutex);
+        pending = w->pending;
+        w->pending = NULL;
+        shutdown = w->shutdown;
+        pthread_mutex_unlock(&w->mutex);
+        worker_adopt(w, pending);
+        continue;
+      }
+      if (session_read(w, sess, &err) != 0) {
+        epoll_ctl(w->epfd, EPOLL_CTL_DEL, sess->fd, NULL);
+        worker_remove(w, sess);
+        session_close(w, sess, err);
+      }
+    }
+  }
+
+  // the station is stopping, so close everything (including sessions that
+  // arrived too late to be adopted)
+  pthread_mutex_lock(&w->mutex);
+  pending = w->pending;
+  w->pending = NULL;
+  pthread_mutex_unlock(&w->mutex);
+  while ((sess = pending) != NULL) {
+    pending = sess->next;
+    session_close(w, sess, PARSEBGP_OK);
+  }
+  while ((sess = w->sessions) != NULL) {
+    epoll_ctl(w->epfd, EPOLL_CTL_DEL, sess->fd, NULL);
+    worker_remove(w, sess);
+    session_close(w, sess, PARSEBGP_OK);
+  }
+
+  return NULL;
+}
+
+static void worker_give(worker_t *w, session_t *sess)
+{
+  pthread_mutex_lock(&w->mutex);
+  sess->next = w->pending;
+  w->pending = sess;
+  pthread_mutex_unlock(&w->mutex);
+  poke(w->wake_fds);
+}
+
+static void worker_destroy(worker_t *w)
+{
+  session_t *sess;
+
+  while ((sess = w->pending) != NULL) {
+    w->pending = sess->next;
+    session_close(w, sess, PARSEBGP_OK);
+  }
+  if (w->epfd >= 0) {
+    close(w->epfd);
+  }
+  close_pipe(w->wake_fds);
+  pthread_mutex_destroy(&w->mutex);
+  parsebgp_bmp_destroy_msg(w->msg);
+}
+
+static int worker_init(parsebgp_bmp_station_t *station, worker_t *w, int idx)
+{
+  w->station = station;
+  w->idx = idx;
+  memcpy(&w->opts, &station->opts, sizeof(w->opts));
+
+  if ((w->msg = malloc_zero(sizeof(parsebgp_bmp_msg_t))) == NULL ||
+      (w->epfd = epoll_create1(EPOLL_CLOEXEC)) < 0 ||
+      make_pipe(w->wake_fds) != 0 ||
+      watch(w->epfd, w->wake_fds[0], NULL) != 0) {
+    return -1;
+  }
+  return 0;
+}
+
+/* ========== PUBLIC API ========== */
+
+parsebgp_bmp_station_t *
+parsebgp_bmp_station_create(const parsebgp_opts_t *opts, int workers_cnt,
+                            parsebgp_bmp_station_msg_cb_t *msg_cb,
+                            parsebgp_bmp_station_session_cb_t *session_cb,
+                            void *user)
+{
+  parsebgp_bmp_station_t *station;
+  int i;
+
+  if (workers_cnt < 1 || msg_cb == NULL ||
+      (station = malloc_zero(sizeof(*station))) == NULL) {
+    return NULL;
+  }
+  memcpy(&station->opts, opts, sizeof(station->opts));
+  station->msg_cb = msg_cb;
+  station->session_cb = session_cb;
+  station->user = user;
+  station->epfd = -1;
+  station->stop_fds[0] = station->stop_fds[1] = -1;
+  pthread_mutex_init(&station->id_mutex, NULL);
+
+  if ((station->epfd = epoll_create1(EPOLL_CLOEXEC)) < 0 ||
+      make_pipe(station->stop_fds) != 0 ||
+      watch(station->epfd, station->stop_fds[0], NULL) != 0) {
+    goto err;
+  }
+
+  if ((station->workers = calloc(workers_cnt, sizeof(worker_t))) == NULL) {
+    goto err;
+  }
+  for (i = 0; i < workers_cnt; i++) {
+    station->workers[i].epfd = -1;
+    station->workers[i].wake_fds[0] = station->workers[i].wake_fds[1] = -1;
+    pthread_mutex_init(&station->workers[i].mutex, NULL);
+  }
+  station->workers_cnt = workers_cnt;
+  for (i = 0; i < workers_cnt; i++) {
+    if (worker_init(station, &station->workers[i], i) != 0) {
+      goto err;
+    }
+  }
+
+  return station;
+
+err:
+  parsebgp_bmp_station_destroy(station);
+  return NULL;
+}
+
+void parsebgp_bmp_station_destroy(parsebgp_bmp_station_t *station)
+{
+  int i;
+
+  if (station == NULL) {
+    return;
+  }
+
+  for (i = 0; i < station->workers_cnt; i++) {
+    worker_destroy(&station->workers[i]);
+  }
+  free(station->workers);
+  for (i = 0; i < station->listen_cnt; i++) {
+    close(station->listen_fds[i]);
+  }
+  if (station->epfd >= 0) {
+    close(station->epfd);
+  }
+  close_pipe(station->stop_fds);
+  pthread_mutex_destroy(&station->id_mutex);
+  free(station);
+}
+
+int parsebgp_bmp_station_listen(parsebgp_bmp_station_t *station,
+                                const char *host, const char *port)
+{
+  struct addrinfo hints, *ai = NULL;
+  struct sockaddr_storage ss;
+  socklen_t ss_len = sizeof(ss);
+  int fd = -1, one = 1, bound_port = -1;
+
+  if (station->listen_cnt == LISTEN_CNT) {
+    return -1;
+  }
+
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = AI_PASSIVE;
+  if (getaddrinfo(host, port, &hints, &ai) != 0) {
+    return -1;
+  }
+
+  if ((fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol)) < 0 ||
+      setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) != 0 ||
+      bind(fd, ai->ai_addr, ai->ai_addrlen) != 0 || listen(fd, 128) != 0 ||
+      set_nonblock(fd) != 0 || watch(station->epfd, fd, &station->listen_fds) ||
+      getsockname(fd, (struct sockaddr *)&ss, &ss_len) != 0) {
+    goto done;
+  }
+
+  if (ss.ss_family == AF_INET6) {
+    bound_port = ntohs(((struct sockaddr_in6 *)&ss)->sin6_port);
+  } else {
+    bound_port = ntohs(((struct sockaddr_in *)&ss)->sin_port);
+  }
+  station->listen_fds[station->listen_cnt++] = fd;
+  fd = -1;
+
+done:
+  if (fd >= 0) {
+    close(fd);
+  }
+  freeaddrinfo(ai);
+  return bound_port;
+}
+
+int parsebgp_bmp_station_add_fd(parsebgp_bmp_station_t *station, int fd)
+{
+  session_t *sess;
+
+  if ((sess = session_create(station, fd)) == NULL) {
+    close(fd);
+    return -1;
+  }
+  worker_give(&station->workers[sess->router.worker], sess);
+  return 0;
+}
+
+int parsebgp_bmp_station_run(parsebgp_bmp_station_t *station)
+{
+  struct epoll_event events[EVENTS_CNT];
+  worker_t *w;
+  int i, j, n, fd, rc = 0, stop = 0;
+
+  for (i = 0; i < station->workers_cnt; i++) {
+    w = &station->workers[i];
+    w->shutdown = 0;
+    if (pthread_create(&w->thread, NULL, worker_thread, w) != 0) {
+      rc = -1;
+      goto stop;
+    }
+    w->started = 1;
+  }
+
+  while (!stop) {
+    if ((n = epoll_wait(station->epfd, events, EVENTS_CNT, -1)) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      rc = -1;
+      break;
+    }
+    for (i = 0; i < n; i++) {
+      if (events[i].data.ptr == NULL) {
+        drain(station->stop_fds);
+        stop = 1;
+        continue;
+      }
+      // a listening socket is readable, so accept everything we can
+      for (j = 0; j < station->listen_cnt; j++) {
+        while ((fd = accept(station->listen_fds[j], NULL, NULL)) >= 0) {
+          parsebgp_bmp_station_add_fd(station, fd);
+        }
+      }
+    }
+  }
+
+stop:
+  for (i = 0; i < station->workers_cnt; i++) {
+    w = &station->workers[i];
+    if (!w->started) {
+      continue;
+    }
+    pthread_mutex_lock(&w->mutex);
+    w->shutdown = 1;
+    pthread_mutex_unlock(&w->mutex);
+    poke(w->wake_fds);
+    pthread_join(w->thread, NULL);
+    w->started = 0;
+  }
+  return rc;
+}
+
+void parsebgp_bmp_station_stop(parsebgp_bmp_station_t *station)
+{
+  poke(station->stop_fds);
+}
+
+#else /* HAVE_SYS_EPOLL_H */
+
+#include <unistd.h>
+
+parsebgp_bmp_station_t *
+parsebgp_bmp_station_create(const parsebgp_opts_t *opts, int workers_cnt,
+                            parsebgp_bmp_station_msg_cb_t *msg_cb,
+                            parsebgp_bmp_station_session_cb_t *session_cb,
+                            void *user)
+{
+  // not supported on this platform
+  return NULL;
+}
+
+void parsebgp_bmp_station_destroy(parsebgp_bmp_station_t *station)
+{
+}
+
+int parsebgp_bmp_station_listen(parsebgp_bmp_station_t *station,
+                                const char *host, const char *port)
+{
+  return -1;
+}
+
+int parsebgp_bmp_station_add_fd(parsebgp_bmp_station_t *station, int fd)
+{
+  close(fd);
+  return -1;
+}
+
+int parsebgp_bmp_station_run(parsebgp_bmp_station_t *station)
+{
+  return -1;
+}
+
+void parsebgp_bmp_station_stop(parsebgp_bmp_station_t *station)
+{
+}
+
+#endif /* HAVE_SYS_EPOLL_H */
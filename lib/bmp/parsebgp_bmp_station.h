@@ -0,0 +1,179 @@
+/*
+ * Copyright (C) 2017 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __PARSEBGP_BMP_STATION_H
+#define __PARSEBGP_BMP_STATION_H
+
+#include "parsebgp_bmp.h"
+#include "parsebgp_error.h"
+#include "parsebgp_opts.h"
+#include <inttypes.h>
+
+/**
+ * BMP Station
+ *
+ * Accepts BMP sessions from any number of routers over TCP, frames the
+ * incoming byte streams into messages, and decodes each message directly from
+ * the session's receive buffer (without copying it).
+ *
+ * Sessions are sharded across a fixed set of worker threads by router address,
+ * and each worker waits on its own sessions using epoll. All callbacks for a
+ * session are made from the worker that owns it, in the order that the
+ * messages were received, so per-router state needs no locking. (A router that
+ * reconnects is always handled by the same worker.)
+ *
+ * The station is only available on platforms that provide epoll (i.e., Linux).
+ * Elsewhere parsebgp_bmp_station_create returns NULL.
+ */
+typedef struct parsebgp_bmp_station parsebgp_bmp_station_t;
+
+/**
+ * A router session
+ */
+typedef struct parsebgp_bmp_station_router {
+
+  /** Unique ID of the session (sessions are numbered from 1) */
+  uint64_t id;
+
+  /** Address of the router (as a string) */
+  char addr[46];
+
+  /** Port of the router */
+  uint16_t port;
+
+  /** Index of the worker thread that handles the session */
+  int worker;
+
+  /** Pointer available for use by the caller (e.g., per-router state) */
+  void *user;
+
+} parsebgp_bmp_station_router_t;
+
+/**
+ * Callback made for each decoded message
+ *
+ * @param user          User pointer given when the station was created
+ * @param router        Router session that the message was received from
+ * @param msg           Decoded message. Owned by the station, and only valid
+ *                      until the callback returns.
+ */
+typedef void(parsebgp_bmp_station_msg_cb_t)(
+  void *user, parsebgp_bmp_station_router_t *router, parsebgp_bmp_msg_t *msg);
+
+/**
+ * Callback made when a router session starts or ends
+ *
+ * @param user          User pointer given when the station was created
+ * @param router        Router session that started or ended
+ * @param up            Set if the session started, zero if it ended
+ * @param err           Why the session ended: PARSEBGP_OK if it was closed
+ *                      cleanly (or the station was stopped), or the error that
+ *                      caused it to be closed
+ *
+ * The end of a session is reported exactly once for every session that was
+ * reported as started, so this is where any per-router state should be freed.
+ */
+typedef void(parsebgp_bmp_station_session_cb_t)(
+  void *user, parsebgp_bmp_station_router_t *router, int up,
+  parsebgp_error_t err);
+
+/**
+ * Create a BMP station
+ *
+ * @param opts          Options to use when decoding messages (copied, one copy
+ *                      per worker)
+ * @param workers_cnt   Number of worker threads to run (at least 1)
+ * @param msg_cb        Callback made for each message
+ * @param session_cb    Callback made when sessions start and end (may be NULL)
+ * @param user          User pointer passed to the callbacks
+ * @return pointer to a new station, or NULL if an error occurred
+ */
+parsebgp_bmp_station_t *
+parsebgp_bmp_station_create(const parsebgp_opts_t *opts, int workers_cnt,
+                            parsebgp_bmp_station_msg_cb_t *msg_cb,
+                            parsebgp_bmp_station_session_cb_t *session_cb,
+                            void *user);
+
+/**
+ * Destroy the given station
+ *
+ * @param station       Pointer to the station to destroy
+ *
+ * The station must not be running.
+ */
+void parsebgp_bmp_station_destroy(parsebgp_bmp_station_t *station);
+
+/**
+ * Listen for BMP sessions on the given address
+ *
+ * @param station       Pointer to the station
+ * @param host          Address to listen on (NULL for all addresses)
+ * @param port          Port (or service name) to listen on ("0" for any port)
+ * @return the port that the station is listening on, or -1 if an error
+ * occurred
+ *
+ * May be called several times (e.g., once for IPv4 and once for IPv6), but
+ * only before the station is run.
+ */
+int parsebgp_bmp_station_listen(parsebgp_bmp_station_t *station,
+                                const char *host, const char *port);
+
+/**
+ * Add an already-connected BMP session
+ *
+ * @param station       Pointer to the station
+ * @param fd            Connected stream socket (owned by the station from now
+ *                      on, even if an error occurs)
+ * @return 0 if successful, -1 if an error occurred
+ *
+ * May be called either before or while the station is running (e.g., to feed
+ * one end of a socketpair from a captured BMP file).
+ */
+int parsebgp_bmp_station_add_fd(parsebgp_bmp_station_t *station, int fd);
+
+/**
+ * Run the station until it is stopped
+ *
+ * @param station       Pointer to the station
+ * @return 0 if the station was stopped, -1 if an error occurred
+ *
+ * Starts the worker threads, and then accepts sessions in the calling thread.
+ * When the station is stopped, all sessions are closed (and reported as ended)
+ * before this returns. The station may be run again afterwards.
+ */
+int parsebgp_bmp_station_run(parsebgp_bmp_station_t *station);
+
+/**
+ * Stop the station
+ *
+ * @param station       Pointer to the station
+ *
+ * May be called from any thread, and from a signal handler. If the station is
+ * not running, the next call to parsebgp_bmp_station_run returns immediately.
+ */
+void parsebgp_bmp_station_stop(parsebgp_bmp_station_t *station);
+
+#endif /* __PARSEBGP_BMP_STATION_H */
@@ -89,6 +89,11 @@ static parsebgp_error_t parse_table_dump(parsebgp_opts_t *opts,
   // Peer ASN (2-byte only)
   PARSEBGP_DESERIALIZE_UINT16(buf, len, nread, msg->peer_asn);
 
+  if (opts->mrt.parse_headers_only) {
+    *lenp = remain;
+    return PARSEBGP_OK;
+  }
+
   // Path Attributes
   slen = len - nread;
   if ((err = parsebgp_bgp_update_path_attrs_decode(
@@ -124,6 +129,24 @@ static void clear_table_dump(parsebgp_bgp_afi_t afi,
   parsebgp_bgp_update_path_attrs_clear(&msg->path_attrs);
 }
 
+static void mem_usage_table_dump(const parsebgp_mrt_table_dump_t *msg,
+                                 parsebgp_mem_usage_t *usage)
+{
+  if (msg == NULL) {
+    return;
+  }
+  PARSEBGP_MEM_ADD(usage, structs, sizeof(*msg));
+  parsebgp_bgp_update_path_attrs_mem_usage(&msg->path_attrs, usage);
+}
+
+static void trim_table_dump(parsebgp_mrt_table_dump_t *msg)
+{
+  if (msg == NULL) {
+    return;
+  }
+  parsebgp_bgp_update_path_attrs_trim(&msg->path_attrs);
+}
+
 static void dump_table_dump(parsebgp_bgp_afi_t afi,
                             const parsebgp_mrt_table_dump_t *msg, int depth)
 {
@@ -235,6 +258,31 @@ clear_table_dump_v2_peer_index(parsebgp_mrt_table_dump_v2_peer_index_t *msg)
   msg->peer_count = 0;
 }
 
+static void mem_usage_table_dump_v2_peer_index(
+  const parsebgp_mrt_table_dump_v2_peer_index_t *msg,
+  parsebgp_mem_usage_t *usage)
+{
+  PARSEBGP_MEM_ADD(usage, raw, msg->_view_name_alloc_len);
+  PARSEBGP_MEM_ADD(usage, rib_entries,
+                   sizeof(*msg->peer_entries) * msg->_peer_entries_alloc_cnt);
+}
+
+static void
+trim_table_dump_v2_peer_index(parsebgp_mrt_table_dump_v2_peer_index_t *msg)
+{
+  // the view name is only (re)written when it is non-empty
+  if (msg->view_name_len == 0) {
+    free(msg->view_name);
+    msg->view_name = NULL;
+    msg->_view_name_alloc_len = 0;
+  } else {
+    PARSEBGP_MAYBE_SHRINK(msg->view_name, msg->_view_name_alloc_len,
+                          msg->view_name_len + 1);
+  }
+  PARSEBGP_MAYBE_SHRINK(msg->peer_entries, msg->_peer_entries_alloc_cnt,
+                        msg->peer_count);
+}
+
 static void
 dump_table_dump_v2_peer_index(
     const parsebgp_mrt_table_dump_v2_peer_index_t *msg, int depth)
@@ -260,59 +308,134 @@ dump_table_dump_v2_peer_index(
   }
 }
 
-static parsebgp_error_t parse_table_dump_v2_rib_entries(
-  parsebgp_opts_t *opts, parsebgp_mrt_table_dump_v2_subtype_t subtype,
-  parsebgp_mrt_table_dump_v2_rib_entry_t *entries, uint16_t entry_count,
-  const uint8_t *buf, size_t *lenp, size_t remain)
-{
-  size_t len = *lenp, nread = 0, slen;
-  int i;
-  parsebgp_mrt_table_dump_v2_rib_entry_t *entry;
-  parsebgp_error_t err;
+/** Parameters of an AFI/SAFI-specific RIB subtype */
+typedef struct table_dump_v2_rib_type {
 
-  opts->bgp.asn_4_byte = 1;
-  opts->bgp.mp_reach_no_afi_safi_reserved = 1;
-  switch (subtype) {
-  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_UNICAST:
-    opts->bgp.afi = PARSEBGP_BGP_AFI_IPV4;
-    opts->bgp.safi = PARSEBGP_BGP_SAFI_UNICAST;
-    break;
+  /** AFI of the prefix and of the MP_REACH attributes */
+  uint16_t afi;
 
-  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_MULTICAST:
-    opts->bgp.afi = PARSEBGP_BGP_AFI_IPV4;
-    opts->bgp.safi = PARSEBGP_BGP_SAFI_MULTICAST;
-    break;
+  /** SAFI of the prefix and of the MP_REACH attributes */
+  uint8_t safi;
 
-  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV6_UNICAST:
-    opts->bgp.afi = PARSEBGP_BGP_AFI_IPV6;
-    opts->bgp.safi = PARSEBGP_BGP_SAFI_UNICAST;
-    break;
+  /** Maximum prefix length */
+  uint8_t max_pfx;
 
-  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV6_MULTICAST:
-    opts->bgp.afi = PARSEBGP_BGP_AFI_IPV6;
-    opts->bgp.safi = PARSEBGP_BGP_SAFI_MULTICAST;
-    break;
+  /** Do the RIB entries carry Path Identifiers (RFC 8050)? */
+  uint8_t add_path;
 
-  default:
-    // programming error
-    assert(0);
-    PARSEBGP_RETURN_INVALID_MSG_ERR;
+} table_dump_v2_rib_type_t;
+
+#define RIB_TYPE(afi, safi, max_pfx, add_path)                                 \
+  {                                                                            \
+    PARSEBGP_BGP_AFI_##afi, PARSEBGP_BGP_SAFI_##safi, max_pfx, add_path        \
   }
 
+/** AFI/SAFI-specific RIB subtypes, looked up once per record */
+static const table_dump_v2_rib_type_t table_dump_v2_rib_types[] = {
+  [PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_UNICAST] =
+    RIB_TYPE(IPV4, UNICAST, 32, 0),
+  [PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_MULTICAST] =
+    RIB_TYPE(IPV4, MULTICAST, 32, 0),
+  [PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV6_UNICAST] =
+    RIB_TYPE(IPV6, UNICAST, 128, 0),
+  [PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV6_MULTICAST] =
+    RIB_TYPE(IPV6, MULTICAST, 128, 0),
+  [PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_UNICAST_ADDPATH] =
+    RIB_TYPE(IPV4, UNICAST, 32, 1),
+  [PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_MULTICAST_ADDPATH] =
+    RIB_TYPE(IPV4, MULTICAST, 32, 1),
+  [PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV6_UNICAST_ADDPATH] =
+    RIB_TYPE(IPV6, UNICAST, 128, 1),
+  [PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV6_MULTICAST_ADDPATH] =
+    RIB_TYPE(IPV6, MULTICAST, 128, 1),
+};
+
+// check that entry_count RIB entries exactly fill the record
+static inline parsebgp_error_t
+validate_table_dump_v2_rib_entries(const uint8_t *buf, size_t remain,
+                                   uint16_t entry_count, const int add_path)
+{
+  // Peer Index, Originated Time, (Path Identifier,) Attribute Length
+  const size_t hdr_len = add_path ? 12 : 8;
+  size_t nread = 0;
+  int i;
+
   for (i = 0; i < entry_count; i++) {
+    if ((remain - nread) < hdr_len) {
+      PARSEBGP_RETURN_INVALID_MSG_ERR;
+    }
+    nread += hdr_len + nptohs(buf + nread + hdr_len - 2);
+    if (nread > remain) {
+      PARSEBGP_RETURN_INVALID_MSG_ERR;
+    }
+  }
+  if (nread != remain) {
+    PARSEBGP_RETURN_INVALID_MSG_ERR;
+  }
+  return PARSEBGP_OK;
+}
+
+// instantiated once per add_path value (which is a constant in each copy)
+static inline parsebgp_error_t decode_table_dump_v2_rib_entries(
+  parsebgp_opts_t *opts, parsebgp_mrt_table_dump_v2_rib_entry_t *entries,
+  uint16_t *entry_count, const uint8_t *buf, size_t *lenp, size_t remain,
+  const int add_path)
+{
+  size_t len = *lenp, nread = 0, slen, hdr_len = add_path ? 10 : 6;
+  int i;
+  parsebgp_mrt_table_dump_v2_rib_entry_t *entry;
+  parsebgp_error_t err;
+
+  // the record is always entirely in the buffer (see parsebgp_mrt_decode), so
+  // the entries can be framed in one pass, after which the entry headers do
+  // not need bounds checks
+  if (remain > len) {
+    return PARSEBGP_PARTIAL_MSG;
+  }
+  if ((err = validate_table_dump_v2_rib_entries(buf, remain, *entry_count,
+                                                add_path)) != PARSEBGP_OK) {
+    return err;
+  }
+
+  for (i = 0; i < *entry_count; i++) {
     entry = &entries[i];
 
+    // stop before this entry if it doesn't fit in the budgets, leaving only
+    // the entries decoded so far
+    if (PARSEBGP_BUDGET_TAKE(opts, rib_entries, PARSEBGP_BUDGET_RIB_ENTRIES, 1,
+                             buf) < 1 ||
+        PARSEBGP_BUDGET_TAKE(opts, bytes, PARSEBGP_BUDGET_BYTES, hdr_len,
+                             buf) < hdr_len) {
+      *entry_count = i;
+      return PARSEBGP_BUDGET_EXCEEDED;
+    }
+
     // Peer Index
-    PARSEBGP_DESERIALIZE_UINT16(buf, len, nread, entry->peer_index);
+    entry->peer_index = nptohs(buf);
+    buf += sizeof(entry->peer_index);
 
     // Originated Time
-    PARSEBGP_DESERIALIZE_UINT32(buf, len, nread, entry->originated_time);
+    entry->originated_time = nptohl(buf);
+    buf += sizeof(entry->originated_time);
+
+    // Path Identifier (RFC 8050)
+    if (add_path) {
+      entry->path_id = nptohl(buf);
+      buf += sizeof(entry->path_id);
+    } else {
+      entry->path_id = 0;
+    }
+    nread += hdr_len;
 
     // Path Attributes
     slen = len - nread;
     if ((err = parsebgp_bgp_update_path_attrs_decode(
            opts, &entry->path_attrs, buf, &slen, remain - nread)) !=
         PARSEBGP_OK) {
+      if (err == PARSEBGP_BUDGET_EXCEEDED) {
+        // keep the partly-decoded entry
+        *entry_count = i + 1;
+      }
       return err;
     }
     nread += slen;
@@ -323,6 +446,25 @@ static parsebgp_error_t parse_table_dump_v2_rib_entries(
   return PARSEBGP_OK;
 }
 
+static parsebgp_error_t parse_table_dump_v2_rib_entries(
+  parsebgp_opts_t *opts, const table_dump_v2_rib_type_t *rib_type,
+  parsebgp_mrt_table_dump_v2_rib_entry_t *entries, uint16_t *entry_count,
+  const uint8_t *buf, size_t *lenp, size_t remain)
+{
+  // the options are the same for every entry of the record
+  opts->bgp.asn_4_byte = 1;
+  opts->bgp.mp_reach_no_afi_safi_reserved = 1;
+  opts->bgp.afi = rib_type->afi;
+  opts->bgp.safi = rib_type->safi;
+
+  if (rib_type->add_path) {
+    return decode_table_dump_v2_rib_entries(opts, entries, entry_count, buf,
+                                            lenp, remain, 1);
+  }
+  return decode_table_dump_v2_rib_entries(opts, entries, entry_count, buf,
+                                          lenp, remain, 0);
+}
+
 static void destroy_table_dump_v2_rib_entries(
   parsebgp_mrt_table_dump_v2_rib_entry_t *entries, uint16_t entry_alloc_cnt)
 {
@@ -342,16 +484,6 @@ static void destroy_table_dump_v2_rib_entries(
   free(entries);
 }
 
-static void
-clear_table_dump_v2_rib_entries(parsebgp_mrt_table_dump_v2_rib_entry_t *entries,
-                                uint16_t entry_count)
-{
-  int i;
-  for (i = 0; i < entry_count; i++) {
-    parsebgp_bgp_update_path_attrs_clear(&entries[i].path_attrs);
-  }
-}
-
 static parsebgp_error_t
 parse_table_dump_v2_afi_safi_rib(parsebgp_opts_t *opts,
                                  parsebgp_mrt_table_dump_v2_subtype_t subtype,
@@ -359,7 +491,7 @@ parse_table_dump_v2_afi_safi_rib(parsebgp_opts_t *opts,
                                  const uint8_t *buf, size_t *lenp, size_t remain)
 {
   size_t len = *lenp, nread = 0, slen;
-  size_t max_pfx;
+  const table_dump_v2_rib_type_t *rib_type = &table_dump_v2_rib_types[subtype];
   parsebgp_error_t err;
 
   // Sequence Number
@@ -370,17 +502,20 @@ parse_table_dump_v2_afi_safi_rib(parsebgp_opts_t *opts,
 
   // Prefix
   slen = len - nread;
-  max_pfx = (subtype == PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_UNICAST ||
-             subtype == PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_MULTICAST) ?
-              32 : 128;
   err = parsebgp_decode_prefix(msg->prefix_len, msg->prefix, buf, &slen,
-      max_pfx);
+                               rib_type->max_pfx);
   if (err != PARSEBGP_OK) {
     return err;
   }
   nread += slen;
   buf += slen;
 
+  if (opts->mrt.parse_headers_only) {
+    msg->entry_count = 0;
+    *lenp = remain;
+    return PARSEBGP_OK;
+  }
+
   // Entry Count
   PARSEBGP_DESERIALIZE_UINT16(buf, len, nread, msg->entry_count);
 
@@ -392,7 +527,7 @@ parse_table_dump_v2_afi_safi_rib(parsebgp_opts_t *opts,
   // and then parse the entries
   slen = len - nread;
   if ((err = parse_table_dump_v2_rib_entries(
-         opts, subtype, msg->entries, msg->entry_count, buf, &slen,
+         opts, rib_type, msg->entries, &msg->entry_count, buf, &slen,
          (remain - nread))) != PARSEBGP_OK) {
     return err;
   }
@@ -420,10 +555,40 @@ clear_table_dump_v2_afi_safi_rib(parsebgp_mrt_table_dump_v2_subtype_t subtype,
   if (msg == NULL) {
     return;
   }
-  clear_table_dump_v2_rib_entries(msg->entries, msg->entry_count);
+  // the Path Attributes of each entry are cleared as the entry is decoded
   msg->entry_count = 0;
 }
 
+static void mem_usage_table_dump_v2_afi_safi_rib(
+  const parsebgp_mrt_table_dump_v2_afi_safi_rib_t *msg,
+  parsebgp_mem_usage_t *usage)
+{
+  int i;
+
+  PARSEBGP_MEM_ADD(usage, rib_entries,
+                   sizeof(*msg->entries) * msg->_entries_alloc_cnt);
+  for (i = 0; i < msg->_entries_alloc_cnt; i++) {
+    parsebgp_bgp_update_path_attrs_mem_usage(&msg->entries[i].path_attrs,
+                                             usage);
+  }
+}
+
+static void
+trim_table_dump_v2_afi_safi_rib(parsebgp_mrt_table_dump_v2_afi_safi_rib_t *msg)
+{
+  int i;
+
+  for (i = 0; i < msg->_entries_alloc_cnt; i++) {
+    if (i < msg->entry_count) {
+      parsebgp_bgp_update_path_attrs_trim(&msg->entries[i].path_attrs);
+    } else {
+      parsebgp_bgp_update_path_attrs_destroy(&msg->entries[i].path_attrs);
+    }
+  }
+  PARSEBGP_MAYBE_SHRINK(msg->entries, msg->_entries_alloc_cnt,
+                        msg->entry_count);
+}
+
 static void
 dump_table_dump_v2_afi_safi_rib(
     parsebgp_mrt_table_dump_v2_subtype_t subtype,
@@ -432,10 +597,7 @@ dump_table_dump_v2_afi_safi_rib(
 {
   PARSEBGP_DUMP_STRUCT_HDR(parsebgp_mrt_table_dump_v2_afi_safi_rib_t, depth);
 
-  int afi = (subtype == PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_UNICAST ||
-             subtype == PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_MULTICAST)
-              ? PARSEBGP_BGP_AFI_IPV4
-              : PARSEBGP_BGP_AFI_IPV6;
+  int afi = table_dump_v2_rib_types[subtype].afi;
 
   PARSEBGP_DUMP_INT(depth, "Sequence", msg->sequence);
   PARSEBGP_DUMP_PFX(depth, "Prefix", afi, msg->prefix, msg->prefix_len);
@@ -451,6 +613,7 @@ dump_table_dump_v2_afi_safi_rib(
 
     PARSEBGP_DUMP_INT(depth, "Peer Index", entry->peer_index);
     PARSEBGP_DUMP_INT(depth, "Originated Time", entry->originated_time);
+    PARSEBGP_DUMP_INT(depth, "Path ID", entry->path_id);
 
     parsebgp_bgp_update_path_attrs_dump(&entry->path_attrs, depth + 1);
   }
@@ -472,11 +635,16 @@ static parsebgp_error_t parse_table_dump_v2(
   case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_MULTICAST:
   case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV6_UNICAST:
   case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV6_MULTICAST:
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_UNICAST_ADDPATH:
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_MULTICAST_ADDPATH:
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV6_UNICAST_ADDPATH:
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV6_MULTICAST_ADDPATH:
     return parse_table_dump_v2_afi_safi_rib(opts, subtype, &msg->afi_safi_rib,
                                             buf, lenp, remain);
     break;
 
   case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_GENERIC:
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_GENERIC_ADDPATH:
     // these probably aren't too hard to support, but bgpdump doesn't support
     // them, so it likely means we don't have any actual use for it.
     PARSEBGP_SKIP_NOT_IMPLEMENTED(opts, buf, nread, remain,
@@ -524,15 +692,66 @@ static void clear_table_dump_v2(parsebgp_mrt_table_dump_v2_subtype_t subtype,
   case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_MULTICAST:
   case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV6_UNICAST:
   case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV6_MULTICAST:
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_UNICAST_ADDPATH:
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_MULTICAST_ADDPATH:
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV6_UNICAST_ADDPATH:
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV6_MULTICAST_ADDPATH:
     clear_table_dump_v2_afi_safi_rib(subtype, &msg->afi_safi_rib);
     break;
 
   case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_GENERIC:
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_GENERIC_ADDPATH:
   default:
     break;
   }
 }
 
+static void
+mem_usage_table_dump_v2(const parsebgp_mrt_table_dump_v2_t *msg,
+                        parsebgp_mem_usage_t *usage)
+{
+  if (msg == NULL) {
+    return;
+  }
+  PARSEBGP_MEM_ADD(usage, structs, sizeof(*msg));
+  mem_usage_table_dump_v2_peer_index(&msg->peer_index, usage);
+  mem_usage_table_dump_v2_afi_safi_rib(&msg->afi_safi_rib, usage);
+}
+
+static void trim_table_dump_v2(parsebgp_mrt_table_dump_v2_subtype_t subtype,
+                               parsebgp_mrt_table_dump_v2_t *msg)
+{
+  if (msg == NULL) {
+    return;
+  }
+
+  // only the subtype currently held is kept
+  if (subtype == PARSEBGP_MRT_TABLE_DUMP_V2_PEER_INDEX_TABLE) {
+    trim_table_dump_v2_peer_index(&msg->peer_index);
+  } else {
+    destroy_table_dump_v2_peer_index(&msg->peer_index);
+    msg->peer_index._view_name_alloc_len = 0;
+    msg->peer_index._peer_entries_alloc_cnt = 0;
+  }
+
+  switch (subtype) {
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_UNICAST:
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_MULTICAST:
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV6_UNICAST:
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV6_MULTICAST:
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_UNICAST_ADDPATH:
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_MULTICAST_ADDPATH:
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV6_UNICAST_ADDPATH:
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV6_MULTICAST_ADDPATH:
+    trim_table_dump_v2_afi_safi_rib(&msg->afi_safi_rib);
+    break;
+
+  default:
+    destroy_table_dump_v2_afi_safi_rib(subtype, &msg->afi_safi_rib);
+    break;
+  }
+}
+
 static void dump_table_dump_v2(parsebgp_mrt_table_dump_v2_subtype_t subtype,
                                const parsebgp_mrt_table_dump_v2_t *msg,
                                int depth)
@@ -548,10 +767,15 @@ static void dump_table_dump_v2(parsebgp_mrt_table_dump_v2_subtype_t subtype,
   case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_MULTICAST:
   case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV6_UNICAST:
   case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV6_MULTICAST:
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_UNICAST_ADDPATH:
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_MULTICAST_ADDPATH:
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV6_UNICAST_ADDPATH:
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV6_MULTICAST_ADDPATH:
     dump_table_dump_v2_afi_safi_rib(subtype, &msg->afi_safi_rib, depth + 1);
     break;
 
   case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_GENERIC:
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_GENERIC_ADDPATH:
   default:
     break;
   }
@@ -726,6 +950,11 @@ static parsebgp_error_t parse_bgp4mp(parsebgp_opts_t *opts,
     DESERIALIZE_IP(msg->afi, buf, len, nread, msg->local_ip);
   }
 
+  if (opts->mrt.parse_headers_only) {
+    *lenp = remain;
+    return PARSEBGP_OK;
+  }
+
   // And then the actual data, based on the subtype
   // the _AS4 subtypes actually only change the common part of the message, so
   // we can treat them the same as their non-AS4 subtype at this point.
@@ -802,6 +1031,38 @@ static void clear_bgp4mp(parsebgp_mrt_bgp4mp_subtype_t subtype,
   }
 }
 
+static void mem_usage_bgp4mp(const parsebgp_mrt_bgp4mp_t *msg,
+                             parsebgp_mem_usage_t *usage)
+{
+  if (msg == NULL) {
+    return;
+  }
+  PARSEBGP_MEM_ADD(usage, structs, sizeof(*msg));
+  parsebgp_bgp_mem_usage(msg->data.bgp_msg, usage);
+}
+
+static void trim_bgp4mp(parsebgp_mrt_bgp4mp_subtype_t subtype,
+                        parsebgp_mrt_bgp4mp_t *msg)
+{
+  if (msg == NULL) {
+    return;
+  }
+
+  switch (subtype) {
+  case PARSEBGP_MRT_BGP4MP_MESSAGE:
+  case PARSEBGP_MRT_BGP4MP_MESSAGE_AS4:
+  case PARSEBGP_MRT_BGP4MP_MESSAGE_LOCAL:
+  case PARSEBGP_MRT_BGP4MP_MESSAGE_AS4_LOCAL:
+    parsebgp_bgp_trim_msg(msg->data.bgp_msg);
+    break;
+
+  default:
+    parsebgp_bgp_destroy_msg(msg->data.bgp_msg);
+    msg->data.bgp_msg = NULL;
+    break;
+  }
+}
+
 static void dump_bgp4mp(parsebgp_mrt_bgp4mp_subtype_t subtype,
                         const parsebgp_mrt_bgp4mp_t *msg, int depth)
 {
@@ -874,6 +1135,7 @@ static parsebgp_error_t parse_common_hdr(parsebgp_opts_t *opts,
   case PARSEBGP_MRT_TYPE_ISIS:
   case PARSEBGP_MRT_TYPE_OSPF_V3:
     // no usec timestamp to read
+    msg->timestamp_usec = 0;
     break;
 
   default:
@@ -927,6 +1189,7 @@ parsebgp_error_t parsebgp_mrt_decode(parsebgp_opts_t *opts,
   }
 
   slen = remain; // don't let sub-parsers go past the end of the MRT message
+  msg->types_valid = !opts->mrt.parse_headers_only;
   switch (msg->type) {
 
   case PARSEBGP_MRT_TYPE_TABLE_DUMP:
@@ -949,6 +1212,10 @@ parsebgp_error_t parsebgp_mrt_decode(parsebgp_opts_t *opts,
     break;
 
   case PARSEBGP_MRT_TYPE_BGP:
+    if (opts->mrt.parse_headers_only) {
+      // nothing worth a shallow parse in these (obsolete) messages
+      break;
+    }
     PARSEBGP_MAYBE_MALLOC_ZERO(msg->types.bgp);
     err =
       parse_bgp(opts, msg->subtype, msg->types.bgp, buf + nread, &slen, remain);
@@ -988,6 +1255,37 @@ parsebgp_error_t parsebgp_mrt_decode(parsebgp_opts_t *opts,
   return err;
 }
 
+parsebgp_error_t parsebgp_mrt_frame(const parsebgp_opts_t *opts,
+                                    const uint8_t *buf, size_t len,
+                                    size_t *msg_len)
+{
+  // MRT framing does not depend on any option
+  (void)opts;
+
+  if (len < MRT_HDR_LEN) {
+    *msg_len = MRT_HDR_LEN;
+    return PARSEBGP_PARTIAL_MSG;
+  }
+  // the length does not include the common header, but does include the
+  // microsecond timestamp of *_ET messages
+  *msg_len = MRT_HDR_LEN + (size_t)nptohl(buf + 8);
+
+  switch (nptohs(buf + 4)) {
+  case PARSEBGP_MRT_TYPE_BGP4MP_ET:
+  case PARSEBGP_MRT_TYPE_ISIS_ET:
+  case PARSEBGP_MRT_TYPE_OSPF_V3_ET:
+    if (*msg_len < MRT_HDR_LEN + sizeof(uint32_t)) {
+      PARSEBGP_RETURN_INVALID_MSG_ERR;
+    }
+    break;
+
+  default:
+    break;
+  }
+
+  return PARSEBGP_OK;
+}
+
 void parsebgp_mrt_destroy_msg(parsebgp_mrt_msg_t *msg)
 {
   if (msg == NULL) {
@@ -1035,11 +1333,57 @@ void parsebgp_mrt_clear_msg(parsebgp_mrt_msg_t *msg)
   }
 }
 
+void parsebgp_mrt_mem_usage(const parsebgp_mrt_msg_t *msg,
+                            parsebgp_mem_usage_t *usage)
+{
+  if (msg == NULL) {
+    return;
+  }
+
+  PARSEBGP_MEM_ADD(usage, structs, sizeof(*msg));
+  mem_usage_table_dump(msg->types.table_dump, usage);
+  mem_usage_table_dump_v2(msg->types.table_dump_v2, usage);
+  mem_usage_bgp4mp(msg->types.bgp4mp, usage);
+}
+
+void parsebgp_mrt_trim_msg(parsebgp_mrt_msg_t *msg)
+{
+  if (msg == NULL) {
+    return;
+  }
+
+  if (msg->type == PARSEBGP_MRT_TYPE_TABLE_DUMP) {
+    trim_table_dump(msg->types.table_dump);
+  } else {
+    destroy_table_dump(msg->subtype, msg->types.table_dump);
+    msg->types.table_dump = NULL;
+  }
+
+  if (msg->type == PARSEBGP_MRT_TYPE_TABLE_DUMP_V2) {
+    trim_table_dump_v2(msg->subtype, msg->types.table_dump_v2);
+  } else {
+    destroy_table_dump_v2(msg->subtype, msg->types.table_dump_v2);
+    msg->types.table_dump_v2 = NULL;
+  }
+
+  if (msg->type == PARSEBGP_MRT_TYPE_BGP4MP ||
+      msg->type == PARSEBGP_MRT_TYPE_BGP4MP_ET) {
+    trim_bgp4mp(msg->subtype, msg->types.bgp4mp);
+  } else {
+    destroy_bgp4mp(msg->subtype, msg->types.bgp4mp);
+    msg->types.bgp4mp = NULL;
+  }
+}
+
 void parsebgp_mrt_dump_msg(const parsebgp_mrt_msg_t *msg, int depth)
 {
   PARSEBGP_DUMP_STRUCT_HDR(parsebgp_mrt_msg_t, depth);
   dump_common_hdr(msg, depth);
 
+  if (!msg->types_valid) {
+    return;
+  }
+
   switch (msg->type) {
   case PARSEBGP_MRT_TYPE_TABLE_DUMP:
     dump_table_dump(msg->subtype, msg->types.table_dump, depth + 1);
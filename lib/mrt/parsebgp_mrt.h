@@ -29,6 +29,7 @@
 
 #include "parsebgp_bgp.h"
 #include "parsebgp_error.h"
+#include "parsebgp_mem.h"
 #include <inttypes.h>
 #include <stddef.h>
 
@@ -144,6 +145,10 @@ typedef struct parsebgp_mrt_table_dump_v2_rib_entry {
   /** Time prefix was heard (in seconds since the unix epoch) */
   uint32_t originated_time;
 
+  /** ADD-PATH Path Identifier (only set for the RIB_*_ADDPATH subtypes,
+      otherwise 0) */
+  uint32_t path_id;
+
   /** Path Attributes */
   parsebgp_bgp_update_path_attrs_t path_attrs;
 
@@ -197,6 +202,21 @@ typedef enum parsebgp_mrt_table_dump_v2_subtype {
   /** Generic RIB */
   PARSEBGP_MRT_TABLE_DUMP_V2_RIB_GENERIC = 6,
 
+  /** IPv4 Unicast RIB with ADD-PATH Path Identifiers (RFC 8050) */
+  PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_UNICAST_ADDPATH = 8,
+
+  /** IPv4 Multicast RIB with ADD-PATH Path Identifiers (RFC 8050) */
+  PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_MULTICAST_ADDPATH = 9,
+
+  /** IPv6 Unicast RIB with ADD-PATH Path Identifiers (RFC 8050) */
+  PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV6_UNICAST_ADDPATH = 10,
+
+  /** IPv6 Multicast RIB with ADD-PATH Path Identifiers (RFC 8050) */
+  PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV6_MULTICAST_ADDPATH = 11,
+
+  /** Generic RIB with ADD-PATH Path Identifiers (RFC 8050) */
+  PARSEBGP_MRT_TABLE_DUMP_V2_RIB_GENERIC_ADDPATH = 12,
+
 } parsebgp_mrt_table_dump_v2_subtype_t;
 
 /*
@@ -446,6 +466,12 @@ typedef struct parsebgp_mrt_msg {
       parsing one of the *_ET message types. */
   uint32_t timestamp_usec;
 
+  /** Set if the message was fully parsed. If this is not set, then only a
+   * shallow parse was performed (see parsebgp_mrt_opts_t.parse_headers_only),
+   * so only the common header and the fixed per-type header fields have been
+   * populated. */
+  int types_valid;
+
   struct {
     /** Type 5: BGP */
     parsebgp_mrt_bgp_t *bgp;
@@ -479,6 +505,27 @@ parsebgp_error_t parsebgp_mrt_decode(parsebgp_opts_t *opts,
                                      parsebgp_mrt_msg_t *msg, const uint8_t *buf,
                                      size_t *len);
 
+/**
+ * Determine the length of the MRT message at the start of the given buffer
+ *
+ * @param [in] opts     Options for the parser
+ * @param [in] buf      Pointer to the start of a raw MRT message
+ * @param [in] len      Number of bytes available in the buffer
+ * @param [out] msg_len Set to the total length of the message if successful,
+ *                      or to the minimum number of bytes needed to determine
+ *                      the length if PARSEBGP_PARTIAL_MSG is returned
+ * @return PARSEBGP_OK (0) if the length was determined, or an error code
+ * otherwise
+ *
+ * Only the header is examined, so this is cheap enough to call every time more
+ * data arrives. Once len is at least msg_len, the message can be decoded
+ * without PARSEBGP_PARTIAL_MSG being returned, so stream readers can wait for
+ * the whole message and decode it exactly once.
+ */
+parsebgp_error_t parsebgp_mrt_frame(const parsebgp_opts_t *opts,
+                                    const uint8_t *buf, size_t len,
+                                    size_t *msg_len);
+
 /** Destroy the given MRT message structure
  *
  * @param msg           Pointer to message structure to destroy
@@ -491,6 +538,22 @@ void parsebgp_mrt_destroy_msg(parsebgp_mrt_msg_t *msg);
  */
 void parsebgp_mrt_clear_msg(parsebgp_mrt_msg_t *msg);
 
+/** Add the memory held by the given MRT message structure to the given usage
+ * counters
+ *
+ * @param msg           Pointer to message structure
+ * @param usage         Pointer to the usage counters to add to
+ */
+void parsebgp_mrt_mem_usage(const parsebgp_mrt_msg_t *msg,
+                            parsebgp_mem_usage_t *usage);
+
+/** Release memory held by the given MRT message structure beyond what the
+ * message it currently holds uses
+ *
+ * @param msg           Pointer to message structure to trim
+ */
+void parsebgp_mrt_trim_msg(parsebgp_mrt_msg_t *msg);
+
 /**
  * Dump a human-readable version of the message to stdout
  *
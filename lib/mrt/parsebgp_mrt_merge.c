@@ -0,0 +1,698 @@
+/*
+ * Copyright (C) 2017 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "parsebgp_mrt_merge.h"
+#include "parsebgp_error.h"
+#include "parsebgp_utils.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/** Number of bytes in the MRT common header (excluding extended timestamp
+    field) */
+#define MRT_HDR_LEN 12
+
+/** Default size of the blocks that inputs are read in */
+#define BLOCK_LEN (256 * 1024)
+
+/** Number of blocks per input (i.e., how far a background reader can get
+    ahead of the merge) */
+#define BLOCKS_CNT 3
+
+/** Location and timestamp of a record within a block */
+typedef struct rec_idx {
+
+  /** Offset of the record within the block */
+  size_t offset;
+
+  /** Length of the record (including the common header) */
+  size_t len;
+
+  /** Timestamp (seconds) */
+  uint32_t sec;
+
+  /** Timestamp (microseconds) */
+  uint32_t usec;
+
+} rec_idx_t;
+
+/** A block of whole records read from an input */
+typedef struct block {
+
+  /** Buffer holding the records */
+  uint8_t *buf;
+
+  /** Allocated size of buf */
+  size_t _buf_alloc_len;
+
+  /** Index of the records in the block */
+  rec_idx_t *recs;
+
+  /** Allocated length of the recs array */
+  int _recs_alloc_cnt;
+
+  /** Number of records in the block */
+  int recs_cnt;
+
+  /** Next block in the (filled or free) list */
+  struct block *next;
+
+} block_t;
+
+/** State for a single input */
+typedef struct input {
+
+  /** Index of this input */
+  int idx;
+
+  /** Callback used to read from the input */
+  parsebgp_mrt_merge_read_cb_t *read_cb;
+
+  /** User pointer for the read callback */
+  void *user;
+
+  /** File descriptor owned by the merge reader (-1 if not owned) */
+  int fd;
+
+  /** Partial record left over from the previous block (reader-side) */
+  uint8_t *carry;
+  size_t carry_len;
+  size_t _carry_alloc_len;
+
+  /** All blocks owned by this input (for cleanup) */
+  block_t blocks[BLOCKS_CNT];
+
+  /** Queue of filled blocks waiting to be merged (oldest first) */
+  block_t *filled_head;
+  block_t *filled_tail;
+
+  /** List of blocks waiting to be filled */
+  block_t *free;
+
+  /** Set once the reader has reached the end of the input (or an error) */
+  int eof;
+
+  /** Error encountered by the reader (reported once all blocks have been
+      consumed) */
+  parsebgp_error_t err;
+
+  /** Background reader state */
+  pthread_t thread;
+  int thread_running;
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+
+  /** Block currently being merged, and the index of the current record */
+  block_t *cur;
+  int cur_rec;
+
+} input_t;
+
+struct parsebgp_mrt_merge {
+
+  /** Options used to decode record bodies */
+  parsebgp_opts_t opts;
+
+  /** Should inputs be read by background threads */
+  int background;
+
+  /** Set to stop background readers */
+  int shutdown;
+
+  /** Inputs */
+  input_t **inputs;
+  int inputs_cnt;
+
+  /** Min-heap of inputs that have a current record, keyed by the timestamp
+      (and input index) of that record */
+  input_t **heap;
+  int heap_cnt;
+
+  /** Set once the heap has been populated */
+  int started;
+
+  /** Input whose current record was last yielded (its cursor is advanced on
+      the next call to parsebgp_mrt_merge_next) */
+  input_t *last;
+
+  /** The record last yielded */
+  parsebgp_mrt_merge_rec_t rec;
+
+  /** Message used for lazy decoding */
+  parsebgp_mrt_msg_t *msg;
+};
+
+static int rec_has_usec(uint16_t type)
+{
+  return type == PARSEBGP_MRT_TYPE_BGP4MP_ET ||
+         type == PARSEBGP_MRT_TYPE_ISIS_ET ||
+         type == PARSEBGP_MRT_TYPE_OSPF_V3_ET;
+}
+
+/** Index the whole records at the start of the given block. Sets used to the
+    number of bytes covered by whole records */
+static parsebgp_error_t index_block(block_t *blk, size_t len, size_t *used)
+{
+  size_t offset = 0, rec_len;
+  const uint8_t *ptr;
+  rec_idx_t *idx;
+
+  blk->recs_cnt = 0;
+  while (len - offset >= MRT_HDR_LEN) {
+    ptr = blk->buf + offset;
+    rec_len = MRT_HDR_LEN + (size_t)nptohl(ptr + 8);
+    if (len - offset < rec_len) {
+      break;
+    }
+
+    if (rec_has_usec(nptohs(ptr + 4)) &&
+        rec_len < MRT_HDR_LEN + sizeof(uint32_t)) {
+      PARSEBGP_RETURN_INVALID_MSG_ERR;
+    }
+
+    PARSEBGP_MAYBE_REALLOC(blk->recs, blk->_recs_alloc_cnt,
+                           blk->recs_cnt + 1);
+    idx = &blk->recs[blk->recs_cnt++];
+    idx->offset = offset;
+    idx->len = rec_len;
+    idx->sec = nptohl(ptr);
+    idx->usec =
+      rec_has_usec(nptohs(ptr + 4)) ? nptohl(ptr + MRT_HDR_LEN) : 0;
+
+    offset += rec_len;
+  }
+
+  *used = offset;
+  return PARSEBGP_OK;
+}
+
+/** Fill the given block with whole records from the input. On return,
+    blk->recs_cnt is zero iff the input has been exhausted (or failed) */
+static parsebgp_error_t fill_block(input_t *in, block_t *blk)
+{
+  size_t len, used = 0, need;
+  ssize_t rlen;
+  parsebgp_error_t err;
+
+  // start with the partial record left over from the previous block (leaving
+  // a block's worth of room to read into after it)
+  PARSEBGP_MAYBE_REALLOC(blk->buf, blk->_buf_alloc_len,
+                         in->carry_len + BLOCK_LEN);
+  if (in->carry_len > 0) {
+    memcpy(blk->buf, in->carry, in->carry_len);
+  }
+  len = in->carry_len;
+  in->carry_len = 0;
+  blk->recs_cnt = 0;
+
+  while (1) {
+    // never issue an empty read, since its result would look like the end of
+    // the input
+    if (len == blk->_buf_alloc_len) {
+      if (blk->recs_cnt > 0) {
+        break;
+      }
+      // a single record larger than the block, grow to fit it
+      need = blk->_buf_alloc_len * 2;
+      if (len - used >= MRT_HDR_LEN &&
+          MRT_HDR_LEN + (size_t)nptohl(blk->buf + 8) > need) {
+        need = MRT_HDR_LEN + (size_t)nptohl(blk->buf + 8);
+      }
+      PARSEBGP_MAYBE_REALLOC(blk->buf, blk->_buf_alloc_len, need);
+    }
+
+    if ((rlen = in->read_cb(in->user, blk->buf + len,
+                            blk->_buf_alloc_len - len)) < 0) {
+      return PARSEBGP_INVALID_MSG;
+    }
+    len += rlen;
+
+    if ((err = index_block(blk, len, &used)) != PARSEBGP_OK) {
+      return err;
+    }
+
+    if (rlen == 0) {
+      // end of input
+      if (used != len) {
+        // trailing partial record
+        return PARSEBGP_PARTIAL_MSG;
+      }
+      return PARSEBGP_OK;
+    }
+  }
+
+  // save the trailing partial record for the next block
+  if (len > used) {
+    PARSEBGP_MAYBE_REALLOC(in->carry, in->_carry_alloc_len, len - used);
+    memcpy(in->carry, blk->buf + used, len - used);
+  }
+  in->carry_len = len - used;
+
+  return PARSEBGP_OK;
+}
+
+/** Fill the next free block of the given input and queue it. Must be called
+    with the input mutex held (if running in the background). Returns 0 if
+    there were no more records to queue */
+static int fill_next_block(input_t *in, int background)
+{
+  block_t *blk = in->free;
+  parsebgp_error_t err;
+
+  in->free = blk->next;
+  blk->next = NULL;
+
+  if (background) {
+    pthread_mutex_unlock(&in->mutex);
+  }
+  err = fill_block(in, blk);
+  if (background) {
+    pthread_mutex_lock(&in->mutex);
+  }
+
+  if (err != PARSEBGP_OK) {
+    // the error is reported once the records before it have been merged
+    in->err = err;
+    in->eof = 1;
+  }
+
+  if (blk->recs_cnt == 0) {
+    in->eof = 1;
+    blk->next = in->free;
+    in->free = blk;
+    return 0;
+  }
+
+  if (in->filled_tail != NULL) {
+    in->filled_tail->next = blk;
+  } else {
+    in->filled_head = blk;
+  }
+  in->filled_tail = blk;
+  return 1;
+}
+
+static void *reader_thread(void *user)
+{
+  input_t *in = user;
+
+  pthread_mutex_lock(&in->mutex);
+  while (!in->eof) {
+    while (in->free == NULL && !in->eof) {
+      pthread_cond_wait(&in->cond, &in->mutex);
+    }
+    if (in->eof) {
+      break;
+    }
+    fill_next_block(in, 1);
+    pthread_cond_broadcast(&in->cond);
+  }
+  pthread_mutex_unlock(&in->mutex);
+
+  return NULL;
+}
+
+/** Get the next filled block from the given input (or NULL if exhausted) */
+static block_t *get_block(parsebgp_mrt_merge_t *merge, input_t *in)
+{
+  block_t *blk;
+
+  if (merge->background) {
+    pthread_mutex_lock(&in->mutex);
+    while (in->filled_head == NULL && !in->eof) {
+      pthread_cond_wait(&in->cond, &in->mutex);
+    }
+  } else if (in->filled_head == NULL && !in->eof) {
+    fill_next_block(in, 0);
+  }
+
+  if ((blk = in->filled_head) != NULL) {
+    if ((in->filled_head = blk->next) == NULL) {
+      in->filled_tail = NULL;
+    }
+    blk->next = NULL;
+  }
+
+  if (merge->background) {
+    pthread_mutex_unlock(&in->mutex);
+  }
+  return blk;
+}
+
+/** Return a consumed block to the given input */
+static void release_block(parsebgp_mrt_merge_t *merge, input_t *in,
+                          block_t *blk)
+{
+  if (merge->background) {
+    pthread_mutex_lock(&in->mutex);
+  }
+  blk->next = in->free;
+  in->free = blk;
+  if (merge->background) {
+    pthread_cond_broadcast(&in->cond);
+    pthread_mutex_unlock(&in->mutex);
+  }
+}
+
+static ssize_t fd_read(void *user, uint8_t *buf, size_t len)
+{
+  input_t *in = user;
+  ssize_t rlen;
+
+  while ((rlen = read(in->fd, buf, len)) < 0 && errno == EINTR)
+    ;
+  return rlen;
+}
+
+static int heap_less(const input_t *a, const input_t *b)
+{
+  const rec_idx_t *ra = &a->cur->recs[a->cur_rec];
+  const rec_idx_t *rb = &b->cur->recs[b->cur_rec];
+
+  if (ra->sec != rb->sec) {
+    return ra->sec < rb->sec;
+  }
+  if (ra->usec != rb->usec) {
+    return ra->usec < rb->usec;
+  }
+  return a->idx < b->idx;
+}
+
+static void heap_sift_down(parsebgp_mrt_merge_t *merge, int i)
+{
+  input_t *tmp;
+  int min, l, r;
+
+  while (1) {
+    min = i;
+    l = 2 * i + 1;
+    r = l + 1;
+    if (l < merge->heap_cnt && heap_less(merge->heap[l], merge->heap[min])) {
+      min = l;
+    }
+    if (r < merge->heap_cnt && heap_less(merge->heap[r], merge->heap[min])) {
+      min = r;
+    }
+    if (min == i) {
+      return;
+    }
+    tmp = merge->heap[i];
+    merge->heap[i] = merge->heap[min];
+    merge->heap[min] = tmp;
+    i = min;
+  }
+}
+
+static void heap_push(parsebgp_mrt_merge_t *merge, input_t *in)
+{
+  int i = merge->heap_cnt++, parent;
+
+  merge->heap[i] = in;
+  while (i > 0) {
+    parent = (i - 1) / 2;
+    if (!heap_less(merge->heap[i], merge->heap[parent])) {
+      break;
+    }
+    merge->heap[i] = merge->heap[parent];
+    merge->heap[parent] = in;
+    i = parent;
+  }
+}
+
+/** Move the cursor of the given input to its next record. Returns 0 if the
+    input has been exhausted */
+static int advance(parsebgp_mrt_merge_t *merge, input_t *in)
+{
+  if (in->cur != NULL && ++in->cur_rec < in->cur->recs_cnt) {
+    return 1;
+  }
+
+  if (in->cur != NULL) {
+    release_block(merge, in, in->cur);
+  }
+  in->cur_rec = 0;
+  return (in->cur = get_block(merge, in)) != NULL;
+}
+
+static parsebgp_error_t start(parsebgp_mrt_merge_t *merge)
+{
+  parsebgp_error_t err = PARSEBGP_OK;
+  input_t *in;
+  int i;
+
+  if ((merge->heap = malloc(sizeof(input_t *) * merge->inputs_cnt)) == NULL &&
+      merge->inputs_cnt > 0) {
+    return PARSEBGP_MALLOC_FAILURE;
+  }
+
+  if (merge->background) {
+    for (i = 0; i < merge->inputs_cnt; i++) {
+      in = merge->inputs[i];
+      if (pthread_create(&in->thread, NULL, reader_thread, in) != 0) {
+        // give up on the merge (the readers that did start are stopped by
+        // parsebgp_mrt_merge_destroy), so that a retry finds nothing to merge
+        free(merge->heap);
+        merge->heap = NULL;
+        merge->heap_cnt = 0;
+        merge->started = 1;
+        return PARSEBGP_MALLOC_FAILURE;
+      }
+      in->thread_running = 1;
+    }
+  }
+
+  for (i = 0; i < merge->inputs_cnt; i++) {
+    in = merge->inputs[i];
+    if (advance(merge, in)) {
+      heap_push(merge, in);
+    } else if (in->err != PARSEBGP_OK && err == PARSEBGP_OK) {
+      err = in->err;
+    }
+  }
+
+  merge->started = 1;
+  return err;
+}
+
+static void destroy_input(input_t *in)
+{
+  int i;
+
+  if (in == NULL) {
+    return;
+  }
+
+  if (in->thread_running) {
+    pthread_mutex_lock(&in->mutex);
+    in->eof = 1;
+    pthread_cond_broadcast(&in->cond);
+    pthread_mutex_unlock(&in->mutex);
+    pthread_join(in->thread, NULL);
+  }
+  pthread_mutex_destroy(&in->mutex);
+  pthread_cond_destroy(&in->cond);
+
+  for (i = 0; i < BLOCKS_CNT; i++) {
+    free(in->blocks[i].buf);
+    free(in->blocks[i].recs);
+  }
+  free(in->carry);
+
+  if (in->fd > STDIN_FILENO) {
+    close(in->fd);
+  }
+
+  free(in);
+}
+
+parsebgp_mrt_merge_t *parsebgp_mrt_merge_create(const parsebgp_opts_t *opts,
+                                                int background)
+{
+  parsebgp_mrt_merge_t *merge;
+
+  if ((merge = malloc_zero(sizeof(parsebgp_mrt_merge_t))) == NULL) {
+    return NULL;
+  }
+
+  merge->opts = *opts;
+  merge->background = background;
+
+  return merge;
+}
+
+void parsebgp_mrt_merge_destroy(parsebgp_mrt_merge_t *merge)
+{
+  int i;
+
+  if (merge == NULL) {
+    return;
+  }
+
+  for (i = 0; i < merge->inputs_cnt; i++) {
+    destroy_input(merge->inputs[i]);
+  }
+  free(merge->inputs);
+  free(merge->heap);
+  parsebgp_mrt_destroy_msg(merge->msg);
+
+  free(merge);
+}
+
+int parsebgp_mrt_merge_add_input(parsebgp_mrt_merge_t *merge,
+                                 parsebgp_mrt_merge_read_cb_t *read_cb,
+                                 void *user)
+{
+  input_t *in, **tmp;
+  int i;
+
+  if (merge->started) {
+    return -1;
+  }
+
+  if ((tmp = realloc(merge->inputs,
+                     sizeof(input_t *) * (merge->inputs_cnt + 1))) == NULL) {
+    return -1;
+  }
+  merge->inputs = tmp;
+
+  if ((in = malloc_zero(sizeof(input_t))) == NULL) {
+    return -1;
+  }
+  in->idx = merge->inputs_cnt;
+  in->read_cb = read_cb;
+  in->user = user;
+  in->fd = -1;
+  pthread_mutex_init(&in->mutex, NULL);
+  pthread_cond_init(&in->cond, NULL);
+  for (i = 0; i < BLOCKS_CNT; i++) {
+    in->blocks[i].next = in->free;
+    in->free = &in->blocks[i];
+  }
+
+  merge->inputs[merge->inputs_cnt++] = in;
+  return in->idx;
+}
+
+int parsebgp_mrt_merge_add_file(parsebgp_mrt_merge_t *merge,
+                                const char *fname)
+{
+  int fd, idx;
+
+  if (strcmp(fname, "-") == 0) {
+    fd = STDIN_FILENO;
+  } else if ((fd = open(fname, O_RDONLY)) < 0) {
+    return -1;
+  }
+
+  if ((idx = parsebgp_mrt_merge_add_input(merge, fd_read, NULL)) < 0) {
+    if (fd != STDIN_FILENO) {
+      close(fd);
+    }
+    return -1;
+  }
+  merge->inputs[idx]->fd = fd;
+  merge->inputs[idx]->user = merge->inputs[idx];
+
+  return idx;
+}
+
+parsebgp_error_t parsebgp_mrt_merge_next(parsebgp_mrt_merge_t *merge,
+                                         parsebgp_mrt_merge_rec_t **rec)
+{
+  parsebgp_error_t err = PARSEBGP_OK;
+  input_t *in;
+  rec_idx_t *idx;
+
+  *rec = NULL;
+
+  if (!merge->started) {
+    if ((err = start(merge)) != PARSEBGP_OK) {
+      return err;
+    }
+  }
+
+  // move past the record we yielded last time (it is at the top of the heap)
+  if ((in = merge->last) != NULL) {
+    merge->last = NULL;
+    if (!advance(merge, in)) {
+      merge->heap[0] = merge->heap[--merge->heap_cnt];
+      err = in->err;
+    }
+    heap_sift_down(merge, 0);
+    if (err != PARSEBGP_OK) {
+      return err;
+    }
+  }
+
+  if (merge->heap_cnt == 0) {
+    return PARSEBGP_OK;
+  }
+
+  in = merge->heap[0];
+  idx = &in->cur->recs[in->cur_rec];
+  merge->rec.input = in->idx;
+  merge->rec.timestamp_sec = idx->sec;
+  merge->rec.timestamp_usec = idx->usec;
+  merge->rec.buf = in->cur->buf + idx->offset;
+  merge->rec.len = idx->len;
+  merge->last = in;
+
+  *rec = &merge->rec;
+  return PARSEBGP_OK;
+}
+
+parsebgp_error_t parsebgp_mrt_merge_decode(parsebgp_mrt_merge_t *merge,
+                                           parsebgp_mrt_msg_t **msg)
+{
+  parsebgp_opts_t opts = merge->opts;
+  size_t len = merge->rec.len;
+  parsebgp_error_t err;
+
+  *msg = NULL;
+  if (merge->last == NULL) {
+    // no current record
+    return PARSEBGP_INVALID_MSG;
+  }
+
+  if (merge->msg == NULL) {
+    if ((merge->msg = malloc_zero(sizeof(parsebgp_mrt_msg_t))) == NULL) {
+      return PARSEBGP_MALLOC_FAILURE;
+    }
+  } else {
+    parsebgp_mrt_clear_msg(merge->msg);
+  }
+
+  if ((err = parsebgp_mrt_decode(&opts, merge->msg, merge->rec.buf, &len)) !=
+      PARSEBGP_OK) {
+    return err;
+  }
+
+  *msg = merge->msg;
+  return PARSEBGP_OK;
+}
@@ -0,0 +1,169 @@
+/*
+ * Copyright (C) 2017 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __PARSEBGP_MRT_MERGE_H
+#define __PARSEBGP_MRT_MERGE_H
+
+#include "parsebgp_error.h"
+#include "parsebgp_mrt.h"
+#include "parsebgp_opts.h"
+#include <inttypes.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+/**
+ * MRT Merge Reader
+ *
+ * Reads MRT records from a number of inputs (e.g., the update files of several
+ * collectors) and yields them in global timestamp order. Each input is read in
+ * blocks of whole records, and the record boundaries and timestamps of a block
+ * are indexed as soon as it is read, so the merge itself only compares
+ * pre-decoded header timestamps. Record bodies are only decoded if the caller
+ * asks for them (see parsebgp_mrt_merge_decode).
+ *
+ * Optionally, each input can be read (and indexed) by a background thread, so
+ * that reading and decompressing inputs overlaps with the caller's processing.
+ *
+ * Records with equal timestamps are yielded in the order that their inputs
+ * were added, and records from a single input are always yielded in the order
+ * they appear in that input.
+ */
+typedef struct parsebgp_mrt_merge parsebgp_mrt_merge_t;
+
+/**
+ * Callback used to read data from an input
+ *
+ * @param user          User pointer given when the input was added
+ * @param buf           Buffer to read data into
+ * @param len           Maximum number of bytes to read
+ * @return the number of bytes read, 0 at the end of the input, or a negative
+ * value if an error occurred
+ *
+ * Decompression can be implemented using this callback (e.g., by wrapping
+ * gzread). If the merge reader uses background threads, the callback is called
+ * from the thread dedicated to the input.
+ */
+typedef ssize_t(parsebgp_mrt_merge_read_cb_t)(void *user, uint8_t *buf,
+                                              size_t len);
+
+/**
+ * A record yielded by the merge reader
+ */
+typedef struct parsebgp_mrt_merge_rec {
+
+  /** Index of the input the record was read from (in the order that the
+      inputs were added, starting from 0) */
+  int input;
+
+  /** Timestamp of the record (seconds) */
+  uint32_t timestamp_sec;
+
+  /** Timestamp of the record (microseconds, 0 unless an *_ET record) */
+  uint32_t timestamp_usec;
+
+  /** Pointer to the raw record (including the MRT common header). Only valid
+      until the next call to parsebgp_mrt_merge_next */
+  const uint8_t *buf;
+
+  /** Length of the raw record */
+  size_t len;
+
+} parsebgp_mrt_merge_rec_t;
+
+/**
+ * Create a merge reader
+ *
+ * @param opts          Options to use when decoding records
+ * @param background    If set, each input is read by a background thread
+ * @return pointer to a new merge reader, or NULL if an error occurred
+ */
+parsebgp_mrt_merge_t *parsebgp_mrt_merge_create(const parsebgp_opts_t *opts,
+                                                int background);
+
+/**
+ * Destroy the given merge reader (and stop any background threads)
+ *
+ * @param merge         Pointer to the merge reader to destroy
+ *
+ * Inputs added using parsebgp_mrt_merge_add_file are closed. Inputs added with
+ * parsebgp_mrt_merge_add_input are owned by the caller.
+ */
+void parsebgp_mrt_merge_destroy(parsebgp_mrt_merge_t *merge);
+
+/**
+ * Add an input that is read using the given callback
+ *
+ * @param merge         Pointer to the merge reader
+ * @param read_cb       Callback used to read data from the input
+ * @param user          User pointer passed to the callback
+ * @return the index of the input, or -1 if an error occurred
+ *
+ * Inputs must be added before the first call to parsebgp_mrt_merge_next.
+ */
+int parsebgp_mrt_merge_add_input(parsebgp_mrt_merge_t *merge,
+                                 parsebgp_mrt_merge_read_cb_t *read_cb,
+                                 void *user);
+
+/**
+ * Add an (uncompressed) MRT file as an input
+ *
+ * @param merge         Pointer to the merge reader
+ * @param fname         Name of the file to read ("-" for stdin)
+ * @return the index of the input, or -1 if an error occurred
+ */
+int parsebgp_mrt_merge_add_file(parsebgp_mrt_merge_t *merge,
+                                const char *fname);
+
+/**
+ * Get the next record (in timestamp order)
+ *
+ * @param merge         Pointer to the merge reader
+ * @param [out] rec     Set to point to the next record, or to NULL once all
+ *                      inputs have been exhausted. The record is owned by the
+ *                      merge reader and is only valid until the next call.
+ * @return PARSEBGP_OK if successful, or an error code otherwise
+ *
+ * If an error occurs while reading an input (e.g., it is truncated or corrupt),
+ * the error is returned (with rec set to NULL) and the input is removed from
+ * the merge. The caller may continue to call this function to read the
+ * remaining inputs.
+ */
+parsebgp_error_t parsebgp_mrt_merge_next(parsebgp_mrt_merge_t *merge,
+                                         parsebgp_mrt_merge_rec_t **rec);
+
+/**
+ * Decode the body of the current record
+ *
+ * @param merge         Pointer to the merge reader
+ * @param [out] msg     Set to point to the decoded message. The message is
+ *                      owned by the merge reader and is only valid until the
+ *                      next call to parsebgp_mrt_merge_next.
+ * @return PARSEBGP_OK if successful, or an error code otherwise
+ */
+parsebgp_error_t parsebgp_mrt_merge_decode(parsebgp_mrt_merge_t *merge,
+                                           parsebgp_mrt_msg_t **msg);
+
+#endif /* __PARSEBGP_MRT_MERGE_H */
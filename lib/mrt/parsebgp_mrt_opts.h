@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2017 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __PARSEBGP_MRT_OPTS_H
+#define __PARSEBGP_MRT_OPTS_H
+
+/**
+ * MRT Parsing Options
+ */
+typedef struct parsebgp_mrt_opts {
+
+  /**
+   * Shallow MRT Parsing
+   *
+   * If this is set, then do not parse past the fixed header fields of each
+   * record. The parser will fill the common header fields and the per-type
+   * header fields that precede the record body (i.e., the BGP4MP peer fields,
+   * the TABLE_DUMP prefix and peer fields, and the TABLE_DUMP_V2 RIB sequence
+   * and prefix). The (small) TABLE_DUMP_V2 Peer Index Table is always fully
+   * parsed.
+   */
+  int parse_headers_only;
+
+} parsebgp_mrt_opts_t;
+
+/**
+ * Initialize parser options to default values
+ *
+ * @param opts          pointer to an opts structure to initialize
+ */
+void parsebgp_mrt_opts_init(parsebgp_mrt_opts_t *opts);
+
+#endif /* __PARSEBGP_MRT_OPTS_H */
@@ -27,37 +27,173 @@
 #include "parsebgp.h"
 #include "parsebgp_bgp.h"
 #include "parsebgp_bmp.h"
+#include "parsebgp_msg_flat.h"
 #include "parsebgp_mrt.h"
 #include "parsebgp_utils.h"
 #include <assert.h>
 #include <stdio.h>
+#include <string.h>
+
+// every trim_interval messages, trim the structure if it retains far more
+// memory than the largest message of the last trim_interval needed
+static void maybe_trim_msg(const parsebgp_opts_t *opts, parsebgp_msg_t *msg,
+                           size_t len)
+{
+  parsebgp_mem_usage_t usage;
+  size_t used, factor;
+
+  // the wire length is free to track for every message
+  if (len > msg->_trim_max_len) {
+    msg->_trim_max_len = len;
+  }
+  if (++msg->_trim_cnt < opts->trim_interval) {
+    return;
+  }
+
+  // the size of a flattened copy is a good measure of the memory in use, but
+  // it walks the whole message, so it is only computed here, and scaled up to
+  // the largest message of the interval by their wire lengths
+  used = parsebgp_msg_flatten(msg, NULL, 0);
+  if (len > 0 && msg->_trim_max_len > len) {
+    used = used * msg->_trim_max_len / len;
+  }
+  factor = opts->trim_factor < 1 ? 1 : opts->trim_factor;
+  parsebgp_msg_mem_usage(msg, &usage);
+  if (usage.total > factor * used) {
+    parsebgp_trim_msg(msg);
+  }
+  msg->_trim_cnt = 0;
+  msg->_trim_max_len = 0;
+}
 
 parsebgp_error_t parsebgp_decode(parsebgp_opts_t opts, parsebgp_msg_type_t type,
                                  parsebgp_msg_t *msg, const uint8_t *buffer,
                                  size_t *len)
 {
+  parsebgp_budget_state_t budget_state;
+  parsebgp_error_t err;
+  size_t buf_len = *len;
+
   msg->type = type;
+  memset(&msg->resume, 0, sizeof(msg->resume));
+  memset(&budget_state, 0, sizeof(budget_state));
+  opts._budget_state = &budget_state;
 
   switch (type) {
   case PARSEBGP_MSG_TYPE_BMP:
     PARSEBGP_MAYBE_MALLOC_ZERO(msg->types.bmp);
-    return parsebgp_bmp_decode(&opts, msg->types.bmp, buffer, len);
+    err = parsebgp_bmp_decode(&opts, msg->types.bmp, buffer, len);
     break;
 
   case PARSEBGP_MSG_TYPE_MRT:
     PARSEBGP_MAYBE_MALLOC_ZERO(msg->types.mrt);
-    return parsebgp_mrt_decode(&opts, msg->types.mrt, buffer, len);
+    err = parsebgp_mrt_decode(&opts, msg->types.mrt, buffer, len);
     break;
 
   case PARSEBGP_MSG_TYPE_BGP:
     PARSEBGP_MAYBE_MALLOC_ZERO(msg->types.bgp);
-    return parsebgp_bgp_decode(&opts, msg->types.bgp, buffer, len);
+    err = parsebgp_bgp_decode(&opts, msg->types.bgp, buffer, len);
     break;
 
   default:
     PARSEBGP_RETURN_INVALID_MSG_ERR;
   }
-  assert(0);
+
+  if (err == PARSEBGP_BUDGET_EXCEEDED) {
+    // tell the caller where we stopped, and skip the rest of the message
+    msg->resume.budget = budget_state.hit;
+    msg->resume.offset = budget_state.stop - buffer;
+    if ((err = parsebgp_frame(&opts, type, buffer, buf_len,
+                              &msg->resume.len)) != PARSEBGP_OK) {
+      return err;
+    }
+    *len = msg->resume.len;
+    return PARSEBGP_BUDGET_EXCEEDED;
+  }
+
+  if (err == PARSEBGP_OK && opts.trim_interval > 0) {
+    maybe_trim_msg(&opts, msg, *len);
+  }
+  return err;
+}
+
+parsebgp_error_t parsebgp_redecode_full(parsebgp_opts_t opts,
+                                        parsebgp_msg_type_t type,
+                                        parsebgp_msg_t *msg,
+                                        const uint8_t *buffer, size_t len)
+{
+  // the part that was already decoded is bounded by the budgets, so just
+  // decode the whole message again without them
+  memset(&opts.budget, 0, sizeof(opts.budget));
+  parsebgp_clear_msg(msg);
+  return parsebgp_decode(opts, type, msg, buffer, &len);
+}
+
+int parsebgp_decode_batch(parsebgp_opts_t opts, parsebgp_msg_type_t type,
+                          parsebgp_msg_t **msgs, parsebgp_error_t *errs,
+                          int max_msgs, const uint8_t *buffer, size_t len,
+                          size_t *consumed)
+{
+  parsebgp_error_t err;
+  size_t nread = 0, msg_len, dec_len;
+  int cnt = 0;
+
+  while (cnt < max_msgs && nread < len) {
+    // only decode messages that are completely in the buffer
+    err = parsebgp_frame(&opts, type, buffer + nread, len - nread, &msg_len);
+    if (err == PARSEBGP_PARTIAL_MSG ||
+        (err == PARSEBGP_OK && msg_len > (len - nread))) {
+      break;
+    }
+    if (err != PARSEBGP_OK) {
+      if (cnt == 0) {
+        *consumed = 0;
+        return err;
+      }
+      // let the next call report it
+      break;
+    }
+
+    parsebgp_clear_msg(msgs[cnt]);
+    dec_len = msg_len;
+    err = parsebgp_decode(opts, type, msgs[cnt], buffer + nread, &dec_len);
+    if (err == PARSEBGP_PARTIAL_MSG) {
+      // the message claims to be longer than its frame, so leave it to the
+      // caller to decide what to do with it
+      break;
+    }
+    if (err != PARSEBGP_OK) {
+      // skip over the whole message
+      dec_len = msg_len;
+    }
+    if (errs != NULL) {
+      errs[cnt] = err;
+    }
+    nread += dec_len;
+    cnt++;
+  }
+
+  *consumed = nread;
+  return cnt;
+}
+
+parsebgp_error_t parsebgp_frame(const parsebgp_opts_t *opts,
+                                parsebgp_msg_type_t type, const uint8_t *buffer,
+                                size_t len, size_t *msg_len)
+{
+  switch (type) {
+  case PARSEBGP_MSG_TYPE_BMP:
+    return parsebgp_bmp_frame(opts, buffer, len, msg_len);
+
+  case PARSEBGP_MSG_TYPE_MRT:
+    return parsebgp_mrt_frame(opts, buffer, len, msg_len);
+
+  case PARSEBGP_MSG_TYPE_BGP:
+    return parsebgp_bgp_frame(opts, buffer, len, msg_len);
+
+  default:
+    PARSEBGP_RETURN_INVALID_MSG_ERR;
+  }
 }
 
 parsebgp_msg_t *parsebgp_create_msg(void)
@@ -109,6 +245,48 @@ void parsebgp_destroy_msg(parsebgp_msg_t *msg)
   free(msg);
 }
 
+void parsebgp_msg_mem_usage(const parsebgp_msg_t *msg,
+                            parsebgp_mem_usage_t *usage)
+{
+  memset(usage, 0, sizeof(*usage));
+  if (msg == NULL) {
+    return;
+  }
+
+  PARSEBGP_MEM_ADD(usage, structs, sizeof(*msg));
+  parsebgp_mrt_mem_usage(msg->types.mrt, usage);
+  parsebgp_bmp_mem_usage(msg->types.bmp, usage);
+  parsebgp_bgp_mem_usage(msg->types.bgp, usage);
+}
+
+void parsebgp_trim_msg(parsebgp_msg_t *msg)
+{
+  if (msg == NULL) {
+    return;
+  }
+
+  if (msg->type == PARSEBGP_MSG_TYPE_MRT) {
+    parsebgp_mrt_trim_msg(msg->types.mrt);
+  } else {
+    parsebgp_mrt_destroy_msg(msg->types.mrt);
+    msg->types.mrt = NULL;
+  }
+
+  if (msg->type == PARSEBGP_MSG_TYPE_BMP) {
+    parsebgp_bmp_trim_msg(msg->types.bmp);
+  } else {
+    parsebgp_bmp_destroy_msg(msg->types.bmp);
+    msg->types.bmp = NULL;
+  }
+
+  if (msg->type == PARSEBGP_MSG_TYPE_BGP) {
+    parsebgp_bgp_trim_msg(msg->types.bgp);
+  } else {
+    parsebgp_bgp_destroy_msg(msg->types.bgp);
+    msg->types.bgp = NULL;
+  }
+}
+
 void parsebgp_dump_msg(const parsebgp_msg_t *msg)
 {
   PARSEBGP_DUMP_STRUCT_HDR(parsebgp_msg_t, 0);
@@ -132,5 +310,14 @@ void parsebgp_dump_msg(const parsebgp_msg_t *msg)
     break;
   }
 
-  fputs("\n", stdout);
+  fputs("\n", PARSEBGP_DUMP_FP);
+}
+
+void parsebgp_dump_msg_fp(FILE *fp, const parsebgp_msg_t *msg)
+{
+  FILE *prev = parsebgp_dump_fp;
+
+  parsebgp_dump_fp = fp;
+  parsebgp_dump_msg(msg);
+  parsebgp_dump_fp = prev;
 }
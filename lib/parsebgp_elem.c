@@ -0,0 +1,562 @@
+/*
+ * Copyright (C) 2017 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "parsebgp_elem.h"
+#include "parsebgp_utils.h"
+#include <stdlib.h>
+#include <string.h>
+
+/** Where the generator is up to in the current message */
+enum {
+
+  /** No (more) elems in the message */
+  STAGE_DONE = 0,
+
+  /** A single elem (already filled) is pending */
+  STAGE_SINGLE,
+
+  /** Iterating over TABLE_DUMP_V2 RIB entries */
+  STAGE_RIB,
+
+  /** Iterating over UPDATE withdrawn NLRIs */
+  STAGE_WITHDRAWN,
+
+  /** Iterating over MP_UNREACH withdrawn NLRIs */
+  STAGE_MP_UNREACH,
+
+  /** Iterating over UPDATE announced NLRIs */
+  STAGE_ANNOUNCED,
+
+  /** Iterating over MP_REACH announced NLRIs */
+  STAGE_MP_REACH,
+};
+
+/** A peer from a TABLE_DUMP_V2 Peer Index Table */
+typedef struct peer {
+
+  /** Peer address AFI */
+  parsebgp_bgp_afi_t afi;
+
+  /** Peer address */
+  uint8_t ip[16];
+
+  /** Peer ASN */
+  uint32_t asn;
+
+} peer_t;
+
+struct parsebgp_elem_gen {
+
+  /** The elem handed to the caller (peer and timestamp fields are filled once
+      per message) */
+  parsebgp_elem_t elem;
+
+  /** Current stage (see the enum above) */
+  int stage;
+
+  /** Index of the next prefix (or RIB entry) in the current stage */
+  int idx;
+
+  /** UPDATE message being iterated over (WITHDRAWN to MP_REACH stages) */
+  const parsebgp_bgp_update_t *update;
+
+  /** Prefixes being iterated over (WITHDRAWN to MP_REACH stages) */
+  const parsebgp_bgp_prefix_t *pfxs;
+
+  /** Compact prefixes being iterated over (instead of pfxs, when the
+      compact_prefixes option is set) */
+  const parsebgp_bgp_prefixes_compact_t *compact;
+
+  /** Number of prefixes in the pfxs (or compact) array */
+  int pfxs_cnt;
+
+  /** RIB record being iterated over (RIB stage) */
+  const parsebgp_mrt_table_dump_v2_afi_safi_rib_t *rib;
+
+  /** Peers from the most recent Peer Index Table */
+  peer_t *peers;
+
+  /** Allocated length of the peers array (INTERNAL) */
+  int _peers_alloc_cnt;
+
+  /** Number of peers in the peers array */
+  int peers_cnt;
+};
+
+static void set_next_hop(parsebgp_elem_t *elem, int use_mp_reach)
+{
+  const parsebgp_bgp_update_path_attrs_t *attrs = elem->path_attrs;
+  const parsebgp_bgp_update_mp_reach_t *mp_reach;
+
+  elem->next_hop_afi = 0;
+
+  if (use_mp_reach && PARSEBGP_HAS_ATTR(attrs, MP_REACH_NLRI)) {
+    mp_reach = PARSEBGP_ATTR(attrs, MP_REACH_NLRI).mp_reach;
+    if (mp_reach->afi == PARSEBGP_BGP_AFI_IPV4 ||
+        mp_reach->afi == PARSEBGP_BGP_AFI_IPV6) {
+      elem->next_hop_afi = mp_reach->afi;
+      memcpy(elem->next_hop, mp_reach->next_hop, sizeof(elem->next_hop));
+    }
+    return;
+  }
+
+  if (PARSEBGP_HAS_ATTR(attrs, NEXT_HOP)) {
+    elem->next_hop_afi = PARSEBGP_BGP_AFI_IPV4;
+    memcpy(elem->next_hop, PARSEBGP_ATTR(attrs, NEXT_HOP).next_hop, 4);
+    memset(elem->next_hop + 4, 0, sizeof(elem->next_hop) - 4);
+  }
+}
+
+static void set_prefix(parsebgp_elem_t *elem, parsebgp_bgp_afi_t afi,
+                       parsebgp_bgp_safi_t safi, const uint8_t *addr,
+                       uint8_t len)
+{
+  elem->prefix.type = (afi == PARSEBGP_BGP_AFI_IPV4)
+                        ? PARSEBGP_BGP_PREFIX_UNICAST_IPV4
+                        : PARSEBGP_BGP_PREFIX_UNICAST_IPV6;
+  elem->prefix.afi = afi;
+  elem->prefix.safi = safi;
+  elem->prefix.len = len;
+  memcpy(elem->prefix.addr, addr, sizeof(elem->prefix.addr));
+  elem->prefix.path_id = 0;
+}
+
+static void set_peer(parsebgp_elem_t *elem, parsebgp_bgp_afi_t afi,
+                     const uint8_t *ip, uint32_t asn)
+{
+  elem->peer_afi = afi;
+  memcpy(elem->peer_ip, ip, sizeof(elem->peer_ip));
+  elem->peer_asn = asn;
+}
+
+static void set_state(parsebgp_elem_gen_t *gen, uint16_t old_state,
+                      uint16_t new_state)
+{
+  gen->elem.type = PARSEBGP_ELEM_TYPE_PEER_STATE;
+  gen->elem.old_state = old_state;
+  gen->elem.new_state = new_state;
+  gen->stage = STAGE_SINGLE;
+}
+
+static void set_compact(parsebgp_elem_gen_t *gen,
+                        const parsebgp_bgp_prefixes_compact_t *compact)
+{
+  if (compact->cnt > 0) {
+    gen->compact = compact;
+    gen->pfxs_cnt = compact->cnt;
+  }
+}
+
+static void set_stage(parsebgp_elem_gen_t *gen, int stage)
+{
+  const parsebgp_bgp_update_path_attrs_t *attrs = &gen->update->path_attrs;
+  const parsebgp_bgp_update_mp_unreach_t *mp_unreach;
+  const parsebgp_bgp_update_mp_reach_t *mp_reach;
+
+  gen->stage = stage;
+  gen->idx = 0;
+  gen->pfxs = NULL;
+  gen->compact = NULL;
+  gen->pfxs_cnt = 0;
+
+  switch (stage) {
+  case STAGE_WITHDRAWN:
+    gen->pfxs = gen->update->withdrawn_nlris.prefixes;
+    gen->pfxs_cnt = gen->update->withdrawn_nlris.prefixes_cnt;
+    set_compact(gen, &gen->update->withdrawn_nlris.compact);
+    break;
+
+  case STAGE_MP_UNREACH:
+    if (PARSEBGP_HAS_ATTR(attrs, MP_UNREACH_NLRI)) {
+      mp_unreach = PARSEBGP_ATTR(attrs, MP_UNREACH_NLRI).mp_unreach;
+      gen->pfxs = mp_unreach->withdrawn_nlris;
+      gen->pfxs_cnt = mp_unreach->withdrawn_nlris_cnt;
+      set_compact(gen, &mp_unreach->compact_withdrawn_nlris);
+    }
+    break;
+
+  case STAGE_ANNOUNCED:
+    gen->pfxs = gen->update->announced_nlris.prefixes;
+    gen->pfxs_cnt = gen->update->announced_nlris.prefixes_cnt;
+    set_compact(gen, &gen->update->announced_nlris.compact);
+    break;
+
+  case STAGE_MP_REACH:
+    if (PARSEBGP_HAS_ATTR(attrs, MP_REACH_NLRI)) {
+      mp_reach = PARSEBGP_ATTR(attrs, MP_REACH_NLRI).mp_reach;
+      gen->pfxs = mp_reach->nlris;
+      gen->pfxs_cnt = mp_reach->nlris_cnt;
+      set_compact(gen, &mp_reach->compact_nlris);
+    }
+    break;
+
+  default:
+    break;
+  }
+}
+
+static void start_update(parsebgp_elem_gen_t *gen,
+                         const parsebgp_bgp_update_t *update)
+{
+  gen->update = update;
+  set_stage(gen, STAGE_WITHDRAWN);
+}
+
+static void start_bgp(parsebgp_elem_gen_t *gen, const parsebgp_bgp_msg_t *msg)
+{
+  if (msg != NULL && msg->type == PARSEBGP_BGP_TYPE_UPDATE) {
+    start_update(gen, msg->types.update);
+  }
+}
+
+static parsebgp_error_t
+copy_peer_index(parsebgp_elem_gen_t *gen,
+                const parsebgp_mrt_table_dump_v2_peer_index_t *pi)
+{
+  int i;
+
+  PARSEBGP_MAYBE_REALLOC(gen->peers, gen->_peers_alloc_cnt, pi->peer_count);
+  for (i = 0; i < pi->peer_count; i++) {
+    gen->peers[i].afi = pi->peer_entries[i].ip_afi;
+    memcpy(gen->peers[i].ip, pi->peer_entries[i].ip, sizeof(gen->peers[i].ip));
+    gen->peers[i].asn = pi->peer_entries[i].asn;
+  }
+  gen->peers_cnt = pi->peer_count;
+
+  return PARSEBGP_OK;
+}
+
+static parsebgp_error_t start_mrt(parsebgp_elem_gen_t *gen,
+                                  const parsebgp_mrt_msg_t *msg)
+{
+  const parsebgp_mrt_table_dump_t *td;
+  const parsebgp_mrt_table_dump_v2_t *td2;
+  const parsebgp_mrt_bgp4mp_t *bgp4mp;
+  const parsebgp_mrt_bgp_t *bgp;
+  parsebgp_elem_t *elem = &gen->elem;
+
+  elem->mrt_type = msg->type;
+  elem->timestamp_sec = msg->timestamp_sec;
+  elem->timestamp_usec = msg->timestamp_usec;
+
+  if (!msg->types_valid) {
+    return PARSEBGP_OK;
+  }
+
+  switch (msg->type) {
+  case PARSEBGP_MRT_TYPE_TABLE_DUMP:
+    // the subtype is the AFI
+    td = msg->types.table_dump;
+    if (msg->subtype != PARSEBGP_BGP_AFI_IPV4 &&
+        msg->subtype != PARSEBGP_BGP_AFI_IPV6) {
+      break;
+    }
+    set_peer(elem, msg->subtype, td->peer_ip, td->peer_asn);
+    set_prefix(elem, msg->subtype, PARSEBGP_BGP_SAFI_UNICAST, td->prefix,
+               td->prefix_len);
+    elem->type = PARSEBGP_ELEM_TYPE_RIB;
+    elem->path_attrs = &td->path_attrs;
+    set_next_hop(elem, msg->subtype != PARSEBGP_BGP_AFI_IPV4);
+    gen->stage = STAGE_SINGLE;
+    break;
+
+  case PARSEBGP_MRT_TYPE_TABLE_DUMP_V2:
+    td2 = msg->types.table_dump_v2;
+    switch (msg->subtype) {
+    case PARSEBGP_MRT_TABLE_DUMP_V2_PEER_INDEX_TABLE:
+      return copy_peer_index(gen, &td2->peer_index);
+
+    case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_UNICAST:
+    case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_MULTICAST:
+    case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_UNICAST_ADDPATH:
+    case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_MULTICAST_ADDPATH:
+      set_prefix(elem, PARSEBGP_BGP_AFI_IPV4,
+                 (msg->subtype == PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_UNICAST ||
+                  msg->subtype ==
+                    PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_UNICAST_ADDPATH)
+                   ? PARSEBGP_BGP_SAFI_UNICAST
+                   : PARSEBGP_BGP_SAFI_MULTICAST,
+                 td2->afi_safi_rib.prefix, td2->afi_safi_rib.prefix_len);
+      gen->rib = &td2->afi_safi_rib;
+      gen->stage = STAGE_RIB;
+      break;
+
+    case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV6_UNICAST:
+    case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV6_MULTICAST:
+    case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV6_UNICAST_ADDPATH:
+    case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV6_MULTICAST_ADDPATH:
+      set_prefix(elem, PARSEBGP_BGP_AFI_IPV6,
+                 (msg->subtype == PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV6_UNICAST ||
+                  msg->subtype ==
+                    PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV6_UNICAST_ADDPATH)
+                   ? PARSEBGP_BGP_SAFI_UNICAST
+                   : PARSEBGP_BGP_SAFI_MULTICAST,
+                 td2->afi_safi_rib.prefix, td2->afi_safi_rib.prefix_len);
+      gen->rib = &td2->afi_safi_rib;
+      gen->stage = STAGE_RIB;
+      break;
+
+    default:
+      // RIB_GENERIC is not supported by the parser
+      break;
+    }
+    break;
+
+  case PARSEBGP_MRT_TYPE_BGP4MP:
+  case PARSEBGP_MRT_TYPE_BGP4MP_ET:
+    bgp4mp = msg->types.bgp4mp;
+    set_peer(elem, bgp4mp->afi, bgp4mp->peer_ip, bgp4mp->peer_asn);
+    switch (msg->subtype) {
+    case PARSEBGP_MRT_BGP4MP_STATE_CHANGE:
+    case PARSEBGP_MRT_BGP4MP_STATE_CHANGE_AS4:
+      set_state(gen, bgp4mp->data.state_change.old_state,
+                bgp4mp->data.state_change.new_state);
+      break;
+
+    case PARSEBGP_MRT_BGP4MP_MESSAGE:
+    case PARSEBGP_MRT_BGP4MP_MESSAGE_AS4:
+    case PARSEBGP_MRT_BGP4MP_MESSAGE_LOCAL:
+    case PARSEBGP_MRT_BGP4MP_MESSAGE_AS4_LOCAL:
+      start_bgp(gen, bgp4mp->data.bgp_msg);
+      break;
+
+    default:
+      break;
+    }
+    break;
+
+  case PARSEBGP_MRT_TYPE_BGP:
+    // the (deprecated) BGP type only supports IPv4 peers
+    bgp = msg->types.bgp;
+    set_peer(elem, PARSEBGP_BGP_AFI_IPV4, bgp->peer_ip, bgp->peer_asn);
+    if (msg->subtype == PARSEBGP_MRT_BGP_MESSAGE_UPDATE &&
+        bgp->data.update != NULL) {
+      start_update(gen, bgp->data.update);
+    } else if (msg->subtype == PARSEBGP_MRT_BGP_MESSAGE_STATE_CHANGE) {
+      set_state(gen, bgp->data.state_change.old_state,
+                bgp->data.state_change.new_state);
+    }
+    break;
+
+  default:
+    break;
+  }
+
+  return PARSEBGP_OK;
+}
+
+static void start_bmp(parsebgp_elem_gen_t *gen, const parsebgp_bmp_msg_t *msg)
+{
+  const parsebgp_bmp_peer_hdr_t *hdr = &msg->peer_hdr;
+  parsebgp_elem_t *elem = &gen->elem;
+
+  elem->timestamp_sec = hdr->ts_sec;
+  elem->timestamp_usec = hdr->ts_usec;
+  set_peer(elem, hdr->afi, hdr->addr, hdr->asn);
+
+  switch (msg->type) {
+  case PARSEBGP_BMP_TYPE_ROUTE_MON:
+    if (msg->types_valid) {
+      start_bgp(gen, msg->types.route_mon);
+    }
+    break;
+
+  case PARSEBGP_BMP_TYPE_PEER_UP:
+    // the state before the session came up is not reported
+    set_state(gen, 0, PARSEBGP_MRT_FSM_CODE_ESTABLISHED);
+    break;
+
+  case PARSEBGP_BMP_TYPE_PEER_DOWN:
+    set_state(gen, PARSEBGP_MRT_FSM_CODE_ESTABLISHED,
+              PARSEBGP_MRT_FSM_CODE_IDLE);
+    break;
+
+  default:
+    break;
+  }
+}
+
+// path length as defined by RFC4271 section 9.1.2.2 (the asns_cnt field of the
+// path is only 8 bits wide, so it cannot be used for long paths)
+static int as_path_hops(const parsebgp_bgp_update_as_path_t *path)
+{
+  int i, hops = 0;
+
+  for (i = 0; i < path->segs_cnt; i++) {
+    if (path->segs[i].type == PARSEBGP_BGP_UPDATE_AS_PATH_SEG_AS_SEQ) {
+      hops += path->segs[i].asns_cnt;
+    } else if (path->segs[i].type == PARSEBGP_BGP_UPDATE_AS_PATH_SEG_AS_SET) {
+      hops++;
+    }
+  }
+  return hops;
+}
+
+parsebgp_elem_gen_t *parsebgp_elem_gen_create(void)
+{
+  return malloc_zero(sizeof(parsebgp_elem_gen_t));
+}
+
+void parsebgp_elem_gen_destroy(parsebgp_elem_gen_t *gen)
+{
+  if (gen == NULL) {
+    return;
+  }
+
+  free(gen->peers);
+  free(gen);
+}
+
+parsebgp_error_t parsebgp_elem_gen_reset(parsebgp_elem_gen_t *gen,
+                                         const parsebgp_msg_t *msg)
+{
+  memset(&gen->elem, 0, sizeof(gen->elem));
+  gen->elem.msg_type = msg->type;
+  gen->stage = STAGE_DONE;
+  gen->idx = 0;
+  gen->update = NULL;
+  gen->pfxs = NULL;
+  gen->compact = NULL;
+  gen->pfxs_cnt = 0;
+  gen->rib = NULL;
+
+  switch (msg->type) {
+  case PARSEBGP_MSG_TYPE_BGP:
+    start_bgp(gen, msg->types.bgp);
+    break;
+
+  case PARSEBGP_MSG_TYPE_BMP:
+    start_bmp(gen, msg->types.bmp);
+    break;
+
+  case PARSEBGP_MSG_TYPE_MRT:
+    return start_mrt(gen, msg->types.mrt);
+
+  default:
+    break;
+  }
+
+  return PARSEBGP_OK;
+}
+
+parsebgp_elem_t *parsebgp_elem_gen_next(parsebgp_elem_gen_t *gen)
+{
+  parsebgp_elem_t *elem = &gen->elem;
+  const parsebgp_mrt_table_dump_v2_rib_entry_t *entry;
+  const peer_t *peer;
+
+  while (1) {
+    switch (gen->stage) {
+    case STAGE_SINGLE:
+      gen->stage = STAGE_DONE;
+      return elem;
+
+    case STAGE_RIB:
+      if (gen->idx >= gen->rib->entry_count) {
+        gen->stage = STAGE_DONE;
+        break;
+      }
+      entry = &gen->rib->entries[gen->idx++];
+      if (entry->peer_index >= gen->peers_cnt) {
+        // no (or an incomplete) peer index table, skip the entry
+        break;
+      }
+      peer = &gen->peers[entry->peer_index];
+      set_peer(elem, peer->afi, peer->ip, peer->asn);
+      elem->type = PARSEBGP_ELEM_TYPE_RIB;
+      elem->prefix.path_id = entry->path_id;
+      elem->path_attrs = &entry->path_attrs;
+      set_next_hop(elem, elem->prefix.afi != PARSEBGP_BGP_AFI_IPV4 ||
+                           !PARSEBGP_HAS_ATTR(&entry->path_attrs, NEXT_HOP));
+      return elem;
+
+    case STAGE_WITHDRAWN:
+    case STAGE_MP_UNREACH:
+    case STAGE_ANNOUNCED:
+    case STAGE_MP_REACH:
+      if (gen->idx >= gen->pfxs_cnt) {
+        set_stage(gen, gen->stage == STAGE_MP_REACH ? STAGE_DONE
+                                                    : gen->stage + 1);
+        break;
+      }
+      if (gen->compact != NULL) {
+        parsebgp_bgp_prefixes_compact_get(gen->compact, gen->idx++,
+                                          &elem->prefix);
+      } else {
+        elem->prefix = gen->pfxs[gen->idx++];
+      }
+      if (gen->stage == STAGE_WITHDRAWN || gen->stage == STAGE_MP_UNREACH) {
+        elem->type = PARSEBGP_ELEM_TYPE_WITHDRAW;
+        elem->path_attrs = NULL;
+        elem->next_hop_afi = 0;
+      } else {
+        elem->type = PARSEBGP_ELEM_TYPE_ANNOUNCE;
+        elem->path_attrs = &gen->update->path_attrs;
+        set_next_hop(elem, gen->stage == STAGE_MP_REACH);
+      }
+      return elem;
+
+    case STAGE_DONE:
+    default:
+      return NULL;
+    }
+  }
+}
+
+void parsebgp_elem_get_as_path(const parsebgp_elem_t *elem,
+                               const parsebgp_bgp_update_as_path_t **as_path,
+                               int *hops,
+                               const parsebgp_bgp_update_as_path_t **as4_path)
+{
+  const parsebgp_bgp_update_path_attrs_t *attrs = elem->path_attrs;
+  int len, len4;
+
+  *as_path = NULL;
+  *hops = -1;
+  *as4_path = NULL;
+
+  if (PARSEBGP_HAS_ATTR(attrs, AS_PATH)) {
+    *as_path = PARSEBGP_ATTR(attrs, AS_PATH).as_path;
+  }
+  if (!PARSEBGP_HAS_ATTR(attrs, AS4_PATH)) {
+    return;
+  }
+  if (*as_path == NULL) {
+    *as_path = PARSEBGP_ATTR(attrs, AS4_PATH).as_path;
+    return;
+  }
+  // AS4_PATH is ignored if AS_PATH already has 4-byte ASNs, or if it is longer
+  // than AS_PATH
+  if ((*as_path)->asn_4_byte) {
+    return;
+  }
+  len = as_path_hops(*as_path);
+  len4 = as_path_hops(PARSEBGP_ATTR(attrs, AS4_PATH).as_path);
+  if (len >= len4) {
+    *hops = len - len4;
+    *as4_path = PARSEBGP_ATTR(attrs, AS4_PATH).as_path;
+  }
+}
@@ -0,0 +1,185 @@
+/*
+ * Copyright (C) 2017 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __PARSEBGP_ELEM_H
+#define __PARSEBGP_ELEM_H
+
+#include "parsebgp.h"
+#include <inttypes.h>
+
+/**
+ * Prefix Elems
+ *
+ * An elem is a single route-level event extracted from a parsed message: one
+ * RIB entry, one announced or withdrawn prefix, or one peer state change. A
+ * message will often contain many elems (e.g., an UPDATE announcing several
+ * prefixes), and many messages contain none.
+ *
+ * Elems are generated on demand by iterating over an already-parsed message;
+ * nothing is copied except the fixed-size fields of the elem itself, so the
+ * path attributes pointed to by an elem are only valid until the message is
+ * cleared.
+ */
+
+/**
+ * Elem Types
+ */
+typedef enum parsebgp_elem_type {
+
+  /** RIB entry (from an MRT TABLE_DUMP or TABLE_DUMP_V2 record) */
+  PARSEBGP_ELEM_TYPE_RIB = 1,
+
+  /** Announced prefix */
+  PARSEBGP_ELEM_TYPE_ANNOUNCE = 2,
+
+  /** Withdrawn prefix */
+  PARSEBGP_ELEM_TYPE_WITHDRAW = 3,
+
+  /** Peer state change (from an MRT state change, or a BMP Peer Up or Peer
+      Down message) */
+  PARSEBGP_ELEM_TYPE_PEER_STATE = 4,
+
+} parsebgp_elem_type_t;
+
+/**
+ * Elem
+ */
+typedef struct parsebgp_elem {
+
+  /** Elem type */
+  parsebgp_elem_type_t type;
+
+  /** Type of the message the elem was extracted from */
+  parsebgp_msg_type_t msg_type;
+
+  /** MRT record type (parsebgp_mrt_msg_type_t) if msg_type is MRT */
+  uint16_t mrt_type;
+
+  /** Timestamp (seconds) of the message (zero for raw BGP messages) */
+  uint32_t timestamp_sec;
+
+  /** Microseconds portion of the message timestamp (if available) */
+  uint32_t timestamp_usec;
+
+  /** AFI of the peer address (zero if the peer is not known) */
+  parsebgp_bgp_afi_t peer_afi;
+
+  /** Peer address */
+  uint8_t peer_ip[16];
+
+  /** Peer ASN */
+  uint32_t peer_asn;
+
+  /** Prefix (RIB, ANNOUNCE, and WITHDRAW elems only) */
+  parsebgp_bgp_prefix_t prefix;
+
+  /** AFI of the next hop (zero if there is no next hop) */
+  parsebgp_bgp_afi_t next_hop_afi;
+
+  /** Next hop address (RIB and ANNOUNCE elems only) */
+  uint8_t next_hop[16];
+
+  /** Path attributes (RIB and ANNOUNCE elems only, NULL otherwise) */
+  const parsebgp_bgp_update_path_attrs_t *path_attrs;
+
+  /** FSM code of the old state (PEER_STATE elems only, zero if unknown) */
+  uint16_t old_state;
+
+  /** FSM code of the new state (PEER_STATE elems only) */
+  uint16_t new_state;
+
+} parsebgp_elem_t;
+
+/**
+ * Elem Generator
+ *
+ * Extracts elems from parsed messages. A generator is intended to be used for
+ * all messages of a single stream (e.g., an MRT file) since it keeps a copy of
+ * the most recent TABLE_DUMP_V2 Peer Index Table to resolve the peers of later
+ * RIB records.
+ */
+typedef struct parsebgp_elem_gen parsebgp_elem_gen_t;
+
+/**
+ * Create an elem generator
+ *
+ * @return pointer to a new generator, or NULL if an error occurred
+ */
+parsebgp_elem_gen_t *parsebgp_elem_gen_create(void);
+
+/**
+ * Destroy the given elem generator
+ *
+ * @param gen           Pointer to the generator to destroy
+ */
+void parsebgp_elem_gen_destroy(parsebgp_elem_gen_t *gen);
+
+/**
+ * Start generating elems from the given message
+ *
+ * @param gen           Pointer to the generator
+ * @param msg           Pointer to the parsed message to extract elems from
+ * @return PARSEBGP_OK if successful, or an error code otherwise
+ *
+ * The message must not be cleared until parsebgp_elem_gen_next has returned
+ * NULL (or the generator has been reset with another message).
+ */
+parsebgp_error_t parsebgp_elem_gen_reset(parsebgp_elem_gen_t *gen,
+                                         const parsebgp_msg_t *msg);
+
+/**
+ * Get the next elem of the current message
+ *
+ * @param gen           Pointer to the generator
+ * @return pointer to the next elem, or NULL if there are no more elems in the
+ * message
+ *
+ * The returned elem is owned by the generator and is overwritten by the next
+ * call.
+ */
+parsebgp_elem_t *parsebgp_elem_gen_next(parsebgp_elem_gen_t *gen);
+
+/**
+ * Get the AS path of the given elem
+ *
+ * @param elem          Pointer to the elem (must have path attributes)
+ * @param [out] as_path Set to the AS_PATH (or AS4_PATH if there is no AS_PATH)
+ *                      attribute, or NULL if the elem has no path
+ * @param [out] hops    Set to the number of hops (as defined by RFC4271
+ *                      section 9.1.2.2) of as_path that are part of the path,
+ *                      or -1 if the whole of as_path is used
+ * @param [out] as4_path Set to the AS4_PATH attribute if it must be appended to
+ *                       the first hops of as_path, or NULL otherwise
+ *
+ * This implements the reconstruction of the path from AS_PATH and AS4_PATH
+ * described in RFC6793 section 4.2.3.
+ */
+void parsebgp_elem_get_as_path(const parsebgp_elem_t *elem,
+                               const parsebgp_bgp_update_as_path_t **as_path,
+                               int *hops,
+                               const parsebgp_bgp_update_as_path_t **as4_path);
+
+#endif /* __PARSEBGP_ELEM_H */
@@ -0,0 +1,1189 @@
+/*
+ * Copyright (C) 2017 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "parsebgp_elem_arrow.h"
+#include "parsebgp_utils.h"
+#include <stdlib.h>
+#include <string.h>
+
+/** Number of rows per record batch if the caller does not choose */
+#define BATCH_ROWS_DEFAULT 65536
+
+/** Round up to a multiple of 8 (the alignment of all IPC buffers) */
+#define ALIGN8(len) (((len) + 7) & ~((size_t)7))
+
+/** Arrow metadata version (MetadataVersion.V5) */
+#define METADATA_VERSION 4
+
+/** Message header types (the MessageHeader union in Message.fbs) */
+enum {
+  MSG_SCHEMA = 1,
+  MSG_DICTIONARY_BATCH = 2,
+  MSG_RECORD_BATCH = 3,
+};
+
+/** Data types (the Type union in Schema.fbs) */
+enum {
+  TYPE_INT = 2,
+  TYPE_UTF8 = 5,
+  TYPE_TIMESTAMP = 10,
+  TYPE_LIST = 12,
+  TYPE_FIXED_SIZE_BINARY = 15,
+};
+
+/** TimeUnit.MICROSECOND */
+#define TIME_UNIT_MICROSECOND 2
+
+/** Dictionaries (the dictionary ID is the index) */
+enum {
+  DICT_TYPE = 0,
+  DICT_AS_PATH,
+  DICT_COMMUNITIES,
+  DICT_LARGE_COMMUNITIES,
+  DICTS_CNT,
+};
+
+/** Columns */
+enum {
+  COL_TYPE = 0,
+  COL_TIMESTAMP,
+  COL_PEER_IP,
+  COL_PEER_ASN,
+  COL_PREFIX,
+  COL_PREFIX_LEN,
+  COL_NEXT_HOP,
+  COL_AS_PATH,
+  COL_ORIGIN,
+  COL_LOCAL_PREF,
+  COL_MED,
+  COL_COMMUNITIES,
+  COL_LARGE_COMMUNITIES,
+  COL_OLD_STATE,
+  COL_NEW_STATE,
+  COLS_CNT,
+};
+
+/** Column definition */
+typedef struct col_spec {
+
+  /** Field name */
+  const char *name;
+
+  /** Data type (of the dictionary values for dictionary-encoded columns) */
+  int type;
+
+  /** Width of each value (or of each dictionary index) in bytes */
+  int width;
+
+  /** Is the (integer) value signed */
+  int is_signed;
+
+  /** Can the column contain nulls */
+  int nullable;
+
+  /** Dictionary ID (or -1 if the column is not dictionary-encoded) */
+  int dict;
+
+} col_spec_t;
+
+static const col_spec_t col_specs[COLS_CNT] = {
+  {"type", TYPE_UTF8, 4, 1, 0, DICT_TYPE},
+  {"timestamp", TYPE_TIMESTAMP, 8, 1, 0, -1},
+  {"peer_ip", TYPE_FIXED_SIZE_BINARY, 16, 0, 1, -1},
+  {"peer_asn", TYPE_INT, 4, 0, 0, -1},
+  {"prefix", TYPE_FIXED_SIZE_BINARY, 16, 0, 1, -1},
+  {"prefix_len", TYPE_INT, 1, 0, 1, -1},
+  {"next_hop", TYPE_FIXED_SIZE_BINARY, 16, 0, 1, -1},
+  {"as_path", TYPE_LIST, 4, 1, 1, DICT_AS_PATH},
+  {"origin", TYPE_INT, 1, 0, 1, -1},
+  {"local_pref", TYPE_INT, 4, 0, 1, -1},
+  {"med", TYPE_INT, 4, 0, 1, -1},
+  {"communities", TYPE_LIST, 4, 1, 1, DICT_COMMUNITIES},
+  {"large_communities", TYPE_LIST, 4, 1, 1, DICT_LARGE_COMMUNITIES},
+  {"old_state", TYPE_INT, 2, 0, 1, -1},
+  {"new_state", TYPE_INT, 2, 0, 1, -1},
+};
+
+/** Values of the (constant) elem type dictionary, indexed by elem type - 1 */
+static const char type_dict_data[] = "ribannouncewithdrawpeer_state";
+static const int32_t type_dict_offsets[] = {0, 3, 11, 19, 29};
+#define TYPE_DICT_CNT 4
+
+/** Column data for the current batch */
+typedef struct column {
+
+  /** Validity bitmap (bit set if the value is not null) */
+  uint8_t *validity;
+
+  /** Values (or dictionary indices) */
+  uint8_t *values;
+
+  /** Number of nulls in the batch */
+  int null_cnt;
+
+} column_t;
+
+/** Dictionary of lists of uint32 values */
+typedef struct dict {
+
+  /** Values of all entries, concatenated */
+  uint32_t *vals;
+
+  /** Number of values in the vals array */
+  size_t vals_cnt;
+
+  /** Allocated length of the vals array (INTERNAL) */
+  size_t _vals_alloc_cnt;
+
+  /** Offset of each entry in vals (with an extra offset for the end of the
+      last entry) */
+  uint32_t *offsets;
+
+  /** Allocated length of the offsets array (INTERNAL) */
+  size_t _offsets_alloc_cnt;
+
+  /** Hash of each entry */
+  uint32_t *hashes;
+
+  /** Allocated length of the hashes array (INTERNAL) */
+  size_t _hashes_alloc_cnt;
+
+  /** Number of entries */
+  int entries_cnt;
+
+  /** Hash table of entry index + 1 (zero for an empty slot) */
+  uint32_t *slots;
+
+  /** Number of slots in the hash table (a power of two) */
+  uint32_t slots_cnt;
+
+  /** Number of entries already written to the file */
+  int written_cnt;
+
+  /** Has a dictionary batch been written for this dictionary */
+  int written;
+
+} dict_t;
+
+/** File block (the Block struct in File.fbs) */
+typedef struct block {
+
+  /** Offset of the message in the file */
+  uint64_t offset;
+
+  /** Length of the message metadata, including the prefix and padding */
+  uint32_t meta_len;
+
+  /** Length of the message body */
+  uint64_t body_len;
+
+} block_t;
+
+/** List of file blocks */
+typedef struct blocks {
+
+  /** Array of blocks */
+  block_t *blocks;
+
+  /** Allocated length of the blocks array (INTERNAL) */
+  size_t _blocks_alloc_cnt;
+
+  /** Number of blocks */
+  size_t blocks_cnt;
+
+} blocks_t;
+
+/** Flatbuffer under construction
+ *
+ * The buffer is built front-to-back (so that all references point forward, as
+ * they must), and every table field is given its own 8-byte slot so that any
+ * scalar is aligned without having to pack the table. */
+typedef struct fb {
+
+  /** Buffer */
+  uint8_t *buf;
+
+  /** Number of bytes used */
+  size_t len;
+
+  /** Allocated length of the buffer (INTERNAL) */
+  size_t _alloc_len;
+
+  /** Set if an allocation failed (all further writes are ignored) */
+  int err;
+
+} fb_t;
+
+/** An IPC message body buffer */
+typedef struct body_buf {
+
+  /** Buffer data (may be NULL if len is zero) */
+  const void *ptr;
+
+  /** Length of the buffer */
+  size_t len;
+
+} body_buf_t;
+
+/** A field node (the FieldNode struct in Message.fbs) */
+typedef struct field_node {
+
+  /** Number of values */
+  uint64_t len;
+
+  /** Number of nulls */
+  uint64_t null_cnt;
+
+} field_node_t;
+
+/** Maximum number of field nodes and body buffers in a message */
+#define NODES_MAX COLS_CNT
+#define BUFS_MAX (COLS_CNT * 2)
+
+struct parsebgp_elem_arrow {
+
+  /** Output stream */
+  FILE *fp;
+
+  /** Number of bytes written to the stream */
+  uint64_t offset;
+
+  /** Set if a write failed */
+  int err;
+
+  /** Number of rows per batch */
+  int batch_rows;
+
+  /** Number of rows in the current batch */
+  int rows;
+
+  /** Column data */
+  column_t cols[COLS_CNT];
+
+  /** Dictionaries (the type dictionary is constant, and only its written
+      flag is used) */
+  dict_t dicts[DICTS_CNT];
+
+  /** Dictionary batch blocks (for the footer) */
+  blocks_t dict_blocks;
+
+  /** Record batch blocks (for the footer) */
+  blocks_t batch_blocks;
+
+  /** Flatbuffer used to build message metadata */
+  fb_t fb;
+
+  /** Body of the message being written */
+  body_buf_t bufs[BUFS_MAX];
+  int bufs_cnt;
+  field_node_t nodes[NODES_MAX];
+  int nodes_cnt;
+
+  /** Scratch space for building dictionary entries and rebased offsets */
+  uint32_t *scratch;
+  size_t _scratch_alloc_cnt;
+  size_t scratch_cnt;
+};
+
+/* ========== UTILITIES ========== */
+
+// grow the given array to hold at least cnt elements, doubling its size so
+// that appending is amortized constant time
+static int grow(void *ptrp, size_t *alloc_cnt, size_t cnt, size_t size)
+{
+  void **ptr = ptrp;
+  size_t new_cnt;
+  void *tmp;
+
+  if (cnt <= *alloc_cnt) {
+    return 0;
+  }
+  new_cnt = (*alloc_cnt > 0) ? *alloc_cnt : 64;
+  while (new_cnt < cnt) {
+    new_cnt *= 2;
+  }
+  if ((tmp = realloc(*ptr, new_cnt * size)) == NULL) {
+    return -1;
+  }
+  *ptr = tmp;
+  *alloc_cnt = new_cnt;
+  return 0;
+}
+
+static int host_is_big_endian(void)
+{
+  const uint16_t one = 1;
+  return *(const uint8_t *)&one == 0;
+}
+
+/* ========== FLATBUFFERS ========== */
+
+// reserve len (zeroed) bytes such that (position + prefix) is aligned
+static size_t fb_alloc(fb_t *fb, size_t len, size_t align, size_t prefix)
+{
+  size_t pos = ((fb->len + prefix + align - 1) & ~(align - 1)) - prefix;
+
+  if (fb->err) {
+    return 0;
+  }
+  if (grow(&fb->buf, &fb->_alloc_len, pos + len, 1) != 0) {
+    fb->err = 1;
+    return 0;
+  }
+  memset(fb->buf + fb->len, 0, pos + len - fb->len);
+  fb->len = pos + len;
+  return pos;
+}
+
+// flatbuffers are always little-endian
+static void fb_put(fb_t *fb, size_t pos, uint64_t val, int len)
+{
+  int i;
+
+  if (fb->err) {
+    return;
+  }
+  for (i = 0; i < len; i++) {
+    fb->buf[pos + i] = (val >> (i * 8)) & 0xFF;
+  }
+}
+
+// point the uoffset at pos to target (which must be after pos)
+static void fb_ref(fb_t *fb, size_t pos, size_t target)
+{
+  fb_put(fb, pos, target - pos, 4);
+}
+
+// start a table with the given number of fields, all of which are absent
+static size_t fb_table(fb_t *fb, int fields_cnt)
+{
+  size_t vt = fb_alloc(fb, 4 + 2 * fields_cnt, 2, 0);
+  size_t tbl = fb_alloc(fb, 8 + 8 * fields_cnt, 8, 0);
+
+  fb_put(fb, vt, 4 + 2 * fields_cnt, 2);
+  fb_put(fb, vt + 2, 8 + 8 * fields_cnt, 2);
+  // the vtable is at the table position minus this offset
+  fb_put(fb, tbl, tbl - vt, 4);
+  return tbl;
+}
+
+// mark a table field as present and return its position
+static size_t fb_field(fb_t *fb, size_t tbl, int id)
+{
+  size_t vt;
+
+  if (fb->err) {
+    return 0;
+  }
+  vt = tbl - (fb->buf[tbl] | (fb->buf[tbl + 1] << 8));
+  fb_put(fb, vt + 4 + 2 * id, 8 + 8 * id, 2);
+  return tbl + 8 + 8 * id;
+}
+
+static void fb_set(fb_t *fb, size_t tbl, int id, uint64_t val, int len)
+{
+  fb_put(fb, fb_field(fb, tbl, id), val, len);
+}
+
+static void fb_set_ref(fb_t *fb, size_t tbl, int id, size_t target)
+{
+  fb_ref(fb, fb_field(fb, tbl, id), target);
+}
+
+// create a vector, returning the position of its length (the elements follow)
+static size_t fb_vector(fb_t *fb, size_t cnt, size_t size, size_t align)
+{
+  size_t pos = fb_alloc(fb, 4 + cnt * size, (align < 4) ? 4 : align, 4);
+
+  fb_put(fb, pos, cnt, 4);
+  return pos;
+}
+
+static size_t fb_string(fb_t *fb, const char *str)
+{
+  size_t len = strlen(str);
+  size_t pos = fb_alloc(fb, 4 + len + 1, 4, 0);
+
+  fb_put(fb, pos, len, 4);
+  if (!fb->err) {
+    memcpy(fb->buf + pos + 4, str, len);
+  }
+  return pos;
+}
+
+/* ========== SCHEMA ========== */
+
+static size_t build_int_type(fb_t *fb, int bits, int is_signed)
+{
+  size_t tbl = fb_table(fb, 2);
+
+  fb_set(fb, tbl, 0, bits, 4);
+  fb_set(fb, tbl, 1, is_signed, 1);
+  return tbl;
+}
+
+static size_t build_field(fb_t *fb, const char *name, int type, int width,
+                          int is_signed, int nullable, int dict)
+{
+  size_t field, type_tbl, dict_tbl, children;
+
+  field = fb_table(fb, 7);
+  fb_set_ref(fb, field, 0, fb_string(fb, name));
+  fb_set(fb, field, 1, nullable, 1);
+  fb_set(fb, field, 2, type, 1);
+
+  switch (type) {
+  case TYPE_INT:
+    type_tbl = build_int_type(fb, width * 8, is_signed);
+    break;
+
+  case TYPE_TIMESTAMP:
+    type_tbl = fb_table(fb, 2);
+    fb_set(fb, type_tbl, 0, TIME_UNIT_MICROSECOND, 2);
+    break;
+
+  case TYPE_FIXED_SIZE_BINARY:
+    type_tbl = fb_table(fb, 1);
+    fb_set(fb, type_tbl, 0, width, 4);
+    break;
+
+  default:
+    // Utf8 and List have no fields
+    type_tbl = fb_table(fb, 0);
+    break;
+  }
+  fb_set_ref(fb, field, 3, type_tbl);
+
+  if (dict >= 0) {
+    // the type above is the type of the dictionary values
+    dict_tbl = fb_table(fb, 4);
+    fb_set(fb, dict_tbl, 0, dict, 8);
+    fb_set_ref(fb, dict_tbl, 1, build_int_type(fb, width * 8, is_signed));
+    fb_set_ref(fb, field, 4, dict_tbl);
+  }
+
+  // readers expect a children vector even if it is empty
+  children = fb_vector(fb, (type == TYPE_LIST) ? 1 : 0, 4, 4);
+  fb_set_ref(fb, field, 5, children);
+  if (type == TYPE_LIST) {
+    fb_ref(fb, children + 4, build_field(fb, "item", TYPE_INT, 4, 0, 1, -1));
+  }
+
+  return field;
+}
+
+static size_t build_schema(fb_t *fb)
+{
+  size_t schema, fields;
+  const col_spec_t *spec;
+  int i;
+
+  schema = fb_table(fb, 4);
+  // endianness of the column data (Little = 0, Big = 1)
+  fb_set(fb, schema, 0, host_is_big_endian(), 2);
+  fields = fb_vector(fb, COLS_CNT, 4, 4);
+  fb_set_ref(fb, schema, 1, fields);
+  for (i = 0; i < COLS_CNT; i++) {
+    spec = &col_specs[i];
+    fb_ref(fb, fields + 4 + 4 * i,
+           build_field(fb, spec->name, spec->type, spec->width,
+                       spec->is_signed, spec->nullable, spec->dict));
+  }
+  return schema;
+}
+
+/* ========== IPC MESSAGES ========== */
+
+static void write_bytes(parsebgp_elem_arrow_t *arrow, const void *buf,
+                        size_t len)
+{
+  static const uint8_t zeros[8] = {0};
+
+  if (len == 0) {
+    return;
+  }
+  if (fwrite((buf != NULL) ? buf : zeros, 1, len, arrow->fp) != len) {
+    arrow->err = 1;
+  }
+  arrow->offset += len;
+}
+
+static void write_padding(parsebgp_elem_arrow_t *arrow)
+{
+  static const uint8_t zeros[8] = {0};
+
+  write_bytes(arrow, zeros, ALIGN8(arrow->offset) - arrow->offset);
+}
+
+static void write_u32(parsebgp_elem_arrow_t *arrow, uint32_t val)
+{
+  uint8_t buf[4];
+  int i;
+
+  for (i = 0; i < 4; i++) {
+    buf[i] = (val >> (i * 8)) & 0xFF;
+  }
+  write_bytes(arrow, buf, sizeof(buf));
+}
+
+static void body_reset(parsebgp_elem_arrow_t *arrow)
+{
+  arrow->bufs_cnt = 0;
+  arrow->nodes_cnt = 0;
+}
+
+static void body_add_node(parsebgp_elem_arrow_t *arrow, uint64_t len,
+                          uint64_t null_cnt)
+{
+  arrow->nodes[arrow->nodes_cnt].len = len;
+  arrow->nodes[arrow->nodes_cnt].null_cnt = null_cnt;
+  arrow->nodes_cnt++;
+}
+
+static void body_add_buf(parsebgp_elem_arrow_t *arrow, const void *ptr,
+                         size_t len)
+{
+  arrow->bufs[arrow->bufs_cnt].ptr = ptr;
+  arrow->bufs[arrow->bufs_cnt].len = len;
+  arrow->bufs_cnt++;
+}
+
+static size_t build_record_batch(parsebgp_elem_arrow_t *arrow, uint64_t rows)
+{
+  fb_t *fb = &arrow->fb;
+  size_t rb, nodes, bufs, pos;
+  uint64_t offset = 0;
+  int i;
+
+  rb = fb_table(fb, 5);
+  fb_set(fb, rb, 0, rows, 8);
+
+  nodes = fb_vector(fb, arrow->nodes_cnt, 16, 8);
+  fb_set_ref(fb, rb, 1, nodes);
+  for (i = 0; i < arrow->nodes_cnt; i++) {
+    pos = nodes + 4 + 16 * i;
+    fb_put(fb, pos, arrow->nodes[i].len, 8);
+    fb_put(fb, pos + 8, arrow->nodes[i].null_cnt, 8);
+  }
+
+  bufs = fb_vector(fb, arrow->bufs_cnt, 16, 8);
+  fb_set_ref(fb, rb, 2, bufs);
+  for (i = 0; i < arrow->bufs_cnt; i++) {
+    pos = bufs + 4 + 16 * i;
+    fb_put(fb, pos, offset, 8);
+    fb_put(fb, pos + 8, arrow->bufs[i].len, 8);
+    offset += ALIGN8(arrow->bufs[i].len);
+  }
+
+  return rb;
+}
+
+// write an encapsulated message with the current body
+static int write_message(parsebgp_elem_arrow_t *arrow, int msg_type,
+                         uint64_t rows, int dict, int is_delta,
+                         blocks_t *blocks)
+{
+  fb_t *fb = &arrow->fb;
+  size_t root, msg, hdr, meta_len;
+  uint64_t body_len = 0;
+  block_t *block;
+  int i;
+
+  for (i = 0; i < arrow->bufs_cnt; i++) {
+    body_len += ALIGN8(arrow->bufs[i].len);
+  }
+
+  fb->len = 0;
+  root = fb_alloc(fb, 4, 4, 0);
+  msg = fb_table(fb, 5);
+  fb_ref(fb, root, msg);
+  fb_set(fb, msg, 0, METADATA_VERSION, 2);
+  fb_set(fb, msg, 1, msg_type, 1);
+  fb_set(fb, msg, 3, body_len, 8);
+
+  switch (msg_type) {
+  case MSG_SCHEMA:
+    hdr = build_schema(fb);
+    break;
+
+  case MSG_DICTIONARY_BATCH:
+    hdr = fb_table(fb, 3);
+    fb_set(fb, hdr, 0, dict, 8);
+    fb_set_ref(fb, hdr, 1, build_record_batch(arrow, rows));
+    fb_set(fb, hdr, 2, is_delta, 1);
+    break;
+
+  default:
+    hdr = build_record_batch(arrow, rows);
+    break;
+  }
+  fb_set_ref(fb, msg, 2, hdr);
+
+  if (fb->err) {
+    return -1;
+  }
+  meta_len = ALIGN8(fb->len);
+
+  if (blocks != NULL) {
+    if (grow(&blocks->blocks, &blocks->_blocks_alloc_cnt,
+             blocks->blocks_cnt + 1, sizeof(block_t)) != 0) {
+      return -1;
+    }
+    block = &blocks->blocks[blocks->blocks_cnt++];
+    block->offset = arrow->offset;
+    block->meta_len = 8 + meta_len;
+    block->body_len = body_len;
+  }
+
+  // continuation marker, metadata length, metadata (padded)
+  write_u32(arrow, 0xFFFFFFFF);
+  write_u32(arrow, meta_len);
+  write_bytes(arrow, fb->buf, fb->len);
+  write_padding(arrow);
+
+  for (i = 0; i < arrow->bufs_cnt; i++) {
+    write_bytes(arrow, arrow->bufs[i].ptr, arrow->bufs[i].len);
+    write_padding(arrow);
+  }
+
+  return arrow->err ? -1 : 0;
+}
+
+static int write_footer(parsebgp_elem_arrow_t *arrow)
+{
+  fb_t *fb = &arrow->fb;
+  blocks_t *lists[2] = {&arrow->dict_blocks, &arrow->batch_blocks};
+  size_t root, footer, vec, pos, i;
+  block_t *block;
+  int j;
+
+  fb->len = 0;
+  root = fb_alloc(fb, 4, 4, 0);
+  footer = fb_table(fb, 5);
+  fb_ref(fb, root, footer);
+  fb_set(fb, footer, 0, METADATA_VERSION, 2);
+  fb_set_ref(fb, footer, 1, build_schema(fb));
+  for (j = 0; j < 2; j++) {
+    vec = fb_vector(fb, lists[j]->blocks_cnt, 24, 8);
+    fb_set_ref(fb, footer, 2 + j, vec);
+    for (i = 0; i < lists[j]->blocks_cnt; i++) {
+      block = &lists[j]->blocks[i];
+      pos = vec + 4 + 24 * i;
+      fb_put(fb, pos, block->offset, 8);
+      fb_put(fb, pos + 8, block->meta_len, 4);
+      fb_put(fb, pos + 16, block->body_len, 8);
+    }
+  }
+  if (fb->err) {
+    return -1;
+  }
+  fb->len = ALIGN8(fb->len);
+
+  // end-of-stream marker, footer, footer length, magic
+  write_u32(arrow, 0xFFFFFFFF);
+  write_u32(arrow, 0);
+  write_bytes(arrow, fb->buf, fb->len);
+  write_u32(arrow, fb->len);
+  write_bytes(arrow, "ARROW1", 6);
+
+  return arrow->err ? -1 : 0;
+}
+
+/* ========== DICTIONARIES ========== */
+
+static uint32_t hash_vals(const uint32_t *vals, size_t cnt)
+{
+  uint64_t hash = 0xCBF29CE484222325ULL ^ cnt;
+  size_t i;
+
+  for (i = 0; i < cnt; i++) {
+    hash = (hash ^ vals[i]) * 0x100000001B3ULL;
+  }
+  return hash ^ (hash >> 32);
+}
+
+static int dict_rehash(dict_t *dict)
+{
+  uint32_t slots_cnt = (dict->slots_cnt > 0) ? dict->slots_cnt * 2 : 1024;
+  uint32_t *slots, mask = slots_cnt - 1, pos;
+  int i;
+
+  if ((slots = calloc(slots_cnt, sizeof(uint32_t))) == NULL) {
+    return -1;
+  }
+  for (i = 0; i < dict->entries_cnt; i++) {
+    pos = dict->hashes[i] & mask;
+    while (slots[pos] != 0) {
+      pos = (pos + 1) & mask;
+    }
+    slots[pos] = i + 1;
+  }
+  free(dict->slots);
+  dict->slots = slots;
+  dict->slots_cnt = slots_cnt;
+  return 0;
+}
+
+// find (or add) the given list in the dictionary, returning its index
+static int dict_intern(dict_t *dict, const uint32_t *vals, size_t cnt)
+{
+  uint32_t hash = hash_vals(vals, cnt), mask, pos, idx;
+
+  // keep the table at most half full
+  if ((uint32_t)(dict->entries_cnt + 1) * 2 > dict->slots_cnt &&
+      dict_rehash(dict) != 0) {
+    return -1;
+  }
+
+  mask = dict->slots_cnt - 1;
+  for (pos = hash & mask; dict->slots[pos] != 0; pos = (pos + 1) & mask) {
+    idx = dict->slots[pos] - 1;
+    if (dict->hashes[idx] == hash &&
+        dict->offsets[idx + 1] - dict->offsets[idx] == cnt &&
+        memcmp(dict->vals + dict->offsets[idx], vals,
+               cnt * sizeof(uint32_t)) == 0) {
+      return idx;
+    }
+  }
+
+  if (grow(&dict->vals, &dict->_vals_alloc_cnt, dict->vals_cnt + cnt,
+           sizeof(uint32_t)) != 0 ||
+      grow(&dict->offsets, &dict->_offsets_alloc_cnt, dict->entries_cnt + 2,
+           sizeof(uint32_t)) != 0 ||
+      grow(&dict->hashes, &dict->_hashes_alloc_cnt, dict->entries_cnt + 1,
+           sizeof(uint32_t)) != 0) {
+    return -1;
+  }
+  if (cnt > 0) {
+    memcpy(dict->vals + dict->vals_cnt, vals, cnt * sizeof(uint32_t));
+  }
+  dict->vals_cnt += cnt;
+  idx = dict->entries_cnt++;
+  dict->offsets[idx] = dict->vals_cnt - cnt;
+  dict->offsets[idx + 1] = dict->vals_cnt;
+  dict->hashes[idx] = hash;
+  dict->slots[pos] = idx + 1;
+  return idx;
+}
+
+static int write_type_dict(parsebgp_elem_arrow_t *arrow)
+{
+  body_reset(arrow);
+  body_add_node(arrow, TYPE_DICT_CNT, 0);
+  // no validity bitmap is needed since there are no nulls
+  body_add_buf(arrow, NULL, 0);
+  body_add_buf(arrow, type_dict_offsets, sizeof(type_dict_offsets));
+  body_add_buf(arrow, type_dict_data, sizeof(type_dict_data) - 1);
+  return write_message(arrow, MSG_DICTIONARY_BATCH, TYPE_DICT_CNT, DICT_TYPE,
+                       0, &arrow->dict_blocks);
+}
+
+// write the entries added to the dictionary since it was last written
+static int write_dict(parsebgp_elem_arrow_t *arrow, int id)
+{
+  dict_t *dict = &arrow->dicts[id];
+  size_t cnt = dict->entries_cnt - dict->written_cnt;
+  uint32_t first = (cnt > 0) ? dict->offsets[dict->written_cnt] : 0;
+  size_t i;
+
+  // the offsets of a delta start from zero
+  if (grow(&arrow->scratch, &arrow->_scratch_alloc_cnt, cnt + 1,
+           sizeof(uint32_t)) != 0) {
+    return -1;
+  }
+  arrow->scratch[0] = 0;
+  for (i = 0; i < cnt; i++) {
+    arrow->scratch[i + 1] = dict->offsets[dict->written_cnt + i + 1] - first;
+  }
+
+  body_reset(arrow);
+  body_add_node(arrow, cnt, 0);
+  body_add_node(arrow, arrow->scratch[cnt], 0);
+  body_add_buf(arrow, NULL, 0);
+  body_add_buf(arrow, arrow->scratch, (cnt + 1) * sizeof(uint32_t));
+  body_add_buf(arrow, NULL, 0);
+  body_add_buf(arrow, dict->vals + first,
+               arrow->scratch[cnt] * sizeof(uint32_t));
+  if (write_message(arrow, MSG_DICTIONARY_BATCH, cnt, id, dict->written,
+                    &arrow->dict_blocks) != 0) {
+    return -1;
+  }
+
+  dict->written = 1;
+  dict->written_cnt = dict->entries_cnt;
+  return 0;
+}
+
+/* ========== RECORD BATCHES ========== */
+
+static int write_batch(parsebgp_elem_arrow_t *arrow)
+{
+  const col_spec_t *spec;
+  column_t *col;
+  int i;
+
+  if (arrow->rows == 0) {
+    return 0;
+  }
+
+  // every dictionary must be written before the first batch that uses it
+  if (!arrow->dicts[DICT_TYPE].written) {
+    if (write_type_dict(arrow) != 0) {
+      return -1;
+    }
+    arrow->dicts[DICT_TYPE].written = 1;
+  }
+  for (i = DICT_TYPE + 1; i < DICTS_CNT; i++) {
+    if ((!arrow->dicts[i].written ||
+         arrow->dicts[i].written_cnt < arrow->dicts[i].entries_cnt) &&
+        write_dict(arrow, i) != 0) {
+      return -1;
+    }
+  }
+
+  body_reset(arrow);
+  for (i = 0; i < COLS_CNT; i++) {
+    spec = &col_specs[i];
+    col = &arrow->cols[i];
+    body_add_node(arrow, arrow->rows, col->null_cnt);
+    body_add_buf(arrow, col->validity, (arrow->rows + 7) / 8);
+    body_add_buf(arrow, col->values, (size_t)arrow->rows * spec->width);
+  }
+  if (write_message(arrow, MSG_RECORD_BATCH, arrow->rows, -1, 0,
+                    &arrow->batch_blocks) != 0) {
+    return -1;
+  }
+
+  for (i = 0; i < COLS_CNT; i++) {
+    col = &arrow->cols[i];
+    memset(col->validity, 0, (arrow->rows + 7) / 8);
+    col->null_cnt = 0;
+  }
+  arrow->rows = 0;
+  return 0;
+}
+
+static void set_value(parsebgp_elem_arrow_t *arrow, int idx, const void *val)
+{
+  column_t *col = &arrow->cols[idx];
+  int row = arrow->rows, width = col_specs[idx].width;
+
+  memcpy(col->values + (size_t)row * width, val, width);
+  col->validity[row / 8] |= 1 << (row % 8);
+}
+
+static void set_null(parsebgp_elem_arrow_t *arrow, int idx)
+{
+  column_t *col = &arrow->cols[idx];
+  int width = col_specs[idx].width;
+
+  memset(col->values + (size_t)arrow->rows * width, 0, width);
+  col->null_cnt++;
+}
+
+static void set_u8(parsebgp_elem_arrow_t *arrow, int idx, uint8_t val)
+{
+  set_value(arrow, idx, &val);
+}
+
+static void set_u16(parsebgp_elem_arrow_t *arrow, int idx, uint16_t val)
+{
+  set_value(arrow, idx, &val);
+}
+
+static void set_u32(parsebgp_elem_arrow_t *arrow, int idx, uint32_t val)
+{
+  set_value(arrow, idx, &val);
+}
+
+static void set_u64(parsebgp_elem_arrow_t *arrow, int idx, uint64_t val)
+{
+  set_value(arrow, idx, &val);
+}
+
+// store an address as 16 bytes, using IPv4-mapped addresses for IPv4
+static void set_addr(parsebgp_elem_arrow_t *arrow, int idx,
+                     parsebgp_bgp_afi_t afi, const uint8_t *addr)
+{
+  uint8_t buf[16];
+
+  if (afi == PARSEBGP_BGP_AFI_IPV4) {
+    memset(buf, 0, 10);
+    buf[10] = buf[11] = 0xFF;
+    memcpy(buf + 12, addr, 4);
+    set_value(arrow, idx, buf);
+  } else {
+    set_value(arrow, idx, addr);
+  }
+}
+
+// set a dictionary-encoded column to the given list
+static int set_list(parsebgp_elem_arrow_t *arrow, int idx, const uint32_t *vals,
+                    size_t cnt)
+{
+  int32_t dict_idx;
+
+  if ((dict_idx = dict_intern(&arrow->dicts[col_specs[idx].dict], vals,
+                              cnt)) < 0) {
+    return -1;
+  }
+  set_value(arrow, idx, &dict_idx);
+  return 0;
+}
+
+static int scratch_push(parsebgp_elem_arrow_t *arrow, uint32_t val)
+{
+  if (grow(&arrow->scratch, &arrow->_scratch_alloc_cnt, arrow->scratch_cnt + 1,
+           sizeof(uint32_t)) != 0) {
+    return -1;
+  }
+  arrow->scratch[arrow->scratch_cnt++] = val;
+  return 0;
+}
+
+// append the ASNs of the path to the scratch space, stopping after limit hops
+// if limit is not negative
+static int flatten_as_path(parsebgp_elem_arrow_t *arrow,
+                           const parsebgp_bgp_update_as_path_t *path,
+                           int limit)
+{
+  const parsebgp_bgp_update_as_path_seg_t *seg;
+  const uint32_t *asns;
+  int i, j;
+
+  for (i = 0; i < path->segs_cnt && limit != 0; i++) {
+    seg = &path->segs[i];
+    if (seg->type != PARSEBGP_BGP_UPDATE_AS_PATH_SEG_AS_SEQ &&
+        seg->type != PARSEBGP_BGP_UPDATE_AS_PATH_SEG_AS_SET) {
+      continue;
+    }
+    asns = PARSEBGP_BGP_UPDATE_AS_PATH_SEG_ASNS(path, seg);
+    for (j = 0; j < seg->asns_cnt; j++) {
+      if (scratch_push(arrow, asns[j]) != 0) {
+        return -1;
+      }
+      // each ASN of a sequence is a hop, but a set is a single hop
+      if (seg->type == PARSEBGP_BGP_UPDATE_AS_PATH_SEG_AS_SEQ && limit > 0 &&
+          --limit == 0) {
+        break;
+      }
+    }
+    if (seg->type == PARSEBGP_BGP_UPDATE_AS_PATH_SEG_AS_SET && limit > 0) {
+      limit--;
+    }
+  }
+  return 0;
+}
+
+static int set_path_attrs(parsebgp_elem_arrow_t *arrow,
+                          const parsebgp_elem_t *elem)
+{
+  const parsebgp_bgp_update_path_attrs_t *attrs = elem->path_attrs;
+  const parsebgp_bgp_update_as_path_t *as_path, *as4_path;
+  const parsebgp_bgp_update_communities_t *comms;
+  const parsebgp_bgp_update_large_communities_t *lcomms;
+  int i, hops;
+
+  parsebgp_elem_get_as_path(elem, &as_path, &hops, &as4_path);
+  if (as_path != NULL) {
+    arrow->scratch_cnt = 0;
+    if (flatten_as_path(arrow, as_path, hops) != 0 ||
+        (as4_path != NULL && flatten_as_path(arrow, as4_path, -1) != 0) ||
+        set_list(arrow, COL_AS_PATH, arrow->scratch, arrow->scratch_cnt) != 0) {
+      return -1;
+    }
+  } else {
+    set_null(arrow, COL_AS_PATH);
+  }
+
+  if (PARSEBGP_HAS_ATTR(attrs, ORIGIN)) {
+    set_u8(arrow, COL_ORIGIN, PARSEBGP_ATTR(attrs, ORIGIN).origin);
+  } else {
+    set_null(arrow, COL_ORIGIN);
+  }
+  if (PARSEBGP_HAS_ATTR(attrs, LOCAL_PREF)) {
+    set_u32(arrow, COL_LOCAL_PREF, PARSEBGP_ATTR(attrs, LOCAL_PREF).local_pref);
+  } else {
+    set_null(arrow, COL_LOCAL_PREF);
+  }
+  if (PARSEBGP_HAS_ATTR(attrs, MED)) {
+    set_u32(arrow, COL_MED, PARSEBGP_ATTR(attrs, MED).med);
+  } else {
+    set_null(arrow, COL_MED);
+  }
+
+  if (PARSEBGP_HAS_ATTR(attrs, COMMUNITIES)) {
+    comms = PARSEBGP_ATTR(attrs, COMMUNITIES).communities;
+    if (set_list(arrow, COL_COMMUNITIES, comms->communities,
+                 comms->communities_cnt) != 0) {
+      return -1;
+    }
+  } else {
+    set_null(arrow, COL_COMMUNITIES);
+  }
+
+  if (PARSEBGP_HAS_ATTR(attrs, LARGE_COMMUNITIES)) {
+    lcomms = PARSEBGP_ATTR(attrs, LARGE_COMMUNITIES).large_communities;
+    arrow->scratch_cnt = 0;
+    for (i = 0; i < lcomms->communities_cnt; i++) {
+      if (scratch_push(arrow, lcomms->communities[i].global_admin) != 0 ||
+          scratch_push(arrow, lcomms->communities[i].local_1) != 0 ||
+          scratch_push(arrow, lcomms->communities[i].local_2) != 0) {
+        return -1;
+      }
+    }
+    if (set_list(arrow, COL_LARGE_COMMUNITIES, arrow->scratch,
+                 arrow->scratch_cnt) != 0) {
+      return -1;
+    }
+  } else {
+    set_null(arrow, COL_LARGE_COMMUNITIES);
+  }
+
+  return 0;
+}
+
+/* ========== PUBLIC API ========== */
+
+parsebgp_elem_arrow_t *parsebgp_elem_arrow_create(FILE *fp, int batch_rows)
+{
+  parsebgp_elem_arrow_t *arrow;
+  int i;
+
+  if ((arrow = malloc_zero(sizeof(parsebgp_elem_arrow_t))) == NULL) {
+    return NULL;
+  }
+  arrow->fp = fp;
+  arrow->batch_rows = (batch_rows > 0) ? batch_rows : BATCH_ROWS_DEFAULT;
+
+  for (i = 0; i < COLS_CNT; i++) {
+    if ((arrow->cols[i].validity = calloc(ALIGN8(arrow->batch_rows) / 8, 1)) ==
+          NULL ||
+        (arrow->cols[i].values =
+           malloc((size_t)arrow->batch_rows * col_specs[i].width)) == NULL) {
+      goto err;
+    }
+  }
+
+  // magic (padded), then the schema
+  write_bytes(arrow, "ARROW1\0\0", 8);
+  body_reset(arrow);
+  if (write_message(arrow, MSG_SCHEMA, 0, -1, 0, NULL) != 0) {
+    goto err;
+  }
+
+  return arrow;
+
+err:
+  parsebgp_elem_arrow_destroy(arrow);
+  return NULL;
+}
+
+int parsebgp_elem_arrow_add(parsebgp_elem_arrow_t *arrow,
+                            const parsebgp_elem_t *elem)
+{
+  int32_t type_idx = elem->type - 1;
+
+  set_value(arrow, COL_TYPE, &type_idx);
+  set_u64(arrow, COL_TIMESTAMP,
+          (uint64_t)elem->timestamp_sec * 1000000 + elem->timestamp_usec);
+  if (elem->peer_afi != 0) {
+    set_addr(arrow, COL_PEER_IP, elem->peer_afi, elem->peer_ip);
+  } else {
+    set_null(arrow, COL_PEER_IP);
+  }
+  set_u32(arrow, COL_PEER_ASN, elem->peer_asn);
+
+  if (elem->type != PARSEBGP_ELEM_TYPE_PEER_STATE) {
+    set_addr(arrow, COL_PREFIX, elem->prefix.afi, elem->prefix.addr);
+    set_u8(arrow, COL_PREFIX_LEN, elem->prefix.len);
+    set_null(arrow, COL_OLD_STATE);
+    set_null(arrow, COL_NEW_STATE);
+  } else {
+    set_null(arrow, COL_PREFIX);
+    set_null(arrow, COL_PREFIX_LEN);
+    set_u16(arrow, COL_OLD_STATE, elem->old_state);
+    set_u16(arrow, COL_NEW_STATE, elem->new_state);
+  }
+
+  if (elem->next_hop_afi != 0) {
+    set_addr(arrow, COL_NEXT_HOP, elem->next_hop_afi, elem->next_hop);
+  } else {
+    set_null(arrow, COL_NEXT_HOP);
+  }
+
+  if (elem->path_attrs != NULL) {
+    if (set_path_attrs(arrow, elem) != 0) {
+      return -1;
+    }
+  } else {
+    set_null(arrow, COL_AS_PATH);
+    set_null(arrow, COL_ORIGIN);
+    set_null(arrow, COL_LOCAL_PREF);
+    set_null(arrow, COL_MED);
+    set_null(arrow, COL_COMMUNITIES);
+    set_null(arrow, COL_LARGE_COMMUNITIES);
+  }
+
+  if (++arrow->rows == arrow->batch_rows) {
+    return write_batch(arrow);
+  }
+  return 0;
+}
+
+int parsebgp_elem_arrow_close(parsebgp_elem_arrow_t *arrow)
+{
+  if (write_batch(arrow) != 0 || write_footer(arrow) != 0 ||
+      fflush(arrow->fp) != 0) {
+    return -1;
+  }
+  return 0;
+}
+
+void parsebgp_elem_arrow_destroy(parsebgp_elem_arrow_t *arrow)
+{
+  int i;
+
+  if (arrow == NULL) {
+    return;
+  }
+
+  for (i = 0; i < COLS_CNT; i++) {
+    free(arrow->cols[i].validity);
+    free(arrow->cols[i].values);
+  }
+  for (i = 0; i < DICTS_CNT; i++) {
+    free(arrow->dicts[i].vals);
+    free(arrow->dicts[i].offsets);
+    free(arrow->dicts[i].hashes);
+    free(arrow->dicts[i].slots);
+  }
+  free(arrow->dict_blocks.blocks);
+  free(arrow->batch_blocks.blocks);
+  free(arrow->fb.buf);
+  free(arrow->scratch);
+  free(arrow);
+}
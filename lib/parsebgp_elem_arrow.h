@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) 2017 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __PARSEBGP_ELEM_ARROW_H
+#define __PARSEBGP_ELEM_ARROW_H
+
+#include "parsebgp_elem.h"
+#include <stdio.h>
+
+/**
+ * Apache Arrow IPC File Writer
+ *
+ * Writes elems as Arrow record batches to an Arrow IPC file (as readable by
+ * pyarrow.ipc.open_file, for example). The writer is self-contained: the
+ * Flatbuffers metadata is encoded directly, and column buffers are filled
+ * straight from the decoded structures without going through text. Since
+ * Parquet writers do not generally support dictionaries of lists, those
+ * columns need to be decoded (e.g., using take) before conversion to Parquet.
+ *
+ * Columns (all addresses are 16-byte binary values, with IPv4 addresses stored
+ * as IPv4-mapped IPv6 addresses):
+ *  - type:              dictionary<int32, utf8> ("rib", "announce", ...)
+ *  - timestamp:         timestamp[us]
+ *  - peer_ip:           fixed_size_binary[16] (null if the peer is unknown)
+ *  - peer_asn:          uint32
+ *  - prefix:            fixed_size_binary[16] (null for peer state elems)
+ *  - prefix_len:        uint8 (null for peer state elems)
+ *  - next_hop:          fixed_size_binary[16] (null if there is no next hop)
+ *  - as_path:           dictionary<int32, list<uint32>>
+ *  - origin:            uint8
+ *  - local_pref:        uint32
+ *  - med:               uint32
+ *  - communities:       dictionary<int32, list<uint32>>
+ *  - large_communities: dictionary<int32, list<uint32>> (3 values each)
+ *  - old_state:         uint16 (peer state elems only)
+ *  - new_state:         uint16 (peer state elems only)
+ *
+ * The AS path is reconstructed from AS_PATH and AS4_PATH, with the members of
+ * AS_SETs flattened into the list and confederation segments omitted. Columns
+ * derived from path attributes are null if the attribute is missing.
+ *
+ * AS paths and communities are dictionary-encoded. Their dictionaries grow for
+ * the life of the writer, and only the entries added since the previous batch
+ * are written (as delta dictionary batches) before each record batch.
+ */
+typedef struct parsebgp_elem_arrow parsebgp_elem_arrow_t;
+
+/**
+ * Create an Arrow IPC file writer
+ *
+ * @param fp            Stream to write the file to (it is not closed by the
+ *                      writer, and need not be seekable)
+ * @param batch_rows    Number of rows per record batch (or 0 for the default)
+ * @return pointer to a new writer, or NULL if an error occurred
+ *
+ * The file header and schema are written immediately.
+ */
+parsebgp_elem_arrow_t *parsebgp_elem_arrow_create(FILE *fp, int batch_rows);
+
+/**
+ * Add a row for the given elem
+ *
+ * @param arrow         Pointer to the writer
+ * @param elem          Pointer to the elem to add
+ * @return 0 if successful, -1 if an error occurred
+ *
+ * A record batch is written whenever batch_rows rows have been added.
+ */
+int parsebgp_elem_arrow_add(parsebgp_elem_arrow_t *arrow,
+                            const parsebgp_elem_t *elem);
+
+/**
+ * Write any pending rows and the file footer
+ *
+ * @param arrow         Pointer to the writer
+ * @return 0 if successful, -1 if an error occurred
+ *
+ * The file is incomplete (and unreadable) until this has been called. No more
+ * rows may be added afterwards.
+ */
+int parsebgp_elem_arrow_close(parsebgp_elem_arrow_t *arrow);
+
+/**
+ * Destroy the given writer
+ *
+ * @param arrow         Pointer to the writer to destroy
+ *
+ * This does not write the file footer (see parsebgp_elem_arrow_close).
+ */
+void parsebgp_elem_arrow_destroy(parsebgp_elem_arrow_t *arrow);
+
+#endif /* __PARSEBGP_ELEM_ARROW_H */
@@ -0,0 +1,580 @@
+/*
+ * Copyright (C) 2017 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "parsebgp_elem_dedup.h"
+#include "parsebgp_rib.h"
+#include "parsebgp_utils.h"
+#include <stdlib.h>
+#include <string.h>
+
+/** State hashes (announcements hash to anything else) */
+#define STATE_UNKNOWN 0
+#define STATE_WITHDRAWN 1
+
+/** Initial number of hash buckets (a power of two) */
+#define BUCKETS_CNT 1024
+
+/** (peer, prefix) key (hashed and compared as raw bytes) */
+typedef struct key {
+
+  uint8_t peer_ip[16];
+  uint8_t addr[16];
+  uint32_t peer_asn;
+  uint8_t peer_afi;
+  uint8_t afi;
+  uint8_t safi;
+  uint8_t len;
+
+} dedup_key_t;
+
+/** Change held for the length of the window (or passed on directly) */
+typedef struct held {
+
+  /** What will be passed on */
+  parsebgp_elem_dedup_elem_t out;
+
+  /** Copy of the most recent elem (without path attributes) */
+  parsebgp_elem_t elem;
+
+  /** Path Attributes Length (2 bytes) followed by a copy of the raw path
+      attributes */
+  uint8_t *buf;
+  size_t _buf_alloc_len;
+
+  /** Are the AS numbers in the raw path attributes 4 bytes wide */
+  uint8_t asn_4_byte;
+
+  /** State hash */
+  uint64_t hash;
+
+  /** Time at which the window closes */
+  uint32_t deadline;
+
+  /** Index of the entry */
+  uint32_t entry;
+
+  /** Is this the elem passed on directly (whose path attributes, if any, are
+      borrowed from the added elem) */
+  int direct;
+
+  /** Next change in the window queue, ready list, or free list */
+  struct held *next;
+
+} held_t;
+
+/** State of a (peer, prefix) */
+typedef struct entry {
+
+  /** Key */
+  dedup_key_t key;
+
+  /** Hash of the key */
+  uint64_t key_hash;
+
+  /** Hash of the state that was last passed on */
+  uint64_t hash;
+
+  /** Number of suppressed elems that have not been passed on yet */
+  uint32_t carried;
+
+  /** Timestamp of the first of these */
+  uint32_t carried_first_sec;
+
+  /** Change held for the window (if any) */
+  held_t *held;
+
+  /** Index + 1 of the next entry in the bucket (or the free list) */
+  uint32_t next;
+
+  /** Is the entry in use */
+  int used;
+
+} entry_t;
+
+/** List of held changes */
+typedef struct held_list {
+
+  held_t *head;
+  held_t *tail;
+
+} held_list_t;
+
+struct parsebgp_elem_dedup {
+
+  /** Aggregation window (seconds) */
+  uint32_t window;
+
+  /** Entries */
+  entry_t *entries;
+  uint32_t entries_cnt;
+  uint32_t _entries_alloc_cnt;
+
+  /** Index + 1 of the first free entry */
+  uint32_t free_entries;
+
+  /** Hash buckets (index + 1 of the first entry) */
+  uint32_t *buckets;
+  uint32_t buckets_cnt;
+
+  /** Number of entries in use */
+  uint32_t used_cnt;
+
+  /** Changes held for the window (in deadline order) */
+  held_list_t queue;
+
+  /** Changes ready to be passed on */
+  held_list_t ready;
+
+  /** Unused changes (kept for their buffers) */
+  held_t *free_held;
+
+  /** Change being passed on directly */
+  held_t direct;
+
+  /** Change most recently returned by next (recycled by the next call) */
+  held_t *cur;
+
+  /** Path attributes decoded for the current change */
+  parsebgp_bgp_update_path_attrs_t path_attrs;
+};
+
+static void list_push(held_list_t *list, held_t *held)
+{
+  held->next = NULL;
+  if (list->tail != NULL) {
+    list->tail->next = held;
+  } else {
+    list->head = held;
+  }
+  list->tail = held;
+}
+
+static held_t *list_pop(held_list_t *list)
+{
+  held_t *held = list->head;
+
+  if (held != NULL && (list->head = held->next) == NULL) {
+    list->tail = NULL;
+  }
+  return held;
+}
+
+static void held_free(parsebgp_elem_dedup_t *dedup, held_t *held)
+{
+  if (held->direct) {
+    return;
+  }
+  held->next = dedup->free_held;
+  dedup->free_held = held;
+}
+
+static void make_key(const parsebgp_elem_t *elem, dedup_key_t *key)
+{
+  memset(key, 0, sizeof(*key));
+  memcpy(key->peer_ip, elem->peer_ip, sizeof(key->peer_ip));
+  memcpy(key->addr, elem->prefix.addr, sizeof(key->addr));
+  key->peer_asn = elem->peer_asn;
+  key->peer_afi = elem->peer_afi;
+  key->afi = elem->prefix.afi;
+  key->safi = elem->prefix.safi;
+  key->len = elem->prefix.len;
+}
+
+static int rehash(parsebgp_elem_dedup_t *dedup, uint32_t buckets_cnt)
+{
+  uint32_t *buckets, i, b;
+  entry_t *entry;
+
+  if ((buckets = calloc(buckets_cnt, sizeof(uint32_t))) == NULL) {
+    return -1;
+  }
+  for (i = 0; i < dedup->entries_cnt; i++) {
+    entry = &dedup->entries[i];
+    if (!entry->used) {
+      continue;
+    }
+    b = entry->key_hash & (buckets_cnt - 1);
+    entry->next = buckets[b];
+    buckets[b] = i + 1;
+  }
+  free(dedup->buckets);
+  dedup->buckets = buckets;
+  dedup->buckets_cnt = buckets_cnt;
+  return 0;
+}
+
+// find (or create) the entry for the given key
+static entry_t *entry_get(parsebgp_elem_dedup_t *dedup, const dedup_key_t *key)
+{
+  uint64_t key_hash = parsebgp_hash(key, sizeof(*key), 0);
+  uint32_t b = key_hash & (dedup->buckets_cnt - 1), idx, alloc_cnt;
+  entry_t *entry, *tmp;
+
+  for (idx = dedup->buckets[b]; idx != 0; idx = entry->next) {
+    entry = &dedup->entries[idx - 1];
+    if (entry->key_hash == key_hash &&
+        memcmp(&entry->key, key, sizeof(*key)) == 0) {
+      return entry;
+    }
+  }
+
+  if (dedup->free_entries != 0) {
+    idx = dedup->free_entries;
+    dedup->free_entries = dedup->entries[idx - 1].next;
+  } else {
+    if (dedup->entries_cnt == dedup->_entries_alloc_cnt) {
+      alloc_cnt = dedup->_entries_alloc_cnt ? dedup->_entries_alloc_cnt * 2
+                                            : BUCKETS_CNT;
+      if ((tmp = realloc(dedup->entries, alloc_cnt * sizeof(entry_t))) ==
+          NULL) {
+        return NULL;
+      }
+      dedup->entries = tmp;
+      dedup->_entries_alloc_cnt = alloc_cnt;
+    }
+    idx = ++dedup->entries_cnt;
+  }
+  entry = &dedup->entries[idx - 1];
+  memset(entry, 0, sizeof(*entry));
+  entry->key = *key;
+  entry->key_hash = key_hash;
+  entry->used = 1;
+  entry->next = dedup->buckets[b];
+  dedup->buckets[b] = idx;
+  dedup->used_cnt++;
+
+  if (dedup->used_cnt > dedup->buckets_cnt &&
+      rehash(dedup, dedup->buckets_cnt * 2) != 0) {
+    return NULL;
+  }
+  return &dedup->entries[idx - 1];
+}
+
+// hash the state that the elem leaves the (peer, prefix) in
+static parsebgp_error_t state_hash(const parsebgp_elem_t *elem, uint64_t *hash,
+                                   uint8_t *asn_4_byte)
+{
+  const parsebgp_bgp_update_path_attrs_t *path_attrs = elem->path_attrs;
+  const parsebgp_bgp_update_path_attr_t *as_path;
+
+  if (elem->type == PARSEBGP_ELEM_TYPE_WITHDRAW) {
+    *hash = STATE_WITHDRAWN;
+    return PARSEBGP_OK;
+  }
+  if (path_attrs == NULL || path_attrs->raw == NULL) {
+    PARSEBGP_RETURN_INVALID_MSG_ERR;
+  }
+  as_path = &path_attrs->attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_AS_PATH];
+  *asn_4_byte = PARSEBGP_BGP_UPDATE_ATTR_PRESENT(
+                  path_attrs, PARSEBGP_BGP_PATH_ATTR_TYPE_AS_PATH)
+                  ? as_path->data.as_path->asn_4_byte
+                  : 1;
+  *hash = parsebgp_hash(path_attrs->raw, path_attrs->raw_len,
+                        parsebgp_hash(elem->next_hop, sizeof(elem->next_hop),
+                                      (elem->next_hop_afi << 1) |
+                                        *asn_4_byte));
+  if (*hash <= STATE_WITHDRAWN) {
+    *hash += 2;
+  }
+  return PARSEBGP_OK;
+}
+
+// account for a suppressed elem
+static void carry(entry_t *entry, uint32_t count, uint32_t first_sec)
+{
+  if (entry->carried == 0) {
+    entry->carried_first_sec = first_sec;
+  }
+  entry->carried += count;
+}
+
+// set the count of a change that is about to be passed on (or held)
+static void start_count(entry_t *entry, held_t *held)
+{
+  held->out.count = 1 + entry->carried;
+  held->out.first_timestamp_sec =
+    entry->carried ? entry->carried_first_sec : held->elem.timestamp_sec;
+  entry->carried = 0;
+}
+
+// the window of a held change has closed
+static void finish_held(parsebgp_elem_dedup_t *dedup, held_t *held)
+{
+  entry_t *entry = &dedup->entries[held->entry];
+
+  entry->held = NULL;
+  if (held->hash == entry->hash) {
+    // back where it started
+    carry(entry, held->out.count, held->out.first_timestamp_sec);
+    held_free(dedup, held);
+    return;
+  }
+  entry->hash = held->hash;
+  list_push(&dedup->ready, held);
+}
+
+// copy the elem into the held change
+static parsebgp_error_t held_set(held_t *held, const parsebgp_elem_t *elem,
+                                 uint64_t hash, uint8_t asn_4_byte)
+{
+  const parsebgp_bgp_update_path_attrs_t *path_attrs = elem->path_attrs;
+
+  held->elem = *elem;
+  held->elem.path_attrs = NULL;
+  held->hash = hash;
+  held->asn_4_byte = asn_4_byte;
+  if (hash != STATE_WITHDRAWN) {
+    PARSEBGP_MAYBE_REALLOC(held->buf, held->_buf_alloc_len,
+                           (size_t)path_attrs->raw_len + 2);
+    held->buf[0] = path_attrs->raw_len >> 8;
+    held->buf[1] = path_attrs->raw_len & 0xFF;
+    memcpy(held->buf + 2, path_attrs->raw, path_attrs->raw_len);
+  }
+  return PARSEBGP_OK;
+}
+
+// pass on all held changes of the peer of the elem, and forget its state
+static void release_peer(parsebgp_elem_dedup_t *dedup,
+                         const parsebgp_elem_t *elem)
+{
+  held_t *held, *prev = NULL, *next;
+  entry_t *entry;
+  dedup_key_t key;
+  uint32_t i;
+
+  make_key(elem, &key);
+  for (held = dedup->queue.head; held != NULL; held = next) {
+    next = held->next;
+    entry = &dedup->entries[held->entry];
+    if (memcmp(entry->key.peer_ip, key.peer_ip, sizeof(key.peer_ip)) != 0 ||
+        entry->key.peer_asn != key.peer_asn ||
+        entry->key.peer_afi != key.peer_afi) {
+      prev = held;
+      continue;
+    }
+    if (prev != NULL) {
+      prev->next = next;
+    } else {
+      dedup->queue.head = next;
+    }
+    if (dedup->queue.tail == held) {
+      dedup->queue.tail = prev;
+    }
+    finish_held(dedup, held);
+  }
+
+  for (i = 0; i < dedup->entries_cnt; i++) {
+    entry = &dedup->entries[i];
+    if (entry->used &&
+        memcmp(entry->key.peer_ip, key.peer_ip, sizeof(key.peer_ip)) == 0 &&
+        entry->key.peer_asn == key.peer_asn &&
+        entry->key.peer_afi == key.peer_afi) {
+      entry->used = 0;
+      entry->next = dedup->free_entries;
+      dedup->free_entries = i + 1;
+      dedup->used_cnt--;
+    }
+  }
+  // rebuilding the buckets in place cannot fail (and fixes the chains)
+  memset(dedup->buckets, 0, dedup->buckets_cnt * sizeof(uint32_t));
+  for (i = 0; i < dedup->entries_cnt; i++) {
+    entry = &dedup->entries[i];
+    if (entry->used) {
+      entry->next = dedup->buckets[entry->key_hash & (dedup->buckets_cnt - 1)];
+      dedup->buckets[entry->key_hash & (dedup->buckets_cnt - 1)] = i + 1;
+    }
+  }
+}
+
+// pass on the added elem directly
+static void pass_direct(parsebgp_elem_dedup_t *dedup,
+                        const parsebgp_elem_t *elem, entry_t *entry)
+{
+  held_t *held = &dedup->direct;
+
+  held->elem = *elem;
+  held->direct = 1;
+  if (entry != NULL) {
+    start_count(entry, held);
+  } else {
+    held->out.count = 1;
+    held->out.first_timestamp_sec = elem->timestamp_sec;
+  }
+  list_push(&dedup->ready, held);
+}
+
+/* ========== PUBLIC API FUNCTIONS ========== */
+
+parsebgp_elem_dedup_t *parsebgp_elem_dedup_create(uint32_t window)
+{
+  parsebgp_elem_dedup_t *dedup;
+
+  if ((dedup = malloc_zero(sizeof(parsebgp_elem_dedup_t))) == NULL) {
+    return NULL;
+  }
+  dedup->window = window;
+  if ((dedup->buckets = calloc(BUCKETS_CNT, sizeof(uint32_t))) == NULL) {
+    free(dedup);
+    return NULL;
+  }
+  dedup->buckets_cnt = BUCKETS_CNT;
+  return dedup;
+}
+
+void parsebgp_elem_dedup_destroy(parsebgp_elem_dedup_t *dedup)
+{
+  held_t *held;
+  uint32_t i;
+
+  if (dedup == NULL) {
+    return;
+  }
+  // held changes are referenced either by an entry or by a list
+  for (i = 0; i < dedup->entries_cnt; i++) {
+    if (dedup->entries[i].used && dedup->entries[i].held != NULL) {
+      held_free(dedup, dedup->entries[i].held);
+    }
+  }
+  while ((held = list_pop(&dedup->ready)) != NULL) {
+    held_free(dedup, held);
+  }
+  if (dedup->cur != NULL) {
+    held_free(dedup, dedup->cur);
+  }
+  while ((held = dedup->free_held) != NULL) {
+    dedup->free_held = held->next;
+    free(held->buf);
+    free(held);
+  }
+  parsebgp_rib_path_attrs_destroy(&dedup->path_attrs);
+  free(dedup->entries);
+  free(dedup->buckets);
+  free(dedup);
+}
+
+parsebgp_error_t parsebgp_elem_dedup_add(parsebgp_elem_dedup_t *dedup,
+                                         const parsebgp_elem_t *elem)
+{
+  held_t *held;
+  entry_t *entry;
+  dedup_key_t key;
+  uint64_t hash;
+  uint8_t asn_4_byte = 0;
+  parsebgp_error_t err;
+
+  if (elem->type != PARSEBGP_ELEM_TYPE_ANNOUNCE &&
+      elem->type != PARSEBGP_ELEM_TYPE_WITHDRAW) {
+    if (elem->type == PARSEBGP_ELEM_TYPE_PEER_STATE) {
+      release_peer(dedup, elem);
+    }
+    pass_direct(dedup, elem, NULL);
+    return PARSEBGP_OK;
+  }
+
+  // close the windows that have ended
+  while (dedup->queue.head != NULL &&
+         dedup->queue.head->deadline <= elem->timestamp_sec) {
+    finish_held(dedup, list_pop(&dedup->queue));
+  }
+
+  if ((err = state_hash(elem, &hash, &asn_4_byte)) != PARSEBGP_OK) {
+    return err;
+  }
+  make_key(elem, &key);
+  if ((entry = entry_get(dedup, &key)) == NULL) {
+    return PARSEBGP_MALLOC_FAILURE;
+  }
+
+  if ((held = entry->held) != NULL) {
+    // a later change within the window replaces the held one
+    held->out.count++;
+    return held_set(held, elem, hash, asn_4_byte);
+  }
+  if (hash == entry->hash) {
+    carry(entry, 1, elem->timestamp_sec);
+    return PARSEBGP_OK;
+  }
+  if (dedup->window == 0) {
+    entry->hash = hash;
+    pass_direct(dedup, elem, entry);
+    return PARSEBGP_OK;
+  }
+
+  if ((held = dedup->free_held) != NULL) {
+    dedup->free_held = held->next;
+  } else if ((held = malloc_zero(sizeof(held_t))) == NULL) {
+    return PARSEBGP_MALLOC_FAILURE;
+  }
+  if ((err = held_set(held, elem, hash, asn_4_byte)) != PARSEBGP_OK) {
+    held_free(dedup, held);
+    return err;
+  }
+  start_count(entry, held);
+  held->deadline = elem->timestamp_sec + dedup->window;
+  held->entry = entry - dedup->entries;
+  entry->held = held;
+  list_push(&dedup->queue, held);
+  return PARSEBGP_OK;
+}
+
+void parsebgp_elem_dedup_flush(parsebgp_elem_dedup_t *dedup)
+{
+  held_t *held;
+
+  while ((held = list_pop(&dedup->queue)) != NULL) {
+    finish_held(dedup, held);
+  }
+}
+
+const parsebgp_elem_dedup_elem_t *
+parsebgp_elem_dedup_next(parsebgp_elem_dedup_t *dedup)
+{
+  parsebgp_rib_attrs_t attrs;
+  held_t *held;
+
+  if (dedup->cur != NULL) {
+    held_free(dedup, dedup->cur);
+    dedup->cur = NULL;
+  }
+  if ((held = list_pop(&dedup->ready)) == NULL) {
+    return NULL;
+  }
+  dedup->cur = held;
+
+  if (!held->direct && held->hash != STATE_WITHDRAWN) {
+    // decode the copy of the attributes (which is known to be valid)
+    memset(&attrs, 0, sizeof(attrs));
+    attrs.raw = held->buf + 2;
+    attrs.raw_len = nptohs(held->buf);
+    attrs.asn_4_byte = held->asn_4_byte;
+    held->elem.path_attrs =
+      (parsebgp_rib_attrs_decode(&attrs, &dedup->path_attrs) == PARSEBGP_OK)
+        ? &dedup->path_attrs
+        : NULL;
+  }
+  held->out.elem = &held->elem;
+  return &held->out;
+}
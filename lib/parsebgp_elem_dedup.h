@@ -0,0 +1,128 @@
+/*
+ * Copyright (C) 2017 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __PARSEBGP_ELEM_DEDUP_H
+#define __PARSEBGP_ELEM_DEDUP_H
+
+#include "parsebgp_elem.h"
+#include <inttypes.h>
+
+/**
+ * Update Deduplication and Burst Aggregation
+ *
+ * Filters a stream of elems, keeping, for each (peer, prefix), a hash of the
+ * state (announced path attributes and next hop, or withdrawn) that was last
+ * passed on:
+ *  - announcements with the same attributes and next hop as the previous
+ *    announcement, and withdrawals of prefixes that are already withdrawn, are
+ *    suppressed;
+ *  - with a window, the first change of a (peer, prefix) is held for the length
+ *    of the window, later changes within the window replace it, and only the
+ *    net change is passed on when the window closes (nothing at all if the
+ *    (peer, prefix) ends up back where it started).
+ *
+ * Every elem that is passed on carries the number of input elems it stands
+ * for, so no information other than the intermediate states is lost. The net
+ * route state of the output is always the same as that of the input.
+ *
+ * Attributes are hashed from their raw bytes, so messages MUST be decoded with
+ * the bgp.path_attrs_copy_raw option set. States with the same hash are
+ * assumed to be the same.
+ *
+ * Only ANNOUNCE and WITHDRAW elems are filtered. Other elems are passed on
+ * (after any held changes of the same peer for PEER_STATE elems, which also
+ * reset the state of the peer). Time is taken from the elem timestamps, which
+ * are expected to be (roughly) in order.
+ */
+typedef struct parsebgp_elem_dedup parsebgp_elem_dedup_t;
+
+/**
+ * Elem passed on by the deduplication stage
+ */
+typedef struct parsebgp_elem_dedup_elem {
+
+  /** Elem (with the timestamp of the last input elem it stands for) */
+  const parsebgp_elem_t *elem;
+
+  /** Number of input elems the elem stands for (including itself, and any
+      suppressed since the previous elem for the (peer, prefix)) */
+  uint32_t count;
+
+  /** Timestamp (seconds) of the first of the input elems */
+  uint32_t first_timestamp_sec;
+
+} parsebgp_elem_dedup_elem_t;
+
+/**
+ * Create a deduplication stage
+ *
+ * @param window        Length (in seconds) of the aggregation window, or 0 to
+ *                      only suppress exact duplicates (in which case elems are
+ *                      passed on immediately)
+ * @return pointer to a new stage, or NULL if an error occurred
+ */
+parsebgp_elem_dedup_t *parsebgp_elem_dedup_create(uint32_t window);
+
+/**
+ * Destroy the given deduplication stage
+ *
+ * @param dedup         Pointer to the stage to destroy
+ */
+void parsebgp_elem_dedup_destroy(parsebgp_elem_dedup_t *dedup);
+
+/**
+ * Add an elem to the deduplication stage
+ *
+ * @param dedup         Pointer to the stage
+ * @param elem          Pointer to the elem to add
+ * @return PARSEBGP_OK if successful, or an error code otherwise
+ *
+ * Elems that are ready to be passed on must be taken with
+ * parsebgp_elem_dedup_next before the next elem is added (elems may refer to
+ * the added elem). PARSEBGP_INVALID_MSG is returned if the path attributes of
+ * an announcement were not copied by the decoder.
+ */
+parsebgp_error_t parsebgp_elem_dedup_add(parsebgp_elem_dedup_t *dedup,
+                                         const parsebgp_elem_t *elem);
+
+/**
+ * Pass on all held changes (e.g., at the end of the stream)
+ *
+ * @param dedup         Pointer to the stage
+ */
+void parsebgp_elem_dedup_flush(parsebgp_elem_dedup_t *dedup);
+
+/**
+ * Get the next elem that is ready to be passed on
+ *
+ * @param dedup         Pointer to the stage
+ * @return borrowed pointer to the elem (valid until the next call to any
+ * function of the stage), or NULL if no more elems are ready
+ */
+const parsebgp_elem_dedup_elem_t *
+parsebgp_elem_dedup_next(parsebgp_elem_dedup_t *dedup);
+
+#endif /* __PARSEBGP_ELEM_DEDUP_H */
@@ -0,0 +1,681 @@
+/*
+ * Copyright (C) 2017 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "parsebgp_elem_fmt.h"
+#include "parsebgp_utils.h"
+#include <stdlib.h>
+#include <string.h>
+
+/** Append a string literal */
+#define PUT_STR(p, str)                                                        \
+  do {                                                                         \
+    memcpy((p), (str), sizeof(str) - 1);                                       \
+    (p) += sizeof(str) - 1;                                                    \
+  } while (0)
+
+/** Space needed for a line, excluding the variable-length attributes */
+#define LINE_FIXED_LEN 512
+
+/** Maximum length of a formatted ASN (plus a separator) */
+#define ASN_MAX_LEN 11
+
+/** Maximum length of a formatted community (plus quotes and a separator) */
+#define COMMUNITY_MAX_LEN 14
+
+/** Maximum length of a formatted large community (plus quotes and a
+    separator) */
+#define LARGE_COMMUNITY_MAX_LEN 35
+
+/** AS_TRANS (RFC6793) */
+#define AS_TRANS 23456
+
+static const char digit_pairs[201] =
+  "00010203040506070809"
+  "10111213141516171819"
+  "20212223242526272829"
+  "30313233343536373839"
+  "40414243444546474849"
+  "50515253545556575859"
+  "60616263646566676869"
+  "70717273747576777879"
+  "80818283848586878889"
+  "90919293949596979899";
+
+static const char hex_digits[] = "0123456789abcdef";
+
+
+static char *put_u32(char *p, uint32_t val)
+{
+  char tmp[10];
+  char *t = tmp + sizeof(tmp);
+  int i;
+
+  // two digits at a time, from the right
+  while (val >= 100) {
+    i = (val % 100) * 2;
+    val /= 100;
+    t -= 2;
+    t[0] = digit_pairs[i];
+    t[1] = digit_pairs[i + 1];
+  }
+  if (val >= 10) {
+    t -= 2;
+    t[0] = digit_pairs[val * 2];
+    t[1] = digit_pairs[val * 2 + 1];
+  } else {
+    *(--t) = '0' + val;
+  }
+
+  memcpy(p, t, tmp + sizeof(tmp) - t);
+  return p + (tmp + sizeof(tmp) - t);
+}
+
+static char *put_usec(char *p, uint32_t usec)
+{
+  int i;
+
+  for (i = 5; i >= 0; i--) {
+    p[i] = '0' + (usec % 10);
+    usec /= 10;
+  }
+  return p + 6;
+}
+
+static char *put_ipv4(char *p, const uint8_t *addr)
+{
+  p = put_u32(p, addr[0]);
+  *(p++) = '.';
+  p = put_u32(p, addr[1]);
+  *(p++) = '.';
+  p = put_u32(p, addr[2]);
+  *(p++) = '.';
+  return put_u32(p, addr[3]);
+}
+
+static char *put_hex16(char *p, uint16_t val)
+{
+  int shift = 12;
+
+  // no leading zeros
+  while (shift > 0 && ((val >> shift) & 0xF) == 0) {
+    shift -= 4;
+  }
+  for (; shift >= 0; shift -= 4) {
+    *(p++) = hex_digits[(val >> shift) & 0xF];
+  }
+  return p;
+}
+
+// RFC5952 text representation, identical to the output of inet_ntop
+static char *put_ipv6(char *p, const uint8_t *addr)
+{
+  uint16_t words[8];
+  int i, best = -1, best_len = 0, cur = -1, cur_len = 0;
+
+  for (i = 0; i < 8; i++) {
+    words[i] = (addr[i * 2] << 8) | addr[i * 2 + 1];
+    if (words[i] == 0) {
+      if (cur == -1) {
+        cur = i;
+        cur_len = 0;
+      }
+      cur_len++;
+      if (cur_len > best_len) {
+        best = cur;
+        best_len = cur_len;
+      }
+    } else {
+      cur = -1;
+    }
+  }
+  // a single zero word is not compressed
+  if (best_len < 2) {
+    best = -1;
+  }
+
+  for (i = 0; i < 8; i++) {
+    if (i == best) {
+      *(p++) = ':';
+      i += best_len - 1;
+      if (i == 7) {
+        *(p++) = ':';
+      }
+      continue;
+    }
+    if (i != 0) {
+      *(p++) = ':';
+    }
+    // IPv4-compatible and IPv4-mapped addresses
+    if (i == 6 && best == 0 &&
+        (best_len == 6 || (best_len == 5 && words[5] == 0xFFFF))) {
+      return put_ipv4(p, addr + 12);
+    }
+    p = put_hex16(p, words[i]);
+  }
+  return p;
+}
+
+static char *put_ip(char *p, parsebgp_bgp_afi_t afi, const uint8_t *addr)
+{
+  return (afi == PARSEBGP_BGP_AFI_IPV4) ? put_ipv4(p, addr)
+                                        : put_ipv6(p, addr);
+}
+
+static char *put_prefix(char *p, const parsebgp_bgp_prefix_t *pfx)
+{
+  p = put_ip(p, pfx->afi, pfx->addr);
+  *(p++) = '/';
+  return put_u32(p, pfx->len);
+}
+
+static char *put_origin(char *p, uint8_t origin)
+{
+  switch (origin) {
+  case PARSEBGP_BGP_UPDATE_ORIGIN_IGP:
+    PUT_STR(p, "IGP");
+    break;
+  case PARSEBGP_BGP_UPDATE_ORIGIN_EGP:
+    PUT_STR(p, "EGP");
+    break;
+  case PARSEBGP_BGP_UPDATE_ORIGIN_INCOMPLETE:
+    PUT_STR(p, "INCOMPLETE");
+    break;
+  }
+  return p;
+}
+
+static char *put_community(char *p, uint32_t comm)
+{
+  p = put_u32(p, comm >> 16);
+  *(p++) = ':';
+  return put_u32(p, comm & 0xFFFF);
+}
+
+static char *
+put_large_community(char *p, const parsebgp_bgp_update_large_community_t *lc)
+{
+  p = put_u32(p, lc->global_admin);
+  *(p++) = ':';
+  p = put_u32(p, lc->local_1);
+  *(p++) = ':';
+  return put_u32(p, lc->local_2);
+}
+
+// append the segments of the given path, stopping after limit hops (as defined
+// by RFC4271 section 9.1.2.2) if limit is not negative
+static char *put_as_path_segs(char *p, const char *start,
+                              const parsebgp_bgp_update_as_path_t *path,
+                              int limit)
+{
+  const parsebgp_bgp_update_as_path_seg_t *seg;
+  const uint32_t *asns;
+  char open, sep, close;
+  int i, j;
+
+  for (i = 0; i < path->segs_cnt && limit != 0; i++) {
+    seg = &path->segs[i];
+    asns = PARSEBGP_BGP_UPDATE_AS_PATH_SEG_ASNS(path, seg);
+    switch (seg->type) {
+    case PARSEBGP_BGP_UPDATE_AS_PATH_SEG_AS_SEQ:
+      for (j = 0; j < seg->asns_cnt && limit != 0; j++) {
+        if (p != start) {
+          *(p++) = ' ';
+        }
+        p = put_u32(p, asns[j]);
+        if (limit > 0) {
+          limit--;
+        }
+      }
+      continue;
+
+    case PARSEBGP_BGP_UPDATE_AS_PATH_SEG_AS_SET:
+      open = '{';
+      sep = ',';
+      close = '}';
+      if (limit > 0) {
+        limit--;
+      }
+      break;
+
+    case PARSEBGP_BGP_UPDATE_AS_PATH_SEG_CONFED_SEQ:
+      open = '(';
+      sep = ' ';
+      close = ')';
+      break;
+
+    case PARSEBGP_BGP_UPDATE_AS_PATH_SEG_CONFED_SET:
+      open = '[';
+      sep = ',';
+      close = ']';
+      break;
+
+    default:
+      continue;
+    }
+
+    if (p != start) {
+      *(p++) = ' ';
+    }
+    *(p++) = open;
+    for (j = 0; j < seg->asns_cnt; j++) {
+      if (j != 0) {
+        *(p++) = sep;
+      }
+      p = put_u32(p, asns[j]);
+    }
+    *(p++) = close;
+  }
+
+  return p;
+}
+
+// append the AS path, reconstructed from AS_PATH and AS4_PATH
+static char *put_as_path(char *p, const parsebgp_elem_t *elem)
+{
+  const parsebgp_bgp_update_as_path_t *as_path, *as4_path;
+  char *start = p;
+  int hops;
+
+  parsebgp_elem_get_as_path(elem, &as_path, &hops, &as4_path);
+  if (as_path != NULL) {
+    p = put_as_path_segs(p, start, as_path, hops);
+  }
+  if (as4_path != NULL) {
+    p = put_as_path_segs(p, start, as4_path, -1);
+  }
+  return p;
+}
+
+// get the aggregator, preferring AS4_AGGREGATOR if AGGREGATOR has AS_TRANS
+static const parsebgp_bgp_update_aggregator_t *
+get_aggregator(const parsebgp_bgp_update_path_attrs_t *attrs)
+{
+  if (!PARSEBGP_HAS_ATTR(attrs, AGGREGATOR)) {
+    return PARSEBGP_HAS_ATTR(attrs, AS4_AGGREGATOR)
+             ? &PARSEBGP_ATTR(attrs, AS4_AGGREGATOR).aggregator
+             : NULL;
+  }
+  if (PARSEBGP_ATTR(attrs, AGGREGATOR).aggregator.asn == AS_TRANS &&
+      PARSEBGP_HAS_ATTR(attrs, AS4_AGGREGATOR)) {
+    return &PARSEBGP_ATTR(attrs, AS4_AGGREGATOR).aggregator;
+  }
+  return &PARSEBGP_ATTR(attrs, AGGREGATOR).aggregator;
+}
+
+static size_t as_path_max_len(const parsebgp_bgp_update_path_attrs_t *attrs,
+                              parsebgp_bgp_update_path_attr_type_t type)
+{
+  const parsebgp_bgp_update_as_path_t *path;
+
+  if (!PARSEBGP_BGP_UPDATE_ATTR_PRESENT(attrs, type)) {
+    return 0;
+  }
+  path = attrs->attrs[type].data.as_path;
+  // ASNs, plus brackets and separator for each segment
+  return ((size_t)path->asns_total_cnt * ASN_MAX_LEN) + (path->segs_cnt * 3);
+}
+
+// upper bound on the length of the line for the given elem
+static size_t line_max_len(const parsebgp_elem_t *elem)
+{
+  const parsebgp_bgp_update_path_attrs_t *attrs = elem->path_attrs;
+  size_t len = LINE_FIXED_LEN;
+
+  if (attrs == NULL) {
+    return len;
+  }
+  len += as_path_max_len(attrs, PARSEBGP_BGP_PATH_ATTR_TYPE_AS_PATH);
+  len += as_path_max_len(attrs, PARSEBGP_BGP_PATH_ATTR_TYPE_AS4_PATH);
+  if (PARSEBGP_HAS_ATTR(attrs, COMMUNITIES)) {
+    len += PARSEBGP_ATTR(attrs, COMMUNITIES).communities->communities_cnt *
+           COMMUNITY_MAX_LEN;
+  }
+  if (PARSEBGP_HAS_ATTR(attrs, LARGE_COMMUNITIES)) {
+    len += PARSEBGP_ATTR(attrs, LARGE_COMMUNITIES)
+             .large_communities->communities_cnt *
+           LARGE_COMMUNITY_MAX_LEN;
+  }
+  return len;
+}
+
+static char *reserve(parsebgp_elem_fmt_buf_t *buf, size_t len)
+{
+  size_t alloc_len;
+  char *tmp;
+
+  if (buf->len + len <= buf->_alloc_len) {
+    return buf->buf + buf->len;
+  }
+  alloc_len = (buf->_alloc_len > 0) ? buf->_alloc_len : 4096;
+  while (alloc_len < buf->len + len) {
+    alloc_len *= 2;
+  }
+  if ((tmp = realloc(buf->buf, alloc_len)) == NULL) {
+    return NULL;
+  }
+  buf->buf = tmp;
+  buf->_alloc_len = alloc_len;
+  return buf->buf + buf->len;
+}
+
+// name of the source of the elem, as used by bgpdump
+static char *put_source(char *p, const parsebgp_elem_t *elem)
+{
+  switch (elem->msg_type) {
+  case PARSEBGP_MSG_TYPE_MRT:
+    switch (elem->mrt_type) {
+    case PARSEBGP_MRT_TYPE_TABLE_DUMP:
+      PUT_STR(p, "TABLE_DUMP");
+      return p;
+    case PARSEBGP_MRT_TYPE_TABLE_DUMP_V2:
+      PUT_STR(p, "TABLE_DUMP2");
+      return p;
+    case PARSEBGP_MRT_TYPE_BGP4MP:
+      PUT_STR(p, "BGP4MP");
+      return p;
+    case PARSEBGP_MRT_TYPE_BGP4MP_ET:
+      PUT_STR(p, "BGP4MP_ET");
+      return p;
+    default:
+      PUT_STR(p, "BGP");
+      return p;
+    }
+
+  case PARSEBGP_MSG_TYPE_BMP:
+    PUT_STR(p, "BMP");
+    return p;
+
+  default:
+    PUT_STR(p, "BGP");
+    return p;
+  }
+}
+
+static char *put_bgpdump(char *p, const parsebgp_elem_t *elem)
+{
+  const parsebgp_bgp_update_path_attrs_t *attrs = elem->path_attrs;
+  const parsebgp_bgp_update_communities_t *comms;
+  const parsebgp_bgp_update_large_communities_t *lcomms;
+  const parsebgp_bgp_update_aggregator_t *aggregator;
+  char *start;
+  int i;
+
+  p = put_source(p, elem);
+  *(p++) = '|';
+  p = put_u32(p, elem->timestamp_sec);
+  if (elem->msg_type == PARSEBGP_MSG_TYPE_MRT &&
+      elem->mrt_type == PARSEBGP_MRT_TYPE_BGP4MP_ET) {
+    *(p++) = '.';
+    p = put_usec(p, elem->timestamp_usec);
+  }
+
+  switch (elem->type) {
+  case PARSEBGP_ELEM_TYPE_RIB:
+    PUT_STR(p, "|B|");
+    break;
+  case PARSEBGP_ELEM_TYPE_ANNOUNCE:
+    PUT_STR(p, "|A|");
+    break;
+  case PARSEBGP_ELEM_TYPE_WITHDRAW:
+    PUT_STR(p, "|W|");
+    break;
+  case PARSEBGP_ELEM_TYPE_PEER_STATE:
+    PUT_STR(p, "|STATE|");
+    break;
+  }
+
+  if (elem->peer_afi != 0) {
+    p = put_ip(p, elem->peer_afi, elem->peer_ip);
+  }
+  *(p++) = '|';
+  p = put_u32(p, elem->peer_asn);
+  *(p++) = '|';
+
+  if (elem->type == PARSEBGP_ELEM_TYPE_PEER_STATE) {
+    p = put_u32(p, elem->old_state);
+    *(p++) = '|';
+    p = put_u32(p, elem->new_state);
+    *(p++) = '\n';
+    return p;
+  }
+
+  p = put_prefix(p, &elem->prefix);
+  if (elem->type == PARSEBGP_ELEM_TYPE_WITHDRAW) {
+    *(p++) = '\n';
+    return p;
+  }
+
+  *(p++) = '|';
+  p = put_as_path(p, elem);
+  *(p++) = '|';
+  if (PARSEBGP_HAS_ATTR(attrs, ORIGIN)) {
+    p = put_origin(p, PARSEBGP_ATTR(attrs, ORIGIN).origin);
+  }
+  *(p++) = '|';
+  if (elem->next_hop_afi != 0) {
+    p = put_ip(p, elem->next_hop_afi, elem->next_hop);
+  }
+  *(p++) = '|';
+  if (PARSEBGP_HAS_ATTR(attrs, LOCAL_PREF)) {
+    p = put_u32(p, PARSEBGP_ATTR(attrs, LOCAL_PREF).local_pref);
+  } else {
+    *(p++) = '0';
+  }
+  *(p++) = '|';
+  if (PARSEBGP_HAS_ATTR(attrs, MED)) {
+    p = put_u32(p, PARSEBGP_ATTR(attrs, MED).med);
+  } else {
+    *(p++) = '0';
+  }
+  *(p++) = '|';
+  start = p;
+  if (PARSEBGP_HAS_ATTR(attrs, COMMUNITIES)) {
+    comms = PARSEBGP_ATTR(attrs, COMMUNITIES).communities;
+    for (i = 0; i < comms->communities_cnt; i++) {
+      if (p != start) {
+        *(p++) = ' ';
+      }
+      p = put_community(p, comms->communities[i]);
+    }
+  }
+  if (PARSEBGP_HAS_ATTR(attrs, LARGE_COMMUNITIES)) {
+    lcomms = PARSEBGP_ATTR(attrs, LARGE_COMMUNITIES).large_communities;
+    for (i = 0; i < lcomms->communities_cnt; i++) {
+      if (p != start) {
+        *(p++) = ' ';
+      }
+      p = put_large_community(p, &lcomms->communities[i]);
+    }
+  }
+  if (PARSEBGP_HAS_ATTR(attrs, ATOMIC_AGGREGATE)) {
+    PUT_STR(p, "|AG|");
+  } else {
+    PUT_STR(p, "|NAG|");
+  }
+  if ((aggregator = get_aggregator(attrs)) != NULL) {
+    p = put_u32(p, aggregator->asn);
+    *(p++) = ' ';
+    p = put_ipv4(p, aggregator->addr);
+  }
+  PUT_STR(p, "|\n");
+
+  return p;
+}
+
+static char *put_json(char *p, const parsebgp_elem_t *elem)
+{
+  const parsebgp_bgp_update_path_attrs_t *attrs = elem->path_attrs;
+  const parsebgp_bgp_update_communities_t *comms;
+  const parsebgp_bgp_update_large_communities_t *lcomms;
+  const parsebgp_bgp_update_aggregator_t *aggregator;
+  int i;
+
+  switch (elem->type) {
+  case PARSEBGP_ELEM_TYPE_RIB:
+    PUT_STR(p, "{\"type\":\"rib\"");
+    break;
+  case PARSEBGP_ELEM_TYPE_ANNOUNCE:
+    PUT_STR(p, "{\"type\":\"announce\"");
+    break;
+  case PARSEBGP_ELEM_TYPE_WITHDRAW:
+    PUT_STR(p, "{\"type\":\"withdraw\"");
+    break;
+  case PARSEBGP_ELEM_TYPE_PEER_STATE:
+    PUT_STR(p, "{\"type\":\"peer_state\"");
+    break;
+  }
+
+  PUT_STR(p, ",\"source\":\"");
+  p = put_source(p, elem);
+  PUT_STR(p, "\",\"timestamp\":");
+  p = put_u32(p, elem->timestamp_sec);
+  PUT_STR(p, ",\"timestamp_usec\":");
+  p = put_u32(p, elem->timestamp_usec);
+
+  if (elem->peer_afi != 0) {
+    PUT_STR(p, ",\"peer_ip\":\"");
+    p = put_ip(p, elem->peer_afi, elem->peer_ip);
+    PUT_STR(p, "\",\"peer_asn\":");
+    p = put_u32(p, elem->peer_asn);
+  }
+
+  if (elem->type == PARSEBGP_ELEM_TYPE_PEER_STATE) {
+    PUT_STR(p, ",\"old_state\":");
+    p = put_u32(p, elem->old_state);
+    PUT_STR(p, ",\"new_state\":");
+    p = put_u32(p, elem->new_state);
+    PUT_STR(p, "}\n");
+    return p;
+  }
+
+  PUT_STR(p, ",\"prefix\":\"");
+  p = put_prefix(p, &elem->prefix);
+  *(p++) = '"';
+  if (elem->type == PARSEBGP_ELEM_TYPE_WITHDRAW) {
+    PUT_STR(p, "}\n");
+    return p;
+  }
+
+  if (elem->next_hop_afi != 0) {
+    PUT_STR(p, ",\"next_hop\":\"");
+    p = put_ip(p, elem->next_hop_afi, elem->next_hop);
+    *(p++) = '"';
+  }
+  PUT_STR(p, ",\"as_path\":\"");
+  p = put_as_path(p, elem);
+  *(p++) = '"';
+  if (PARSEBGP_HAS_ATTR(attrs, ORIGIN)) {
+    PUT_STR(p, ",\"origin\":\"");
+    p = put_origin(p, PARSEBGP_ATTR(attrs, ORIGIN).origin);
+    *(p++) = '"';
+  }
+  if (PARSEBGP_HAS_ATTR(attrs, LOCAL_PREF)) {
+    PUT_STR(p, ",\"local_pref\":");
+    p = put_u32(p, PARSEBGP_ATTR(attrs, LOCAL_PREF).local_pref);
+  }
+  if (PARSEBGP_HAS_ATTR(attrs, MED)) {
+    PUT_STR(p, ",\"med\":");
+    p = put_u32(p, PARSEBGP_ATTR(attrs, MED).med);
+  }
+  if (PARSEBGP_HAS_ATTR(attrs, COMMUNITIES)) {
+    comms = PARSEBGP_ATTR(attrs, COMMUNITIES).communities;
+    PUT_STR(p, ",\"communities\":[");
+    for (i = 0; i < comms->communities_cnt; i++) {
+      if (i != 0) {
+        *(p++) = ',';
+      }
+      *(p++) = '"';
+      p = put_community(p, comms->communities[i]);
+      *(p++) = '"';
+    }
+    *(p++) = ']';
+  }
+  if (PARSEBGP_HAS_ATTR(attrs, LARGE_COMMUNITIES)) {
+    lcomms = PARSEBGP_ATTR(attrs, LARGE_COMMUNITIES).large_communities;
+    PUT_STR(p, ",\"large_communities\":[");
+    for (i = 0; i < lcomms->communities_cnt; i++) {
+      if (i != 0) {
+        *(p++) = ',';
+      }
+      *(p++) = '"';
+      p = put_large_community(p, &lcomms->communities[i]);
+      *(p++) = '"';
+    }
+    *(p++) = ']';
+  }
+  if (PARSEBGP_HAS_ATTR(attrs, ATOMIC_AGGREGATE)) {
+    PUT_STR(p, ",\"atomic_aggregate\":true");
+  }
+  if ((aggregator = get_aggregator(attrs)) != NULL) {
+    PUT_STR(p, ",\"aggregator_asn\":");
+    p = put_u32(p, aggregator->asn);
+    PUT_STR(p, ",\"aggregator_ip\":\"");
+    p = put_ipv4(p, aggregator->addr);
+    *(p++) = '"';
+  }
+  PUT_STR(p, "}\n");
+
+  return p;
+}
+
+int parsebgp_elem_fmt(parsebgp_elem_fmt_buf_t *buf, parsebgp_elem_fmt_t fmt,
+                      const parsebgp_elem_t *elem)
+{
+  char *p;
+
+  if ((p = reserve(buf, line_max_len(elem))) == NULL) {
+    return -1;
+  }
+
+  switch (fmt) {
+  case PARSEBGP_ELEM_FMT_JSON:
+    p = put_json(p, elem);
+    break;
+
+  case PARSEBGP_ELEM_FMT_BGPDUMP:
+    p = put_bgpdump(p, elem);
+    break;
+
+  default:
+    return -1;
+  }
+
+  buf->len = p - buf->buf;
+  return 0;
+}
+
+void parsebgp_elem_fmt_buf_clear(parsebgp_elem_fmt_buf_t *buf)
+{
+  buf->len = 0;
+}
+
+void parsebgp_elem_fmt_buf_destroy(parsebgp_elem_fmt_buf_t *buf)
+{
+  free(buf->buf);
+  buf->buf = NULL;
+  buf->len = 0;
+  buf->_alloc_len = 0;
+}
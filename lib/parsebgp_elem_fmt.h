@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2017 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __PARSEBGP_ELEM_FMT_H
+#define __PARSEBGP_ELEM_FMT_H
+
+#include "parsebgp_elem.h"
+#include <stddef.h>
+
+/**
+ * Elem Formatters
+ *
+ * Machine-readable text output of elems, one line per elem. Lines are appended
+ * to a caller-owned output buffer which is grown as needed and can be reused
+ * for the whole stream, so that the caller can write many lines at once.
+ */
+
+/**
+ * Output Formats
+ */
+typedef enum parsebgp_elem_fmt {
+
+  /** JSON Lines (one JSON object per line) */
+  PARSEBGP_ELEM_FMT_JSON = 1,
+
+  /** Pipe-separated format compatible with the output of "bgpdump -m" */
+  PARSEBGP_ELEM_FMT_BGPDUMP = 2,
+
+} parsebgp_elem_fmt_t;
+
+/**
+ * Output Buffer
+ */
+typedef struct parsebgp_elem_fmt_buf {
+
+  /** Formatted output (not NUL-terminated) */
+  char *buf;
+
+  /** Number of bytes of output in the buffer */
+  size_t len;
+
+  /** Allocated length of the buffer (INTERNAL) */
+  size_t _alloc_len;
+
+} parsebgp_elem_fmt_buf_t;
+
+/**
+ * Append a line describing the given elem to the given buffer
+ *
+ * @param buf           Pointer to the output buffer to append to
+ * @param fmt           Output format to use
+ * @param elem          Pointer to the elem to format
+ * @return 0 if the line was appended, -1 if an error occurred
+ *
+ * In both formats, an AS_PATH and AS4_PATH pair is merged into a single path
+ * as described in RFC6793. The bgpdump format lists large communities after
+ * the standard communities, and uses zero for a missing LOCAL_PREF or MED.
+ */
+int parsebgp_elem_fmt(parsebgp_elem_fmt_buf_t *buf, parsebgp_elem_fmt_t fmt,
+                      const parsebgp_elem_t *elem);
+
+/**
+ * Empty the given buffer ready for reuse (without freeing memory)
+ *
+ * @param buf           Pointer to the output buffer to clear
+ */
+void parsebgp_elem_fmt_buf_clear(parsebgp_elem_fmt_buf_t *buf);
+
+/**
+ * Free the memory used by the given buffer
+ *
+ * @param buf           Pointer to the output buffer to destroy
+ */
+void parsebgp_elem_fmt_buf_destroy(parsebgp_elem_fmt_buf_t *buf);
+
+#endif /* __PARSEBGP_ELEM_FMT_H */
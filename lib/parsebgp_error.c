@@ -34,6 +34,8 @@ static const char *err_strings[] = {
   "Not Implemented",    // PARSEBGP_NOT_IMPLEMENTED
   "Malloc Failure",     // PARSEBGP_MALLOC_FAILURE
   "Truncated Message",  // PARSEBGP_TRUNCATED_MSG
+  "Budget Exceeded",    // PARSEBGP_BUDGET_EXCEEDED
+  "Invalid Options",    // PARSEBGP_INVALID_OPTS
 };
 
 const char *parsebgp_strerror(parsebgp_error_t err)
@@ -53,7 +53,14 @@ typedef enum parsebgp_error {
   /** Message does not contain an entire sub-message */
   PARSEBGP_TRUNCATED_MSG = -5,
 
-  PARSEBGP_N_ERR = -6,
+  /** Message was only partly decoded because a decode budget ran out */
+  PARSEBGP_BUDGET_EXCEEDED = -6,
+
+  /** Parsing options are inconsistent (e.g., a Path Attribute type is set to
+      be passed to a handler, but has no handler) */
+  PARSEBGP_INVALID_OPTS = -7,
+
+  PARSEBGP_N_ERR = -8,
 
 } parsebgp_error_t;
 
@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2017 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __PARSEBGP_MEM_H
+#define __PARSEBGP_MEM_H
+
+#include <stddef.h>
+
+/**
+ * Memory Usage of a Message Structure
+ *
+ * Message structures keep the memory they allocate when they are cleared so
+ * that it can be reused by the next message decoded into them. These counters
+ * give the number of bytes that a structure currently holds (including such
+ * retained, but unused, capacity), broken down by what the memory is used for.
+ * Allocator overheads are not included.
+ */
+typedef struct parsebgp_mem_usage {
+
+  /** Total number of bytes held (the sum of all of the following) */
+  size_t total;
+
+  /** Message structures (e.g., the BGP UPDATE or BMP Peer Up structure) */
+  size_t structs;
+
+  /** Arrays of prefixes (NLRIs, MP_REACH and MP_UNREACH) */
+  size_t prefixes;
+
+  /** Decoded Path Attribute data (AS Paths, Communities, etc.) */
+  size_t path_attrs;
+
+  /** Copies of raw message data (raw Path Attributes, NOTIFICATION data, BMP
+      Information TLVs, etc.) */
+  size_t raw;
+
+  /** MRT RIB entries and peer index entries (including the Path Attribute
+      structures embedded in each RIB entry) */
+  size_t rib_entries;
+
+  /** Everything else (OPEN capabilities, BMP TLV arrays and statistics) */
+  size_t other;
+
+} parsebgp_mem_usage_t;
+
+#endif /* __PARSEBGP_MEM_H */
@@ -0,0 +1,891 @@
+/*
+ * Copyright (C) 2017 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "parsebgp_msg_flat.h"
+#include <stdint.h>
+#include <string.h>
+
+/** Magic number that identifies a flattened message ("BGPF") */
+#define FLAT_MAGIC 0x46504742
+
+/** Version of the flattened message layout */
+#define FLAT_VERSION 6
+
+/** Alignment of every object in the block */
+#define FLAT_ALIGN 8
+
+#define FLAT_ALIGN_UP(x)                                                       \
+  (((x) + (FLAT_ALIGN - 1)) & ~((size_t)FLAT_ALIGN - 1))
+
+/** Header at the start of every flattened block */
+typedef struct flat_hdr {
+
+  /** FLAT_MAGIC */
+  uint32_t magic;
+
+  /** FLAT_VERSION */
+  uint16_t version;
+
+  /** Unused (zero) */
+  uint16_t reserved;
+
+  /** Total length of the block (including this header) */
+  uint64_t len;
+
+  /** Address that the pointers in the block are relative to (0 when the
+      pointers are offsets from the start of the block) */
+  uint64_t base;
+
+} flat_hdr_t;
+
+/** Offset of the root message in the block */
+#define FLAT_ROOT_OFFSET FLAT_ALIGN_UP(sizeof(flat_hdr_t))
+
+typedef enum {
+
+  /** Only compute the size of the block (nothing is written) */
+  FLAT_SIZE,
+
+  /** Copy objects into the block, replacing pointers with offsets */
+  FLAT_COPY,
+
+  /** Check and rebase the pointers of an existing block */
+  FLAT_RELOCATE,
+
+} flat_mode_t;
+
+typedef struct flat_ctx {
+
+  /** Current mode */
+  flat_mode_t mode;
+
+  /** Block being written or relocated */
+  uint8_t *buf;
+
+  /** Length of the block (capacity when copying) */
+  size_t len;
+
+  /** Bytes used so far (when sizing or copying), or the end of the last
+      array visited (when relocating) */
+  size_t used;
+
+  /** Address that pointers are currently relative to (when relocating) */
+  uintptr_t from;
+
+  /** Set if the block is invalid (when relocating) */
+  int err;
+
+} flat_ctx_t;
+
+/**
+ * Visit an array of cnt objects of the given size pointed to by the pointer at
+ * fieldp, and return the array to descend into (or NULL if there is none).
+ *
+ * When sizing, this just accounts for the array. When copying, the array is
+ * appended to the block and the pointer replaced by its offset (if the block
+ * is too small, we fall back to sizing for the rest of the message). When
+ * relocating, the pointer is checked to refer to cnt objects within the
+ * block and rebased onto the block's current address. Since copying writes
+ * the arrays in visit order, each array must also start at or after the end of
+ * the previous one, so that no array of the block can alias another (e.g., an
+ * array that overlaps a structure whose counts have already been checked).
+ *
+ * If opt is set, the pointer may legitimately be NULL whatever the value of
+ * cnt, and (when sizing or copying) an array that is smaller than cnt (i.e.,
+ * alloc_cnt is less than cnt) is stale and so is dropped.
+ */
+static void *visit_array(flat_ctx_t *ctx, void *fieldp, size_t size,
+                         size_t cnt, int opt, size_t alloc_cnt)
+{
+  void *p;
+  size_t off;
+
+  // the field may be in a packed structure, so don't dereference it directly
+  memcpy(&p, fieldp, sizeof(p));
+
+  switch (ctx->mode) {
+  case FLAT_SIZE:
+  case FLAT_COPY:
+    if (p == NULL || cnt == 0 || (opt && cnt > alloc_cnt)) {
+      if (ctx->mode == FLAT_COPY) {
+        p = NULL;
+        memcpy(fieldp, &p, sizeof(p));
+      }
+      return NULL;
+    }
+    off = FLAT_ALIGN_UP(ctx->used);
+    if (ctx->mode == FLAT_COPY && off + (size * cnt) > ctx->len) {
+      ctx->mode = FLAT_SIZE;
+    }
+    if (ctx->mode == FLAT_SIZE) {
+      ctx->used = off + (size * cnt);
+      return p;
+    }
+    // zero the alignment padding so that the block is deterministic
+    memset(ctx->buf + ctx->used, 0, off - ctx->used);
+    memcpy(ctx->buf + off, p, size * cnt);
+    ctx->used = off + (size * cnt);
+    p = (void *)(uintptr_t)off;
+    memcpy(fieldp, &p, sizeof(p));
+    return ctx->buf + off;
+
+  case FLAT_RELOCATE:
+    if (p == NULL) {
+      if (cnt != 0 && !opt) {
+        ctx->err = 1;
+      }
+      return NULL;
+    }
+    off = (uintptr_t)p - ctx->from;
+    if (off < ctx->used || off > ctx->len || (off % FLAT_ALIGN) != 0 ||
+        cnt > (ctx->len - off) / size) {
+      ctx->err = 1;
+      p = NULL;
+    } else {
+      ctx->used = off + (size * cnt);
+      p = ctx->buf + off;
+    }
+    memcpy(fieldp, &p, sizeof(p));
+    return p;
+  }
+
+  return NULL;
+}
+
+#define VISIT(ctx, fieldp, size, cnt)                                          \
+  visit_array((ctx), (fieldp), (size), (cnt), 0, 0)
+
+#define VISIT_OPT(ctx, fieldp, size, cnt, alloc_cnt)                           \
+  visit_array((ctx), (fieldp), (size), (cnt), 1, (alloc_cnt))
+
+/** Set the (unused) pointer at fieldp to NULL */
+static void drop(flat_ctx_t *ctx, void *fieldp)
+{
+  void *p = NULL;
+
+  // the source message must never be modified
+  if (ctx->mode != FLAT_SIZE) {
+    memcpy(fieldp, &p, sizeof(p));
+  }
+}
+
+/** Visit a NUL-terminated string of len characters */
+static void visit_string(flat_ctx_t *ctx, void *fieldp, size_t len)
+{
+  char *str = VISIT(ctx, fieldp, 1, len + 1);
+
+  // don't trust the terminator of a block that we didn't just write
+  if (str != NULL && ctx->mode == FLAT_RELOCATE) {
+    str[len] = '\0';
+  }
+}
+
+/* -------------------- BGP -------------------- */
+
+static void walk_open(flat_ctx_t *ctx, parsebgp_bgp_open_t *msg)
+{
+  parsebgp_bgp_open_capability_t *caps, *cap;
+  int i;
+
+  if (msg == NULL) {
+    return;
+  }
+
+  caps = VISIT(ctx, &msg->capabilities, sizeof(*caps), msg->capabilities_cnt);
+  for (i = 0; caps != NULL && i < msg->capabilities_cnt; i++) {
+    cap = &caps[i];
+    if (cap->code == PARSEBGP_BGP_OPEN_CAPABILITY_ADD_PATH) {
+      VISIT(ctx, &cap->values.add_path.afi_safis,
+            sizeof(parsebgp_bgp_open_capability_add_path_afi_safi_t),
+            cap->values.add_path.afi_safis_cnt);
+    } else if (BGPSTREAM_OPEN_CAPABILITY_IS_RAW(cap) &&
+               cap->len > sizeof(cap->values.databuf)) {
+      VISIT(ctx, &cap->values.datap, 1, cap->len);
+    }
+  }
+}
+
+static void walk_as_path(flat_ctx_t *ctx, parsebgp_bgp_update_as_path_t *msg,
+                         size_t raw_len)
+{
+  parsebgp_bgp_update_as_path_seg_t *segs;
+  int i;
+
+  if (msg == NULL) {
+    return;
+  }
+
+  segs = VISIT(ctx, &msg->segs, sizeof(*segs), msg->segs_cnt);
+  VISIT(ctx, &msg->asns, sizeof(*msg->asns), msg->asns_total_cnt);
+  if (ctx->mode == FLAT_RELOCATE) {
+    // segments must not point outside of the ASN array
+    for (i = 0; segs != NULL && i < msg->segs_cnt; i++) {
+      if (segs[i].asns_offset + segs[i].asns_cnt > msg->asns_total_cnt) {
+        ctx->err = 1;
+      }
+    }
+  }
+
+  VISIT_OPT(ctx, &msg->raw, 1, raw_len, msg->_raw_alloc_len);
+}
+
+static void walk_prefixes_compact(flat_ctx_t *ctx,
+                                  parsebgp_bgp_prefixes_compact_t *pfxs)
+{
+  int ipv4 = (pfxs->afi == PARSEBGP_BGP_AFI_IPV4);
+
+  // only the address array of the AFI is used (see
+  // parsebgp_bgp_prefixes_compact_get), so the other one is dropped
+  VISIT(ctx, &pfxs->lens, sizeof(*pfxs->lens), pfxs->cnt);
+  VISIT(ctx, &pfxs->addrs4, sizeof(*pfxs->addrs4), ipv4 ? pfxs->cnt : 0);
+  VISIT(ctx, &pfxs->addrs6, sizeof(*pfxs->addrs6), ipv4 ? 0 : pfxs->cnt);
+  VISIT(ctx, &pfxs->path_ids, sizeof(*pfxs->path_ids),
+        pfxs->has_path_ids ? pfxs->cnt : 0);
+}
+
+static void walk_path_attr(flat_ctx_t *ctx,
+                           parsebgp_bgp_update_path_attr_t *attr)
+{
+  parsebgp_bgp_update_communities_t *comms;
+  parsebgp_bgp_update_cluster_list_t *cluster_list;
+  parsebgp_bgp_update_mp_reach_t *mp_reach;
+  parsebgp_bgp_update_mp_unreach_t *mp_unreach;
+  parsebgp_bgp_update_ext_communities_t *ext_comms;
+  parsebgp_bgp_update_large_communities_t *large_comms;
+
+  switch (attr->type) {
+  case PARSEBGP_BGP_PATH_ATTR_TYPE_AS_PATH:
+  case PARSEBGP_BGP_PATH_ATTR_TYPE_AS4_PATH:
+    walk_as_path(ctx, VISIT(ctx, &attr->data.as_path,
+                            sizeof(parsebgp_bgp_update_as_path_t), 1),
+                 attr->len);
+    break;
+
+  case PARSEBGP_BGP_PATH_ATTR_TYPE_COMMUNITIES:
+    comms = VISIT(ctx, &attr->data.communities, sizeof(*comms), 1);
+    if (comms == NULL) {
+      break;
+    }
+    // communities are not decoded when the raw option is set
+    VISIT_OPT(ctx, &comms->communities, sizeof(uint32_t),
+              comms->communities_cnt, comms->_communities_alloc_cnt);
+    VISIT_OPT(ctx, &comms->raw, 1, attr->len, comms->_raw_alloc_len);
+    break;
+
+  case PARSEBGP_BGP_PATH_ATTR_TYPE_CLUSTER_LIST:
+    cluster_list =
+      VISIT(ctx, &attr->data.cluster_list, sizeof(*cluster_list), 1);
+    if (cluster_list != NULL) {
+      VISIT(ctx, &cluster_list->cluster_ids, sizeof(uint32_t),
+            cluster_list->cluster_ids_cnt);
+    }
+    break;
+
+  case PARSEBGP_BGP_PATH_ATTR_TYPE_MP_REACH_NLRI:
+    mp_reach = VISIT(ctx, &attr->data.mp_reach, sizeof(*mp_reach), 1);
+    if (mp_reach != NULL) {
+      VISIT(ctx, &mp_reach->nlris, sizeof(parsebgp_bgp_prefix_t),
+            mp_reach->nlris_cnt);
+      walk_prefixes_compact(ctx, &mp_reach->compact_nlris);
+    }
+    break;
+
+  case PARSEBGP_BGP_PATH_ATTR_TYPE_MP_UNREACH_NLRI:
+    mp_unreach = VISIT(ctx, &attr->data.mp_unreach, sizeof(*mp_unreach), 1);
+    if (mp_unreach != NULL) {
+      VISIT(ctx, &mp_unreach->withdrawn_nlris, sizeof(parsebgp_bgp_prefix_t),
+            mp_unreach->withdrawn_nlris_cnt);
+      walk_prefixes_compact(ctx, &mp_unreach->compact_withdrawn_nlris);
+    }
+    break;
+
+  case PARSEBGP_BGP_PATH_ATTR_TYPE_EXT_COMMUNITIES:
+  case PARSEBGP_BGP_PATH_ATTR_TYPE_IPV6_EXT_COMMUNITIES:
+    ext_comms =
+      VISIT(ctx, &attr->data.ext_communities, sizeof(*ext_comms), 1);
+    if (ext_comms != NULL) {
+      VISIT(ctx, &ext_comms->communities,
+            sizeof(parsebgp_bgp_update_ext_community_t),
+            ext_comms->communities_cnt);
+    }
+    break;
+
+  case PARSEBGP_BGP_PATH_ATTR_TYPE_LARGE_COMMUNITIES:
+    large_comms =
+      VISIT(ctx, &attr->data.large_communities, sizeof(*large_comms), 1);
+    if (large_comms != NULL) {
+      VISIT(ctx, &large_comms->communities,
+            sizeof(parsebgp_bgp_update_large_community_t),
+            large_comms->communities_cnt);
+    }
+    break;
+
+  default:
+    // all other attributes are stored inline
+    break;
+  }
+}
+
+static void walk_path_attrs(flat_ctx_t *ctx,
+                            parsebgp_bgp_update_path_attrs_t *msg)
+{
+  uint8_t *used;
+  int i;
+
+  VISIT_OPT(ctx, &msg->raw, 1, msg->raw_len, msg->_raw_alloc_len);
+
+  used = VISIT(ctx, &msg->attrs_used, sizeof(uint8_t), msg->attrs_cnt);
+  if (ctx->mode == FLAT_RELOCATE) {
+    // attrs_used values are used to index attrs, so must be checked
+    for (i = 0; used != NULL && i < msg->attrs_cnt; i++) {
+      if (used[i] >= PARSEBGP_BGP_PATH_ATTRS_LEN ||
+          !PARSEBGP_BGP_UPDATE_ATTR_PRESENT(msg, used[i])) {
+        ctx->err = 1;
+      }
+    }
+  }
+
+  for (i = 0; i < PARSEBGP_BGP_PATH_ATTRS_LEN; i++) {
+    if (PARSEBGP_BGP_UPDATE_ATTR_PRESENT(msg, i)) {
+      walk_path_attr(ctx, &msg->attrs[i]);
+    } else if (ctx->mode != FLAT_SIZE) {
+      // absent attributes may hold stale pointers
+      memset(&msg->attrs[i].data, 0, sizeof(msg->attrs[i].data));
+    }
+  }
+}
+
+static void walk_update(flat_ctx_t *ctx, parsebgp_bgp_update_t *msg)
+{
+  if (msg == NULL) {
+    return;
+  }
+
+  VISIT(ctx, &msg->withdrawn_nlris.prefixes, sizeof(parsebgp_bgp_prefix_t),
+        msg->withdrawn_nlris.prefixes_cnt);
+  walk_prefixes_compact(ctx, &msg->withdrawn_nlris.compact);
+  walk_path_attrs(ctx, &msg->path_attrs);
+  VISIT(ctx, &msg->announced_nlris.prefixes, sizeof(parsebgp_bgp_prefix_t),
+        msg->announced_nlris.prefixes_cnt);
+  walk_prefixes_compact(ctx, &msg->announced_nlris.compact);
+}
+
+static void walk_notification(flat_ctx_t *ctx,
+                              parsebgp_bgp_notification_t *msg)
+{
+  if (msg != NULL) {
+    VISIT(ctx, &msg->data, 1, msg->data_len);
+  }
+}
+
+static void walk_bgp_msg(flat_ctx_t *ctx, parsebgp_bgp_msg_t *msg)
+{
+  parsebgp_bgp_route_refresh_t *rr;
+
+  if (msg == NULL) {
+    return;
+  }
+
+  if (msg->type != PARSEBGP_BGP_TYPE_OPEN) {
+    drop(ctx, &msg->types.open);
+  }
+  if (msg->type != PARSEBGP_BGP_TYPE_UPDATE) {
+    drop(ctx, &msg->types.update);
+  }
+  if (msg->type != PARSEBGP_BGP_TYPE_NOTIFICATION) {
+    drop(ctx, &msg->types.notification);
+  }
+  if (msg->type != PARSEBGP_BGP_TYPE_ROUTE_REFRESH) {
+    drop(ctx, &msg->types.route_refresh);
+  }
+
+  switch (msg->type) {
+  case PARSEBGP_BGP_TYPE_OPEN:
+    walk_open(ctx, VISIT(ctx, &msg->types.open, sizeof(parsebgp_bgp_open_t),
+                         1));
+    break;
+
+  case PARSEBGP_BGP_TYPE_UPDATE:
+    walk_update(ctx, VISIT(ctx, &msg->types.update,
+                           sizeof(parsebgp_bgp_update_t), 1));
+    break;
+
+  case PARSEBGP_BGP_TYPE_NOTIFICATION:
+    walk_notification(ctx, VISIT(ctx, &msg->types.notification,
+                                 sizeof(parsebgp_bgp_notification_t), 1));
+    break;
+
+  case PARSEBGP_BGP_TYPE_ROUTE_REFRESH:
+    rr = VISIT(ctx, &msg->types.route_refresh, sizeof(*rr), 1);
+    if (rr != NULL) {
+      VISIT(ctx, &rr->data, 1, rr->data_len);
+    }
+    break;
+
+  default:
+    // KEEPALIVE (and unknown types) have no data
+    break;
+  }
+}
+
+static void walk_bgp_msg_ptr(flat_ctx_t *ctx, void *fieldp)
+{
+  walk_bgp_msg(ctx, VISIT(ctx, fieldp, sizeof(parsebgp_bgp_msg_t), 1));
+}
+
+/* -------------------- BMP -------------------- */
+
+static void walk_info_tlvs(flat_ctx_t *ctx, parsebgp_bmp_info_tlv_t **tlvsp,
+                           int tlvs_cnt)
+{
+  parsebgp_bmp_info_tlv_t *tlvs;
+  int i;
+
+  tlvs = VISIT(ctx, tlvsp, sizeof(*tlvs), tlvs_cnt);
+  for (i = 0; tlvs != NULL && i < tlvs_cnt; i++) {
+    VISIT(ctx, &tlvs[i].info, 1, tlvs[i].len);
+  }
+}
+
+static void walk_peer_down(flat_ctx_t *ctx, parsebgp_bmp_peer_down_t *msg)
+{
+  if (msg == NULL) {
+    return;
+  }
+
+  switch (msg->reason) {
+  case PARSEBGP_BMP_PEER_DOWN_LOCAL_CLOSE_WITH_NOTIF:
+  case PARSEBGP_BMP_PEER_DOWN_REMOTE_CLOSE_WITH_NOTIF:
+    walk_bgp_msg_ptr(ctx, &msg->data.notification);
+    break;
+
+  default:
+    drop(ctx, &msg->data.notification);
+    break;
+  }
+}
+
+static void walk_peer_up(flat_ctx_t *ctx, parsebgp_bmp_peer_up_t *msg)
+{
+  if (msg == NULL) {
+    return;
+  }
+
+  walk_bgp_msg_ptr(ctx, &msg->sent_open);
+  walk_bgp_msg_ptr(ctx, &msg->recv_open);
+  walk_info_tlvs(ctx, &msg->tlvs, msg->tlvs_cnt);
+}
+
+static void walk_term_msg(flat_ctx_t *ctx, parsebgp_bmp_term_msg_t *msg)
+{
+  parsebgp_bmp_term_tlv_t *tlvs;
+  int i;
+
+  if (msg == NULL) {
+    return;
+  }
+
+  tlvs = VISIT(ctx, &msg->tlvs, sizeof(*tlvs), msg->tlvs_cnt);
+  for (i = 0; tlvs != NULL && i < msg->tlvs_cnt; i++) {
+    if (tlvs[i].type == PARSEBGP_BMP_TERM_INFO_TYPE_STRING) {
+      visit_string(ctx, &tlvs[i].info.string, tlvs[i].len);
+    } else {
+      drop(ctx, &tlvs[i].info.string);
+    }
+  }
+}
+
+static void walk_route_mirror(flat_ctx_t *ctx,
+                              parsebgp_bmp_route_mirror_t *msg)
+{
+  parsebgp_bmp_route_mirror_tlv_t *tlvs;
+  int i;
+
+  if (msg == NULL) {
+    return;
+  }
+
+  tlvs = VISIT(ctx, &msg->tlvs, sizeof(*tlvs), msg->tlvs_cnt);
+  for (i = 0; tlvs != NULL && i < msg->tlvs_cnt; i++) {
+    if (tlvs[i].type == PARSEBGP_BMP_ROUTE_MIRROR_TYPE_BGP_MSG) {
+      walk_bgp_msg_ptr(ctx, &tlvs[i].values.bgp_msg);
+    } else {
+      drop(ctx, &tlvs[i].values.bgp_msg);
+    }
+  }
+}
+
+static void walk_bmp_msg(flat_ctx_t *ctx, parsebgp_bmp_msg_t *msg)
+{
+  parsebgp_bmp_stats_report_t *stats;
+  parsebgp_bmp_init_msg_t *init;
+  int type;
+
+  if (msg == NULL) {
+    return;
+  }
+
+  type = msg->types_valid ? msg->type : -1;
+
+  if (type != PARSEBGP_BMP_TYPE_ROUTE_MON) {
+    drop(ctx, &msg->types.route_mon);
+  }
+  if (type != PARSEBGP_BMP_TYPE_STATS_REPORT) {
+    drop(ctx, &msg->types.stats_report);
+  }
+  if (type != PARSEBGP_BMP_TYPE_PEER_DOWN) {
+    drop(ctx, &msg->types.peer_down);
+  }
+  if (type != PARSEBGP_BMP_TYPE_PEER_UP) {
+    drop(ctx, &msg->types.peer_up);
+  }
+  if (type != PARSEBGP_BMP_TYPE_INIT_MSG) {
+    drop(ctx, &msg->types.init_msg);
+  }
+  if (type != PARSEBGP_BMP_TYPE_TERM_MSG) {
+    drop(ctx, &msg->types.term_msg);
+  }
+  if (type != PARSEBGP_BMP_TYPE_ROUTE_MIRROR_MSG) {
+    drop(ctx, &msg->types.route_mirror);
+  }
+
+  switch (type) {
+  case PARSEBGP_BMP_TYPE_ROUTE_MON:
+    walk_bgp_msg_ptr(ctx, &msg->types.route_mon);
+    break;
+
+  case PARSEBGP_BMP_TYPE_STATS_REPORT:
+    stats = VISIT(ctx, &msg->types.stats_report, sizeof(*stats), 1);
+    if (stats != NULL) {
+      VISIT(ctx, &stats->counters, sizeof(parsebgp_bmp_stats_counter_t),
+            stats->stats_count);
+    }
+    break;
+
+  case PARSEBGP_BMP_TYPE_PEER_DOWN:
+    walk_peer_down(ctx, VISIT(ctx, &msg->types.peer_down,
+                              sizeof(parsebgp_bmp_peer_down_t), 1));
+    break;
+
+  case PARSEBGP_BMP_TYPE_PEER_UP:
+    walk_peer_up(ctx, VISIT(ctx, &msg->types.peer_up,
+                            sizeof(parsebgp_bmp_peer_up_t), 1));
+    break;
+
+  case PARSEBGP_BMP_TYPE_INIT_MSG:
+    init = VISIT(ctx, &msg->types.init_msg, sizeof(*init), 1);
+    if (init != NULL) {
+      walk_info_tlvs(ctx, &init->tlvs, init->tlvs_cnt);
+    }
+    break;
+
+  case PARSEBGP_BMP_TYPE_TERM_MSG:
+    walk_term_msg(ctx, VISIT(ctx, &msg->types.term_msg,
+                             sizeof(parsebgp_bmp_term_msg_t), 1));
+    break;
+
+  case PARSEBGP_BMP_TYPE_ROUTE_MIRROR_MSG:
+    walk_route_mirror(ctx, VISIT(ctx, &msg->types.route_mirror,
+                                 sizeof(parsebgp_bmp_route_mirror_t), 1));
+    break;
+
+  default:
+    break;
+  }
+}
+
+/* -------------------- MRT -------------------- */
+
+static void walk_table_dump_v2(flat_ctx_t *ctx, int subtype,
+                               parsebgp_mrt_table_dump_v2_t *msg)
+{
+  parsebgp_mrt_table_dump_v2_peer_index_t *pi;
+  parsebgp_mrt_table_dump_v2_afi_safi_rib_t *rib;
+  parsebgp_mrt_table_dump_v2_rib_entry_t *entries;
+  int i;
+
+  if (msg == NULL) {
+    return;
+  }
+  pi = &msg->peer_index;
+  rib = &msg->afi_safi_rib;
+
+  switch (subtype) {
+  case PARSEBGP_MRT_TABLE_DUMP_V2_PEER_INDEX_TABLE:
+    if (pi->view_name_len > 0) {
+      visit_string(ctx, &pi->view_name, pi->view_name_len);
+    } else {
+      drop(ctx, &pi->view_name);
+    }
+    VISIT(ctx, &pi->peer_entries,
+          sizeof(parsebgp_mrt_table_dump_v2_peer_entry_t), pi->peer_count);
+    drop(ctx, &rib->entries);
+    break;
+
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_UNICAST:
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_MULTICAST:
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV6_UNICAST:
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV6_MULTICAST:
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_UNICAST_ADDPATH:
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_MULTICAST_ADDPATH:
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV6_UNICAST_ADDPATH:
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV6_MULTICAST_ADDPATH:
+    entries = VISIT(ctx, &rib->entries, sizeof(*entries), rib->entry_count);
+    for (i = 0; entries != NULL && i < rib->entry_count; i++) {
+      walk_path_attrs(ctx, &entries[i].path_attrs);
+    }
+    drop(ctx, &pi->view_name);
+    drop(ctx, &pi->peer_entries);
+    break;
+
+  default:
+    drop(ctx, &pi->view_name);
+    drop(ctx, &pi->peer_entries);
+    drop(ctx, &rib->entries);
+    break;
+  }
+}
+
+static void walk_mrt_bgp(flat_ctx_t *ctx, int subtype, parsebgp_mrt_bgp_t *msg)
+{
+  if (msg == NULL) {
+    return;
+  }
+
+  if (subtype != PARSEBGP_MRT_BGP_MESSAGE_UPDATE) {
+    drop(ctx, &msg->data.update);
+  }
+  if (subtype != PARSEBGP_MRT_BGP_MESSAGE_OPEN) {
+    drop(ctx, &msg->data.open);
+  }
+  if (subtype != PARSEBGP_MRT_BGP_MESSAGE_NOTIFY) {
+    drop(ctx, &msg->data.notification);
+  }
+
+  switch (subtype) {
+  case PARSEBGP_MRT_BGP_MESSAGE_UPDATE:
+    walk_update(ctx, VISIT(ctx, &msg->data.update,
+                           sizeof(parsebgp_bgp_update_t), 1));
+    break;
+
+  case PARSEBGP_MRT_BGP_MESSAGE_OPEN:
+    walk_open(ctx, VISIT(ctx, &msg->data.open, sizeof(parsebgp_bgp_open_t),
+                         1));
+    break;
+
+  case PARSEBGP_MRT_BGP_MESSAGE_NOTIFY:
+    walk_notification(ctx, VISIT(ctx, &msg->data.notification,
+                                 sizeof(parsebgp_bgp_notification_t), 1));
+    break;
+
+  default:
+    break;
+  }
+}
+
+static void walk_bgp4mp(flat_ctx_t *ctx, int subtype,
+                        parsebgp_mrt_bgp4mp_t *msg)
+{
+  if (msg == NULL) {
+    return;
+  }
+
+  switch (subtype) {
+  case PARSEBGP_MRT_BGP4MP_MESSAGE:
+  case PARSEBGP_MRT_BGP4MP_MESSAGE_AS4:
+  case PARSEBGP_MRT_BGP4MP_MESSAGE_LOCAL:
+  case PARSEBGP_MRT_BGP4MP_MESSAGE_AS4_LOCAL:
+    walk_bgp_msg_ptr(ctx, &msg->data.bgp_msg);
+    break;
+
+  default:
+    drop(ctx, &msg->data.bgp_msg);
+    break;
+  }
+}
+
+static void walk_mrt_msg(flat_ctx_t *ctx, parsebgp_mrt_msg_t *msg)
+{
+  parsebgp_mrt_table_dump_t *td;
+  int type;
+
+  if (msg == NULL) {
+    return;
+  }
+
+  type = msg->types_valid ? msg->type : -1;
+
+  // BGP4MP and BGP4MP_ET share a structure
+  if (type == PARSEBGP_MRT_TYPE_BGP4MP_ET) {
+    type = PARSEBGP_MRT_TYPE_BGP4MP;
+  }
+
+  if (type != PARSEBGP_MRT_TYPE_BGP) {
+    drop(ctx, &msg->types.bgp);
+  }
+  if (type != PARSEBGP_MRT_TYPE_TABLE_DUMP) {
+    drop(ctx, &msg->types.table_dump);
+  }
+  if (type != PARSEBGP_MRT_TYPE_TABLE_DUMP_V2) {
+    drop(ctx, &msg->types.table_dump_v2);
+  }
+  if (type != PARSEBGP_MRT_TYPE_BGP4MP) {
+    drop(ctx, &msg->types.bgp4mp);
+  }
+
+  switch (type) {
+  case PARSEBGP_MRT_TYPE_BGP:
+    walk_mrt_bgp(ctx, msg->subtype,
+                 VISIT(ctx, &msg->types.bgp, sizeof(parsebgp_mrt_bgp_t), 1));
+    break;
+
+  case PARSEBGP_MRT_TYPE_TABLE_DUMP:
+    td = VISIT(ctx, &msg->types.table_dump, sizeof(*td), 1);
+    if (td != NULL) {
+      walk_path_attrs(ctx, &td->path_attrs);
+    }
+    break;
+
+  case PARSEBGP_MRT_TYPE_TABLE_DUMP_V2:
+    walk_table_dump_v2(ctx, msg->subtype,
+                       VISIT(ctx, &msg->types.table_dump_v2,
+                             sizeof(parsebgp_mrt_table_dump_v2_t), 1));
+    break;
+
+  case PARSEBGP_MRT_TYPE_BGP4MP:
+    walk_bgp4mp(ctx, msg->subtype,
+                VISIT(ctx, &msg->types.bgp4mp, sizeof(parsebgp_mrt_bgp4mp_t),
+                      1));
+    break;
+
+  default:
+    break;
+  }
+}
+
+/* -------------------- Message -------------------- */
+
+static void walk_msg(flat_ctx_t *ctx, parsebgp_msg_t *msg)
+{
+  if (msg->type != PARSEBGP_MSG_TYPE_BGP) {
+    drop(ctx, &msg->types.bgp);
+  }
+  if (msg->type != PARSEBGP_MSG_TYPE_BMP) {
+    drop(ctx, &msg->types.bmp);
+  }
+  if (msg->type != PARSEBGP_MSG_TYPE_MRT) {
+    drop(ctx, &msg->types.mrt);
+  }
+
+  switch (msg->type) {
+  case PARSEBGP_MSG_TYPE_BGP:
+    walk_bgp_msg_ptr(ctx, &msg->types.bgp);
+    break;
+
+  case PARSEBGP_MSG_TYPE_BMP:
+    walk_bmp_msg(ctx, VISIT(ctx, &msg->types.bmp, sizeof(parsebgp_bmp_msg_t),
+                            1));
+    break;
+
+  case PARSEBGP_MSG_TYPE_MRT:
+    walk_mrt_msg(ctx, VISIT(ctx, &msg->types.mrt, sizeof(parsebgp_mrt_msg_t),
+                            1));
+    break;
+
+  default:
+    break;
+  }
+}
+
+size_t parsebgp_msg_flatten(const parsebgp_msg_t *msg, uint8_t *buf,
+                            size_t len)
+{
+  flat_ctx_t ctx;
+  flat_hdr_t *hdr;
+  parsebgp_msg_t *root;
+
+  if (((uintptr_t)buf % FLAT_ALIGN) != 0) {
+    return 0;
+  }
+
+  memset(&ctx, 0, sizeof(ctx));
+  ctx.buf = buf;
+  ctx.len = len;
+  ctx.used = FLAT_ROOT_OFFSET + sizeof(parsebgp_msg_t);
+
+  if (ctx.used <= len) {
+    ctx.mode = FLAT_COPY;
+    root = (parsebgp_msg_t *)(buf + FLAT_ROOT_OFFSET);
+    memset(buf, 0, FLAT_ROOT_OFFSET);
+    memcpy(root, msg, sizeof(*root));
+  } else {
+    // the walk never writes to the message when sizing
+    ctx.mode = FLAT_SIZE;
+    root = (parsebgp_msg_t *)msg;
+  }
+
+  walk_msg(&ctx, root);
+
+  if (ctx.mode == FLAT_COPY) {
+    hdr = (flat_hdr_t *)buf;
+    hdr->magic = FLAT_MAGIC;
+    hdr->version = FLAT_VERSION;
+    hdr->len = ctx.used;
+    hdr->base = 0;
+  }
+
+  return ctx.used;
+}
+
+const parsebgp_msg_t *parsebgp_msg_flat_view(uint8_t *buf, size_t len)
+{
+  flat_ctx_t ctx;
+  flat_hdr_t *hdr = (flat_hdr_t *)buf;
+  parsebgp_msg_t *msg;
+
+  if (buf == NULL || ((uintptr_t)buf % FLAT_ALIGN) != 0 ||
+      len < FLAT_ROOT_OFFSET + sizeof(parsebgp_msg_t) ||
+      hdr->magic != FLAT_MAGIC || hdr->version != FLAT_VERSION ||
+      hdr->len < FLAT_ROOT_OFFSET + sizeof(parsebgp_msg_t) || hdr->len > len) {
+    return NULL;
+  }
+
+  memset(&ctx, 0, sizeof(ctx));
+  ctx.mode = FLAT_RELOCATE;
+  ctx.buf = buf;
+  ctx.len = hdr->len;
+  ctx.used = FLAT_ROOT_OFFSET + sizeof(parsebgp_msg_t);
+  ctx.from = hdr->base;
+
+  msg = (parsebgp_msg_t *)(buf + FLAT_ROOT_OFFSET);
+  walk_msg(&ctx, msg);
+  if (ctx.err != 0) {
+    return NULL;
+  }
+
+  hdr->base = (uintptr_t)buf;
+  return msg;
+}
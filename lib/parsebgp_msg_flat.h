@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2017 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __PARSEBGP_MSG_FLAT_H
+#define __PARSEBGP_MSG_FLAT_H
+
+#include "parsebgp.h"
+#include <inttypes.h>
+#include <stddef.h>
+
+/**
+ * Flat Message Snapshots
+ *
+ * A decoded message is a tree of structures spread over many heap blocks.
+ * parsebgp_msg_flatten packs a message (including any BGP message nested in
+ * an MRT or BMP message) into a single contiguous block in which all pointers
+ * are stored as offsets from the start of the block. The block can then be
+ * moved as plain bytes (written to a file, copied through shared memory or a
+ * pipe, etc.) and later turned back into a usable message, in place, by
+ * parsebgp_msg_flat_view.
+ *
+ * Only the parts of the message that are in use (i.e., that the dump
+ * functions would print) are copied. Pointers to unused (stale) structures
+ * are set to NULL, and empty arrays are stored as NULL pointers.
+ *
+ * Blocks use the native byte order and structure layout, so they may only be
+ * read by the same build of the library on the same architecture.
+ */
+
+/**
+ * Flatten the given message into the given buffer
+ *
+ * @param msg           Pointer to the message to flatten
+ * @param buf           Pointer to the buffer to write into (must be aligned
+ *                      to 8 bytes, may be NULL if len is 0)
+ * @param len           Length of the buffer
+ * @return the number of bytes needed to hold the flattened message, or 0 if
+ * the message (or buffer) cannot be flattened
+ *
+ * Like snprintf, the return value may be larger than len, in which case the
+ * contents of the buffer are undefined, and the call should be repeated with
+ * a buffer of at least the returned size.
+ */
+size_t parsebgp_msg_flatten(const parsebgp_msg_t *msg, uint8_t *buf,
+                            size_t len);
+
+/**
+ * Get a read-only view of the message in the given flattened block
+ *
+ * @param buf           Pointer to a block created by parsebgp_msg_flatten
+ *                      (must be aligned to 8 bytes)
+ * @param len           Length of the block
+ * @return pointer to the message stored in the block, or NULL if the block is
+ * not valid
+ *
+ * The offsets in the block are converted to pointers in place, so the buffer
+ * must be writable (e.g., a MAP_PRIVATE mapping). Every pointer is checked to
+ * fall within the block without overlapping any other object, so a corrupt
+ * block is rejected rather than read out of bounds (in which case the contents
+ * of the block are left undefined). If
+ * the block is subsequently moved, it may be viewed again at its new location.
+ *
+ * The returned message is owned by the block: it must not be cleared,
+ * destroyed, or decoded into, and it becomes invalid if the block is freed.
+ */
+const parsebgp_msg_t *parsebgp_msg_flat_view(uint8_t *buf, size_t len);
+
+#endif /* __PARSEBGP_MSG_FLAT_H */
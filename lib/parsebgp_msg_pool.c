@@ -0,0 +1,259 @@
+/*
+ * Copyright (C) 2017 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "parsebgp_msg_pool.h"
+#include "parsebgp_utils.h"
+#include <stdlib.h>
+
+// keep the enqueue and dequeue positions of the queue on separate cache lines
+#define CACHE_LINE_LEN 64
+
+/** A pooled message */
+typedef struct pool_msg {
+
+  /** The message (MUST be the first field, since users are given a pointer
+      to it, and parsebgp_destroy_msg frees it) */
+  parsebgp_msg_t msg;
+
+  /** Pool the message belongs to */
+  parsebgp_msg_pool_t *pool;
+
+  /** Number of references to the message */
+  uint32_t refcnt;
+
+} pool_msg_t;
+
+/** A slot of the queue of released messages */
+typedef struct pool_slot {
+
+  /** Sequence number (see queue_push and queue_pop) */
+  uint64_t seq;
+
+  /** Message held in the slot */
+  pool_msg_t *msg;
+
+} pool_slot_t;
+
+struct parsebgp_msg_pool {
+
+  /** Bounded MPMC queue of released messages (after Dmitry Vyukov's). Each slot
+      has a sequence number that says whether it is ready to be pushed to or
+      popped from at a given position, so positions are claimed with a single
+      CAS and there is no ABA problem. */
+  pool_slot_t *slots;
+
+  /** Number of slots - 1 (the number of slots is a power of two, and at least
+      two) */
+  uint64_t mask;
+
+  uint8_t _pad0[CACHE_LINE_LEN];
+
+  /** Position of the next push */
+  uint64_t tail;
+
+  uint8_t _pad1[CACHE_LINE_LEN];
+
+  /** Position of the next pop */
+  uint64_t head;
+
+  uint8_t _pad2[CACHE_LINE_LEN];
+};
+
+static int queue_push(parsebgp_msg_pool_t *pool, pool_msg_t *msg)
+{
+  pool_slot_t *slot;
+  uint64_t pos = __atomic_load_n(&pool->tail, __ATOMIC_RELAXED), seq;
+  int64_t dif;
+
+  while (1) {
+    slot = &pool->slots[pos & pool->mask];
+    seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+    dif = (int64_t)seq - (int64_t)pos;
+    if (dif == 0) {
+      // the slot is free at this position, so try to claim it
+      if (__atomic_compare_exchange_n(&pool->tail, &pos, pos + 1, 1,
+                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        break;
+      }
+    } else if (dif < 0) {
+      // the slot still holds a message from the previous lap: full
+      return -1;
+    } else {
+      // another thread pushed here first
+      pos = __atomic_load_n(&pool->tail, __ATOMIC_RELAXED);
+    }
+  }
+
+  slot->msg = msg;
+  __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+  return 0;
+}
+
+static pool_msg_t *queue_pop(parsebgp_msg_pool_t *pool)
+{
+  pool_slot_t *slot;
+  pool_msg_t *msg;
+  uint64_t pos = __atomic_load_n(&pool->head, __ATOMIC_RELAXED), seq;
+  int64_t dif;
+
+  while (1) {
+    slot = &pool->slots[pos & pool->mask];
+    seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+    dif = (int64_t)seq - (int64_t)(pos + 1);
+    if (dif == 0) {
+      // the slot holds a message at this position, so try to claim it
+      if (__atomic_compare_exchange_n(&pool->head, &pos, pos + 1, 1,
+                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        break;
+      }
+    } else if (dif < 0) {
+      // nothing has been pushed here yet: empty
+      return NULL;
+    } else {
+      // another thread popped here first
+      pos = __atomic_load_n(&pool->head, __ATOMIC_RELAXED);
+    }
+  }
+
+  msg = slot->msg;
+  // free the slot for the push of the next lap
+  __atomic_store_n(&slot->seq, pos + pool->mask + 1, __ATOMIC_RELEASE);
+  return msg;
+}
+
+static pool_msg_t *msg_create(parsebgp_msg_pool_t *pool)
+{
+  pool_msg_t *pm;
+
+  if ((pm = malloc_zero(sizeof(pool_msg_t))) == NULL) {
+    return NULL;
+  }
+  pm->pool = pool;
+  return pm;
+}
+
+static void msg_destroy(pool_msg_t *pm)
+{
+  // frees pm too (msg is its first field)
+  parsebgp_destroy_msg(&pm->msg);
+}
+
+/* -------------------- PUBLIC API -------------------- */
+
+parsebgp_msg_pool_t *parsebgp_msg_pool_create(int size)
+{
+  parsebgp_msg_pool_t *pool;
+  pool_msg_t *pm;
+  uint64_t slots_cnt = 2, i;
+  int j;
+
+  if (size < 0 || (pool = malloc_zero(sizeof(parsebgp_msg_pool_t))) == NULL) {
+    return NULL;
+  }
+
+  // the queue needs at least two slots to tell full from empty
+  while (slots_cnt < (uint64_t)size) {
+    slots_cnt <<= 1;
+  }
+  if ((pool->slots = malloc(sizeof(pool_slot_t) * slots_cnt)) == NULL) {
+    free(pool);
+    return NULL;
+  }
+  pool->mask = slots_cnt - 1;
+  for (i = 0; i < slots_cnt; i++) {
+    pool->slots[i].seq = i;
+    pool->slots[i].msg = NULL;
+  }
+
+  for (j = 0; j < size; j++) {
+    if ((pm = msg_create(pool)) == NULL) {
+      parsebgp_msg_pool_destroy(pool);
+      return NULL;
+    }
+    queue_push(pool, pm);
+  }
+
+  return pool;
+}
+
+void parsebgp_msg_pool_destroy(parsebgp_msg_pool_t *pool)
+{
+  pool_msg_t *pm;
+
+  if (pool == NULL) {
+    return;
+  }
+
+  while ((pm = queue_pop(pool)) != NULL) {
+    msg_destroy(pm);
+  }
+  free(pool->slots);
+  free(pool);
+}
+
+parsebgp_msg_t *parsebgp_msg_pool_acquire(parsebgp_msg_pool_t *pool)
+{
+  pool_msg_t *pm;
+
+  if ((pm = queue_pop(pool)) == NULL && (pm = msg_create(pool)) == NULL) {
+    return NULL;
+  }
+  // the message is not shared yet, so a plain store is enough
+  pm->refcnt = 1;
+  return &pm->msg;
+}
+
+const parsebgp_msg_t *parsebgp_msg_pool_ref(const parsebgp_msg_t *msg)
+{
+  pool_msg_t *pm = (pool_msg_t *)msg;
+
+  // the caller already holds a reference, so the count cannot drop to zero
+  // concurrently
+  __atomic_fetch_add(&pm->refcnt, 1, __ATOMIC_RELAXED);
+  return msg;
+}
+
+void parsebgp_msg_pool_release(const parsebgp_msg_t *msg)
+{
+  pool_msg_t *pm = (pool_msg_t *)msg;
+
+  if (msg == NULL) {
+    return;
+  }
+
+  // the release/acquire pair orders every thread's reads of the message
+  // before it is cleared
+  if (__atomic_sub_fetch(&pm->refcnt, 1, __ATOMIC_ACQ_REL) != 0) {
+    return;
+  }
+
+  // clearing keeps the allocated memory for the next user
+  parsebgp_clear_msg(&pm->msg);
+  if (queue_push(pm->pool, pm) != 0) {
+    // the pool is full
+    msg_destroy(pm);
+  }
+}
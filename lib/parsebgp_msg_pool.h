@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2017 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __PARSEBGP_MSG_POOL_H
+#define __PARSEBGP_MSG_POOL_H
+
+#include "parsebgp.h"
+#include <inttypes.h>
+
+/**
+ * Shared Message Pool
+ *
+ * Hands out message structures that can be shared between threads without
+ * copying. A message is acquired from the pool (with a reference count of one)
+ * by the thread that decodes into it, which then passes it on (e.g., through
+ * a queue) to any number of consumers, taking a reference for each. From then
+ * on, the message must be treated as immutable. When the last reference is
+ * released, the message is cleared and returned to the pool, keeping all of
+ * the memory that it had allocated, so that in steady state decoding into
+ * pooled messages allocates nothing.
+ *
+ * Reference counts are atomic, and the pool keeps released messages in a
+ * bounded lock-free queue, so acquire, reference and release may be called
+ * from any thread without locking. Passing a message to another thread must
+ * still happen-before it is used there (as it does through any queue that
+ * uses a mutex or atomics).
+ */
+typedef struct parsebgp_msg_pool parsebgp_msg_pool_t;
+
+/**
+ * Create a message pool
+ *
+ * @param size          Number of messages to create up front, which is also
+ *                      (rounded up to a power of two, and at least two) the
+ *                      number of released messages the pool keeps
+ * @return pointer to a new pool, or NULL if an error occurred
+ *
+ * If more messages are acquired than the pool holds, new messages are created,
+ * and any that are released while the pool is full are destroyed.
+ */
+parsebgp_msg_pool_t *parsebgp_msg_pool_create(int size);
+
+/**
+ * Destroy the given message pool
+ *
+ * @param pool          Pointer to the pool to destroy
+ *
+ * All messages acquired from the pool must have been released.
+ */
+void parsebgp_msg_pool_destroy(parsebgp_msg_pool_t *pool);
+
+/**
+ * Acquire an empty message from the given pool
+ *
+ * @param pool          Pointer to the pool
+ * @return pointer to an empty message with a reference count of one, or NULL
+ * if an error occurred
+ *
+ * The message must be released using parsebgp_msg_pool_release (and not
+ * destroyed using parsebgp_destroy_msg).
+ */
+parsebgp_msg_t *parsebgp_msg_pool_acquire(parsebgp_msg_pool_t *pool);
+
+/**
+ * Take another reference to the given pooled message
+ *
+ * @param msg           Pointer to a message acquired from a pool
+ * @return msg (for convenience)
+ */
+const parsebgp_msg_t *parsebgp_msg_pool_ref(const parsebgp_msg_t *msg);
+
+/**
+ * Release a reference to the given pooled message
+ *
+ * @param msg           Pointer to a message acquired from a pool
+ *
+ * If this was the last reference, the message is cleared and returned to its
+ * pool, and must no longer be used.
+ */
+void parsebgp_msg_pool_release(const parsebgp_msg_t *msg);
+
+#endif /* __PARSEBGP_MSG_POOL_H */
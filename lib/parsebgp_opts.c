@@ -33,4 +33,6 @@ void parsebgp_opts_init(parsebgp_opts_t *opts)
   memset(opts, 0, sizeof(*opts));
 
   parsebgp_bgp_opts_init(&opts->bgp);
+  parsebgp_bmp_opts_init(&opts->bmp);
+  parsebgp_mrt_opts_init(&opts->mrt);
 }
@@ -29,6 +29,59 @@
 
 #include "parsebgp_bgp_opts.h"
 #include "parsebgp_bmp_opts.h"
+#include "parsebgp_mrt_opts.h"
+
+/**
+ * Decode Budgets
+ *
+ * Each budget that is set (i.e., non-zero) limits the amount of work done to
+ * decode a single message (see the budget option).
+ */
+typedef enum parsebgp_budget_type {
+
+  /** No budget */
+  PARSEBGP_BUDGET_NONE = 0,
+
+  /** Prefixes, from all NLRI fields (including MP_REACH and MP_UNREACH) */
+  PARSEBGP_BUDGET_PREFIXES = 1,
+
+  /** Path Attributes, from all attribute lists (e.g., of all RIB entries) */
+  PARSEBGP_BUDGET_PATH_ATTRS = 2,
+
+  /** ASNs, from all AS_PATH and AS4_PATH attributes */
+  PARSEBGP_BUDGET_AS_PATH_ASNS = 3,
+
+  /** TABLE_DUMP_V2 RIB entries */
+  PARSEBGP_BUDGET_RIB_ENTRIES = 4,
+
+  /** Bytes of prefixes, path attributes and RIB entries */
+  PARSEBGP_BUDGET_BYTES = 5,
+
+} parsebgp_budget_type_t;
+
+/**
+ * Decode Budget Limits (or usage)
+ *
+ * Zero means unlimited. See parsebgp_budget_type_t for what each one counts.
+ */
+typedef struct parsebgp_budget {
+
+  /** Maximum number of prefixes */
+  uint32_t prefixes;
+
+  /** Maximum number of path attributes */
+  uint32_t path_attrs;
+
+  /** Maximum number of AS path ASNs */
+  uint32_t as_path_asns;
+
+  /** Maximum number of RIB entries */
+  uint32_t rib_entries;
+
+  /** Maximum number of bytes */
+  uint32_t bytes;
+
+} parsebgp_budget_t;
 
 /**
  * Parsing Options
@@ -83,12 +136,60 @@ typedef struct parsebgp_opts {
    */
   int silence_invalid;
 
+  /**
+   * Trim Interval
+   *
+   * If this is set (to K), then every K successful calls to parsebgp_decode
+   * with a given message structure, the memory retained by that structure is
+   * compared to the memory used by the largest of those K messages, and it is
+   * trimmed (see parsebgp_trim_msg) if it holds more than trim_factor times
+   * that amount. (The memory used by the largest message is estimated from the
+   * message just decoded, scaled by their lengths.) This bounds the memory a
+   * long-lived message structure keeps after decoding an unusually large
+   * message, at the cost of some extra allocations afterward.
+   *
+   * If this is **not** set (the default), message structures keep all the
+   * memory they have allocated until they are destroyed.
+   */
+  int trim_interval;
+
+  /**
+   * Trim Factor
+   *
+   * Ratio between the retained memory and the memory in use above which a
+   * message structure is trimmed (see trim_interval). Values less
+   * than 1 are treated as 1.
+   */
+  int trim_factor;
+
+  /**
+   * Decode Budgets
+   *
+   * If any of these are set, parsebgp_decode stops decoding a message once it
+   * has used up one of them, and returns PARSEBGP_BUDGET_EXCEEDED along with
+   * everything it decoded up to that point (which is a consistent, if
+   * incomplete, message). Decoding stops between items (prefixes, path
+   * attributes, AS path segments and RIB entries), so the work done for a
+   * message is bounded by the budgets rather than by its size. See
+   * parsebgp_redecode_full to get the complete message.
+   *
+   * None are set by default.
+   */
+  parsebgp_budget_t budget;
+
+  /** Budget usage of the current decode, which parsebgp_decode keeps on its
+      stack (INTERNAL) */
+  struct parsebgp_budget_state *_budget_state;
+
   /** BGP-specific parsing options */
   parsebgp_bgp_opts_t bgp;
 
   /** BMP-specific parsing options */
   parsebgp_bmp_opts_t bmp;
 
+  /** MRT-specific parsing options */
+  parsebgp_mrt_opts_t mrt;
+
 } parsebgp_opts_t;
 
 /**
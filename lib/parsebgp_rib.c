@@ -0,0 +1,1023 @@
+/*
+ * Copyright (C) 2017 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "parsebgp_rib.h"
+#include "parsebgp_bgp_update_impl.h"
+#include "parsebgp_utils.h"
+#include <stdlib.h>
+#include <string.h>
+
+/** Number of trie nodes allocated at a time */
+#define NODES_PER_SLAB 4096
+
+/** Initial number of slots in the hash indexes (a power of two) */
+#define INDEX_INIT_CNT 1024
+
+/** Deepest possible trie path (one node per prefix length) */
+#define TRIE_DEPTH_MAX 129
+
+/** Number of leading address bits used to index the stride table. Prefixes at
+    least this long are kept in one trie per value of these bits, which saves
+    the descent through the (sparse, and cache-missing) top of a single trie. */
+#define STRIDE_BITS 16
+#define STRIDE_CNT (1 << STRIDE_BITS)
+#define STRIDE_IDX(addr) (((addr)[0] << 8) | (addr)[1])
+
+/** Route of a peer for the prefix of a trie node */
+typedef struct route {
+
+  /** Index of the peer */
+  uint32_t peer;
+
+  /** ADD-PATH Path Identifier (0 if the peer does not use ADD-PATH) */
+  uint32_t path_id;
+
+  /** ID of the attribute set */
+  uint32_t attrs;
+
+} route_t;
+
+/** Trie node. Nodes without routes are only kept as branch points. */
+typedef struct node {
+
+  /** Prefix address (bits beyond len are zero) */
+  uint8_t addr[16];
+
+  /** Prefix length */
+  uint8_t len;
+
+  /** Children (by the value of bit len of the address) */
+  struct node *child[2];
+
+  /** Routes, sorted by peer index (and then by path ID) */
+  route_t *routes;
+
+  /** Number of routes */
+  uint32_t routes_cnt;
+
+  /** Allocated length of the routes array (INTERNAL) */
+  uint32_t _routes_alloc_cnt;
+
+} node_t;
+
+/** Block of trie nodes */
+typedef struct slab {
+
+  /** Nodes */
+  node_t nodes[NODES_PER_SLAB];
+
+  /** Next slab in the list of all slabs */
+  struct slab *next;
+
+} slab_t;
+
+/** Interned attribute set */
+typedef struct attrs {
+
+  /** Public information (pub.raw points into buf) */
+  parsebgp_rib_attrs_t pub;
+
+  /** Path Attributes Length field (2 bytes) followed by the raw attributes,
+      so that the buffer can be given straight to the decoder */
+  uint8_t *buf;
+
+  /** Next free ID (if the set is unused) */
+  uint32_t next_free;
+
+} attrs_t;
+
+/** Open-addressing hash index of IDs (0 marks an empty slot) */
+typedef struct index {
+
+  /** Slots */
+  uint32_t *slots;
+
+  /** Number of slots (a power of two) */
+  uint32_t slots_cnt;
+
+  /** Number of used slots */
+  uint32_t used_cnt;
+
+} index_t;
+
+struct parsebgp_rib {
+
+  /** Roots of the tries of prefixes shorter than STRIDE_BITS (IPv4, IPv6) */
+  node_t *short_roots[2];
+
+  /** Stride tables of trie roots for longer prefixes, indexed by the first
+      STRIDE_BITS of the address (IPv4, IPv6; allocated when first used) */
+  node_t **strides[2];
+
+  /** Slabs of trie nodes */
+  slab_t *slabs;
+
+  /** Number of nodes used from the newest slab */
+  int slab_used;
+
+  /** Freed nodes (linked through child[0]) */
+  node_t *free_nodes;
+
+  /** Peers, by index */
+  parsebgp_rib_peer_t *peers;
+
+  /** Number of peers */
+  uint32_t peers_cnt;
+
+  /** Allocated length of the peers array (INTERNAL) */
+  uint32_t _peers_alloc_cnt;
+
+  /** Index of peers (slots hold peer index + 1) */
+  index_t peers_index;
+
+  /** Attribute sets, by ID (ID 0 is unused) */
+  attrs_t *attrs;
+
+  /** Number of attribute set IDs in use (including freed IDs) */
+  uint32_t attrs_ids_cnt;
+
+  /** Allocated length of the attrs array (INTERNAL) */
+  uint32_t _attrs_alloc_cnt;
+
+  /** First free attribute set ID (or 0) */
+  uint32_t attrs_free;
+
+  /** Index of attribute sets (slots hold attribute set IDs) */
+  index_t attrs_index;
+
+  /** Statistics */
+  parsebgp_rib_stats_t stats;
+
+  /** Total allocated length of all routes arrays */
+  uint64_t routes_alloc_cnt;
+
+  /** Total length of all attribute buffers */
+  uint64_t attrs_bytes;
+};
+
+#define AFI_IDX(afi) ((afi) == PARSEBGP_BGP_AFI_IPV4 ? 0 : 1)
+#define AFI_ADDR_LEN(afi) ((afi) == PARSEBGP_BGP_AFI_IPV4 ? 4 : 16)
+
+#define BIT(addr, i) (((addr)[(i) >> 3] >> (7 - ((i)&7))) & 1)
+
+/* ========== HASH INDEXES ========== */
+
+static int index_init(index_t *idx)
+{
+  if ((idx->slots = calloc(INDEX_INIT_CNT, sizeof(uint32_t))) == NULL) {
+    return -1;
+  }
+  idx->slots_cnt = INDEX_INIT_CNT;
+  idx->used_cnt = 0;
+  return 0;
+}
+
+static uint64_t peer_hash(parsebgp_bgp_afi_t afi, const uint8_t *ip,
+                          uint32_t asn)
+{
+  return parsebgp_hash(ip, AFI_ADDR_LEN(afi), ((uint64_t)asn << 8) | afi);
+}
+
+static uint64_t attrs_hash(const parsebgp_rib_attrs_t *key)
+{
+  return parsebgp_hash(key->raw, key->raw_len,
+                       parsebgp_hash(key->next_hop, sizeof(key->next_hop),
+                                     (key->next_hop_afi << 1) |
+                                       key->asn_4_byte));
+}
+
+static int attrs_equal(const parsebgp_rib_attrs_t *a,
+                       const parsebgp_rib_attrs_t *b)
+{
+  return a->hash == b->hash && a->raw_len == b->raw_len &&
+         a->asn_4_byte == b->asn_4_byte && a->next_hop_afi == b->next_hop_afi &&
+         memcmp(a->next_hop, b->next_hop, sizeof(a->next_hop)) == 0 &&
+         memcmp(a->raw, b->raw, a->raw_len) == 0;
+}
+
+// double the number of slots, re-inserting IDs using the given hashes
+static int index_grow(index_t *idx, const parsebgp_rib_t *rib, int peers)
+{
+  uint32_t cnt = idx->slots_cnt * 2, i, id, s;
+  uint32_t *slots;
+  uint64_t hash;
+  const parsebgp_rib_peer_t *peer;
+
+  if ((slots = calloc(cnt, sizeof(uint32_t))) == NULL) {
+    return -1;
+  }
+  for (i = 0; i < idx->slots_cnt; i++) {
+    if ((id = idx->slots[i]) == 0) {
+      continue;
+    }
+    if (peers) {
+      peer = &rib->peers[id - 1];
+      hash = peer_hash(peer->afi, peer->ip, peer->asn);
+    } else {
+      hash = rib->attrs[id].pub.hash;
+    }
+    for (s = hash & (cnt - 1); slots[s] != 0; s = (s + 1) & (cnt - 1))
+      ;
+    slots[s] = id;
+  }
+  free(idx->slots);
+  idx->slots = slots;
+  idx->slots_cnt = cnt;
+  return 0;
+}
+
+/* ========== PEERS ========== */
+
+// find (or create) the peer of the given elem, returning its index or -1
+static int64_t peer_get(parsebgp_rib_t *rib, const parsebgp_elem_t *elem,
+                        int create)
+{
+  index_t *idx = &rib->peers_index;
+  uint64_t hash;
+  uint32_t s, mask, alloc_cnt;
+  parsebgp_rib_peer_t *peer, *tmp;
+  int alen;
+
+  if (elem->peer_afi != PARSEBGP_BGP_AFI_IPV4 &&
+      elem->peer_afi != PARSEBGP_BGP_AFI_IPV6) {
+    return -1;
+  }
+  alen = AFI_ADDR_LEN(elem->peer_afi);
+  hash = peer_hash(elem->peer_afi, elem->peer_ip, elem->peer_asn);
+
+  mask = idx->slots_cnt - 1;
+  for (s = hash & mask; idx->slots[s] != 0; s = (s + 1) & mask) {
+    peer = &rib->peers[idx->slots[s] - 1];
+    if (peer->afi == elem->peer_afi && peer->asn == elem->peer_asn &&
+        memcmp(peer->ip, elem->peer_ip, alen) == 0) {
+      return peer->idx;
+    }
+  }
+  if (!create) {
+    return -1;
+  }
+
+  if (rib->peers_cnt == rib->_peers_alloc_cnt) {
+    alloc_cnt = rib->_peers_alloc_cnt ? rib->_peers_alloc_cnt * 2 : 64;
+    if ((tmp = realloc(rib->peers, alloc_cnt * sizeof(*tmp))) == NULL) {
+      return -1;
+    }
+    rib->peers = tmp;
+    rib->_peers_alloc_cnt = alloc_cnt;
+  }
+  peer = &rib->peers[rib->peers_cnt];
+  memset(peer, 0, sizeof(*peer));
+  peer->idx = rib->peers_cnt++;
+  peer->afi = elem->peer_afi;
+  memcpy(peer->ip, elem->peer_ip, alen);
+  peer->asn = elem->peer_asn;
+
+  idx->slots[s] = peer->idx + 1;
+  if (++idx->used_cnt * 2 > idx->slots_cnt && index_grow(idx, rib, 1) != 0) {
+    return -1;
+  }
+  return peer->idx;
+}
+
+/* ========== ATTRIBUTE SETS ========== */
+
+// intern the attributes of the given elem, returning a referenced ID (or 0)
+static uint32_t attrs_ref(parsebgp_rib_t *rib, const parsebgp_elem_t *elem)
+{
+  const parsebgp_bgp_update_path_attrs_t *path_attrs = elem->path_attrs;
+  const parsebgp_bgp_update_path_attr_t *as_path;
+  index_t *idx = &rib->attrs_index;
+  parsebgp_rib_attrs_t key;
+  uint32_t s, mask, id, alloc_cnt;
+  attrs_t *attrs, *tmp;
+
+  memset(&key, 0, sizeof(key));
+  key.raw = path_attrs->raw;
+  key.raw_len = path_attrs->raw_len;
+  as_path = &path_attrs->attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_AS_PATH];
+  key.asn_4_byte = PARSEBGP_BGP_UPDATE_ATTR_PRESENT(
+                     path_attrs, PARSEBGP_BGP_PATH_ATTR_TYPE_AS_PATH)
+                     ? as_path->data.as_path->asn_4_byte
+                     : 1;
+  key.next_hop_afi = elem->next_hop_afi;
+  if (elem->next_hop_afi != 0) {
+    memcpy(key.next_hop, elem->next_hop, sizeof(key.next_hop));
+  }
+  key.hash = attrs_hash(&key);
+
+  mask = idx->slots_cnt - 1;
+  for (s = key.hash & mask; idx->slots[s] != 0; s = (s + 1) & mask) {
+    attrs = &rib->attrs[idx->slots[s]];
+    if (attrs_equal(&attrs->pub, &key)) {
+      attrs->pub.refcnt++;
+      return idx->slots[s];
+    }
+  }
+
+  // new attribute set
+  if ((id = rib->attrs_free) != 0) {
+    rib->attrs_free = rib->attrs[id].next_free;
+  } else {
+    if (rib->attrs_ids_cnt + 1 >= rib->_attrs_alloc_cnt) {
+      alloc_cnt = rib->_attrs_alloc_cnt ? rib->_attrs_alloc_cnt * 2 : 1024;
+      if ((tmp = realloc(rib->attrs, alloc_cnt * sizeof(*tmp))) == NULL) {
+        return 0;
+      }
+      rib->attrs = tmp;
+      rib->_attrs_alloc_cnt = alloc_cnt;
+    }
+    id = ++rib->attrs_ids_cnt;
+  }
+  attrs = &rib->attrs[id];
+  memset(attrs, 0, sizeof(*attrs));
+  if ((attrs->buf = malloc(key.raw_len + 2)) == NULL) {
+    attrs->next_free = rib->attrs_free;
+    rib->attrs_free = id;
+    return 0;
+  }
+  attrs->buf[0] = key.raw_len >> 8;
+  attrs->buf[1] = key.raw_len & 0xFF;
+  memcpy(attrs->buf + 2, key.raw, key.raw_len);
+  attrs->pub = key;
+  attrs->pub.raw = attrs->buf + 2;
+  attrs->pub.refcnt = 1;
+  rib->attrs_bytes += key.raw_len + 2;
+  rib->stats.attrs_cnt++;
+
+  idx->slots[s] = id;
+  if (++idx->used_cnt * 2 > idx->slots_cnt) {
+    // on failure, the index is just fuller than it should be
+    index_grow(idx, rib, 0);
+  }
+  return id;
+}
+
+static void attrs_unref(parsebgp_rib_t *rib, uint32_t id)
+{
+  attrs_t *attrs = &rib->attrs[id];
+  index_t *idx = &rib->attrs_index;
+  uint32_t s, n, home, mask = idx->slots_cnt - 1;
+
+  if (--attrs->pub.refcnt > 0) {
+    return;
+  }
+
+  // remove from the index, shifting back any entries that probed past it
+  for (s = attrs->pub.hash & mask; idx->slots[s] != id; s = (s + 1) & mask)
+    ;
+  for (n = (s + 1) & mask; idx->slots[n] != 0; n = (n + 1) & mask) {
+    home = rib->attrs[idx->slots[n]].pub.hash & mask;
+    // can the entry at n move to s (i.e., is s cyclically within [home, n))?
+    if (((n - home) & mask) >= ((n - s) & mask)) {
+      idx->slots[s] = idx->slots[n];
+      s = n;
+    }
+  }
+  idx->slots[s] = 0;
+  idx->used_cnt--;
+
+  rib->attrs_bytes -= attrs->pub.raw_len + 2;
+  rib->stats.attrs_cnt--;
+  free(attrs->buf);
+  attrs->buf = NULL;
+  attrs->next_free = rib->attrs_free;
+  rib->attrs_free = id;
+}
+
+/* ========== TRIE ========== */
+
+static node_t *node_alloc(parsebgp_rib_t *rib, const uint8_t *addr,
+                          uint8_t len)
+{
+  node_t *node;
+  slab_t *slab;
+  int i;
+
+  if ((node = rib->free_nodes) != NULL) {
+    rib->free_nodes = node->child[0];
+  } else {
+    if (rib->slabs == NULL || rib->slab_used == NODES_PER_SLAB) {
+      if ((slab = malloc(sizeof(slab_t))) == NULL) {
+        return NULL;
+      }
+      slab->next = rib->slabs;
+      rib->slabs = slab;
+      rib->slab_used = 0;
+    }
+    node = &rib->slabs->nodes[rib->slab_used++];
+  }
+  memset(node, 0, sizeof(*node));
+
+  // copy the address, zeroing the bits beyond the prefix length
+  memcpy(node->addr, addr, (len + 7) / 8);
+  if ((i = len % 8) != 0) {
+    node->addr[len / 8] &= 0xFF << (8 - i);
+  }
+  node->len = len;
+  rib->stats.nodes_cnt++;
+  return node;
+}
+
+static void node_free(parsebgp_rib_t *rib, node_t *node)
+{
+  rib->routes_alloc_cnt -= node->_routes_alloc_cnt;
+  free(node->routes);
+  node->routes = NULL;
+  node->child[0] = rib->free_nodes;
+  rib->free_nodes = node;
+  rib->stats.nodes_cnt--;
+}
+
+// number of leading bits that two addresses have in common (up to max)
+static int common_bits(const uint8_t *a, const uint8_t *b, int max)
+{
+  int i = 0, bits;
+  uint8_t x;
+
+  while (i < max && a[i / 8] == b[i / 8]) {
+    i += 8;
+  }
+  if (i < max) {
+    x = a[i / 8] ^ b[i / 8];
+    for (bits = 0; !(x & 0x80); bits++, x <<= 1)
+      ;
+    i += bits;
+  }
+  return i < max ? i : max;
+}
+
+// find the node for the given prefix, creating it if needed. if path is given,
+// it is filled with the pointers leading to the node (path[depth - 1] points
+// to the node itself)
+static node_t *node_get(parsebgp_rib_t *rib, node_t **root,
+                        const uint8_t *addr, uint8_t len, int create,
+                        node_t ***path, int *depth)
+{
+  node_t **pp = root, *node, *glue, *leaf;
+  int common, d = 0;
+
+  while ((node = *pp) != NULL) {
+    if (path != NULL) {
+      path[d++] = pp;
+    }
+    common = common_bits(node->addr, addr, node->len < len ? node->len : len);
+    if (common == node->len) {
+      if (node->len == len) {
+        if (depth != NULL) {
+          *depth = d;
+        }
+        return node;
+      }
+      // the node covers the prefix, keep going
+      pp = &node->child[BIT(addr, node->len)];
+      continue;
+    }
+
+    // the prefix diverges from (or covers) the node
+    if (!create) {
+      return NULL;
+    }
+    if ((leaf = node_alloc(rib, addr, len)) == NULL) {
+      return NULL;
+    }
+    if (common == len) {
+      // the new node covers the existing node
+      leaf->child[BIT(node->addr, len)] = node;
+      *pp = leaf;
+      return leaf;
+    }
+    // add a branch point where they diverge
+    if ((glue = node_alloc(rib, addr, common)) == NULL) {
+      node_free(rib, leaf);
+      return NULL;
+    }
+    glue->child[BIT(addr, common)] = leaf;
+    glue->child[BIT(node->addr, common)] = node;
+    *pp = glue;
+    return leaf;
+  }
+
+  if (!create) {
+    return NULL;
+  }
+  return (*pp = node_alloc(rib, addr, len));
+}
+
+// remove the node that pp points to if it has no routes and is not needed as
+// a branch point
+static void node_collapse(parsebgp_rib_t *rib, node_t **pp)
+{
+  node_t *node = *pp;
+
+  if (node == NULL || node->routes_cnt > 0 ||
+      (node->child[0] != NULL && node->child[1] != NULL)) {
+    return;
+  }
+  *pp = (node->child[0] != NULL) ? node->child[0] : node->child[1];
+  node_free(rib, node);
+}
+
+// find the route with the given peer and path ID in the node (or where it
+// would go)
+static uint32_t route_find(const node_t *node, uint32_t peer, uint32_t path_id)
+{
+  uint32_t lo = 0, hi = node->routes_cnt, mid;
+  const route_t *r;
+
+  while (lo < hi) {
+    mid = (lo + hi) / 2;
+    r = &node->routes[mid];
+    if (r->peer < peer || (r->peer == peer && r->path_id < path_id)) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+// does the i'th route of the node have the given peer and path ID
+#define ROUTE_MATCH(node, i, peer_, path_id_)                                  \
+  ((i) < (node)->routes_cnt && (node)->routes[i].peer == (peer_) &&            \
+   (node)->routes[i].path_id == (path_id_))
+
+static parsebgp_error_t route_set(parsebgp_rib_t *rib, node_t *node,
+                                  uint32_t peer, uint32_t path_id,
+                                  uint32_t attrs)
+{
+  uint32_t i = route_find(node, peer, path_id), alloc_cnt;
+  route_t *tmp;
+
+  if (ROUTE_MATCH(node, i, peer, path_id)) {
+    attrs_unref(rib, node->routes[i].attrs);
+    node->routes[i].attrs = attrs;
+    return PARSEBGP_OK;
+  }
+
+  if (node->routes_cnt == node->_routes_alloc_cnt) {
+    alloc_cnt = node->_routes_alloc_cnt ? node->_routes_alloc_cnt * 2 : 1;
+    if ((tmp = realloc(node->routes, alloc_cnt * sizeof(route_t))) == NULL) {
+      attrs_unref(rib, attrs);
+      return PARSEBGP_MALLOC_FAILURE;
+    }
+    rib->routes_alloc_cnt += alloc_cnt - node->_routes_alloc_cnt;
+    node->routes = tmp;
+    node->_routes_alloc_cnt = alloc_cnt;
+  }
+  memmove(&node->routes[i + 1], &node->routes[i],
+          (node->routes_cnt - i) * sizeof(route_t));
+  node->routes[i].peer = peer;
+  node->routes[i].path_id = path_id;
+  node->routes[i].attrs = attrs;
+  if (node->routes_cnt++ == 0) {
+    rib->stats.prefixes_cnt++;
+  }
+  rib->peers[peer].routes_cnt++;
+  rib->stats.routes_cnt++;
+  return PARSEBGP_OK;
+}
+
+// remove cnt routes starting at the i'th route of the node
+static void routes_remove(parsebgp_rib_t *rib, node_t *node, uint32_t i,
+                          uint32_t cnt)
+{
+  uint32_t j;
+
+  if (cnt == 0) {
+    return;
+  }
+  for (j = i; j < i + cnt; j++) {
+    attrs_unref(rib, node->routes[j].attrs);
+    rib->peers[node->routes[j].peer].routes_cnt--;
+  }
+  memmove(&node->routes[i], &node->routes[i + cnt],
+          (node->routes_cnt - i - cnt) * sizeof(route_t));
+  node->routes_cnt -= cnt;
+  if (node->routes_cnt == 0) {
+    rib->stats.prefixes_cnt--;
+  }
+  rib->stats.routes_cnt -= cnt;
+}
+
+// remove the route with the given peer and path ID from the node (returns 0 if
+// there was no route)
+static int route_del(parsebgp_rib_t *rib, node_t *node, uint32_t peer,
+                     uint32_t path_id)
+{
+  uint32_t i = route_find(node, peer, path_id);
+
+  if (!ROUTE_MATCH(node, i, peer, path_id)) {
+    return 0;
+  }
+  routes_remove(rib, node, i, 1);
+  return 1;
+}
+
+// remove all routes (i.e., all paths) of the given peer from the node
+static void route_del_peer(parsebgp_rib_t *rib, node_t *node, uint32_t peer)
+{
+  uint32_t i = route_find(node, peer, 0), j = i;
+
+  while (j < node->routes_cnt && node->routes[j].peer == peer) {
+    j++;
+  }
+  routes_remove(rib, node, i, j - i);
+}
+
+static void flush_subtree(parsebgp_rib_t *rib, node_t **pp, uint32_t peer)
+{
+  node_t *node = *pp;
+
+  if (node == NULL) {
+    return;
+  }
+  flush_subtree(rib, &node->child[0], peer);
+  flush_subtree(rib, &node->child[1], peer);
+  route_del_peer(rib, node, peer);
+  node_collapse(rib, pp);
+}
+
+static void free_subtree(node_t *node)
+{
+  if (node == NULL) {
+    return;
+  }
+  free_subtree(node->child[0]);
+  free_subtree(node->child[1]);
+  free(node->routes);
+}
+
+// find the root of the trie for the given prefix (or NULL if there is none and
+// create is not set)
+static node_t **root_get(parsebgp_rib_t *rib, parsebgp_bgp_afi_t afi,
+                         const uint8_t *addr, uint8_t len, int create)
+{
+  node_t ***strides = &rib->strides[AFI_IDX(afi)];
+
+  if (len < STRIDE_BITS) {
+    return &rib->short_roots[AFI_IDX(afi)];
+  }
+  if (*strides == NULL &&
+      (!create || (*strides = calloc(STRIDE_CNT, sizeof(node_t *))) == NULL)) {
+    return NULL;
+  }
+  return &(*strides)[STRIDE_IDX(addr)];
+}
+
+/** State of a walk */
+typedef struct walk {
+
+  /** RIB being walked */
+  const parsebgp_rib_t *rib;
+
+  /** Route passed to the callback */
+  parsebgp_rib_route_t route;
+
+  /** Callback */
+  parsebgp_rib_walk_cb_t *cb;
+
+  /** User pointer */
+  void *user;
+
+  /** Stride table of the address family being walked (or NULL) */
+  node_t *const *strides;
+
+  /** Index of the next stride table entry to walk */
+  uint32_t stride_next;
+
+} walk_t;
+
+static int walk_subtree(walk_t *w, const node_t *node, int is_short);
+
+// walk the stride table tries up to (but not including) the given index
+static int walk_strides(walk_t *w, uint32_t end)
+{
+  int rc;
+
+  if (w->strides == NULL) {
+    return 0;
+  }
+  for (; w->stride_next < end; w->stride_next++) {
+    if ((rc = walk_subtree(w, w->strides[w->stride_next], 0)) != 0) {
+      return rc;
+    }
+  }
+  return 0;
+}
+
+static int walk_subtree(walk_t *w, const node_t *node, int is_short)
+{
+  parsebgp_rib_route_t *route = &w->route;
+  uint32_t i;
+  int rc;
+
+  if (node == NULL) {
+    return 0;
+  }
+  if (node->routes_cnt > 0) {
+    // a short prefix comes after the longer prefixes in the stride table
+    // entries before the first entry that it covers
+    if (is_short && (rc = walk_strides(w, STRIDE_IDX(node->addr))) != 0) {
+      return rc;
+    }
+    route->prefix.len = node->len;
+    memcpy(route->prefix.addr, node->addr, sizeof(node->addr));
+    for (i = 0; i < node->routes_cnt; i++) {
+      route->prefix.path_id = node->routes[i].path_id;
+      route->peer = &w->rib->peers[node->routes[i].peer];
+      route->attrs = &w->rib->attrs[node->routes[i].attrs].pub;
+      if ((rc = w->cb(w->user, route)) != 0) {
+        return rc;
+      }
+    }
+  }
+  if ((rc = walk_subtree(w, node->child[0], is_short)) != 0) {
+    return rc;
+  }
+  return walk_subtree(w, node->child[1], is_short);
+}
+
+/* ========== PUBLIC API FUNCTIONS ========== */
+
+parsebgp_rib_t *parsebgp_rib_create(void)
+{
+  parsebgp_rib_t *rib;
+
+  if ((rib = malloc_zero(sizeof(parsebgp_rib_t))) == NULL) {
+    return NULL;
+  }
+  if (index_init(&rib->peers_index) != 0 ||
+      index_init(&rib->attrs_index) != 0) {
+    parsebgp_rib_destroy(rib);
+    return NULL;
+  }
+  return rib;
+}
+
+void parsebgp_rib_destroy(parsebgp_rib_t *rib)
+{
+  slab_t *slab;
+  uint32_t i;
+  int afi;
+
+  if (rib == NULL) {
+    return;
+  }
+
+  for (afi = 0; afi < 2; afi++) {
+    free_subtree(rib->short_roots[afi]);
+    for (i = 0; rib->strides[afi] != NULL && i < STRIDE_CNT; i++) {
+      free_subtree(rib->strides[afi][i]);
+    }
+    free(rib->strides[afi]);
+  }
+  while ((slab = rib->slabs) != NULL) {
+    rib->slabs = slab->next;
+    free(slab);
+  }
+  for (i = 1; i <= rib->attrs_ids_cnt; i++) {
+    free(rib->attrs[i].buf);
+  }
+  free(rib->attrs);
+  free(rib->attrs_index.slots);
+  free(rib->peers);
+  free(rib->peers_index.slots);
+  free(rib);
+}
+
+parsebgp_error_t parsebgp_rib_apply_elem(parsebgp_rib_t *rib,
+                                         const parsebgp_elem_t *elem)
+{
+  node_t **root, *node, **path[TRIE_DEPTH_MAX];
+  int64_t peer;
+  uint32_t attrs;
+  int depth = 0;
+  parsebgp_error_t err;
+
+  switch (elem->type) {
+  case PARSEBGP_ELEM_TYPE_RIB:
+  case PARSEBGP_ELEM_TYPE_ANNOUNCE:
+  case PARSEBGP_ELEM_TYPE_WITHDRAW:
+    if (elem->prefix.safi != PARSEBGP_BGP_SAFI_UNICAST ||
+        (elem->prefix.afi != PARSEBGP_BGP_AFI_IPV4 &&
+         elem->prefix.afi != PARSEBGP_BGP_AFI_IPV6) ||
+        elem->prefix.len > AFI_ADDR_LEN(elem->prefix.afi) * 8) {
+      return PARSEBGP_OK;
+    }
+    break;
+
+  case PARSEBGP_ELEM_TYPE_PEER_STATE:
+    if (elem->new_state != PARSEBGP_MRT_FSM_CODE_ESTABLISHED &&
+        (peer = peer_get(rib, elem, 0)) >= 0) {
+      parsebgp_rib_flush_peer(rib, peer);
+    }
+    return PARSEBGP_OK;
+
+  default:
+    return PARSEBGP_OK;
+  }
+
+  if (elem->type == PARSEBGP_ELEM_TYPE_WITHDRAW) {
+    if ((peer = peer_get(rib, elem, 0)) < 0 ||
+        (root = root_get(rib, elem->prefix.afi, elem->prefix.addr,
+                         elem->prefix.len, 0)) == NULL ||
+        (node = node_get(rib, root, elem->prefix.addr, elem->prefix.len, 0,
+                         path, &depth)) == NULL ||
+        route_del(rib, node, peer, elem->prefix.path_id) == 0) {
+      return PARSEBGP_OK;
+    }
+    // removing the node may leave its parent as a needless branch point
+    node_collapse(rib, path[depth - 1]);
+    if (depth > 1) {
+      node_collapse(rib, path[depth - 2]);
+    }
+    return PARSEBGP_OK;
+  }
+
+  if (elem->path_attrs == NULL ||
+      (elem->path_attrs->raw == NULL && elem->path_attrs->len != 0)) {
+    // the decoder was not asked to copy the raw attributes
+    return PARSEBGP_INVALID_MSG;
+  }
+  if ((peer = peer_get(rib, elem, 1)) < 0) {
+    return (elem->peer_afi == PARSEBGP_BGP_AFI_IPV4 ||
+            elem->peer_afi == PARSEBGP_BGP_AFI_IPV6)
+             ? PARSEBGP_MALLOC_FAILURE
+             : PARSEBGP_OK;
+  }
+  if ((root = root_get(rib, elem->prefix.afi, elem->prefix.addr,
+                       elem->prefix.len, 1)) == NULL ||
+      (attrs = attrs_ref(rib, elem)) == 0) {
+    return PARSEBGP_MALLOC_FAILURE;
+  }
+  if ((node = node_get(rib, root, elem->prefix.addr, elem->prefix.len, 1,
+                       NULL, NULL)) == NULL) {
+    attrs_unref(rib, attrs);
+    return PARSEBGP_MALLOC_FAILURE;
+  }
+  if ((err = route_set(rib, node, peer, elem->prefix.path_id, attrs)) !=
+      PARSEBGP_OK) {
+    return err;
+  }
+  return PARSEBGP_OK;
+}
+
+parsebgp_error_t parsebgp_rib_apply_msg(parsebgp_rib_t *rib,
+                                        parsebgp_elem_gen_t *gen,
+                                        const parsebgp_msg_t *msg)
+{
+  parsebgp_elem_t *elem;
+  parsebgp_error_t err;
+
+  if ((err = parsebgp_elem_gen_reset(gen, msg)) != PARSEBGP_OK) {
+    return err;
+  }
+  while ((elem = parsebgp_elem_gen_next(gen)) != NULL) {
+    if ((err = parsebgp_rib_apply_elem(rib, elem)) != PARSEBGP_OK) {
+      return err;
+    }
+  }
+  return PARSEBGP_OK;
+}
+
+void parsebgp_rib_flush_peer(parsebgp_rib_t *rib, uint32_t peer_idx)
+{
+  uint32_t i;
+  int afi;
+
+  if (peer_idx >= rib->peers_cnt || rib->peers[peer_idx].routes_cnt == 0) {
+    return;
+  }
+  for (afi = 0; afi < 2; afi++) {
+    flush_subtree(rib, &rib->short_roots[afi], peer_idx);
+    for (i = 0; rib->strides[afi] != NULL && i < STRIDE_CNT; i++) {
+      flush_subtree(rib, &rib->strides[afi][i], peer_idx);
+    }
+  }
+}
+
+const parsebgp_rib_attrs_t *
+parsebgp_rib_lookup(const parsebgp_rib_t *rib,
+                    const parsebgp_bgp_prefix_t *prefix, uint32_t peer_idx)
+{
+  // node_get only modifies the RIB when asked to create the node
+  parsebgp_rib_t *r = (parsebgp_rib_t *)rib;
+  node_t **root, *node;
+  uint32_t i;
+
+  if ((prefix->afi != PARSEBGP_BGP_AFI_IPV4 &&
+       prefix->afi != PARSEBGP_BGP_AFI_IPV6) ||
+      (root = root_get(r, prefix->afi, prefix->addr, prefix->len, 0)) ==
+        NULL ||
+      (node = node_get(r, root, prefix->addr, prefix->len, 0, NULL, NULL)) ==
+        NULL) {
+    return NULL;
+  }
+  i = route_find(node, peer_idx, prefix->path_id);
+  if (!ROUTE_MATCH(node, i, peer_idx, prefix->path_id)) {
+    return NULL;
+  }
+  return &rib->attrs[node->routes[i].attrs].pub;
+}
+
+const parsebgp_rib_peer_t *parsebgp_rib_get_peer(const parsebgp_rib_t *rib,
+                                                 uint32_t peer_idx)
+{
+  return (peer_idx < rib->peers_cnt) ? &rib->peers[peer_idx] : NULL;
+}
+
+int parsebgp_rib_walk(const parsebgp_rib_t *rib, parsebgp_rib_walk_cb_t *cb,
+                      void *user)
+{
+  walk_t w;
+  int afi, rc;
+
+  memset(&w, 0, sizeof(w));
+  w.rib = rib;
+  w.cb = cb;
+  w.user = user;
+  w.route.prefix.safi = PARSEBGP_BGP_SAFI_UNICAST;
+
+  for (afi = PARSEBGP_BGP_AFI_IPV4; afi <= PARSEBGP_BGP_AFI_IPV6; afi++) {
+    w.route.prefix.type = (afi == PARSEBGP_BGP_AFI_IPV4)
+                            ? PARSEBGP_BGP_PREFIX_UNICAST_IPV4
+                            : PARSEBGP_BGP_PREFIX_UNICAST_IPV6;
+    w.route.prefix.afi = afi;
+    w.strides = rib->strides[AFI_IDX(afi)];
+    w.stride_next = 0;
+    if ((rc = walk_subtree(&w, rib->short_roots[AFI_IDX(afi)], 1)) != 0 ||
+        (rc = walk_strides(&w, STRIDE_CNT)) != 0) {
+      return rc;
+    }
+  }
+  return 0;
+}
+
+void parsebgp_rib_get_stats(const parsebgp_rib_t *rib,
+                            parsebgp_rib_stats_t *stats)
+{
+  slab_t *slab;
+
+  *stats = rib->stats;
+  stats->peers_cnt = rib->peers_cnt;
+
+  stats->mem_bytes = sizeof(parsebgp_rib_t);
+  for (slab = rib->slabs; slab != NULL; slab = slab->next) {
+    stats->mem_bytes += sizeof(slab_t);
+  }
+  stats->mem_bytes += rib->routes_alloc_cnt * sizeof(route_t);
+  stats->mem_bytes += rib->_peers_alloc_cnt * sizeof(parsebgp_rib_peer_t);
+  stats->mem_bytes += rib->_attrs_alloc_cnt * sizeof(attrs_t);
+  stats->mem_bytes += rib->attrs_bytes;
+  stats->mem_bytes +=
+    (rib->peers_index.slots_cnt + rib->attrs_index.slots_cnt) *
+    sizeof(uint32_t);
+  stats->mem_bytes += ((rib->strides[0] != NULL) + (rib->strides[1] != NULL)) *
+                      STRIDE_CNT * sizeof(node_t *);
+}
+
+parsebgp_error_t
+parsebgp_rib_attrs_decode(const parsebgp_rib_attrs_t *attrs,
+                          parsebgp_bgp_update_path_attrs_t *path_attrs)
+{
+  parsebgp_opts_t opts;
+  size_t len = attrs->raw_len + 2;
+
+  parsebgp_opts_init(&opts);
+  opts.bgp.asn_4_byte = attrs->asn_4_byte;
+  opts.bgp.asn_4_byte_trusted = 1;
+
+  parsebgp_bgp_update_path_attrs_clear(path_attrs);
+  // the Path Attributes Length field is stored just before the raw data
+  return parsebgp_bgp_update_path_attrs_decode(&opts, path_attrs,
+                                               attrs->raw - 2, &len, len);
+}
+
+void parsebgp_rib_path_attrs_destroy(
+  parsebgp_bgp_update_path_attrs_t *path_attrs)
+{
+  parsebgp_bgp_update_path_attrs_destroy(path_attrs);
+}
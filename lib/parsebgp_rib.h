@@ -0,0 +1,288 @@
+/*
+ * Copyright (C) 2017 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __PARSEBGP_RIB_H
+#define __PARSEBGP_RIB_H
+
+#include "parsebgp_elem.h"
+#include <inttypes.h>
+
+/**
+ * RIB (Adj-RIB-In) Reconstruction
+ *
+ * Maintains the routes of many peers, as built from TABLE_DUMP_V2 snapshots
+ * and kept up to date by BGP4MP (or BMP) updates. Routes are applied one elem
+ * at a time, so anything that the elem generator understands can be used.
+ *
+ * Prefixes are stored in path-compressed binary tries, with a table indexed by
+ * the first 16 bits of the address in front of them (so that lookups skip the
+ * top of the trie), and the routes of all peers for a prefix kept in a single
+ * array on the trie node. The attributes of each route are interned: routes with the same
+ * path attributes and next hop share one reference-counted attribute set, so
+ * a route costs only a (peer, path ID, attribute set) triple.
+ *
+ * Attribute sets are keyed on the raw bytes of the path attributes, so
+ * messages MUST be decoded with the bgp.path_attrs_copy_raw option set.
+ *
+ * Only unicast routes are kept. Routes are keyed by peer, prefix and ADD-PATH
+ * Path Identifier, so a peer may have several paths for a prefix. A RIB must
+ * only be used by one thread at a time.
+ */
+typedef struct parsebgp_rib parsebgp_rib_t;
+
+/**
+ * RIB Peer
+ */
+typedef struct parsebgp_rib_peer {
+
+  /** Index of the peer in the RIB (peers are never removed, so indexes are
+      stable) */
+  uint32_t idx;
+
+  /** AFI of the peer address */
+  parsebgp_bgp_afi_t afi;
+
+  /** Peer address */
+  uint8_t ip[16];
+
+  /** Peer ASN */
+  uint32_t asn;
+
+  /** Number of routes from this peer currently in the RIB */
+  uint64_t routes_cnt;
+
+} parsebgp_rib_peer_t;
+
+/**
+ * Interned Attribute Set
+ */
+typedef struct parsebgp_rib_attrs {
+
+  /** Hash of the attribute set */
+  uint64_t hash;
+
+  /** Number of routes using the attribute set */
+  uint64_t refcnt;
+
+  /** Raw path attributes (without MP_REACH_NLRI and MP_UNREACH_NLRI), as
+      copied by the decoder */
+  const uint8_t *raw;
+
+  /** Length of the raw path attributes */
+  uint16_t raw_len;
+
+  /** Are the AS numbers in the raw path attributes 4 bytes wide */
+  uint8_t asn_4_byte;
+
+  /** AFI of the next hop (zero if there is no next hop) */
+  parsebgp_bgp_afi_t next_hop_afi;
+
+  /** Next hop address */
+  uint8_t next_hop[16];
+
+} parsebgp_rib_attrs_t;
+
+/**
+ * RIB Route (as passed to a walk callback)
+ */
+typedef struct parsebgp_rib_route {
+
+  /** Prefix of the route (including its Path Identifier) */
+  parsebgp_bgp_prefix_t prefix;
+
+  /** Peer the route was received from */
+  const parsebgp_rib_peer_t *peer;
+
+  /** Attributes of the route */
+  const parsebgp_rib_attrs_t *attrs;
+
+} parsebgp_rib_route_t;
+
+/**
+ * RIB Statistics
+ */
+typedef struct parsebgp_rib_stats {
+
+  /** Number of peers */
+  uint32_t peers_cnt;
+
+  /** Number of prefixes with at least one route */
+  uint64_t prefixes_cnt;
+
+  /** Number of routes */
+  uint64_t routes_cnt;
+
+  /** Number of distinct attribute sets */
+  uint64_t attrs_cnt;
+
+  /** Number of trie nodes (including nodes with no routes) */
+  uint64_t nodes_cnt;
+
+  /** Approximate number of bytes allocated by the RIB */
+  uint64_t mem_bytes;
+
+} parsebgp_rib_stats_t;
+
+/**
+ * Walk callback
+ *
+ * @param user          User pointer passed to parsebgp_rib_walk
+ * @param route         Route (only valid for the duration of the call)
+ * @return 0 to continue the walk, or any other value to stop it
+ *
+ * The callback must not modify the RIB.
+ */
+typedef int(parsebgp_rib_walk_cb_t)(void *user,
+                                    const parsebgp_rib_route_t *route);
+
+/**
+ * Create a RIB
+ *
+ * @return pointer to a new (empty) RIB, or NULL if an error occurred
+ */
+parsebgp_rib_t *parsebgp_rib_create(void);
+
+/**
+ * Destroy the given RIB
+ *
+ * @param rib           Pointer to the RIB to destroy
+ */
+void parsebgp_rib_destroy(parsebgp_rib_t *rib);
+
+/**
+ * Apply the given elem to the RIB
+ *
+ * @param rib           Pointer to the RIB
+ * @param elem          Pointer to the elem to apply
+ * @return PARSEBGP_OK if successful, or an error code otherwise
+ *
+ * RIB and ANNOUNCE elems add (or replace) the route of the peer for the
+ * prefix, and WITHDRAW elems remove it. A PEER_STATE elem that leaves the
+ * Established state flushes all routes of the peer. Elems that are not
+ * relevant to the RIB are ignored. PARSEBGP_INVALID_MSG is returned if the
+ * path attributes of an elem were not copied by the decoder.
+ */
+parsebgp_error_t parsebgp_rib_apply_elem(parsebgp_rib_t *rib,
+                                         const parsebgp_elem_t *elem);
+
+/**
+ * Apply all elems of the given message to the RIB
+ *
+ * @param rib           Pointer to the RIB
+ * @param gen           Elem generator to extract elems with (it must be used
+ *                      for every message of the stream, so that RIB entries
+ *                      can be matched with the Peer Index Table)
+ * @param msg           Pointer to the parsed message
+ * @return PARSEBGP_OK if successful, or an error code otherwise
+ */
+parsebgp_error_t parsebgp_rib_apply_msg(parsebgp_rib_t *rib,
+                                        parsebgp_elem_gen_t *gen,
+                                        const parsebgp_msg_t *msg);
+
+/**
+ * Remove all routes of the given peer
+ *
+ * @param rib           Pointer to the RIB
+ * @param peer_idx      Index of the peer to flush
+ */
+void parsebgp_rib_flush_peer(parsebgp_rib_t *rib, uint32_t peer_idx);
+
+/**
+ * Look up the route of a peer for a prefix
+ *
+ * @param rib           Pointer to the RIB
+ * @param prefix        Prefix to look up (exact match, including the Path
+ *                      Identifier, which is 0 for peers without ADD-PATH)
+ * @param peer_idx      Index of the peer
+ * @return borrowed pointer to the attributes of the route (valid until the RIB
+ * is next modified), or NULL if the peer has no route for the prefix
+ */
+const parsebgp_rib_attrs_t *
+parsebgp_rib_lookup(const parsebgp_rib_t *rib,
+                    const parsebgp_bgp_prefix_t *prefix, uint32_t peer_idx);
+
+/**
+ * Get a peer of the RIB
+ *
+ * @param rib           Pointer to the RIB
+ * @param peer_idx      Index of the peer
+ * @return borrowed pointer to the peer (valid until the RIB is next
+ * modified), or NULL if there is no such peer
+ */
+const parsebgp_rib_peer_t *parsebgp_rib_get_peer(const parsebgp_rib_t *rib,
+                                                 uint32_t peer_idx);
+
+/**
+ * Walk all routes in the RIB
+ *
+ * @param rib           Pointer to the RIB
+ * @param cb            Callback to call for each route
+ * @param user          User pointer passed to the callback
+ * @return 0 if all routes were walked, or the (non-zero) value that the
+ * callback returned to stop the walk
+ *
+ * Routes are visited in prefix order (IPv4 before IPv6, and shorter prefixes
+ * before the longer prefixes they cover), and in peer index order within a
+ * prefix.
+ */
+int parsebgp_rib_walk(const parsebgp_rib_t *rib, parsebgp_rib_walk_cb_t *cb,
+                      void *user);
+
+/**
+ * Get statistics about the RIB
+ *
+ * @param rib           Pointer to the RIB
+ * @param [out] stats   Filled with the statistics
+ */
+void parsebgp_rib_get_stats(const parsebgp_rib_t *rib,
+                            parsebgp_rib_stats_t *stats);
+
+/**
+ * Decode an attribute set
+ *
+ * @param attrs         Pointer to the attribute set to decode
+ * @param path_attrs    Path attributes structure to decode into (it must be
+ *                      zeroed before first use, and may be reused)
+ * @return PARSEBGP_OK if successful, or an error code otherwise
+ *
+ * The memory used by path_attrs must be released with
+ * parsebgp_rib_path_attrs_destroy.
+ */
+parsebgp_error_t
+parsebgp_rib_attrs_decode(const parsebgp_rib_attrs_t *attrs,
+                          parsebgp_bgp_update_path_attrs_t *path_attrs);
+
+/**
+ * Release the memory used by decoded path attributes
+ *
+ * @param path_attrs    Path attributes structure filled by
+ *                      parsebgp_rib_attrs_decode (the structure itself is not
+ *                      freed)
+ */
+void parsebgp_rib_path_attrs_destroy(
+  parsebgp_bgp_update_path_attrs_t *path_attrs);
+
+#endif /* __PARSEBGP_RIB_H */
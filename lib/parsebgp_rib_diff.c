@@ -0,0 +1,753 @@
+/*
+ * Copyright (C) 2017 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "parsebgp_rib_diff.h"
+#include "parsebgp_utils.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/** Size of the MRT common header */
+#define MRT_HDR_LEN 12
+
+/** Initial size of an input buffer (grown to fit larger records) */
+#define BUF_LEN (1024 * 1024)
+
+/** Number of slots in the peer index (a power of two, at least twice the
+    maximum number of peers in a Peer Index Table) */
+#define PEERS_INDEX_CNT (1 << 17)
+
+/** Raw RIB entry (pointing into the input buffer) */
+typedef struct entry {
+
+  /** Peer ID (see peer_t) */
+  uint32_t peer;
+
+  /** Raw path attributes */
+  const uint8_t *attrs;
+
+  /** Length of the raw path attributes */
+  uint16_t attrs_len;
+
+} entry_t;
+
+/** Peer, identified across both dumps. Peer IDs are indexes into the peers
+    array of the diff. */
+typedef struct peer {
+
+  /** Peer AFI */
+  parsebgp_bgp_afi_t afi;
+
+  /** Peer address */
+  uint8_t ip[16];
+
+  /** Peer ASN */
+  uint32_t asn;
+
+  /** Number of the record for which the slots were last set (per side) */
+  uint64_t rec_num[2];
+
+  /** Index of the entry of the peer in the current record (per side) */
+  uint32_t entry[2];
+
+} peer_t;
+
+/** One dump */
+typedef struct input {
+
+  /** Read callback */
+  parsebgp_rib_diff_read_cb_t *read_cb;
+
+  /** User pointer for the callback */
+  void *user;
+
+  /** File descriptor (if the input was opened by the diff), or -1 */
+  int fd;
+
+  /** Buffer of data read from the input */
+  uint8_t *buf;
+
+  /** Allocated length of the buffer */
+  size_t buf_len;
+
+  /** Offset of the current record in the buffer */
+  size_t head;
+
+  /** Offset of the end of the data in the buffer */
+  size_t tail;
+
+  /** Has the input been read to the end */
+  int eof;
+
+  /** Is there a current RIB record */
+  int have_rec;
+
+  /** Current RIB record */
+  const uint8_t *rec;
+
+  /** Length of the current record */
+  size_t rec_len;
+
+  /** Number of the current record (for the peer slots) */
+  uint64_t rec_num;
+
+  /** Key of the current record: subtype, prefix length, and prefix */
+  uint16_t subtype;
+  uint8_t pfx_len;
+  uint8_t pfx[16];
+
+  /** Entries of the current record */
+  entry_t *entries;
+
+  /** Number of entries */
+  int entries_cnt;
+
+  /** Allocated length of the entries array (INTERNAL) */
+  int _entries_alloc_cnt;
+
+  /** Peer IDs for the indexes of the most recent Peer Index Table */
+  uint32_t *peer_ids;
+
+  /** Number of peers in the most recent Peer Index Table */
+  int peer_ids_cnt;
+
+  /** Allocated length of the peer_ids array (INTERNAL) */
+  int _peer_ids_alloc_cnt;
+
+  /** Decoded Peer Index Table */
+  parsebgp_msg_t *pi_msg;
+
+  /** Decoded RIB record (records are only decoded if they differ) */
+  parsebgp_msg_t *msg;
+
+  /** Elem generator */
+  parsebgp_elem_gen_t *gen;
+
+  /** Elems of the decoded record (one per entry, in the same order) */
+  parsebgp_elem_t *elems;
+
+  /** Number of elems */
+  int elems_cnt;
+
+  /** Allocated length of the elems array (INTERNAL) */
+  int _elems_alloc_cnt;
+
+} input_t;
+
+struct parsebgp_rib_diff {
+
+  /** Decoding options */
+  parsebgp_opts_t opts;
+
+  /** Inputs (old and new) */
+  input_t inputs[2];
+
+  /** Peers seen in either dump */
+  peer_t *peers;
+
+  /** Number of peers */
+  uint32_t peers_cnt;
+
+  /** Allocated length of the peers array (INTERNAL) */
+  uint32_t _peers_alloc_cnt;
+
+  /** Hash index of peers (slots hold peer ID + 1) */
+  uint32_t *peers_index;
+
+  /** Changes found in the current prefix */
+  parsebgp_rib_diff_change_t *changes;
+
+  /** Number of changes */
+  int changes_cnt;
+
+  /** Allocated length of the changes array (INTERNAL) */
+  int _changes_alloc_cnt;
+
+  /** Index of the next change to yield */
+  int changes_next;
+
+  /** Have the first records been read */
+  int started;
+};
+
+static ssize_t fd_read(void *user, uint8_t *buf, size_t len)
+{
+  input_t *in = user;
+  ssize_t rlen;
+
+  while ((rlen = read(in->fd, buf, len)) < 0 && errno == EINTR)
+    ;
+  return rlen;
+}
+
+// find (or add) the ID of the given peer, returning -1 on error
+static int64_t peer_id(parsebgp_rib_diff_t *diff, parsebgp_bgp_afi_t afi,
+                       const uint8_t *ip, uint32_t asn)
+{
+  int alen = (afi == PARSEBGP_BGP_AFI_IPV4) ? 4 : 16;
+  uint32_t s, mask = PEERS_INDEX_CNT - 1, alloc_cnt;
+  peer_t *peer, *tmp;
+
+  s = parsebgp_hash(ip, alen, ((uint64_t)asn << 8) | afi) & mask;
+  for (; diff->peers_index[s] != 0; s = (s + 1) & mask) {
+    peer = &diff->peers[diff->peers_index[s] - 1];
+    if (peer->afi == afi && peer->asn == asn &&
+        memcmp(peer->ip, ip, alen) == 0) {
+      return diff->peers_index[s] - 1;
+    }
+  }
+  // a Peer Index Table has at most 65535 peers, so even two completely
+  // different tables leave the index half empty
+  if (diff->peers_cnt * 2 >= PEERS_INDEX_CNT) {
+    return -1;
+  }
+
+  if (diff->peers_cnt == diff->_peers_alloc_cnt) {
+    alloc_cnt = diff->_peers_alloc_cnt ? diff->_peers_alloc_cnt * 2 : 64;
+    if ((tmp = realloc(diff->peers, alloc_cnt * sizeof(peer_t))) == NULL) {
+      return -1;
+    }
+    diff->peers = tmp;
+    diff->_peers_alloc_cnt = alloc_cnt;
+  }
+  peer = &diff->peers[diff->peers_cnt];
+  memset(peer, 0, sizeof(*peer));
+  peer->afi = afi;
+  memcpy(peer->ip, ip, alen);
+  peer->asn = asn;
+  diff->peers_index[s] = ++diff->peers_cnt;
+  return diff->peers_cnt - 1;
+}
+
+// make the next record of the input available (rec is NULL at the end)
+static parsebgp_error_t read_record(parsebgp_rib_diff_t *diff, input_t *in)
+{
+  size_t avail, need, len;
+  ssize_t rlen;
+  uint8_t *tmp;
+  parsebgp_error_t err;
+
+  in->head += in->rec_len;
+  in->rec = NULL;
+  in->rec_len = 0;
+
+  while (1) {
+    avail = in->tail - in->head;
+    err = parsebgp_mrt_frame(&diff->opts, in->buf + in->head, avail, &need);
+    if (err != PARSEBGP_OK && err != PARSEBGP_PARTIAL_MSG) {
+      return err;
+    }
+    if (err == PARSEBGP_OK && need <= avail) {
+      in->rec = in->buf + in->head;
+      in->rec_len = need;
+      return PARSEBGP_OK;
+    }
+    if (in->eof) {
+      return (avail == 0) ? PARSEBGP_OK : PARSEBGP_TRUNCATED_MSG;
+    }
+
+    // move the partial record to the start of the buffer, and make sure that
+    // it will fit
+    memmove(in->buf, in->buf + in->head, avail);
+    in->head = 0;
+    in->tail = avail;
+    if (need > in->buf_len) {
+      for (len = in->buf_len; len < need; len *= 2)
+        ;
+      if ((tmp = realloc(in->buf, len)) == NULL) {
+        return PARSEBGP_MALLOC_FAILURE;
+      }
+      in->buf = tmp;
+      in->buf_len = len;
+    }
+
+    if ((rlen = in->read_cb(in->user, in->buf + in->tail,
+                            in->buf_len - in->tail)) < 0) {
+      return PARSEBGP_INVALID_MSG;
+    }
+    if (rlen == 0) {
+      in->eof = 1;
+    }
+    in->tail += rlen;
+  }
+}
+
+// load the peers of a Peer Index Table record
+static parsebgp_error_t load_peer_index(parsebgp_rib_diff_t *diff,
+                                        input_t *in)
+{
+  const parsebgp_mrt_table_dump_v2_peer_index_t *pi;
+  const parsebgp_mrt_table_dump_v2_peer_entry_t *pe;
+  size_t len = in->rec_len;
+  int64_t id;
+  parsebgp_error_t err;
+  int i;
+
+  // the RIB message is left alone since pending changes may refer to it
+  parsebgp_clear_msg(in->pi_msg);
+  if ((err = parsebgp_decode(diff->opts, PARSEBGP_MSG_TYPE_MRT, in->pi_msg,
+                             in->rec, &len)) != PARSEBGP_OK ||
+      (err = parsebgp_elem_gen_reset(in->gen, in->pi_msg)) != PARSEBGP_OK) {
+    return err;
+  }
+  pi = &in->pi_msg->types.mrt->types.table_dump_v2->peer_index;
+
+  PARSEBGP_MAYBE_REALLOC(in->peer_ids, in->_peer_ids_alloc_cnt,
+                         pi->peer_count);
+  for (i = 0; i < pi->peer_count; i++) {
+    pe = &pi->peer_entries[i];
+    if ((id = peer_id(diff, pe->ip_afi, pe->ip, pe->asn)) < 0) {
+      return PARSEBGP_MALLOC_FAILURE;
+    }
+    in->peer_ids[i] = id;
+  }
+  in->peer_ids_cnt = pi->peer_count;
+  return PARSEBGP_OK;
+}
+
+// scan the entries of a RIB record without decoding their attributes
+static parsebgp_error_t scan_rib(input_t *in, const uint8_t *buf, size_t len)
+{
+  size_t nread = 0;
+  uint16_t entry_cnt, peer_idx, attrs_len;
+  uint8_t pfx_len, bytes;
+  entry_t *entry;
+  int i;
+
+  // Sequence Number (4), Prefix Length (1), Prefix, Entry Count (2)
+  if (len < 5) {
+    PARSEBGP_RETURN_INVALID_MSG_ERR;
+  }
+  pfx_len = buf[4];
+  bytes = (pfx_len + 7) / 8;
+  if (pfx_len > ((in->subtype <= PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_MULTICAST)
+                   ? 32
+                   : 128) ||
+      len < 5 + (size_t)bytes + 2) {
+    PARSEBGP_RETURN_INVALID_MSG_ERR;
+  }
+  in->pfx_len = pfx_len;
+  memset(in->pfx, 0, sizeof(in->pfx));
+  memcpy(in->pfx, buf + 5, bytes);
+  if (pfx_len % 8 != 0) {
+    in->pfx[bytes - 1] &= 0xFF << (8 - pfx_len % 8);
+  }
+  nread = 5 + bytes;
+  entry_cnt = nptohs(buf + nread);
+  nread += 2;
+
+  PARSEBGP_MAYBE_REALLOC(in->entries, in->_entries_alloc_cnt, entry_cnt);
+  in->entries_cnt = 0;
+  for (i = 0; i < entry_cnt; i++) {
+    // Peer Index (2), Originated Time (4), Attribute Length (2)
+    if (len - nread < 8) {
+      PARSEBGP_RETURN_INVALID_MSG_ERR;
+    }
+    peer_idx = nptohs(buf + nread);
+    attrs_len = nptohs(buf + nread + 6);
+    nread += 8;
+    if (len - nread < attrs_len) {
+      PARSEBGP_RETURN_INVALID_MSG_ERR;
+    }
+    if (peer_idx < in->peer_ids_cnt) {
+      entry = &in->entries[in->entries_cnt++];
+      entry->peer = in->peer_ids[peer_idx];
+      entry->attrs = buf + nread;
+      entry->attrs_len = attrs_len;
+    }
+    nread += attrs_len;
+  }
+  return PARSEBGP_OK;
+}
+
+// compare the keys of the current records of two inputs
+static int key_cmp(const input_t *a, const input_t *b)
+{
+  int cmp;
+
+  if (a->subtype != b->subtype) {
+    return (a->subtype < b->subtype) ? -1 : 1;
+  }
+  if ((cmp = memcmp(a->pfx, b->pfx, sizeof(a->pfx))) != 0) {
+    return cmp;
+  }
+  return (int)a->pfx_len - (int)b->pfx_len;
+}
+
+// move to the next RIB record of the input (have_rec is cleared at the end)
+static parsebgp_error_t next_rib(parsebgp_rib_diff_t *diff, input_t *in)
+{
+  input_t prev;
+  uint16_t type, subtype;
+  parsebgp_error_t err;
+
+  prev.subtype = in->subtype;
+  prev.pfx_len = in->pfx_len;
+  memcpy(prev.pfx, in->pfx, sizeof(prev.pfx));
+
+  while (1) {
+    if ((err = read_record(diff, in)) != PARSEBGP_OK) {
+      return err;
+    }
+    if (in->rec == NULL) {
+      in->have_rec = 0;
+      return PARSEBGP_OK;
+    }
+    type = nptohs(in->rec + 4);
+    subtype = nptohs(in->rec + 6);
+    if (type != PARSEBGP_MRT_TYPE_TABLE_DUMP_V2) {
+      continue;
+    }
+    if (subtype == PARSEBGP_MRT_TABLE_DUMP_V2_PEER_INDEX_TABLE) {
+      if ((err = load_peer_index(diff, in)) != PARSEBGP_OK) {
+        return err;
+      }
+      continue;
+    }
+    if (subtype < PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_UNICAST ||
+        subtype > PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV6_MULTICAST) {
+      // RIB_GENERIC (and anything newer) is not supported
+      continue;
+    }
+    in->subtype = subtype;
+    if ((err = scan_rib(in, in->rec + MRT_HDR_LEN,
+                        in->rec_len - MRT_HDR_LEN)) != PARSEBGP_OK) {
+      return err;
+    }
+    if (in->have_rec && key_cmp(in, &prev) <= 0) {
+      // the lockstep walk only works if records are in prefix order
+      PARSEBGP_RETURN_INVALID_MSG_ERR;
+    }
+    in->have_rec = 1;
+    in->rec_num++;
+    return PARSEBGP_OK;
+  }
+}
+
+// decode the current record of the input
+static parsebgp_error_t decode_rib(parsebgp_rib_diff_t *diff, input_t *in)
+{
+  size_t len = in->rec_len;
+  parsebgp_elem_t *elem;
+  parsebgp_error_t err;
+
+  parsebgp_clear_msg(in->msg);
+  if ((err = parsebgp_decode(diff->opts, PARSEBGP_MSG_TYPE_MRT, in->msg,
+                             in->rec, &len)) != PARSEBGP_OK ||
+      (err = parsebgp_elem_gen_reset(in->gen, in->msg)) != PARSEBGP_OK) {
+    return err;
+  }
+  // the generator skips the same entries (unknown peer index) as scan_rib
+  in->elems_cnt = 0;
+  while ((elem = parsebgp_elem_gen_next(in->gen)) != NULL) {
+    PARSEBGP_MAYBE_REALLOC(in->elems, in->_elems_alloc_cnt,
+                           in->elems_cnt + 1);
+    in->elems[in->elems_cnt++] = *elem;
+  }
+  if (in->elems_cnt != in->entries_cnt) {
+    PARSEBGP_RETURN_INVALID_MSG_ERR;
+  }
+  return PARSEBGP_OK;
+}
+
+// add a change between the given entries (-1 if there is none)
+static parsebgp_error_t add_change(parsebgp_rib_diff_t *diff,
+                                   parsebgp_rib_diff_type_t type,
+                                   int old_idx, int new_idx)
+{
+  parsebgp_rib_diff_change_t *change;
+
+  PARSEBGP_MAYBE_REALLOC(diff->changes, diff->_changes_alloc_cnt,
+                         diff->changes_cnt + 1);
+  change = &diff->changes[diff->changes_cnt++];
+  change->type = type;
+  change->old_elem =
+    (old_idx < 0) ? NULL : &diff->inputs[PARSEBGP_RIB_DIFF_OLD].elems[old_idx];
+  change->new_elem =
+    (new_idx < 0) ? NULL : &diff->inputs[PARSEBGP_RIB_DIFF_NEW].elems[new_idx];
+  return PARSEBGP_OK;
+}
+
+// compare the current records of the inputs (which have the same key),
+// finding the changes between them
+static parsebgp_error_t compare_ribs(parsebgp_rib_diff_t *diff)
+{
+  input_t *old_in = &diff->inputs[PARSEBGP_RIB_DIFF_OLD];
+  input_t *new_in = &diff->inputs[PARSEBGP_RIB_DIFF_NEW];
+  const entry_t *oe, *ne;
+  peer_t *peer;
+  int i, same = (old_in->entries_cnt == new_in->entries_cnt);
+  parsebgp_error_t err;
+
+  // index the old entries by peer
+  for (i = 0; i < old_in->entries_cnt; i++) {
+    peer = &diff->peers[old_in->entries[i].peer];
+    peer->rec_num[PARSEBGP_RIB_DIFF_OLD] = old_in->rec_num;
+    peer->entry[PARSEBGP_RIB_DIFF_OLD] = i;
+  }
+  // find the new entries that differ (the common case is that none do)
+  for (i = 0; same && i < new_in->entries_cnt; i++) {
+    ne = &new_in->entries[i];
+    peer = &diff->peers[ne->peer];
+    if (peer->rec_num[PARSEBGP_RIB_DIFF_OLD] != old_in->rec_num) {
+      same = 0;
+      break;
+    }
+    oe = &old_in->entries[peer->entry[PARSEBGP_RIB_DIFF_OLD]];
+    same = (oe->attrs_len == ne->attrs_len &&
+            memcmp(oe->attrs, ne->attrs, ne->attrs_len) == 0);
+  }
+  if (same) {
+    return PARSEBGP_OK;
+  }
+
+  // something changed, so it is worth decoding both records
+  if ((err = decode_rib(diff, old_in)) != PARSEBGP_OK ||
+      (err = decode_rib(diff, new_in)) != PARSEBGP_OK) {
+    return err;
+  }
+  for (i = 0; i < new_in->entries_cnt; i++) {
+    ne = &new_in->entries[i];
+    peer = &diff->peers[ne->peer];
+    peer->rec_num[PARSEBGP_RIB_DIFF_NEW] = new_in->rec_num;
+    if (peer->rec_num[PARSEBGP_RIB_DIFF_OLD] != old_in->rec_num) {
+      err = add_change(diff, PARSEBGP_RIB_DIFF_ADDED, -1, i);
+    } else {
+      oe = &old_in->entries[peer->entry[PARSEBGP_RIB_DIFF_OLD]];
+      if (oe->attrs_len != ne->attrs_len ||
+          memcmp(oe->attrs, ne->attrs, ne->attrs_len) != 0) {
+        err = add_change(diff, PARSEBGP_RIB_DIFF_CHANGED,
+                         peer->entry[PARSEBGP_RIB_DIFF_OLD], i);
+      }
+    }
+    if (err != PARSEBGP_OK) {
+      return err;
+    }
+  }
+  for (i = 0; i < old_in->entries_cnt; i++) {
+    oe = &old_in->entries[i];
+    if (diff->peers[oe->peer].rec_num[PARSEBGP_RIB_DIFF_NEW] !=
+          new_in->rec_num &&
+        (err = add_change(diff, PARSEBGP_RIB_DIFF_REMOVED, i, -1)) !=
+          PARSEBGP_OK) {
+      return err;
+    }
+  }
+  return PARSEBGP_OK;
+}
+
+// all routes of the current record of the input were added (or removed)
+static parsebgp_error_t all_changed(parsebgp_rib_diff_t *diff, int side)
+{
+  input_t *in = &diff->inputs[side];
+  parsebgp_error_t err;
+  int i;
+
+  if ((err = decode_rib(diff, in)) != PARSEBGP_OK) {
+    return err;
+  }
+  for (i = 0; i < in->entries_cnt; i++) {
+    if (side == PARSEBGP_RIB_DIFF_NEW) {
+      err = add_change(diff, PARSEBGP_RIB_DIFF_ADDED, -1, i);
+    } else {
+      err = add_change(diff, PARSEBGP_RIB_DIFF_REMOVED, i, -1);
+    }
+    if (err != PARSEBGP_OK) {
+      return err;
+    }
+  }
+  return PARSEBGP_OK;
+}
+
+static void input_destroy(input_t *in)
+{
+  if (in->fd >= 0 && in->fd != STDIN_FILENO) {
+    close(in->fd);
+  }
+  free(in->buf);
+  free(in->entries);
+  free(in->peer_ids);
+  free(in->elems);
+  parsebgp_destroy_msg(in->pi_msg);
+  parsebgp_destroy_msg(in->msg);
+  parsebgp_elem_gen_destroy(in->gen);
+}
+
+/* ========== PUBLIC API FUNCTIONS ========== */
+
+parsebgp_rib_diff_t *parsebgp_rib_diff_create(const parsebgp_opts_t *opts)
+{
+  parsebgp_rib_diff_t *diff;
+  input_t *in;
+  int i;
+
+  if ((diff = malloc_zero(sizeof(parsebgp_rib_diff_t))) == NULL) {
+    return NULL;
+  }
+  memcpy(&diff->opts, opts, sizeof(diff->opts));
+  for (i = 0; i < 2; i++) {
+    diff->inputs[i].fd = -1;
+  }
+  if ((diff->peers_index = calloc(PEERS_INDEX_CNT, sizeof(uint32_t))) ==
+      NULL) {
+    goto err;
+  }
+  for (i = 0; i < 2; i++) {
+    in = &diff->inputs[i];
+    if ((in->buf = malloc(BUF_LEN)) == NULL ||
+        (in->pi_msg = parsebgp_create_msg()) == NULL ||
+        (in->msg = parsebgp_create_msg()) == NULL ||
+        (in->gen = parsebgp_elem_gen_create()) == NULL) {
+      goto err;
+    }
+    in->buf_len = BUF_LEN;
+  }
+  return diff;
+
+err:
+  parsebgp_rib_diff_destroy(diff);
+  return NULL;
+}
+
+void parsebgp_rib_diff_destroy(parsebgp_rib_diff_t *diff)
+{
+  if (diff == NULL) {
+    return;
+  }
+  input_destroy(&diff->inputs[0]);
+  input_destroy(&diff->inputs[1]);
+  free(diff->peers);
+  free(diff->peers_index);
+  free(diff->changes);
+  free(diff);
+}
+
+int parsebgp_rib_diff_set_input(parsebgp_rib_diff_t *diff,
+                                parsebgp_rib_diff_side_t side,
+                                parsebgp_rib_diff_read_cb_t *read_cb,
+                                void *user)
+{
+  input_t *in;
+
+  if (side != PARSEBGP_RIB_DIFF_OLD && side != PARSEBGP_RIB_DIFF_NEW) {
+    return -1;
+  }
+  in = &diff->inputs[side];
+  if (in->read_cb != NULL) {
+    return -1;
+  }
+  in->read_cb = read_cb;
+  in->user = user;
+  return 0;
+}
+
+int parsebgp_rib_diff_set_file(parsebgp_rib_diff_t *diff,
+                               parsebgp_rib_diff_side_t side,
+                               const char *fname)
+{
+  int fd;
+
+  if (strcmp(fname, "-") == 0) {
+    fd = STDIN_FILENO;
+  } else if ((fd = open(fname, O_RDONLY)) < 0) {
+    return -1;
+  }
+
+  if (parsebgp_rib_diff_set_input(diff, side, fd_read, NULL) != 0) {
+    if (fd != STDIN_FILENO) {
+      close(fd);
+    }
+    return -1;
+  }
+  diff->inputs[side].fd = fd;
+  diff->inputs[side].user = &diff->inputs[side];
+  return 0;
+}
+
+parsebgp_error_t parsebgp_rib_diff_next(parsebgp_rib_diff_t *diff,
+                                        parsebgp_rib_diff_change_t **change)
+{
+  input_t *old_in = &diff->inputs[PARSEBGP_RIB_DIFF_OLD];
+  input_t *new_in = &diff->inputs[PARSEBGP_RIB_DIFF_NEW];
+  parsebgp_error_t err;
+  int cmp, i;
+
+  *change = NULL;
+
+  if (old_in->read_cb == NULL || new_in->read_cb == NULL) {
+    return PARSEBGP_INVALID_MSG;
+  }
+
+  while (diff->changes_next == diff->changes_cnt) {
+    diff->changes_cnt = 0;
+    diff->changes_next = 0;
+
+    if (!diff->started) {
+      for (i = 0; i < 2; i++) {
+        if ((err = next_rib(diff, &diff->inputs[i])) != PARSEBGP_OK) {
+          return err;
+        }
+      }
+      diff->started = 1;
+    }
+    if (!old_in->have_rec && !new_in->have_rec) {
+      return PARSEBGP_OK;
+    }
+
+    if (!new_in->have_rec) {
+      cmp = -1;
+    } else if (!old_in->have_rec) {
+      cmp = 1;
+    } else {
+      cmp = key_cmp(old_in, new_in);
+    }
+
+    if (cmp < 0) {
+      err = all_changed(diff, PARSEBGP_RIB_DIFF_OLD);
+    } else if (cmp > 0) {
+      err = all_changed(diff, PARSEBGP_RIB_DIFF_NEW);
+    } else {
+      err = compare_ribs(diff);
+    }
+    if (err != PARSEBGP_OK) {
+      return err;
+    }
+
+    // the changes refer to decoded messages, not the input buffers, so the
+    // inputs can move on now
+    if (cmp <= 0 && (err = next_rib(diff, old_in)) != PARSEBGP_OK) {
+      return err;
+    }
+    if (cmp >= 0 && (err = next_rib(diff, new_in)) != PARSEBGP_OK) {
+      return err;
+    }
+  }
+
+  *change = &diff->changes[diff->changes_next++];
+  return PARSEBGP_OK;
+}
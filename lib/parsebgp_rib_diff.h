@@ -0,0 +1,177 @@
+/*
+ * Copyright (C) 2017 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __PARSEBGP_RIB_DIFF_H
+#define __PARSEBGP_RIB_DIFF_H
+
+#include "parsebgp_elem.h"
+#include "parsebgp_error.h"
+#include "parsebgp_opts.h"
+#include <inttypes.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+/**
+ * TABLE_DUMP_V2 RIB Diff
+ *
+ * Compares two TABLE_DUMP_V2 RIB dumps (e.g., consecutive dumps from one
+ * collector) and yields the routes that were added, removed, or changed
+ * between them. Both dumps are read in lockstep, one RIB record at a time, so
+ * memory use is bounded by the size of a single record rather than that of the
+ * table.
+ *
+ * Records are first compared without decoding them: the entries of both
+ * records for a prefix are matched by peer (address and ASN, since peer
+ * indexes may differ between dumps), and the raw path attribute bytes of each
+ * pair are compared. Records are only decoded (and elems generated) if they
+ * differ. The originated time of entries is ignored.
+ *
+ * Both dumps must list their RIB records in prefix order (i.e., by subtype,
+ * then address, then prefix length), as dumps written from a routing table
+ * do. Records of other types are skipped.
+ */
+typedef struct parsebgp_rib_diff parsebgp_rib_diff_t;
+
+/**
+ * Inputs of a diff
+ */
+typedef enum parsebgp_rib_diff_side {
+
+  /** The older dump */
+  PARSEBGP_RIB_DIFF_OLD = 0,
+
+  /** The newer dump */
+  PARSEBGP_RIB_DIFF_NEW = 1,
+
+} parsebgp_rib_diff_side_t;
+
+/**
+ * Change Types
+ */
+typedef enum parsebgp_rib_diff_type {
+
+  /** The route is only in the new dump */
+  PARSEBGP_RIB_DIFF_ADDED = 1,
+
+  /** The route is only in the old dump */
+  PARSEBGP_RIB_DIFF_REMOVED = 2,
+
+  /** The route is in both dumps, with different path attributes */
+  PARSEBGP_RIB_DIFF_CHANGED = 3,
+
+} parsebgp_rib_diff_type_t;
+
+/**
+ * A change yielded by the diff
+ */
+typedef struct parsebgp_rib_diff_change {
+
+  /** Change type */
+  parsebgp_rib_diff_type_t type;
+
+  /** RIB elem from the old dump (NULL for ADDED changes) */
+  const parsebgp_elem_t *old_elem;
+
+  /** RIB elem from the new dump (NULL for REMOVED changes) */
+  const parsebgp_elem_t *new_elem;
+
+} parsebgp_rib_diff_change_t;
+
+/**
+ * Callback used to read data from an input
+ *
+ * @param user          User pointer given when the input was set
+ * @param buf           Buffer to read data into
+ * @param len           Maximum number of bytes to read
+ * @return the number of bytes read, 0 at the end of the input, or a negative
+ * value if an error occurred
+ */
+typedef ssize_t(parsebgp_rib_diff_read_cb_t)(void *user, uint8_t *buf,
+                                             size_t len);
+
+/**
+ * Create a diff
+ *
+ * @param opts          Options to use when decoding records
+ * @return pointer to a new diff, or NULL if an error occurred
+ */
+parsebgp_rib_diff_t *parsebgp_rib_diff_create(const parsebgp_opts_t *opts);
+
+/**
+ * Destroy the given diff
+ *
+ * @param diff          Pointer to the diff to destroy
+ *
+ * Inputs opened using parsebgp_rib_diff_set_file are closed. Inputs set with
+ * parsebgp_rib_diff_set_input are owned by the caller.
+ */
+void parsebgp_rib_diff_destroy(parsebgp_rib_diff_t *diff);
+
+/**
+ * Set an input that is read using the given callback
+ *
+ * @param diff          Pointer to the diff
+ * @param side          Which dump the input holds
+ * @param read_cb       Callback used to read data from the input
+ * @param user          User pointer passed to the callback
+ * @return 0 if successful, or -1 if an error occurred
+ *
+ * Both inputs must be set before the first call to parsebgp_rib_diff_next.
+ */
+int parsebgp_rib_diff_set_input(parsebgp_rib_diff_t *diff,
+                                parsebgp_rib_diff_side_t side,
+                                parsebgp_rib_diff_read_cb_t *read_cb,
+                                void *user);
+
+/**
+ * Set an (uncompressed) MRT file as an input
+ *
+ * @param diff          Pointer to the diff
+ * @param side          Which dump the file holds
+ * @param fname         Name of the file to read ("-" for stdin)
+ * @return 0 if successful, or -1 if an error occurred
+ */
+int parsebgp_rib_diff_set_file(parsebgp_rib_diff_t *diff,
+                               parsebgp_rib_diff_side_t side,
+                               const char *fname);
+
+/**
+ * Get the next change
+ *
+ * @param diff          Pointer to the diff
+ * @param [out] change  Set to point to the next change, or to NULL once both
+ *                      dumps have been compared. The change (and its elems)
+ *                      is owned by the diff and is only valid until the next
+ *                      call.
+ * @return PARSEBGP_OK if successful, or an error code otherwise
+ *
+ * Changes are yielded in prefix order. PARSEBGP_INVALID_MSG is returned if a
+ * dump is not in prefix order.
+ */
+parsebgp_error_t parsebgp_rib_diff_next(parsebgp_rib_diff_t *diff,
+                                        parsebgp_rib_diff_change_t **change);
+
+#endif /* __PARSEBGP_RIB_DIFF_H */
@@ -0,0 +1,1080 @@
+/*
+ * Copyright (C) 2017 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "parsebgp_rib_file.h"
+#include "parsebgp_utils.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef HAVE_LIBZ
+#include <zlib.h>
+#endif
+
+/* File layout:
+ *
+ * Header (HDR_LEN bytes, see the HDR_* offsets)
+ * Prefix blocks (from HDR_LEN to the peer table)
+ * Peer table (PEER_LEN bytes per peer)
+ * Attribute sets (ATTRS_HDR_LEN bytes followed by the raw attributes, for each
+ *   set)
+ * Attribute set index (file offset of each attribute set, 8 bytes each)
+ * Block index (BLOCK_IDX_LEN bytes per block)
+ *
+ * A prefix record in a block is: AFI index (1 byte), prefix length (1 byte),
+ * prefix (as many bytes as the length needs), the difference between the
+ * number of the record and that of its parent, i.e., the longest prefix in the
+ * file that covers it (varint, zero if there is none), number of routes
+ * (varint), and, for each route, the difference between its peer index and
+ * that of the previous route (varint), its ADD-PATH Path Identifier (varint)
+ * and the ID of its attribute set (varint). A block ends with a directory of the offsets of its records (4
+ * bytes each) and the number of records (4 bytes), so that a reader can binary
+ * search a block without decoding it.
+ *
+ * Parent links make longest-prefix matches cheap: the longest match for an
+ * address is the closest prefix that does not sort after it, or one of the
+ * parents of that prefix.
+ */
+
+/** File magic */
+#define FILE_MAGIC "PBGPRIBF"
+
+/** File format version */
+#define FILE_VERSION 2
+
+/** Header field offsets */
+#define HDR_VERSION 8
+#define HDR_FLAGS 10
+#define HDR_TIMESTAMP 12
+#define HDR_PEERS_CNT 16
+#define HDR_BLOCKS_CNT 20
+#define HDR_ATTRS_CNT 24
+#define HDR_PREFIXES_CNT 32
+#define HDR_ROUTES_CNT 40
+#define HDR_PEERS_OFF 48
+#define HDR_ATTRS_OFF 56
+#define HDR_ATTRS_INDEX_OFF 64
+#define HDR_BLOCKS_INDEX_OFF 72
+#define HDR_FILE_LEN 80
+#define HDR_LEN 88
+
+/** Header flag set if blocks may be compressed */
+#define FLAG_COMPRESSED 0x1
+
+/** Peer table entry: AFI (1), padding (3), ASN (4), address (16), number of
+    routes (8) */
+#define PEER_LEN 32
+
+/** Attribute set header: hash (8), number of routes (8), next hop (16),
+    4-byte ASN flag (1), next hop AFI (1), length of the raw attributes (2) */
+#define ATTRS_HDR_LEN 36
+
+/** Block index entry: first key (18), padding (2), decoded length (4), stored
+    length (4), padding (4), file offset (8), number of the first record (8) */
+#define BLOCK_IDX_LEN 48
+
+/** Target (uncompressed) size of a block */
+#define BLOCK_LEN (4 * 1024)
+
+/** Prefix key: AFI index (1), address (16), length (1), so that keys compare
+    with memcmp in the same order as parsebgp_rib_walk visits prefixes */
+#define KEY_LEN 18
+
+/** Maximum length of an encoded varint */
+#define VARINT_MAX_LEN 10
+
+typedef struct route {
+
+  /** Peer index */
+  uint32_t peer;
+
+  /** Path Identifier */
+  uint32_t path_id;
+
+  /** Attribute set ID */
+  uint64_t attrs;
+
+} route_t;
+
+typedef struct writer {
+
+  /** File being written */
+  FILE *fp;
+
+  /** Current offset in the file */
+  uint64_t off;
+
+  /** Has a write failed */
+  int err;
+
+  /** Compress blocks */
+  int compress;
+
+  /** Block being built */
+  uint8_t *block;
+  size_t block_len;
+  size_t _block_alloc_len;
+
+  /** Buffer for compressed blocks */
+  uint8_t *zbuf;
+  size_t _zbuf_alloc_len;
+
+  /** First key of the block being built */
+  uint8_t block_key[KEY_LEN];
+
+  /** Offsets of the records of the block being built */
+  uint32_t *dir;
+  size_t dir_cnt;
+  size_t _dir_alloc_cnt;
+
+  /** Block index */
+  uint8_t *index;
+  size_t index_len;
+  size_t _index_alloc_len;
+  uint32_t blocks_cnt;
+
+  /** Prefix being collected (routes arrive one at a time from the walk) */
+  int have_prefix;
+  uint8_t key[KEY_LEN];
+  route_t *routes;
+  size_t routes_cnt;
+  size_t _routes_alloc_cnt;
+
+  /** Attribute sets, by ID */
+  const parsebgp_rib_attrs_t **attrs;
+  size_t attrs_cnt;
+  size_t _attrs_alloc_cnt;
+
+  /** Hash index of attribute sets (slots hold the ID + 1) */
+  uint64_t *attrs_index;
+  size_t attrs_slots_cnt;
+
+  /** Totals */
+  uint64_t prefixes_cnt;
+  uint64_t total_routes_cnt;
+
+  /** Number of the first record of the block being built */
+  uint64_t block_first;
+
+  /** Keys and numbers of the chain of records covering the current prefix
+      (one per possible prefix length at most) */
+  uint8_t parents[129][KEY_LEN];
+  uint64_t parents_num[129];
+  int parents_cnt;
+
+} writer_t;
+
+struct parsebgp_rib_file {
+
+  /** Mapped file */
+  const uint8_t *map;
+  size_t map_len;
+
+  /** Snapshot information */
+  parsebgp_rib_file_info_t info;
+
+  /** Sections */
+  uint64_t blocks_end;
+  const uint8_t *blocks_index;
+  const uint8_t *attrs;
+  uint64_t attrs_len;
+  const uint8_t *attrs_index;
+
+  /** Peers */
+  parsebgp_rib_peer_t *peers;
+
+  /** Index of the decoded block (or -1) */
+  int64_t block;
+
+  /** Number of the first record of the decoded block */
+  uint64_t block_first;
+
+  /** Records of the decoded block (in the map unless the block is
+      compressed) */
+  const uint8_t *buf;
+  size_t buf_len;
+
+  /** Directory of the decoded block */
+  const uint8_t *dir;
+  size_t recs_cnt;
+
+  /** Buffer for decompressed blocks */
+  uint8_t *zbuf;
+  size_t _zbuf_alloc_len;
+
+#ifdef HAVE_LIBZ
+  /** Decompression stream (reused, since setting one up costs more than
+      inflating a block) */
+  z_stream zs;
+  int zs_init;
+#endif
+};
+
+/* ========== UTILITIES ========== */
+
+// grow the given array to hold at least cnt elements, doubling its size so
+// that appending is amortized constant time
+static int grow(void *ptrp, size_t *alloc_cnt, size_t cnt, size_t size)
+{
+  void **ptr = ptrp;
+  size_t new_cnt;
+  void *tmp;
+
+  if (cnt <= *alloc_cnt) {
+    return 0;
+  }
+  new_cnt = (*alloc_cnt > 0) ? *alloc_cnt : 64;
+  while (new_cnt < cnt) {
+    new_cnt *= 2;
+  }
+  if ((tmp = realloc(*ptr, new_cnt * size)) == NULL) {
+    return -1;
+  }
+  *ptr = tmp;
+  *alloc_cnt = new_cnt;
+  return 0;
+}
+
+static void enc_u16(uint8_t *p, uint16_t v)
+{
+  p[0] = v >> 8;
+  p[1] = v;
+}
+
+static void enc_u32(uint8_t *p, uint32_t v)
+{
+  enc_u16(p, v >> 16);
+  enc_u16(p + 2, v);
+}
+
+static void enc_u64(uint8_t *p, uint64_t v)
+{
+  enc_u32(p, v >> 32);
+  enc_u32(p + 4, v);
+}
+
+static size_t enc_varint(uint8_t *p, uint64_t v)
+{
+  size_t len = 0;
+
+  while (v >= 0x80) {
+    p[len++] = (v & 0x7F) | 0x80;
+    v >>= 7;
+  }
+  p[len++] = v;
+  return len;
+}
+
+static int dec_varint(const uint8_t **p, const uint8_t *end, uint64_t *v)
+{
+  int shift;
+
+  *v = 0;
+  for (shift = 0; *p < end && shift < 64; shift += 7) {
+    *v |= (uint64_t)(**p & 0x7F) << shift;
+    if ((*(*p)++ & 0x80) == 0) {
+      return 0;
+    }
+  }
+  return -1;
+}
+
+// build the key of a prefix (with the host bits cleared)
+static int make_key(const parsebgp_bgp_prefix_t *prefix, uint8_t *key)
+{
+  int max_len, bytes;
+
+  if (prefix->afi == PARSEBGP_BGP_AFI_IPV4) {
+    max_len = 32;
+  } else if (prefix->afi == PARSEBGP_BGP_AFI_IPV6) {
+    max_len = 128;
+  } else {
+    return -1;
+  }
+  if (prefix->len > max_len) {
+    return -1;
+  }
+  memset(key, 0, KEY_LEN);
+  key[0] = (prefix->afi == PARSEBGP_BGP_AFI_IPV6);
+  bytes = (prefix->len + 7) / 8;
+  memcpy(key + 1, prefix->addr, bytes);
+  if (prefix->len % 8 != 0) {
+    key[bytes] &= 0xFF << (8 - prefix->len % 8);
+  }
+  key[KEY_LEN - 1] = prefix->len;
+  return 0;
+}
+
+// does the prefix of key a cover the prefix of key b
+static int key_covers(const uint8_t *a, const uint8_t *b)
+{
+  int len = a[KEY_LEN - 1], bytes = len / 8;
+
+  if (a[0] != b[0] || len > b[KEY_LEN - 1] ||
+      memcmp(a + 1, b + 1, bytes) != 0) {
+    return 0;
+  }
+  return (len % 8 == 0) ||
+         ((a[1 + bytes] ^ b[1 + bytes]) & (0xFF << (8 - len % 8))) == 0;
+}
+
+/* ========== WRITER ========== */
+
+static void put(writer_t *w, const void *buf, size_t len)
+{
+  if (!w->err && fwrite(buf, 1, len, w->fp) != len) {
+    w->err = 1;
+  }
+  w->off += len;
+}
+
+static int flush_block(writer_t *w)
+{
+  const uint8_t *data = w->block;
+  size_t len = w->block_len;
+  uint8_t *e;
+#ifdef HAVE_LIBZ
+  uLongf zlen;
+#endif
+
+  size_t i;
+
+  if (w->block_len == 0) {
+    return 0;
+  }
+
+  // add the directory
+  if (grow(&w->block, &w->_block_alloc_len,
+           w->block_len + (w->dir_cnt + 1) * 4, 1) != 0) {
+    return -1;
+  }
+  for (i = 0; i < w->dir_cnt; i++) {
+    enc_u32(w->block + w->block_len, w->dir[i]);
+    w->block_len += 4;
+  }
+  enc_u32(w->block + w->block_len, w->dir_cnt);
+  w->block_len += 4;
+  len = w->block_len;
+#ifdef HAVE_LIBZ
+  if (w->compress) {
+    zlen = compressBound(w->block_len);
+    if (grow(&w->zbuf, &w->_zbuf_alloc_len, zlen, 1) != 0 ||
+        compress2(w->zbuf, &zlen, w->block, w->block_len,
+                  Z_DEFAULT_COMPRESSION) != Z_OK) {
+      return -1;
+    }
+    // blocks that do not shrink are stored as is
+    if (zlen < w->block_len) {
+      data = w->zbuf;
+      len = zlen;
+    }
+  }
+#endif
+
+  if (grow(&w->index, &w->_index_alloc_len, w->index_len + BLOCK_IDX_LEN,
+           1) != 0) {
+    return -1;
+  }
+  e = w->index + w->index_len;
+  memset(e, 0, BLOCK_IDX_LEN);
+  memcpy(e, w->block_key, KEY_LEN);
+  enc_u32(e + 20, w->block_len);
+  enc_u32(e + 24, len);
+  enc_u64(e + 32, w->off);
+  enc_u64(e + 40, w->block_first);
+  w->index_len += BLOCK_IDX_LEN;
+  w->blocks_cnt++;
+
+  put(w, data, len);
+  w->block_len = 0;
+  w->dir_cnt = 0;
+  return w->err ? -1 : 0;
+}
+
+static int64_t attrs_id(writer_t *w, const parsebgp_rib_attrs_t *attrs)
+{
+  size_t mask = w->attrs_slots_cnt - 1, s, i, slots_cnt;
+  uint64_t *slots;
+
+  for (s = attrs->hash & mask; w->attrs_index[s] != 0; s = (s + 1) & mask) {
+    if (w->attrs[w->attrs_index[s] - 1] == attrs) {
+      return w->attrs_index[s] - 1;
+    }
+  }
+
+  if (grow(&w->attrs, &w->_attrs_alloc_cnt, w->attrs_cnt + 1,
+           sizeof(*w->attrs)) != 0) {
+    return -1;
+  }
+  w->attrs[w->attrs_cnt++] = attrs;
+  w->attrs_index[s] = w->attrs_cnt;
+
+  // keep the index at most half full
+  if (w->attrs_cnt * 2 > w->attrs_slots_cnt) {
+    slots_cnt = w->attrs_slots_cnt * 2;
+    if ((slots = calloc(slots_cnt, sizeof(uint64_t))) == NULL) {
+      return -1;
+    }
+    mask = slots_cnt - 1;
+    for (i = 0; i < w->attrs_cnt; i++) {
+      for (s = w->attrs[i]->hash & mask; slots[s] != 0; s = (s + 1) & mask)
+        ;
+      slots[s] = i + 1;
+    }
+    free(w->attrs_index);
+    w->attrs_index = slots;
+    w->attrs_slots_cnt = slots_cnt;
+  }
+  return w->attrs_cnt - 1;
+}
+
+// add the collected prefix to the block
+static int finish_prefix(writer_t *w)
+{
+  uint8_t *p;
+  uint32_t prev_peer = 0;
+  uint64_t num = w->prefixes_cnt;
+  int bytes = (w->key[KEY_LEN - 1] + 7) / 8;
+  size_t i;
+
+  if (grow(&w->block, &w->_block_alloc_len,
+           w->block_len + 2 + bytes + 2 * VARINT_MAX_LEN +
+             w->routes_cnt * 3 * VARINT_MAX_LEN,
+           1) != 0 ||
+      grow(&w->dir, &w->_dir_alloc_cnt, w->dir_cnt + 1, sizeof(uint32_t)) !=
+        0) {
+    return -1;
+  }
+  if (w->block_len == 0) {
+    memcpy(w->block_key, w->key, KEY_LEN);
+    w->block_first = num;
+  }
+  w->dir[w->dir_cnt++] = w->block_len;
+
+  // prefixes arrive in order, so the parents of the prefix are the records on
+  // the chain that still cover it
+  while (w->parents_cnt > 0 &&
+         !key_covers(w->parents[w->parents_cnt - 1], w->key)) {
+    w->parents_cnt--;
+  }
+
+  p = w->block + w->block_len;
+  *p++ = w->key[0];
+  *p++ = w->key[KEY_LEN - 1];
+  memcpy(p, w->key + 1, bytes);
+  p += bytes;
+  p += enc_varint(p, (w->parents_cnt > 0)
+                       ? num - w->parents_num[w->parents_cnt - 1]
+                       : 0);
+  p += enc_varint(p, w->routes_cnt);
+  for (i = 0; i < w->routes_cnt; i++) {
+    p += enc_varint(p, w->routes[i].peer - prev_peer);
+    p += enc_varint(p, w->routes[i].path_id);
+    p += enc_varint(p, w->routes[i].attrs);
+    prev_peer = w->routes[i].peer;
+  }
+  w->block_len = p - w->block;
+
+  memcpy(w->parents[w->parents_cnt], w->key, KEY_LEN);
+  w->parents_num[w->parents_cnt++] = num;
+
+  w->prefixes_cnt++;
+  w->total_routes_cnt += w->routes_cnt;
+  w->routes_cnt = 0;
+
+  return (w->block_len >= BLOCK_LEN) ? flush_block(w) : 0;
+}
+
+static int write_route(void *user, const parsebgp_rib_route_t *route)
+{
+  writer_t *w = user;
+  uint8_t key[KEY_LEN];
+  int64_t id;
+
+  if (make_key(&route->prefix, key) != 0) {
+    return -1;
+  }
+  if (!w->have_prefix || memcmp(key, w->key, KEY_LEN) != 0) {
+    if (w->have_prefix && finish_prefix(w) != 0) {
+      return -1;
+    }
+    memcpy(w->key, key, KEY_LEN);
+    w->have_prefix = 1;
+  }
+  if ((id = attrs_id(w, route->attrs)) < 0 ||
+      grow(&w->routes, &w->_routes_alloc_cnt, w->routes_cnt + 1,
+           sizeof(route_t)) != 0) {
+    return -1;
+  }
+  w->routes[w->routes_cnt].peer = route->peer->idx;
+  w->routes[w->routes_cnt].path_id = route->prefix.path_id;
+  w->routes[w->routes_cnt].attrs = id;
+  w->routes_cnt++;
+  return 0;
+}
+
+static int write_tables(writer_t *w, const parsebgp_rib_t *rib,
+                        uint32_t timestamp)
+{
+  parsebgp_rib_stats_t stats;
+  const parsebgp_rib_peer_t *peer;
+  const parsebgp_rib_attrs_t *attrs;
+  uint8_t buf[HDR_LEN];
+  uint64_t peers_off, attrs_off, attrs_index_off, blocks_index_off, *offs;
+  size_t i;
+
+  if ((offs = malloc((w->attrs_cnt + 1) * sizeof(uint64_t))) == NULL) {
+    return -1;
+  }
+
+  parsebgp_rib_get_stats(rib, &stats);
+  peers_off = w->off;
+  for (i = 0; i < stats.peers_cnt; i++) {
+    peer = parsebgp_rib_get_peer(rib, i);
+    memset(buf, 0, PEER_LEN);
+    buf[0] = peer->afi;
+    enc_u32(buf + 4, peer->asn);
+    memcpy(buf + 8, peer->ip, 16);
+    enc_u64(buf + 24, peer->routes_cnt);
+    put(w, buf, PEER_LEN);
+  }
+
+  attrs_off = w->off;
+  for (i = 0; i < w->attrs_cnt; i++) {
+    attrs = w->attrs[i];
+    offs[i] = w->off - attrs_off;
+    enc_u64(buf, attrs->hash);
+    enc_u64(buf + 8, attrs->refcnt);
+    memcpy(buf + 16, attrs->next_hop, 16);
+    buf[32] = attrs->asn_4_byte;
+    buf[33] = attrs->next_hop_afi;
+    enc_u16(buf + 34, attrs->raw_len);
+    put(w, buf, ATTRS_HDR_LEN);
+    put(w, attrs->raw, attrs->raw_len);
+  }
+
+  attrs_index_off = w->off;
+  for (i = 0; i < w->attrs_cnt; i++) {
+    enc_u64(buf, offs[i]);
+    put(w, buf, 8);
+  }
+  free(offs);
+
+  blocks_index_off = w->off;
+  put(w, w->index, w->index_len);
+
+  memset(buf, 0, HDR_LEN);
+  memcpy(buf, FILE_MAGIC, 8);
+  enc_u16(buf + HDR_VERSION, FILE_VERSION);
+  enc_u16(buf + HDR_FLAGS, w->compress ? FLAG_COMPRESSED : 0);
+  enc_u32(buf + HDR_TIMESTAMP, timestamp);
+  enc_u32(buf + HDR_PEERS_CNT, stats.peers_cnt);
+  enc_u32(buf + HDR_BLOCKS_CNT, w->blocks_cnt);
+  enc_u64(buf + HDR_ATTRS_CNT, w->attrs_cnt);
+  enc_u64(buf + HDR_PREFIXES_CNT, w->prefixes_cnt);
+  enc_u64(buf + HDR_ROUTES_CNT, w->total_routes_cnt);
+  enc_u64(buf + HDR_PEERS_OFF, peers_off);
+  enc_u64(buf + HDR_ATTRS_OFF, attrs_off);
+  enc_u64(buf + HDR_ATTRS_INDEX_OFF, attrs_index_off);
+  enc_u64(buf + HDR_BLOCKS_INDEX_OFF, blocks_index_off);
+  enc_u64(buf + HDR_FILE_LEN, w->off);
+  if (w->err || fseek(w->fp, 0, SEEK_SET) != 0) {
+    return -1;
+  }
+  put(w, buf, HDR_LEN);
+  return w->err ? -1 : 0;
+}
+
+/* ========== READER ========== */
+
+// find the last block whose first key is not after the given key (or -1)
+static int64_t find_block(const parsebgp_rib_file_t *file, const uint8_t *key)
+{
+  int64_t lo = 0, hi = (int64_t)file->info.blocks_cnt - 1, mid, found = -1;
+
+  while (lo <= hi) {
+    mid = lo + (hi - lo) / 2;
+    if (memcmp(file->blocks_index + mid * BLOCK_IDX_LEN, key, KEY_LEN) <= 0) {
+      found = mid;
+      lo = mid + 1;
+    } else {
+      hi = mid - 1;
+    }
+  }
+  return found;
+}
+
+// decode the given block (unless it is already decoded)
+static int load_block(parsebgp_rib_file_t *file, int64_t block)
+{
+  const uint8_t *e = file->blocks_index + block * BLOCK_IDX_LEN;
+  uint64_t off = nptohll(e + 32);
+  size_t raw_len = nptohl(e + 20), stored_len = nptohl(e + 24), cnt;
+
+  if (file->block == block) {
+    return 0;
+  }
+  file->block = -1;
+  if (off < HDR_LEN || off > file->blocks_end ||
+      stored_len > file->blocks_end - off || raw_len < 4) {
+    return -1;
+  }
+  if (stored_len == raw_len) {
+    file->buf = file->map + off;
+  } else {
+#ifdef HAVE_LIBZ
+    if (grow(&file->zbuf, &file->_zbuf_alloc_len, raw_len, 1) != 0) {
+      return -1;
+    }
+    if (!file->zs_init) {
+      if (inflateInit(&file->zs) != Z_OK) {
+        return -1;
+      }
+      file->zs_init = 1;
+    } else if (inflateReset(&file->zs) != Z_OK) {
+      return -1;
+    }
+    file->zs.next_in = (Bytef *)(file->map + off);
+    file->zs.avail_in = stored_len;
+    file->zs.next_out = file->zbuf;
+    file->zs.avail_out = raw_len;
+    if (inflate(&file->zs, Z_FINISH) != Z_STREAM_END ||
+        file->zs.avail_out != 0) {
+      return -1;
+    }
+    file->buf = file->zbuf;
+#else
+    // the file was written with compression, but zlib is not available
+    return -1;
+#endif
+  }
+
+  // the records are checked as they are used
+  cnt = nptohl(file->buf + raw_len - 4);
+  if (cnt == 0 || cnt > (raw_len - 4) / 4) {
+    return -1;
+  }
+  file->buf_len = raw_len - 4 - cnt * 4;
+  file->dir = file->buf + file->buf_len;
+  file->recs_cnt = cnt;
+  file->block = block;
+  file->block_first = nptohll(e + 40);
+  return 0;
+}
+
+// find the block that holds the record with the given number (or -1)
+static int64_t find_block_num(const parsebgp_rib_file_t *file, uint64_t num)
+{
+  int64_t lo = 0, hi = (int64_t)file->info.blocks_cnt - 1, mid, found = -1;
+
+  while (lo <= hi) {
+    mid = lo + (hi - lo) / 2;
+    if (nptohll(file->blocks_index + mid * BLOCK_IDX_LEN + 40) <= num) {
+      found = mid;
+      lo = mid + 1;
+    } else {
+      hi = mid - 1;
+    }
+  }
+  return found;
+}
+
+// get the key of a record of the decoded block (and a pointer to the rest of
+// the record)
+static int get_rec(const parsebgp_rib_file_t *file, size_t idx, uint8_t *key,
+                   const uint8_t **body)
+{
+  uint32_t off = nptohl(file->dir + idx * 4);
+  const uint8_t *p = file->buf + off;
+  int bytes;
+
+  if (off > file->buf_len || file->buf_len - off < 2 || p[0] > 1 ||
+      p[1] > (p[0] ? 128 : 32)) {
+    return -1;
+  }
+  bytes = (p[1] + 7) / 8;
+  if (file->buf_len - off - 2 < (size_t)bytes) {
+    return -1;
+  }
+  memset(key, 0, KEY_LEN);
+  key[0] = p[0];
+  memcpy(key + 1, p + 2, bytes);
+  key[KEY_LEN - 1] = p[1];
+  *body = p + 2 + bytes;
+  return 0;
+}
+
+// find the first record of the decoded block whose key is not before the
+// given key (the record key is returned in rec_key)
+static int find_rec(const parsebgp_rib_file_t *file, const uint8_t *key,
+                    size_t *idx, uint8_t *rec_key, const uint8_t **body)
+{
+  size_t lo = 0, hi = file->recs_cnt, mid;
+
+  while (lo < hi) {
+    mid = lo + (hi - lo) / 2;
+    if (get_rec(file, mid, rec_key, body) != 0) {
+      return -1;
+    }
+    if (memcmp(rec_key, key, KEY_LEN) < 0) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  *idx = lo;
+  if (lo < file->recs_cnt && get_rec(file, lo, rec_key, body) != 0) {
+    return -1;
+  }
+  return 0;
+}
+
+static int get_attrs(const parsebgp_rib_file_t *file, uint64_t id,
+                     parsebgp_rib_attrs_t *attrs)
+{
+  const uint8_t *p;
+  uint64_t off;
+
+  if (id >= file->info.attrs_cnt) {
+    return -1;
+  }
+  off = nptohll(file->attrs_index + id * 8);
+  if (off > file->attrs_len || file->attrs_len - off < ATTRS_HDR_LEN) {
+    return -1;
+  }
+  p = file->attrs + off;
+  attrs->raw_len = nptohs(p + 34);
+  if (file->attrs_len - off - ATTRS_HDR_LEN < attrs->raw_len) {
+    return -1;
+  }
+  attrs->hash = nptohll(p);
+  attrs->refcnt = nptohll(p + 8);
+  memcpy(attrs->next_hop, p + 16, 16);
+  attrs->asn_4_byte = p[32];
+  attrs->next_hop_afi = p[33];
+  attrs->raw = p + ATTRS_HDR_LEN;
+  return 0;
+}
+
+// pass the routes of a record of the decoded block to the callback (the
+// callback return value is stored in rc)
+static int emit_routes(parsebgp_rib_file_t *file, const uint8_t *key,
+                       const uint8_t *body, parsebgp_rib_walk_cb_t *cb,
+                       void *user, int *rc)
+{
+  const uint8_t *p = body, *end = file->buf + file->buf_len;
+  parsebgp_rib_route_t route;
+  parsebgp_rib_attrs_t attrs;
+  uint64_t cnt, peer = 0, delta, path_id, id;
+
+  memset(&route, 0, sizeof(route));
+  if (key[0] == 0) {
+    route.prefix.type = PARSEBGP_BGP_PREFIX_UNICAST_IPV4;
+    route.prefix.afi = PARSEBGP_BGP_AFI_IPV4;
+  } else {
+    route.prefix.type = PARSEBGP_BGP_PREFIX_UNICAST_IPV6;
+    route.prefix.afi = PARSEBGP_BGP_AFI_IPV6;
+  }
+  route.prefix.safi = PARSEBGP_BGP_SAFI_UNICAST;
+  route.prefix.len = key[KEY_LEN - 1];
+  memcpy(route.prefix.addr, key + 1, 16);
+  route.attrs = &attrs;
+
+  // skip the parent
+  *rc = 0;
+  if (dec_varint(&p, end, &delta) != 0 || dec_varint(&p, end, &cnt) != 0) {
+    return -1;
+  }
+  for (; cnt > 0; cnt--) {
+    if (dec_varint(&p, end, &delta) != 0 ||
+        dec_varint(&p, end, &path_id) != 0 || path_id > UINT32_MAX ||
+        dec_varint(&p, end, &id) != 0 ||
+        (peer += delta) >= file->info.peers_cnt ||
+        get_attrs(file, id, &attrs) != 0) {
+      return -1;
+    }
+    route.prefix.path_id = path_id;
+    route.peer = &file->peers[peer];
+    if ((*rc = cb(user, &route)) != 0) {
+      break;
+    }
+  }
+  return 0;
+}
+
+/* ========== PUBLIC API FUNCTIONS ========== */
+
+int parsebgp_rib_file_write(const parsebgp_rib_t *rib, const char *fname,
+                            uint32_t timestamp, int flags)
+{
+  writer_t w;
+  uint8_t hdr[HDR_LEN];
+  int rc = -1;
+
+  memset(&w, 0, sizeof(w));
+#ifdef HAVE_LIBZ
+  w.compress = (flags & PARSEBGP_RIB_FILE_COMPRESS) != 0;
+#endif
+  w.attrs_slots_cnt = 1024;
+  if ((w.attrs_index = calloc(w.attrs_slots_cnt, sizeof(uint64_t))) == NULL ||
+      (w.fp = fopen(fname, "wb")) == NULL) {
+    goto done;
+  }
+
+  // the header is written last, once the offsets are known
+  memset(hdr, 0, HDR_LEN);
+  put(&w, hdr, HDR_LEN);
+  if (parsebgp_rib_walk(rib, write_route, &w) != 0 ||
+      (w.have_prefix && finish_prefix(&w) != 0) || flush_block(&w) != 0 ||
+      write_tables(&w, rib, timestamp) != 0) {
+    goto done;
+  }
+  rc = 0;
+
+done:
+  if (w.fp != NULL && fclose(w.fp) != 0) {
+    rc = -1;
+  }
+  if (w.fp != NULL && rc != 0) {
+    unlink(fname);
+  }
+  free(w.block);
+  free(w.zbuf);
+  free(w.index);
+  free(w.dir);
+  free(w.routes);
+  free(w.attrs);
+  free(w.attrs_index);
+  return rc;
+}
+
+parsebgp_rib_file_t *parsebgp_rib_file_open(const char *fname)
+{
+  parsebgp_rib_file_t *file;
+  parsebgp_rib_peer_t *peer;
+  const uint8_t *p;
+  uint64_t peers_off, attrs_off, attrs_index_off, blocks_index_off, len;
+  struct stat st;
+  uint32_t i;
+  int fd;
+  void *map;
+
+  if ((fd = open(fname, O_RDONLY)) < 0) {
+    return NULL;
+  }
+  if (fstat(fd, &st) != 0 || st.st_size < HDR_LEN ||
+      (map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) ==
+        MAP_FAILED) {
+    close(fd);
+    return NULL;
+  }
+  close(fd);
+  if ((file = malloc_zero(sizeof(parsebgp_rib_file_t))) == NULL) {
+    munmap(map, st.st_size);
+    return NULL;
+  }
+  file->map = p = map;
+  file->map_len = len = st.st_size;
+  file->block = -1;
+
+  // check that every section is inside the file
+  if (memcmp(p, FILE_MAGIC, 8) != 0 ||
+      nptohs(p + HDR_VERSION) != FILE_VERSION ||
+      nptohll(p + HDR_FILE_LEN) != len) {
+    goto err;
+  }
+  file->info.timestamp = nptohl(p + HDR_TIMESTAMP);
+  file->info.peers_cnt = nptohl(p + HDR_PEERS_CNT);
+  file->info.blocks_cnt = nptohl(p + HDR_BLOCKS_CNT);
+  file->info.attrs_cnt = nptohll(p + HDR_ATTRS_CNT);
+  file->info.prefixes_cnt = nptohll(p + HDR_PREFIXES_CNT);
+  file->info.routes_cnt = nptohll(p + HDR_ROUTES_CNT);
+  file->info.compressed = (nptohs(p + HDR_FLAGS) & FLAG_COMPRESSED) != 0;
+  peers_off = nptohll(p + HDR_PEERS_OFF);
+  attrs_off = nptohll(p + HDR_ATTRS_OFF);
+  attrs_index_off = nptohll(p + HDR_ATTRS_INDEX_OFF);
+  blocks_index_off = nptohll(p + HDR_BLOCKS_INDEX_OFF);
+  if (peers_off < HDR_LEN || peers_off > attrs_off ||
+      attrs_off > attrs_index_off || attrs_index_off > blocks_index_off ||
+      blocks_index_off > len ||
+      (attrs_off - peers_off) / PEER_LEN < file->info.peers_cnt ||
+      (blocks_index_off - attrs_index_off) / 8 < file->info.attrs_cnt ||
+      (len - blocks_index_off) / BLOCK_IDX_LEN < file->info.blocks_cnt) {
+    goto err;
+  }
+  file->blocks_end = peers_off;
+  file->attrs = p + attrs_off;
+  file->attrs_len = attrs_index_off - attrs_off;
+  file->attrs_index = p + attrs_index_off;
+  file->blocks_index = p + blocks_index_off;
+
+  if ((file->peers = malloc_zero((file->info.peers_cnt + 1) *
+                                 sizeof(parsebgp_rib_peer_t))) == NULL) {
+    goto err;
+  }
+  for (i = 0; i < file->info.peers_cnt; i++) {
+    p = file->map + peers_off + i * PEER_LEN;
+    peer = &file->peers[i];
+    peer->idx = i;
+    peer->afi = p[0];
+    peer->asn = nptohl(p + 4);
+    memcpy(peer->ip, p + 8, 16);
+    peer->routes_cnt = nptohll(p + 24);
+  }
+  return file;
+
+err:
+  parsebgp_rib_file_close(file);
+  return NULL;
+}
+
+void parsebgp_rib_file_close(parsebgp_rib_file_t *file)
+{
+  if (file == NULL) {
+    return;
+  }
+  if (file->map != NULL) {
+    munmap((void *)file->map, file->map_len);
+  }
+#ifdef HAVE_LIBZ
+  if (file->zs_init) {
+    inflateEnd(&file->zs);
+  }
+#endif
+  free(file->peers);
+  free(file->zbuf);
+  free(file);
+}
+
+void parsebgp_rib_file_get_info(const parsebgp_rib_file_t *file,
+                                parsebgp_rib_file_info_t *info)
+{
+  *info = file->info;
+}
+
+const parsebgp_rib_peer_t *
+parsebgp_rib_file_get_peer(const parsebgp_rib_file_t *file, uint32_t peer_idx)
+{
+  return (peer_idx < file->info.peers_cnt) ? &file->peers[peer_idx] : NULL;
+}
+
+int parsebgp_rib_file_lookup(parsebgp_rib_file_t *file,
+                             const parsebgp_bgp_prefix_t *prefix, int longest,
+                             parsebgp_rib_walk_cb_t *cb, void *user)
+{
+  uint8_t key[KEY_LEN], rec_key[KEY_LEN];
+  const uint8_t *body, *p;
+  uint64_t num, delta;
+  int64_t block;
+  size_t idx;
+  int rc;
+
+  if (make_key(prefix, key) != 0 || (block = find_block(file, key)) < 0) {
+    return 0;
+  }
+  if (load_block(file, block) != 0 ||
+      find_rec(file, key, &idx, rec_key, &body) != 0) {
+    return -1;
+  }
+  if (idx == file->recs_cnt || memcmp(rec_key, key, KEY_LEN) != 0) {
+    if (!longest || idx == 0) {
+      return 0;
+    }
+    // start from the closest prefix before the key, and follow its parents
+    // until one covers the key
+    num = file->block_first + --idx;
+    if (get_rec(file, idx, rec_key, &body) != 0) {
+      return -1;
+    }
+    while (!key_covers(rec_key, key)) {
+      p = body;
+      if (dec_varint(&p, file->buf + file->buf_len, &delta) != 0 ||
+          delta > num) {
+        return -1;
+      }
+      if (delta == 0) {
+        return 0;
+      }
+      num -= delta;
+      if ((block = find_block_num(file, num)) < 0 ||
+          load_block(file, block) != 0 ||
+          num - file->block_first >= file->recs_cnt ||
+          get_rec(file, num - file->block_first, rec_key, &body) != 0) {
+        return -1;
+      }
+    }
+  }
+  return (emit_routes(file, rec_key, body, cb, user, &rc) != 0) ? -1 : 1;
+}
+
+int parsebgp_rib_file_walk(parsebgp_rib_file_t *file,
+                           const parsebgp_bgp_prefix_t *first,
+                           const parsebgp_bgp_prefix_t *last,
+                           parsebgp_rib_walk_cb_t *cb, void *user)
+{
+  uint8_t first_key[KEY_LEN], last_key[KEY_LEN], rec_key[KEY_LEN];
+  const uint8_t *body;
+  int64_t block = 0, first_block;
+  size_t idx;
+  int rc;
+
+  if ((first != NULL && make_key(first, first_key) != 0) ||
+      (last != NULL && make_key(last, last_key) != 0)) {
+    return 0;
+  }
+  if (first != NULL && (block = find_block(file, first_key)) < 0) {
+    block = 0;
+  }
+
+  for (first_block = block; block < file->info.blocks_cnt; block++) {
+    if (load_block(file, block) != 0) {
+      return -1;
+    }
+    idx = 0;
+    if (first != NULL && block == first_block &&
+        find_rec(file, first_key, &idx, rec_key, &body) != 0) {
+      return -1;
+    }
+    for (; idx < file->recs_cnt; idx++) {
+      if (get_rec(file, idx, rec_key, &body) != 0) {
+        return -1;
+      }
+      if (last != NULL && memcmp(rec_key, last_key, KEY_LEN) > 0) {
+        return 0;
+      }
+      if (emit_routes(file, rec_key, body, cb, user, &rc) != 0) {
+        return -1;
+      }
+      if (rc != 0) {
+        return rc;
+      }
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,871 @@
+/*
+ * Copyright (C) 2017 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "parsebgp_sax.h"
+#include "parsebgp_bgp_update_impl.h"
+#include "parsebgp_bmp_peers.h"
+#include "parsebgp_utils.h"
+#include <string.h>
+
+#define BGP_MARKER_LEN 16
+#define BMP_HDR_V3_LEN 6
+#define BMP_PEER_HDR_LEN 42
+#define MRT_HDR_LEN 12
+
+/** Returned by the (internal) decoders if a handler asked to skip the rest of
+    the message. Errors are negative, so this never collides with them. */
+#define SAX_SKIP PARSEBGP_SAX_SKIP_MSG
+
+/** Call the given handler (if set), and stop decoding if it asks to skip the
+    rest of the message */
+#define SAX_CALL(ctx, handler, ...)                                            \
+  do {                                                                         \
+    if ((ctx)->handlers->handler != NULL &&                                    \
+        (ctx)->handlers->handler((ctx)->user, __VA_ARGS__) !=                 \
+          PARSEBGP_SAX_CONTINUE) {                                             \
+      return SAX_SKIP;                                                         \
+    }                                                                          \
+  } while (0)
+
+/** Return from the calling decoder unless the given decoder returned OK */
+#define SAX_TRY(expr)                                                          \
+  do {                                                                         \
+    int _rc = (expr);                                                          \
+    if (_rc != PARSEBGP_OK) {                                                  \
+      return _rc;                                                              \
+    }                                                                          \
+  } while (0)
+
+/** Ensure that at least n bytes are left in [buf, end). The whole message is
+    known to be in the buffer, so running out of bytes means it is malformed. */
+#define SAX_NEED(buf, end, n)                                                  \
+  PARSEBGP_ASSERT((size_t)((end) - (buf)) >= (size_t)(n))
+
+typedef struct sax_ctx {
+
+  /** Options given by the caller */
+  const parsebgp_opts_t *opts;
+
+  /** Handlers given by the caller */
+  const parsebgp_sax_handlers_t *handlers;
+
+  /** User pointer given by the caller */
+  void *user;
+
+  /** Timestamp of the current message (used for encapsulated messages) */
+  uint32_t ts_sec;
+  uint32_t ts_usec;
+
+  /** BGP parser configuration for the current message (these mirror the
+      fields of parsebgp_bgp_opts_t that the MRT and BMP decoders set) */
+  int asn_4_byte;
+  int asn_4_byte_trusted;
+  int mp_reach_no_afi_safi_reserved;
+  uint16_t afi;
+  uint8_t safi;
+  uint8_t add_path[PARSEBGP_BGP_OPTS_ADD_PATH_CNT]
+                  [PARSEBGP_BGP_OPTS_ADD_PATH_CNT];
+
+} sax_ctx_t;
+
+/* -------------------- BGP -------------------- */
+
+static int sax_prefixes(sax_ctx_t *ctx, parsebgp_sax_nlri_kind_t kind,
+                        parsebgp_bgp_afi_t afi, parsebgp_bgp_safi_t safi,
+                        const uint8_t *buf, const uint8_t *end)
+{
+  parsebgp_sax_prefix_t pfx;
+  uint8_t max_len = (afi == PARSEBGP_BGP_AFI_IPV4) ? 32 : 128;
+  int add_path = afi < PARSEBGP_BGP_OPTS_ADD_PATH_CNT &&
+                 safi < PARSEBGP_BGP_OPTS_ADD_PATH_CNT &&
+                 ctx->add_path[afi][safi];
+  size_t bytes;
+
+  if (ctx->handlers->on_nlri == NULL) {
+    return PARSEBGP_OK;
+  }
+
+  pfx.afi = afi;
+  pfx.safi = safi;
+  pfx.path_id = 0;
+
+  while (buf < end) {
+    if (add_path) {
+      SAX_NEED(buf, end, sizeof(uint32_t));
+      pfx.path_id = nptohl(buf);
+      buf += sizeof(uint32_t);
+    }
+    SAX_NEED(buf, end, 1);
+    pfx.len = *(buf++);
+    PARSEBGP_ASSERT(pfx.len <= max_len);
+    bytes = (pfx.len + 7) / 8;
+    SAX_NEED(buf, end, bytes);
+    pfx.addr = buf;
+    buf += bytes;
+
+    SAX_CALL(ctx, on_nlri, kind, &pfx);
+  }
+
+  return PARSEBGP_OK;
+}
+
+// does the given AS path consist of whole segments of ASNs of the given size?
+static int sax_as_path(sax_ctx_t *ctx, uint8_t attr_type, int asn_4_byte,
+                       int trusted, const uint8_t *buf, const uint8_t *end)
+{
+  parsebgp_sax_as_path_seg_t seg;
+  size_t asn_size;
+
+  if (ctx->handlers->on_as_path_segment == NULL) {
+    return PARSEBGP_OK;
+  }
+
+  // as in parse_path_attr_as_path_safe, if the path does not parse with 4-byte
+  // ASNs then (unless that is known to be right) try 2-byte ASNs
+  if (asn_4_byte &&
+      parsebgp_bgp_update_as_path_fits(buf, end - buf, sizeof(uint32_t))) {
+    asn_size = sizeof(uint32_t);
+  } else if ((asn_4_byte == 0 || trusted == 0) &&
+             parsebgp_bgp_update_as_path_fits(buf, end - buf,
+                                              sizeof(uint16_t))) {
+    asn_4_byte = 0;
+    asn_size = sizeof(uint16_t);
+  } else {
+    PARSEBGP_RETURN_INVALID_MSG_ERR;
+  }
+
+  seg.attr_type = attr_type;
+  seg.asn_4_byte = asn_4_byte;
+
+  // the path was checked above, so the segments can be read directly
+  while (buf < end) {
+    seg.type = buf[0];
+    seg.asns_cnt = buf[1];
+    seg.asns = buf + 2;
+    buf += 2 + (seg.asns_cnt * asn_size);
+
+    SAX_CALL(ctx, on_as_path_segment, &seg);
+  }
+
+  return PARSEBGP_OK;
+}
+
+static int is_ip_unicast_multicast(uint16_t afi, uint8_t safi)
+{
+  return (afi == PARSEBGP_BGP_AFI_IPV4 || afi == PARSEBGP_BGP_AFI_IPV6) &&
+         (safi == PARSEBGP_BGP_SAFI_UNICAST ||
+          safi == PARSEBGP_BGP_SAFI_MULTICAST);
+}
+
+static int sax_mp_reach(sax_ctx_t *ctx, const uint8_t *buf,
+                        const uint8_t *end)
+{
+  uint16_t afi;
+  uint8_t safi, next_hop_len;
+
+  if (ctx->handlers->on_nlri == NULL) {
+    return PARSEBGP_OK;
+  }
+
+  // see parsebgp_bgp_update_mp_reach_decode for the compressed header used by
+  // TABLE_DUMP_V2
+  if (ctx->mp_reach_no_afi_safi_reserved && buf < end && *buf != 0) {
+    afi = ctx->afi;
+    safi = ctx->safi;
+    next_hop_len = *(buf++);
+    SAX_NEED(buf, end, next_hop_len);
+    buf += next_hop_len;
+  } else {
+    SAX_NEED(buf, end, 4);
+    afi = nptohs(buf);
+    safi = buf[2];
+    next_hop_len = buf[3];
+    buf += 4;
+    // next-hop and reserved byte
+    SAX_NEED(buf, end, next_hop_len + 1);
+    buf += next_hop_len + 1;
+  }
+
+  if (!is_ip_unicast_multicast(afi, safi)) {
+    // not supported, but the attribute was still given to on_path_attr
+    return PARSEBGP_OK;
+  }
+  return sax_prefixes(ctx, PARSEBGP_SAX_NLRI_ANNOUNCE, afi, safi, buf, end);
+}
+
+static int sax_mp_unreach(sax_ctx_t *ctx, const uint8_t *buf,
+                          const uint8_t *end)
+{
+  uint16_t afi;
+  uint8_t safi;
+
+  if (ctx->handlers->on_nlri == NULL) {
+    return PARSEBGP_OK;
+  }
+
+  SAX_NEED(buf, end, 3);
+  afi = nptohs(buf);
+  safi = buf[2];
+  buf += 3;
+
+  if (!is_ip_unicast_multicast(afi, safi)) {
+    return PARSEBGP_OK;
+  }
+  return sax_prefixes(ctx, PARSEBGP_SAX_NLRI_WITHDRAW, afi, safi, buf, end);
+}
+
+static int sax_path_attrs(sax_ctx_t *ctx, const uint8_t *buf,
+                          const uint8_t *end)
+{
+  parsebgp_sax_path_attr_t attr;
+
+  while (buf < end) {
+    SAX_NEED(buf, end, 2);
+    attr.flags = buf[0];
+    attr.type = buf[1];
+    buf += 2;
+
+    if (attr.flags & PARSEBGP_BGP_PATH_ATTR_FLAG_EXTENDED) {
+      SAX_NEED(buf, end, sizeof(uint16_t));
+      attr.len = nptohs(buf);
+      buf += sizeof(uint16_t);
+    } else {
+      SAX_NEED(buf, end, 1);
+      attr.len = *(buf++);
+    }
+    SAX_NEED(buf, end, attr.len);
+    attr.data = buf;
+    buf += attr.len;
+
+    SAX_CALL(ctx, on_path_attr, &attr);
+
+    switch (attr.type) {
+    case PARSEBGP_BGP_PATH_ATTR_TYPE_AS_PATH:
+      SAX_TRY(sax_as_path(ctx, attr.type, ctx->asn_4_byte,
+                          ctx->asn_4_byte_trusted, attr.data, buf));
+      break;
+
+    case PARSEBGP_BGP_PATH_ATTR_TYPE_AS4_PATH:
+      SAX_TRY(sax_as_path(ctx, attr.type, 1, 1, attr.data, buf));
+      break;
+
+    case PARSEBGP_BGP_PATH_ATTR_TYPE_MP_REACH_NLRI:
+      SAX_TRY(sax_mp_reach(ctx, attr.data, buf));
+      break;
+
+    case PARSEBGP_BGP_PATH_ATTR_TYPE_MP_UNREACH_NLRI:
+      SAX_TRY(sax_mp_unreach(ctx, attr.data, buf));
+      break;
+
+    default:
+      // only given to on_path_attr
+      break;
+    }
+  }
+
+  return PARSEBGP_OK;
+}
+
+static int sax_bgp_update(sax_ctx_t *ctx, const uint8_t *buf,
+                          const uint8_t *end)
+{
+  uint16_t withdrawn_len, attrs_len;
+
+  // Withdrawn Routes
+  SAX_NEED(buf, end, sizeof(uint16_t));
+  withdrawn_len = nptohs(buf);
+  buf += sizeof(uint16_t);
+  SAX_NEED(buf, end, withdrawn_len);
+  SAX_TRY(sax_prefixes(ctx, PARSEBGP_SAX_NLRI_WITHDRAW, PARSEBGP_BGP_AFI_IPV4,
+                       PARSEBGP_BGP_SAFI_UNICAST, buf, buf + withdrawn_len));
+  buf += withdrawn_len;
+
+  // Path Attributes
+  SAX_NEED(buf, end, sizeof(uint16_t));
+  attrs_len = nptohs(buf);
+  buf += sizeof(uint16_t);
+  SAX_NEED(buf, end, attrs_len);
+  SAX_TRY(sax_path_attrs(ctx, buf, buf + attrs_len));
+  buf += attrs_len;
+
+  // NLRI (the rest of the message)
+  return sax_prefixes(ctx, PARSEBGP_SAX_NLRI_ANNOUNCE, PARSEBGP_BGP_AFI_IPV4,
+                      PARSEBGP_BGP_SAFI_UNICAST, buf, end);
+}
+
+// decode a BGP message that has been framed (len is its length), or just call
+// on_msg_header for it if walk is not set
+static int sax_bgp(sax_ctx_t *ctx, const uint8_t *buf, size_t len, int walk)
+{
+  parsebgp_sax_msg_hdr_t hdr;
+  size_t hdr_len = ctx->opts->bgp.marker_omitted ? 3 : BGP_MARKER_LEN + 3;
+
+  memset(&hdr, 0, sizeof(hdr));
+  hdr.type = PARSEBGP_MSG_TYPE_BGP;
+  hdr.msg_type = buf[hdr_len - 1];
+  hdr.timestamp_sec = ctx->ts_sec;
+  hdr.timestamp_usec = ctx->ts_usec;
+  hdr.raw = buf;
+  hdr.len = len;
+  SAX_CALL(ctx, on_msg_header, &hdr);
+
+  if (walk == 0 || hdr.msg_type != PARSEBGP_BGP_TYPE_UPDATE) {
+    return PARSEBGP_OK;
+  }
+  return sax_bgp_update(ctx, buf + hdr_len, buf + len);
+}
+
+// decode a BGP message encapsulated in an MRT or BMP message
+static int sax_bgp_encap(sax_ctx_t *ctx, const uint8_t *buf, size_t len,
+                         int allow_truncation)
+{
+  size_t msg_len;
+  int err;
+
+  if ((err = parsebgp_bgp_frame(ctx->opts, buf, len, &msg_len)) !=
+      PARSEBGP_OK) {
+    // the outer message is complete, so a partial header is malformed
+    PARSEBGP_ASSERT(err != PARSEBGP_PARTIAL_MSG);
+    return err;
+  }
+
+  if (msg_len > len) {
+    // as parsebgp_bgp_decode_ext does for MRT, report the truncated message
+    // without decoding it
+    PARSEBGP_ASSERT(allow_truncation);
+    SAX_TRY(sax_bgp(ctx, buf, len, 0));
+    return PARSEBGP_TRUNCATED_MSG;
+  }
+
+  return sax_bgp(ctx, buf, msg_len, 1);
+}
+
+/* -------------------- MRT -------------------- */
+
+static int sax_table_dump(sax_ctx_t *ctx, uint16_t subtype,
+                          const uint8_t *buf, const uint8_t *end)
+{
+  parsebgp_sax_peer_t peer;
+  parsebgp_sax_prefix_t pfx;
+  parsebgp_sax_rib_entry_t entry;
+  size_t ip_len;
+  uint16_t attrs_len;
+
+  // the subtype is the AFI
+  switch (subtype) {
+  case PARSEBGP_BGP_AFI_IPV4:
+    ip_len = 4;
+    break;
+
+  case PARSEBGP_BGP_AFI_IPV6:
+    ip_len = 16;
+    break;
+
+  default:
+    return PARSEBGP_OK;
+  }
+
+  // View Number, Sequence, Prefix, Prefix Length, Status, Originated Time,
+  // Peer IP, Peer AS, Attribute Length
+  SAX_NEED(buf, end, 4 + ip_len + 2 + 4 + ip_len + 2 + 2);
+  buf += 4;
+
+  pfx.afi = subtype;
+  pfx.safi = PARSEBGP_BGP_SAFI_UNICAST;
+  pfx.path_id = 0;
+  pfx.addr = buf;
+  buf += ip_len;
+  pfx.len = *(buf++);
+  PARSEBGP_ASSERT(pfx.len <= ip_len * 8);
+  buf++;
+
+  entry.peer_index = 0;
+  entry.originated_time = nptohl(buf);
+  entry.path_id = 0;
+  buf += sizeof(uint32_t);
+
+  peer.index = -1;
+  peer.afi = subtype;
+  peer.ip = buf;
+  peer.bgp_id = NULL;
+  buf += ip_len;
+  peer.asn = nptohs(buf);
+  buf += sizeof(uint16_t);
+
+  attrs_len = nptohs(buf);
+  buf += sizeof(uint16_t);
+  SAX_NEED(buf, end, attrs_len);
+
+  SAX_CALL(ctx, on_peer, &peer);
+  SAX_CALL(ctx, on_prefix, &pfx);
+  SAX_CALL(ctx, on_rib_entry, &entry);
+  return sax_path_attrs(ctx, buf, buf + attrs_len);
+}
+
+static int sax_table_dump_v2_peer_index(sax_ctx_t *ctx, const uint8_t *buf,
+                                        const uint8_t *end)
+{
+  parsebgp_sax_peer_t peer;
+  uint16_t name_len, peer_cnt, i;
+  uint8_t type;
+  size_t ip_len, asn_len;
+
+  // Collector BGP ID, View Name Length, View Name, Peer Count
+  SAX_NEED(buf, end, 4 + 2);
+  buf += 4;
+  name_len = nptohs(buf);
+  buf += 2;
+  SAX_NEED(buf, end, name_len + 2);
+  buf += name_len;
+  peer_cnt = nptohs(buf);
+  buf += 2;
+
+  for (i = 0; i < peer_cnt; i++) {
+    SAX_NEED(buf, end, 1);
+    type = *(buf++);
+    peer.index = i;
+    peer.afi = (type & 0x01) + 1;
+    ip_len = (type & 0x01) ? 16 : 4;
+    asn_len = (type & 0x02) ? 4 : 2;
+
+    SAX_NEED(buf, end, 4 + ip_len + asn_len);
+    peer.bgp_id = buf;
+    buf += 4;
+    peer.ip = buf;
+    buf += ip_len;
+    peer.asn = (asn_len == 4) ? nptohl(buf) : nptohs(buf);
+    buf += asn_len;
+
+    SAX_CALL(ctx, on_peer, &peer);
+  }
+
+  return PARSEBGP_OK;
+}
+
+static int sax_table_dump_v2_rib(sax_ctx_t *ctx, uint16_t subtype,
+                                 const uint8_t *buf, const uint8_t *end)
+{
+  parsebgp_sax_prefix_t pfx;
+  parsebgp_sax_rib_entry_t entry;
+  uint16_t entry_cnt, attrs_len, i;
+  int add_path = 0;
+  size_t bytes;
+
+  switch (subtype) {
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_UNICAST_ADDPATH:
+    add_path = 1;
+  // FALL THROUGH
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_UNICAST:
+    pfx.afi = PARSEBGP_BGP_AFI_IPV4;
+    pfx.safi = PARSEBGP_BGP_SAFI_UNICAST;
+    break;
+
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_MULTICAST_ADDPATH:
+    add_path = 1;
+  // FALL THROUGH
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_MULTICAST:
+    pfx.afi = PARSEBGP_BGP_AFI_IPV4;
+    pfx.safi = PARSEBGP_BGP_SAFI_MULTICAST;
+    break;
+
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV6_UNICAST_ADDPATH:
+    add_path = 1;
+  // FALL THROUGH
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV6_UNICAST:
+    pfx.afi = PARSEBGP_BGP_AFI_IPV6;
+    pfx.safi = PARSEBGP_BGP_SAFI_UNICAST;
+    break;
+
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV6_MULTICAST_ADDPATH:
+    add_path = 1;
+  // FALL THROUGH
+  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV6_MULTICAST:
+    pfx.afi = PARSEBGP_BGP_AFI_IPV6;
+    pfx.safi = PARSEBGP_BGP_SAFI_MULTICAST;
+    break;
+
+  default:
+    // RIB_GENERIC is not supported (by the tree decoder either)
+    return PARSEBGP_OK;
+  }
+
+  // Sequence Number, Prefix Length, Prefix, Entry Count
+  SAX_NEED(buf, end, 4 + 1);
+  buf += 4;
+  pfx.len = *(buf++);
+  PARSEBGP_ASSERT(pfx.len <= (pfx.afi == PARSEBGP_BGP_AFI_IPV4 ? 32 : 128));
+  bytes = (pfx.len + 7) / 8;
+  SAX_NEED(buf, end, bytes + 2);
+  pfx.addr = buf;
+  pfx.path_id = 0;
+  buf += bytes;
+  entry_cnt = nptohs(buf);
+  buf += 2;
+
+  // as parse_table_dump_v2_rib_entries configures the BGP parser
+  ctx->asn_4_byte = 1;
+  ctx->mp_reach_no_afi_safi_reserved = 1;
+  ctx->afi = pfx.afi;
+  ctx->safi = pfx.safi;
+
+  SAX_CALL(ctx, on_prefix, &pfx);
+
+  for (i = 0; i < entry_cnt; i++) {
+    // Peer Index, Originated Time, [Path Identifier], Attribute Length
+    SAX_NEED(buf, end, 2 + 4 + (add_path ? 4 : 0) + 2);
+    entry.peer_index = nptohs(buf);
+    entry.originated_time = nptohl(buf + 2);
+    buf += 6;
+    entry.path_id = 0;
+    if (add_path) {
+      entry.path_id = nptohl(buf);
+      buf += 4;
+    }
+    attrs_len = nptohs(buf);
+    buf += 2;
+    SAX_NEED(buf, end, attrs_len);
+
+    SAX_CALL(ctx, on_rib_entry, &entry);
+    SAX_TRY(sax_path_attrs(ctx, buf, buf + attrs_len));
+    buf += attrs_len;
+  }
+
+  return PARSEBGP_OK;
+}
+
+static int sax_bgp4mp(sax_ctx_t *ctx, uint16_t subtype, const uint8_t *buf,
+                      const uint8_t *end)
+{
+  parsebgp_sax_peer_t peer;
+  size_t asn_len, ip_len;
+
+  switch (subtype) {
+  case PARSEBGP_MRT_BGP4MP_STATE_CHANGE:
+  case PARSEBGP_MRT_BGP4MP_MESSAGE:
+  case PARSEBGP_MRT_BGP4MP_MESSAGE_LOCAL:
+    asn_len = 2;
+    break;
+
+  case PARSEBGP_MRT_BGP4MP_MESSAGE_AS4:
+  case PARSEBGP_MRT_BGP4MP_STATE_CHANGE_AS4:
+  case PARSEBGP_MRT_BGP4MP_MESSAGE_AS4_LOCAL:
+    asn_len = 4;
+    break;
+
+  default:
+    return PARSEBGP_OK;
+  }
+
+  // Peer ASN, Local ASN
+  SAX_NEED(buf, end, asn_len * 2);
+  peer.index = -1;
+  peer.bgp_id = NULL;
+  peer.asn = (asn_len == 4) ? nptohl(buf) : nptohs(buf);
+  buf += asn_len * 2;
+
+  // see parse_bgp4mp for these old Quagga quirks
+  if ((subtype == PARSEBGP_MRT_BGP4MP_STATE_CHANGE && (end - buf) == 4) ||
+      (subtype == PARSEBGP_MRT_BGP4MP_MESSAGE && (end - buf) > 4 &&
+       memcmp(buf + 2, "\xff\xff", 2) == 0)) {
+    peer.afi = 0;
+    peer.ip = NULL;
+  } else {
+    // Interface Index, Address Family, Peer IP, Local IP
+    SAX_NEED(buf, end, 4);
+    peer.afi = nptohs(buf + 2);
+    buf += 4;
+    switch (peer.afi) {
+    case PARSEBGP_BGP_AFI_IPV4:
+      ip_len = 4;
+      break;
+
+    case PARSEBGP_BGP_AFI_IPV6:
+      ip_len = 16;
+      break;
+
+    default:
+      PARSEBGP_RETURN_INVALID_MSG_ERR;
+    }
+    SAX_NEED(buf, end, ip_len * 2);
+    peer.ip = buf;
+    buf += ip_len * 2;
+  }
+
+  SAX_CALL(ctx, on_peer, &peer);
+
+  switch (subtype) {
+  case PARSEBGP_MRT_BGP4MP_MESSAGE_AS4:
+  case PARSEBGP_MRT_BGP4MP_MESSAGE_AS4_LOCAL:
+    ctx->asn_4_byte = 1;
+  // FALL THROUGH
+  case PARSEBGP_MRT_BGP4MP_MESSAGE:
+  case PARSEBGP_MRT_BGP4MP_MESSAGE_LOCAL:
+    return sax_bgp_encap(ctx, buf, end - buf, 1);
+
+  default:
+    // state changes have no handlers
+    return PARSEBGP_OK;
+  }
+}
+
+static int sax_mrt(sax_ctx_t *ctx, const uint8_t *buf, size_t len)
+{
+  parsebgp_sax_msg_hdr_t hdr;
+  const uint8_t *end = buf + len;
+
+  // parsebgp_mrt_frame checked the header is there
+  memset(&hdr, 0, sizeof(hdr));
+  hdr.type = PARSEBGP_MSG_TYPE_MRT;
+  hdr.timestamp_sec = nptohl(buf);
+  hdr.msg_type = nptohs(buf + 4);
+  hdr.subtype = nptohs(buf + 6);
+  hdr.raw = buf;
+  hdr.len = len;
+  buf += MRT_HDR_LEN;
+
+  switch (hdr.msg_type) {
+  case PARSEBGP_MRT_TYPE_BGP4MP_ET:
+  case PARSEBGP_MRT_TYPE_ISIS_ET:
+  case PARSEBGP_MRT_TYPE_OSPF_V3_ET:
+    hdr.timestamp_usec = nptohl(buf);
+    buf += sizeof(uint32_t);
+    break;
+
+  default:
+    break;
+  }
+
+  ctx->ts_sec = hdr.timestamp_sec;
+  ctx->ts_usec = hdr.timestamp_usec;
+  SAX_CALL(ctx, on_msg_header, &hdr);
+
+  if (ctx->opts->mrt.parse_headers_only) {
+    return PARSEBGP_OK;
+  }
+
+  switch (hdr.msg_type) {
+  case PARSEBGP_MRT_TYPE_TABLE_DUMP:
+    return sax_table_dump(ctx, hdr.subtype, buf, end);
+
+  case PARSEBGP_MRT_TYPE_TABLE_DUMP_V2:
+    if (hdr.subtype == PARSEBGP_MRT_TABLE_DUMP_V2_PEER_INDEX_TABLE) {
+      return sax_table_dump_v2_peer_index(ctx, buf, end);
+    }
+    return sax_table_dump_v2_rib(ctx, hdr.subtype, buf, end);
+
+  case PARSEBGP_MRT_TYPE_BGP4MP:
+  case PARSEBGP_MRT_TYPE_BGP4MP_ET:
+    return sax_bgp4mp(ctx, hdr.subtype, buf, end);
+
+  default:
+    // only given to on_msg_header
+    return PARSEBGP_OK;
+  }
+}
+
+/* -------------------- BMP -------------------- */
+
+// configure the BGP parser from the peer table, as parsebgp_bmp_decode does
+static void sax_bmp_peers_set_opts(sax_ctx_t *ctx, const uint8_t *buf)
+{
+  parsebgp_bmp_peer_hdr_t hdr;
+  parsebgp_opts_t opts;
+
+  memset(&hdr, 0, sizeof(hdr));
+  hdr.type = buf[0];
+  hdr.flags = buf[1];
+  memcpy(&hdr.dist_id, buf + 2, sizeof(hdr.dist_id));
+  if (hdr.flags & PARSEBGP_BMP_PEER_FLAG_IPV6) {
+    hdr.afi = PARSEBGP_BGP_AFI_IPV6;
+    memcpy(hdr.addr, buf + 10, 16);
+  } else {
+    hdr.afi = PARSEBGP_BGP_AFI_IPV4;
+    memcpy(hdr.addr, buf + 22, 4);
+  }
+  hdr.asn = nptohl(buf + 26);
+  memcpy(hdr.bgp_id, buf + 30, sizeof(hdr.bgp_id));
+
+  // the peer table only sets a few BGP options, but takes them all
+  memcpy(&opts, ctx->opts, sizeof(opts));
+  parsebgp_bmp_peers_set_opts(ctx->opts->bmp.peers, &hdr, &opts);
+  ctx->asn_4_byte = opts.bgp.asn_4_byte;
+  ctx->asn_4_byte_trusted = opts.bgp.asn_4_byte_trusted;
+  memcpy(ctx->add_path, opts.bgp.add_path, sizeof(ctx->add_path));
+}
+
+static int sax_bmp(sax_ctx_t *ctx, const uint8_t *buf, size_t len)
+{
+  parsebgp_sax_msg_hdr_t hdr;
+  parsebgp_sax_peer_t peer;
+  const uint8_t *end = buf + len, *peer_hdr = NULL;
+
+  // Version, Length, Type (the caller checked the version, and
+  // parsebgp_bmp_frame the length)
+  memset(&hdr, 0, sizeof(hdr));
+  hdr.type = PARSEBGP_MSG_TYPE_BMP;
+  hdr.msg_type = buf[5];
+  hdr.raw = buf;
+  hdr.len = len;
+  buf += BMP_HDR_V3_LEN;
+
+  switch (hdr.msg_type) {
+  case PARSEBGP_BMP_TYPE_ROUTE_MON:
+  case PARSEBGP_BMP_TYPE_STATS_REPORT:
+  case PARSEBGP_BMP_TYPE_PEER_DOWN:
+  case PARSEBGP_BMP_TYPE_PEER_UP:
+  case PARSEBGP_BMP_TYPE_ROUTE_MIRROR_MSG:
+    // Per-Peer Header: Type, Flags, Distinguisher, Address, AS, BGP ID,
+    // Timestamp (seconds), Timestamp (microseconds)
+    SAX_NEED(buf, end, BMP_PEER_HDR_LEN);
+    peer_hdr = buf;
+    peer.index = -1;
+    if (peer_hdr[1] & PARSEBGP_BMP_PEER_FLAG_IPV6) {
+      peer.afi = PARSEBGP_BGP_AFI_IPV6;
+      peer.ip = peer_hdr + 10;
+    } else {
+      // IPv4 addresses are in the last 4 bytes of the field
+      peer.afi = PARSEBGP_BGP_AFI_IPV4;
+      peer.ip = peer_hdr + 22;
+    }
+    peer.asn = nptohl(peer_hdr + 26);
+    peer.bgp_id = peer_hdr + 30;
+    ctx->ts_sec = hdr.timestamp_sec = nptohl(peer_hdr + 34);
+    ctx->ts_usec = hdr.timestamp_usec = nptohl(peer_hdr + 38);
+    buf += BMP_PEER_HDR_LEN;
+    break;
+
+  default:
+    // no per-peer header
+    break;
+  }
+
+  SAX_CALL(ctx, on_msg_header, &hdr);
+  if (peer_hdr != NULL) {
+    SAX_CALL(ctx, on_peer, &peer);
+  }
+
+  if (ctx->opts->bmp.parse_headers_only ||
+      hdr.msg_type != PARSEBGP_BMP_TYPE_ROUTE_MON) {
+    return PARSEBGP_OK;
+  }
+
+  ctx->asn_4_byte = !(peer_hdr[1] & PARSEBGP_BMP_PEER_FLAG_2_BYTE_AS_PATH);
+  ctx->asn_4_byte_trusted = 0;
+  if (ctx->opts->bmp.peers != NULL) {
+    sax_bmp_peers_set_opts(ctx, peer_hdr);
+  }
+  return sax_bgp_encap(ctx, buf, end - buf, 0);
+}
+
+/* -------------------- PUBLIC API -------------------- */
+
+parsebgp_error_t parsebgp_sax_decode(const parsebgp_opts_t *opts,
+                                     parsebgp_msg_type_t type,
+                                     const parsebgp_sax_handlers_t *handlers,
+                                     void *user, const uint8_t *buf,
+                                     size_t *len)
+{
+  sax_ctx_t ctx;
+  size_t msg_len;
+  int err;
+
+  if (type == PARSEBGP_MSG_TYPE_BMP && *len > 0 && buf[0] != 3) {
+    // only BMP v3 messages have a length field and a per-peer header that
+    // can be read in place
+    return PARSEBGP_NOT_IMPLEMENTED;
+  }
+
+  // no handlers are called until the whole message is in the buffer
+  if ((err = parsebgp_frame(opts, type, buf, *len, &msg_len)) !=
+      PARSEBGP_OK) {
+    return err;
+  }
+  if (msg_len > *len) {
+    return PARSEBGP_PARTIAL_MSG;
+  }
+
+  ctx.opts = opts;
+  ctx.handlers = handlers;
+  ctx.user = user;
+  ctx.ts_sec = 0;
+  ctx.ts_usec = 0;
+  ctx.asn_4_byte = opts->bgp.asn_4_byte;
+  ctx.asn_4_byte_trusted = opts->bgp.asn_4_byte_trusted;
+  ctx.mp_reach_no_afi_safi_reserved = opts->bgp.mp_reach_no_afi_safi_reserved;
+  ctx.afi = opts->bgp.afi;
+  ctx.safi = opts->bgp.safi;
+  memcpy(ctx.add_path, opts->bgp.add_path, sizeof(ctx.add_path));
+
+  switch (type) {
+  case PARSEBGP_MSG_TYPE_BGP:
+    err = sax_bgp(&ctx, buf, msg_len, 1);
+    break;
+
+  case PARSEBGP_MSG_TYPE_BMP:
+    err = sax_bmp(&ctx, buf, msg_len);
+    break;
+
+  case PARSEBGP_MSG_TYPE_MRT:
+    err = sax_mrt(&ctx, buf, msg_len);
+    break;
+
+  default:
+    PARSEBGP_RETURN_INVALID_MSG_ERR;
+  }
+
+  if (err == SAX_SKIP) {
+    err = PARSEBGP_OK;
+  }
+  if (err == PARSEBGP_OK || err == PARSEBGP_TRUNCATED_MSG) {
+    *len = msg_len;
+  }
+  return err;
+}
+
+void parsebgp_sax_prefix_addr(const parsebgp_sax_prefix_t *prefix,
+                              uint8_t *dst)
+{
+  size_t len = prefix->len;
+
+  // parsebgp_decode_prefix zeroes the trailing bits (and bytes) the same way
+  memset(dst, 0, 16);
+  if (len > 128) {
+    len = 128;
+  }
+  memcpy(dst, prefix->addr, (len + 7) / 8);
+  if ((len % 8) != 0) {
+    dst[len / 8] &= 0xFF << (8 - (len % 8));
+  }
+}
+
+uint32_t parsebgp_sax_as_path_seg_asn(const parsebgp_sax_as_path_seg_t *seg,
+                                      int idx)
+{
+  if (seg->asn_4_byte) {
+    return nptohl(seg->asns + (idx * sizeof(uint32_t)));
+  }
+  return nptohs(seg->asns + (idx * sizeof(uint16_t)));
+}
@@ -0,0 +1,339 @@
+/*
+ * Copyright (C) 2017 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __PARSEBGP_SAX_H
+#define __PARSEBGP_SAX_H
+
+#include "parsebgp.h"
+#include "parsebgp_error.h"
+#include "parsebgp_opts.h"
+#include <inttypes.h>
+#include <stddef.h>
+
+/**
+ * Callback-Driven ("SAX") Decoding
+ *
+ * Instead of building a message structure that the caller then walks, the
+ * decoder invokes user-supplied handlers as it reads the wire format. Handlers
+ * are given views into the input buffer (which are only valid for the duration
+ * of the call) and nothing is allocated, so consumers that do not need to keep
+ * the decoded data avoid the cost of building it.
+ *
+ * Handlers are called in wire order, e.g., for a TABLE_DUMP_V2 RIB record:
+ * on_msg_header, on_prefix, and then on_rib_entry for each entry, followed by
+ * on_path_attr (and on_as_path_segment or on_nlri as appropriate) for each of
+ * its path attributes. For BGP messages encapsulated in MRT or BMP messages,
+ * on_peer is called with the peer from the outer header, followed by a second
+ * on_msg_header for the BGP message itself.
+ *
+ * Any handler may return PARSEBGP_SAX_SKIP_MSG to stop decoding the current
+ * message, in which case no further handlers are called and the whole message
+ * is consumed. NULL handlers are not called, and where possible the parts of
+ * the message that only they would need are not decoded (e.g., AS_PATH
+ * segments are not walked if on_as_path_segment is NULL).
+ *
+ * Messages are checked to be complete before any handler is called, but (since
+ * there is no validation pass) a malformed message may only be detected after
+ * some handlers were called for it. Data that the decoder does not understand
+ * (e.g., unknown message types, AFIs or SAFIs) is passed over without error.
+ */
+
+/**
+ * Handler Return Values
+ */
+typedef enum parsebgp_sax_action {
+
+  /** Continue decoding the message */
+  PARSEBGP_SAX_CONTINUE = 0,
+
+  /** Skip the rest of the message */
+  PARSEBGP_SAX_SKIP_MSG = 1,
+
+} parsebgp_sax_action_t;
+
+/**
+ * NLRI Kinds
+ */
+typedef enum parsebgp_sax_nlri_kind {
+
+  /** Announced (NLRI or MP_REACH_NLRI) prefix */
+  PARSEBGP_SAX_NLRI_ANNOUNCE = 1,
+
+  /** Withdrawn (Withdrawn Routes or MP_UNREACH_NLRI) prefix */
+  PARSEBGP_SAX_NLRI_WITHDRAW = 2,
+
+} parsebgp_sax_nlri_kind_t;
+
+/**
+ * Message Header
+ */
+typedef struct parsebgp_sax_msg_hdr {
+
+  /** Message type (BGP messages encapsulated in MRT or BMP messages are
+      reported as PARSEBGP_MSG_TYPE_BGP) */
+  parsebgp_msg_type_t type;
+
+  /** Type-specific message type (i.e., the MRT, BMP or BGP message type) */
+  uint16_t msg_type;
+
+  /** MRT subtype (zero for other message types) */
+  uint16_t subtype;
+
+  /** Timestamp (seconds) from the MRT common header or BMP per-peer header
+      (zero if there is none) */
+  uint32_t timestamp_sec;
+
+  /** Timestamp (microseconds), only set for extended-timestamp MRT types and
+      BMP messages */
+  uint32_t timestamp_usec;
+
+  /** Raw message (including its header) */
+  const uint8_t *raw;
+
+  /** Length of the raw message */
+  size_t len;
+
+} parsebgp_sax_msg_hdr_t;
+
+/**
+ * Peer
+ */
+typedef struct parsebgp_sax_peer {
+
+  /** Index of the peer in a TABLE_DUMP_V2 PEER_INDEX_TABLE, or -1 if the peer
+      is from the header of another message */
+  int index;
+
+  /** AFI of the peer address */
+  parsebgp_bgp_afi_t afi;
+
+  /** Peer address (4 or 16 bytes, depending on the AFI), or NULL if not
+      present in the message (as in BGP4MP messages from old Quagga versions) */
+  const uint8_t *ip;
+
+  /** Peer BGP ID (4 bytes), or NULL if not present in the message */
+  const uint8_t *bgp_id;
+
+  /** Peer ASN */
+  uint32_t asn;
+
+} parsebgp_sax_peer_t;
+
+/**
+ * Prefix
+ */
+typedef struct parsebgp_sax_prefix {
+
+  /** AFI */
+  parsebgp_bgp_afi_t afi;
+
+  /** SAFI */
+  parsebgp_bgp_safi_t safi;
+
+  /** Prefix length (in bits) */
+  uint8_t len;
+
+  /** ADD-PATH Path Identifier (zero if the prefix has none) */
+  uint32_t path_id;
+
+  /** Prefix address. At least (len + 7) / 8 bytes are readable, and any bits
+      past the prefix length are as they were on the wire (i.e., not necessarily
+      zero). Use parsebgp_sax_prefix_addr to get a clean copy. */
+  const uint8_t *addr;
+
+} parsebgp_sax_prefix_t;
+
+/**
+ * TABLE_DUMP(_V2) RIB Entry
+ */
+typedef struct parsebgp_sax_rib_entry {
+
+  /** Index of the peer in the PEER_INDEX_TABLE (zero for TABLE_DUMP, whose
+      peer is given to on_peer instead) */
+  uint16_t peer_index;
+
+  /** Time the prefix was heard (seconds) */
+  uint32_t originated_time;
+
+  /** ADD-PATH Path Identifier (zero for non-ADDPATH subtypes) */
+  uint32_t path_id;
+
+} parsebgp_sax_rib_entry_t;
+
+/**
+ * Path Attribute
+ */
+typedef struct parsebgp_sax_path_attr {
+
+  /** Flags */
+  uint8_t flags;
+
+  /** Type */
+  uint8_t type;
+
+  /** Length of the attribute data */
+  uint16_t len;
+
+  /** Attribute data */
+  const uint8_t *data;
+
+} parsebgp_sax_path_attr_t;
+
+/**
+ * AS_PATH (or AS4_PATH) Segment
+ */
+typedef struct parsebgp_sax_as_path_seg {
+
+  /** Type of the attribute the segment is from (AS_PATH or AS4_PATH) */
+  uint8_t attr_type;
+
+  /** Segment type (parsebgp_bgp_update_as_path_seg_type_t) */
+  uint8_t type;
+
+  /** Number of ASNs in the segment */
+  uint8_t asns_cnt;
+
+  /** Are the ASNs encoded using 4 bytes? */
+  int asn_4_byte;
+
+  /** Raw (network byte order) ASNs. Use parsebgp_sax_as_path_seg_asn to read
+      them. */
+  const uint8_t *asns;
+
+} parsebgp_sax_as_path_seg_t;
+
+/** Message header handler */
+typedef int(parsebgp_sax_msg_hdr_cb_t)(void *user,
+                                       const parsebgp_sax_msg_hdr_t *hdr);
+
+/** Peer handler */
+typedef int(parsebgp_sax_peer_cb_t)(void *user,
+                                    const parsebgp_sax_peer_t *peer);
+
+/** RIB record prefix handler */
+typedef int(parsebgp_sax_prefix_cb_t)(void *user,
+                                      const parsebgp_sax_prefix_t *prefix);
+
+/** RIB entry handler */
+typedef int(parsebgp_sax_rib_entry_cb_t)(void *user,
+                                         const parsebgp_sax_rib_entry_t *entry);
+
+/** Path attribute handler */
+typedef int(parsebgp_sax_path_attr_cb_t)(void *user,
+                                         const parsebgp_sax_path_attr_t *attr);
+
+/** AS path segment handler */
+typedef int(parsebgp_sax_as_path_seg_cb_t)(
+  void *user, const parsebgp_sax_as_path_seg_t *seg);
+
+/** NLRI handler */
+typedef int(parsebgp_sax_nlri_cb_t)(void *user, parsebgp_sax_nlri_kind_t kind,
+                                    const parsebgp_sax_prefix_t *nlri);
+
+/**
+ * Handlers
+ *
+ * Each handler returns a parsebgp_sax_action_t value. Unused handlers must be
+ * NULL.
+ */
+typedef struct parsebgp_sax_handlers {
+
+  /** Called for each message (and each encapsulated BGP message) */
+  parsebgp_sax_msg_hdr_cb_t *on_msg_header;
+
+  /** Called for each TABLE_DUMP_V2 PEER_INDEX_TABLE entry, and for the peer in
+      the header of TABLE_DUMP, BGP4MP and BMP messages */
+  parsebgp_sax_peer_cb_t *on_peer;
+
+  /** Called with the prefix of each TABLE_DUMP(_V2) RIB record */
+  parsebgp_sax_prefix_cb_t *on_prefix;
+
+  /** Called for each TABLE_DUMP(_V2) RIB entry, before its path attributes */
+  parsebgp_sax_rib_entry_cb_t *on_rib_entry;
+
+  /** Called for each path attribute (including MP_REACH_NLRI and
+      MP_UNREACH_NLRI) */
+  parsebgp_sax_path_attr_cb_t *on_path_attr;
+
+  /** Called for each segment of the AS_PATH and AS4_PATH attributes, after
+      on_path_attr for the attribute */
+  parsebgp_sax_as_path_seg_cb_t *on_as_path_segment;
+
+  /** Called for each withdrawn and announced prefix of an UPDATE message
+      (including IPv4/IPv6 Unicast/Multicast prefixes from MP_REACH_NLRI and
+      MP_UNREACH_NLRI, after on_path_attr for the attribute) */
+  parsebgp_sax_nlri_cb_t *on_nlri;
+
+} parsebgp_sax_handlers_t;
+
+/**
+ * Decode a single message of the given type, calling the given handlers
+ *
+ * @param [in] opts     Options for the parser
+ * @param [in] type     Type of message to decode
+ * @param [in] handlers Handlers to call
+ * @param [in] user     User pointer passed to the handlers
+ * @param [in] buf      Buffer containing the raw (unparsed) message
+ * @param [in,out] len  Number of bytes in buffer. Updated with number of bytes
+ *                      read from the buffer
+ * @return PARSEBGP_OK (0) if the message was decoded (or skipped by a handler),
+ * or an error code otherwise
+ *
+ * If PARSEBGP_PARTIAL_MSG is returned, no handlers were called. BGP messages
+ * that are longer than the MRT message that encapsulates them are reported
+ * (with on_msg_header) but not decoded, and PARSEBGP_TRUNCATED_MSG is returned
+ * (with len set to the length of the MRT message).
+ *
+ * Only BMP version 3 messages are supported. If opts->bmp.peers is set, it is
+ * used to configure the BGP parser for route monitoring messages (as it is by
+ * parsebgp_decode), but it is never updated.
+ */
+parsebgp_error_t parsebgp_sax_decode(const parsebgp_opts_t *opts,
+                                     parsebgp_msg_type_t type,
+                                     const parsebgp_sax_handlers_t *handlers,
+                                     void *user, const uint8_t *buf,
+                                     size_t *len);
+
+/**
+ * Copy the address of the given prefix, zeroing any bits past its length
+ *
+ * @param prefix        Pointer to the prefix
+ * @param dst           Buffer (of 16 bytes) to copy the address into
+ */
+void parsebgp_sax_prefix_addr(const parsebgp_sax_prefix_t *prefix,
+                              uint8_t *dst);
+
+/**
+ * Get an ASN from the given AS path segment
+ *
+ * @param seg           Pointer to the segment
+ * @param idx           Index of the ASN (less than seg->asns_cnt)
+ * @return the ASN
+ */
+uint32_t parsebgp_sax_as_path_seg_asn(const parsebgp_sax_as_path_seg_t *seg,
+                                      int idx);
+
+#endif /* __PARSEBGP_SAX_H */
@@ -31,6 +31,8 @@
 #include <stdio.h>
 #include <string.h>
 
+__thread FILE *parsebgp_dump_fp = NULL;
+
 parsebgp_error_t parsebgp_decode_prefix(uint8_t pfx_len, uint8_t *dst,
                                         const uint8_t *buf, size_t *buf_len,
                                         size_t max_pfx_len)
@@ -66,3 +68,69 @@ void *malloc_zero(const size_t size)
 {
   return calloc(size, 1);
 }
+
+void *parsebgp_shrink(void *ptr, size_t len)
+{
+  void *p;
+
+  if (len == 0) {
+    free(ptr);
+    return NULL;
+  }
+  // a failed realloc leaves the original allocation intact
+  if ((p = realloc(ptr, len)) == NULL) {
+    return ptr;
+  }
+  return p;
+}
+
+uint32_t parsebgp_budget_take(parsebgp_budget_state_t *state, uint32_t max,
+                              uint32_t *used, parsebgp_budget_type_t type,
+                              uint32_t cnt, const uint8_t *pos)
+{
+  if ((uint64_t)*used + cnt <= max) {
+    *used += cnt;
+    return cnt;
+  }
+  cnt = max - *used;
+  *used = max;
+  // only the first stop counts, since nothing is decoded after it
+  if (state->hit == PARSEBGP_BUDGET_NONE) {
+    state->hit = type;
+    state->stop = pos;
+  }
+  return cnt;
+}
+
+#define HASH_M1 0x9E3779B97F4A7C15ULL
+#define HASH_M2 0xC2B2AE3D27D4EB4FULL
+
+static inline uint64_t hash_mix(uint64_t h, uint64_t v)
+{
+  h ^= v * HASH_M1;
+  h = (h << 31) | (h >> 33);
+  return h * HASH_M2;
+}
+
+uint64_t parsebgp_hash(const void *buf, size_t len, uint64_t seed)
+{
+  const uint8_t *p = buf;
+  uint64_t h = seed ^ (len * HASH_M2), v;
+
+  // 8 bytes at a time (memcpy is the portable unaligned load)
+  for (; len >= 8; len -= 8, p += 8) {
+    memcpy(&v, p, 8);
+    h = hash_mix(h, v);
+  }
+  if (len > 0) {
+    v = 0;
+    memcpy(&v, p, len);
+    h = hash_mix(h, v);
+  }
+
+  // final avalanche
+  h ^= h >> 33;
+  h *= HASH_M1;
+  h ^= h >> 29;
+  return h;
+}
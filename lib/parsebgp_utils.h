@@ -28,6 +28,7 @@
 #define __PARSEBGP_UTILS_H
 
 #include "parsebgp_error.h"
+#include "parsebgp_opts.h"
 #include "config.h"
 #include <inttypes.h>
 #include <stdio.h>
@@ -206,28 +207,35 @@
     }                                                                          \
   } while (0)
 
+/** Per-thread stream used by the dump functions (NULL means stdout). This is
+    set by parsebgp_dump_msg_fp for the duration of a dump. */
+extern __thread FILE *parsebgp_dump_fp;
+
+/** Stream that the dump macros write to */
+#define PARSEBGP_DUMP_FP (parsebgp_dump_fp != NULL ? parsebgp_dump_fp : stdout)
 
 #define PARSEBGP_DUMP_STRUCT_HDR(struct_name, depth)                           \
   do {                                                                         \
     int _i;                                                                    \
     for (_i = 0; _i < (depth); _i++) {                                         \
       if (_i == depth - 1) {                                                   \
-        fputs(" ", stdout);                                                    \
+        fputs(" ", PARSEBGP_DUMP_FP);                                          \
       } else {                                                                 \
-        fputs("  ", stdout);                                                   \
+        fputs("  ", PARSEBGP_DUMP_FP);                                         \
       }                                                                        \
     }                                                                          \
-    printf(">> " STR(struct_name) " (%ld bytes):\n", sizeof(struct_name));     \
+    fprintf(PARSEBGP_DUMP_FP, ">> " STR(struct_name) " (%ld bytes):\n",       \
+            sizeof(struct_name));                                              \
   } while (0)
 
 #define PARSEBGP_DUMP_INFO(depth, ...)                                         \
   do {                                                                         \
     int _i;                                                                    \
-    fputs(" ", stdout);                                                        \
+    fputs(" ", PARSEBGP_DUMP_FP);                                              \
     for (_i = 0; _i < (depth); _i++) {                                         \
-      fputs("  ", stdout);                                                     \
+      fputs("  ", PARSEBGP_DUMP_FP);                                           \
     }                                                                          \
-    printf(__VA_ARGS__);                                                       \
+    fprintf(PARSEBGP_DUMP_FP, __VA_ARGS__);                                    \
   } while (0)
 
 #if defined(__GNUC__)
@@ -276,15 +284,15 @@
     int _byte;                                                                 \
     PARSEBGP_DUMP_INFO(depth, name ": ");                                      \
     if ((len) == 0) {                                                          \
-      fputs("NONE\n", stdout);                                                 \
+      fputs("NONE\n", PARSEBGP_DUMP_FP);                                       \
     } else {                                                                   \
       for (_byte = 0; _byte < (len); _byte++) {                                \
         if (_byte != 0) {                                                      \
-          fputs(" ", stdout);                                                  \
+          fputs(" ", PARSEBGP_DUMP_FP);                                        \
         }                                                                      \
-        printf("%02X", (data)[_byte]);                                         \
+        fprintf(PARSEBGP_DUMP_FP, "%02X", (data)[_byte]);                      \
       }                                                                        \
-      fputs("\n", stdout);                                                     \
+      fputs("\n", PARSEBGP_DUMP_FP);                                           \
     }                                                                          \
   } while (0)
 
@@ -311,6 +319,30 @@ parsebgp_error_t parsebgp_decode_prefix(uint8_t pfx_len, uint8_t *dst,
 /** Convenience function to allocate and zero memory */
 void *malloc_zero(const size_t size);
 
+/**
+ * Hash the given bytes (not cryptographically strong, but fast and well
+ * mixed, so it is suitable for hash tables keyed on raw message data)
+ *
+ * @param buf           Pointer to the data to hash
+ * @param len           Number of bytes to hash
+ * @param seed          Seed (e.g., the hash of some other part of the key)
+ * @return 64-bit hash of the data
+ */
+uint64_t parsebgp_hash(const void *buf, size_t len, uint64_t seed);
+
+/**
+ * Shrink the given allocation to the given length
+ *
+ * @param ptr           Pointer to the memory to shrink
+ * @param len           New length (in bytes), which must not be larger than the
+ *                      current allocation
+ * @return pointer to the shrunk memory (NULL if len is 0)
+ *
+ * Unlike realloc, if the memory cannot be shrunk, the original pointer is
+ * returned (and remains valid).
+ */
+void *parsebgp_shrink(void *ptr, size_t len);
+
 /** Conditionally reallocate memory if not enough is currently allocated.
  *
  * Note: Relies on the type of ptr to determine the correct size to allocate.
@@ -333,4 +365,79 @@ void *malloc_zero(const size_t size);
     }                                                                          \
   } while (0)
 
+/** Shrink an array allocated using PARSEBGP_MAYBE_REALLOC to len elements if
+ * more than that are currently allocated.
+ *
+ * Note: Relies on the type of ptr to determine the correct size.
+ */
+#define PARSEBGP_MAYBE_SHRINK(ptr, alloc_len, len)                             \
+  do {                                                                         \
+    if ((size_t)(alloc_len) > (size_t)(len)) {                                 \
+      (ptr) = parsebgp_shrink((ptr), sizeof(*(ptr)) * (len));                  \
+      alloc_len = len;                                                         \
+    }                                                                          \
+  } while (0)
+
+/** Budget usage of a single call to parsebgp_decode */
+typedef struct parsebgp_budget_state {
+
+  /** Amount of each budget used so far */
+  parsebgp_budget_t used;
+
+  /** Budget that stopped the decode (PARSEBGP_BUDGET_NONE if none has) */
+  parsebgp_budget_type_t hit;
+
+  /** Position in the buffer at which the decode stopped */
+  const uint8_t *stop;
+
+} parsebgp_budget_state_t;
+
+/**
+ * Charge cnt units against a decode budget
+ *
+ * @param state         Budget usage of the current decode
+ * @param max           Budget limit (non-zero)
+ * @param used          Pointer to the amount of the budget used so far
+ * @param type          Type of the budget
+ * @param cnt           Number of units to charge
+ * @param pos           Position in the buffer of the first of the units
+ * @return the number of units (at most cnt) that fit in the budget
+ *
+ * If they do not all fit, the decode is marked as stopped at pos (i.e., the
+ * caller must not decode any further than that). Use PARSEBGP_BUDGET_TAKE
+ * rather than calling this directly.
+ */
+uint32_t parsebgp_budget_take(parsebgp_budget_state_t *state, uint32_t max,
+                              uint32_t *used, parsebgp_budget_type_t type,
+                              uint32_t cnt, const uint8_t *pos);
+
+/** Charge cnt units against the given budget (a field of parsebgp_budget_t),
+ * evaluating to the number of them that fit. If not all of them fit, the
+ * caller should decode only those that do, and then return
+ * PARSEBGP_BUDGET_EXCEEDED. Budgets only apply to decodes started by
+ * parsebgp_decode, since that is what tracks their usage.
+ */
+#define PARSEBGP_BUDGET_TAKE(opts, field, type, cnt, pos)                      \
+  ((opts)->budget.field == 0 || (opts)->_budget_state == NULL                  \
+     ? (cnt)                                                                   \
+     : parsebgp_budget_take((opts)->_budget_state, (opts)->budget.field,       \
+                            &(opts)->_budget_state->used.field, (type), (cnt), \
+                            (pos)))
+
+/** Add bytes to the given memory usage category (and the total) */
+#define PARSEBGP_MEM_ADD(usage, category, bytes)                               \
+  do {                                                                         \
+    (usage)->category += (bytes);                                              \
+    (usage)->total += (bytes);                                                 \
+  } while (0)
+
+/** Is the given path attribute (e.g., AS_PATH) of a path attribute set
+    present */
+#define PARSEBGP_HAS_ATTR(attrs, type)                                         \
+  PARSEBGP_BGP_UPDATE_ATTR_PRESENT(attrs, PARSEBGP_BGP_PATH_ATTR_TYPE_##type)
+
+/** Get the data of the given path attribute of a path attribute set */
+#define PARSEBGP_ATTR(attrs, type)                                             \
+  ((attrs)->attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_##type].data)
+
 #endif /*  __PARSEBGP_UTILS_H */
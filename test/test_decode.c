@@ -0,0 +1,591 @@
+/*
+ * Copyright (C) 2017 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Decode regression tests
+ *
+ * Decodes the captured MRT and BMP records in the data directory and checks
+ * the results, both against values known from the captures and against other
+ * ways of decoding the same records (into a fresh message, without budgets,
+ * from a flat snapshot). Run by "make check".
+ */
+
+#include "parsebgp.h"
+#include "parsebgp_bmp_peers.h"
+#include "parsebgp_msg_flat.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// record a failed check, and carry on so that all failures are reported
+#define CHECK(cond)                                                            \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      fprintf(stderr, "FAIL: %s:%d: %s\n", __func__, __LINE__, #cond);         \
+      failures++;                                                              \
+    }                                                                          \
+  } while (0)
+
+static int failures = 0;
+
+// contents of a data file
+typedef struct file {
+  const char *name;
+  parsebgp_msg_type_t type;
+  uint8_t *buf;
+  size_t len;
+} file_t;
+
+// captured records shared by several tests
+static file_t files[] = {
+  {"updates.mrt", PARSEBGP_MSG_TYPE_MRT, NULL, 0},
+  {"rib.mrt", PARSEBGP_MSG_TYPE_MRT, NULL, 0},
+  {"stream.bmp", PARSEBGP_MSG_TYPE_BMP, NULL, 0},
+  {"as_path.mrt", PARSEBGP_MSG_TYPE_MRT, NULL, 0},
+  {"rib_addpath.mrt", PARSEBGP_MSG_TYPE_MRT, NULL, 0},
+  {"addpath.bmp", PARSEBGP_MSG_TYPE_BMP, NULL, 0},
+};
+#define FILES_CNT (sizeof(files) / sizeof(files[0]))
+
+static int load_file(file_t *file)
+{
+  const char *srcdir = getenv("srcdir");
+  char path[1024];
+  FILE *fp;
+  long len;
+
+  snprintf(path, sizeof(path), "%s/data/%s", srcdir ? srcdir : ".",
+           file->name);
+  if ((fp = fopen(path, "rb")) == NULL || fseek(fp, 0, SEEK_END) != 0 ||
+      (len = ftell(fp)) <= 0 || fseek(fp, 0, SEEK_SET) != 0 ||
+      (file->buf = malloc(len)) == NULL ||
+      fread(file->buf, 1, len, fp) != (size_t)len) {
+    fprintf(stderr, "ERROR: Could not read %s\n", path);
+    if (fp != NULL) {
+      fclose(fp);
+    }
+    return -1;
+  }
+  fclose(fp);
+  file->len = len;
+  return 0;
+}
+
+static file_t *get_file(const char *name)
+{
+  size_t i;
+
+  for (i = 0; i < FILES_CNT; i++) {
+    if (strcmp(files[i].name, name) == 0) {
+      return &files[i];
+    }
+  }
+  return NULL;
+}
+
+// dump a message into a string, so that two decodes can be compared
+static char *dump_str(const parsebgp_msg_t *msg, size_t *len)
+{
+  char *str = NULL;
+  FILE *fp;
+
+  if ((fp = open_memstream(&str, len)) == NULL) {
+    return NULL;
+  }
+  parsebgp_dump_msg_fp(fp, msg);
+  fclose(fp);
+  return str;
+}
+
+static int dumps_equal(const parsebgp_msg_t *a, const parsebgp_msg_t *b)
+{
+  char *da, *db;
+  size_t la, lb;
+  int eq;
+
+  da = dump_str(a, &la);
+  db = dump_str(b, &lb);
+  eq = da != NULL && db != NULL && la == lb && memcmp(da, db, la) == 0;
+  free(da);
+  free(db);
+  return eq;
+}
+
+static void init_opts(parsebgp_opts_t *opts)
+{
+  parsebgp_opts_init(opts);
+  opts->ignore_not_implemented = 1;
+  opts->silence_not_implemented = 1;
+}
+
+// get the UPDATE of a BGP4MP or Route Monitoring message (NULL if none)
+static parsebgp_bgp_update_t *get_update(const parsebgp_msg_t *msg)
+{
+  parsebgp_bgp_msg_t *bgp = NULL;
+
+  if (msg->type == PARSEBGP_MSG_TYPE_MRT &&
+      msg->types.mrt->types.bgp4mp != NULL &&
+      (msg->types.mrt->type == PARSEBGP_MRT_TYPE_BGP4MP ||
+       msg->types.mrt->type == PARSEBGP_MRT_TYPE_BGP4MP_ET) &&
+      (msg->types.mrt->subtype == PARSEBGP_MRT_BGP4MP_MESSAGE ||
+       msg->types.mrt->subtype == PARSEBGP_MRT_BGP4MP_MESSAGE_AS4)) {
+    bgp = msg->types.mrt->types.bgp4mp->data.bgp_msg;
+  } else if (msg->type == PARSEBGP_MSG_TYPE_BMP &&
+             msg->types.bmp->type == PARSEBGP_BMP_TYPE_ROUTE_MON) {
+    bgp = msg->types.bmp->types.route_mon;
+  }
+  if (bgp == NULL || bgp->type != PARSEBGP_BGP_TYPE_UPDATE) {
+    return NULL;
+  }
+  return bgp->types.update;
+}
+
+// check that exactly the attributes listed in attrs_used are present
+static void check_attrs_present(const parsebgp_bgp_update_path_attrs_t *attrs)
+{
+  int i, present = 0;
+
+  for (i = 0; i < PARSEBGP_BGP_PATH_ATTRS_LEN; i++) {
+    if (PARSEBGP_BGP_UPDATE_ATTR_PRESENT(attrs, i)) {
+      present++;
+    }
+  }
+  CHECK(present == attrs->attrs_cnt);
+  for (i = 0; i < attrs->attrs_cnt; i++) {
+    CHECK(PARSEBGP_BGP_UPDATE_ATTR_PRESENT(attrs, attrs->attrs_used[i]));
+  }
+}
+
+// Decoding into a reused message (whose attributes are cleared by starting a
+// new epoch) gives the same result as decoding into a fresh one
+static void test_reuse(const file_t *file)
+{
+  parsebgp_opts_t opts;
+  parsebgp_msg_t *reused, *fresh;
+  parsebgp_bgp_update_t *update;
+  size_t off = 0, len, fresh_len;
+  parsebgp_error_t err;
+
+  init_opts(&opts);
+  reused = parsebgp_create_msg();
+  while (off < file->len) {
+    len = fresh_len = file->len - off;
+    fresh = parsebgp_create_msg();
+    parsebgp_clear_msg(reused);
+    err = parsebgp_decode(opts, file->type, reused, file->buf + off, &len);
+    CHECK(err == PARSEBGP_OK);
+    CHECK(parsebgp_decode(opts, file->type, fresh, file->buf + off,
+                          &fresh_len) == err);
+    if (err != PARSEBGP_OK) {
+      parsebgp_destroy_msg(fresh);
+      break;
+    }
+    CHECK(len == fresh_len);
+    CHECK(dumps_equal(reused, fresh));
+    if ((update = get_update(reused)) != NULL) {
+      check_attrs_present(&update->path_attrs);
+    }
+    parsebgp_destroy_msg(fresh);
+    off += len;
+  }
+  parsebgp_destroy_msg(reused);
+}
+
+// A zeroed Path Attributes structure that has never been decoded into has no
+// attributes
+static void test_zeroed_attrs(void)
+{
+  parsebgp_bgp_update_path_attrs_t *attrs;
+  int i;
+
+  attrs = calloc(1, sizeof(*attrs));
+  for (i = 0; i < PARSEBGP_BGP_PATH_ATTRS_LEN; i++) {
+    CHECK(!PARSEBGP_BGP_UPDATE_ATTR_PRESENT(attrs, i));
+  }
+  free(attrs);
+}
+
+// Budgets stop decoding early with a consistent message and a cursor, and
+// parsebgp_redecode_full then gives the same message as a decode without
+// budgets
+static void test_budgets(const file_t *file, int *exceeded)
+{
+  static const parsebgp_budget_t budgets[] = {
+    {3, 0, 0, 0, 0},   {0, 2, 0, 0, 0}, {0, 0, 5, 0, 0},
+    {0, 0, 0, 2, 0},   {0, 0, 0, 0, 100}, {1, 1, 1, 1, 1},
+    {50, 20, 30, 10, 4000},
+  };
+  parsebgp_opts_t opts, budget_opts;
+  parsebgp_msg_t *ref, *msg, *other;
+  size_t off, len, budget_len, i;
+  parsebgp_error_t err;
+  uint8_t *copy;
+  char *dump;
+
+  init_opts(&opts);
+  ref = parsebgp_create_msg();
+  msg = parsebgp_create_msg();
+  other = parsebgp_create_msg();
+  for (i = 0; i < sizeof(budgets) / sizeof(budgets[0]); i++) {
+    budget_opts = opts;
+    budget_opts.budget = budgets[i];
+    off = 0;
+    while (off < file->len) {
+      len = budget_len = file->len - off;
+      parsebgp_clear_msg(ref);
+      if (parsebgp_decode(opts, file->type, ref, file->buf + off, &len) !=
+          PARSEBGP_OK) {
+        CHECK(0);
+        break;
+      }
+      parsebgp_clear_msg(msg);
+      err = parsebgp_decode(budget_opts, file->type, msg, file->buf + off,
+                            &budget_len);
+      CHECK(budget_len == len);
+      if (err == PARSEBGP_OK) {
+        CHECK(msg->resume.budget == PARSEBGP_BUDGET_NONE);
+        CHECK(dumps_equal(msg, ref));
+      } else if (err == PARSEBGP_BUDGET_EXCEEDED) {
+        CHECK(msg->resume.budget > PARSEBGP_BUDGET_NONE &&
+              msg->resume.budget <= PARSEBGP_BUDGET_BYTES);
+        CHECK(msg->resume.len == len);
+        CHECK(msg->resume.offset < msg->resume.len);
+        exceeded[msg->resume.budget]++;
+        // the partial message can be dumped and snapshotted
+        CHECK((dump = dump_str(msg, &budget_len)) != NULL);
+        free(dump);
+        CHECK(parsebgp_msg_flatten(msg, NULL, 0) > 0);
+        // finish it on another message, given only a copy of the message bytes
+        copy = malloc(msg->resume.len);
+        memcpy(copy, file->buf + off, msg->resume.len);
+        CHECK(parsebgp_redecode_full(budget_opts, file->type, other, copy,
+                                     msg->resume.len) == PARSEBGP_OK);
+        CHECK(dumps_equal(other, ref));
+        free(copy);
+        // and on the same one
+        CHECK(parsebgp_redecode_full(budget_opts, file->type, msg,
+                                     file->buf + off,
+                                     file->len - off) == PARSEBGP_OK);
+        CHECK(dumps_equal(msg, ref));
+      } else {
+        CHECK(0);
+      }
+      off += len;
+    }
+  }
+  parsebgp_destroy_msg(ref);
+  parsebgp_destroy_msg(msg);
+  parsebgp_destroy_msg(other);
+}
+
+// A flat snapshot, moved to another buffer, views as the original message,
+// and a truncated one is rejected
+static void test_flat(const file_t *file)
+{
+  parsebgp_opts_t opts;
+  parsebgp_msg_t *msg;
+  const parsebgp_msg_t *view;
+  void *buf, *moved;
+  size_t off = 0, len, flat_len;
+
+  init_opts(&opts);
+  msg = parsebgp_create_msg();
+  while (off < file->len) {
+    len = file->len - off;
+    parsebgp_clear_msg(msg);
+    if (parsebgp_decode(opts, file->type, msg, file->buf + off, &len) !=
+        PARSEBGP_OK) {
+      CHECK(0);
+      break;
+    }
+    off += len;
+
+    flat_len = parsebgp_msg_flatten(msg, NULL, 0);
+    CHECK(flat_len > 0);
+    // blocks must be aligned to 8 bytes
+    if (posix_memalign(&buf, 8, flat_len) != 0 ||
+        posix_memalign(&moved, 8, flat_len) != 0) {
+      CHECK(0);
+      break;
+    }
+    CHECK(parsebgp_msg_flatten(msg, buf, flat_len) == flat_len);
+    memcpy(moved, buf, flat_len);
+    memset(buf, 0xAA, flat_len);
+    CHECK((view = parsebgp_msg_flat_view(moved, flat_len)) != NULL);
+    if (view != NULL) {
+      CHECK(dumps_equal(view, msg));
+    }
+
+    CHECK(parsebgp_msg_flatten(msg, buf, flat_len) == flat_len);
+    CHECK(parsebgp_msg_flat_view(buf, flat_len - 1) == NULL);
+    free(buf);
+    free(moved);
+  }
+  parsebgp_destroy_msg(msg);
+}
+
+// check that the segments of a path cover its ASNs array in order
+static void check_as_path_layout(const parsebgp_bgp_update_as_path_t *path)
+{
+  int i, offset = 0;
+
+  for (i = 0; i < path->segs_cnt; i++) {
+    CHECK(path->segs[i].asns_offset == offset);
+    offset += path->segs[i].asns_cnt;
+  }
+  CHECK(offset == path->asns_total_cnt);
+}
+
+// The ASNs of all segments of an AS path are stored in one array
+static void test_as_path(void)
+{
+  static const uint8_t seg_types[] = {
+    PARSEBGP_BGP_UPDATE_AS_PATH_SEG_AS_SEQ,
+    PARSEBGP_BGP_UPDATE_AS_PATH_SEG_AS_SET,
+    PARSEBGP_BGP_UPDATE_AS_PATH_SEG_AS_SEQ,
+  };
+  static const uint8_t seg_cnts[] = {3, 2, 1};
+  static const uint32_t asns[] = {64501, 65001, 65002, 65010, 65011, 65020};
+  const file_t *file = get_file("as_path.mrt");
+  const parsebgp_bgp_update_as_path_t *path;
+  parsebgp_bgp_update_t *update;
+  parsebgp_opts_t opts;
+  parsebgp_msg_t *msg;
+  size_t len = file->len, off = 0;
+  int i;
+
+  init_opts(&opts);
+  msg = parsebgp_create_msg();
+  CHECK(parsebgp_decode(opts, file->type, msg, file->buf, &len) ==
+        PARSEBGP_OK);
+  if ((update = get_update(msg)) == NULL ||
+      !PARSEBGP_BGP_UPDATE_ATTR_PRESENT(&update->path_attrs,
+                                        PARSEBGP_BGP_PATH_ATTR_TYPE_AS_PATH)) {
+    CHECK(0);
+    parsebgp_destroy_msg(msg);
+    return;
+  }
+  path = update->path_attrs.attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_AS_PATH]
+           .data.as_path;
+  CHECK(path->segs_cnt == 3);
+  CHECK(path->asns_total_cnt == 6);
+  // the AS_SET counts as a single ASN
+  CHECK(path->asns_cnt == 5);
+  for (i = 0; i < path->segs_cnt && i < 3; i++) {
+    CHECK(path->segs[i].type == seg_types[i]);
+    CHECK(path->segs[i].asns_cnt == seg_cnts[i]);
+  }
+  for (i = 0; i < path->asns_total_cnt && i < 6; i++) {
+    CHECK(path->asns[i] == asns[i]);
+  }
+  check_as_path_layout(path);
+
+  // and every path of the captured updates is laid out the same way
+  file = get_file("updates.mrt");
+  while (off < file->len) {
+    len = file->len - off;
+    parsebgp_clear_msg(msg);
+    if (parsebgp_decode(opts, file->type, msg, file->buf + off, &len) !=
+        PARSEBGP_OK) {
+      CHECK(0);
+      break;
+    }
+    off += len;
+    if ((update = get_update(msg)) != NULL &&
+        PARSEBGP_BGP_UPDATE_ATTR_PRESENT(&update->path_attrs,
+                                         PARSEBGP_BGP_PATH_ATTR_TYPE_AS_PATH)) {
+      check_as_path_layout(
+        update->path_attrs.attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_AS_PATH]
+          .data.as_path);
+    }
+  }
+  parsebgp_destroy_msg(msg);
+}
+
+// check the path IDs of NLRI, which the capture numbers from *next_id (or
+// which are all zero if next_id is NULL)
+static void check_path_ids(const parsebgp_bgp_update_nlris_t *nlris,
+                           uint32_t *next_id)
+{
+  int i;
+
+  for (i = 0; i < nlris->prefixes_cnt; i++) {
+    CHECK(nlris->prefixes[i].len <= 32);
+    if (next_id == NULL) {
+      CHECK(nlris->prefixes[i].path_id == 0);
+    } else {
+      CHECK(nlris->prefixes[i].path_id == (*next_id)++);
+    }
+  }
+}
+
+// The first peer of the BMP capture negotiated ADD-PATH for IPv4 unicast in
+// its PEER_UP, so its prefixes have path IDs, but those of the second peer
+// (which did not) do not
+static void test_add_path_bmp(void)
+{
+  const file_t *file = get_file("addpath.bmp");
+  parsebgp_bmp_peers_t *peers;
+  parsebgp_bgp_update_t *update;
+  parsebgp_opts_t opts;
+  parsebgp_msg_t *msg;
+  uint8_t first_peer[16];
+  size_t off = 0, len;
+  uint32_t next_id = 0x100;
+  int have_first_peer = 0, with_ids = 0, without_ids = 0;
+
+  init_opts(&opts);
+  peers = parsebgp_bmp_peers_create();
+  opts.bmp.peers = peers;
+  msg = parsebgp_create_msg();
+  while (off < file->len) {
+    len = file->len - off;
+    parsebgp_clear_msg(msg);
+    if (parsebgp_decode(opts, file->type, msg, file->buf + off, &len) !=
+        PARSEBGP_OK) {
+      CHECK(0);
+      break;
+    }
+    off += len;
+    if (msg->types.bmp->type == PARSEBGP_BMP_TYPE_PEER_UP &&
+        !have_first_peer) {
+      memcpy(first_peer, msg->types.bmp->peer_hdr.addr, sizeof(first_peer));
+      have_first_peer = 1;
+    }
+    if ((update = get_update(msg)) == NULL) {
+      continue;
+    }
+    if (memcmp(msg->types.bmp->peer_hdr.addr, first_peer,
+               sizeof(first_peer)) == 0) {
+      check_path_ids(&update->withdrawn_nlris, &next_id);
+      check_path_ids(&update->announced_nlris, &next_id);
+      with_ids++;
+    } else {
+      check_path_ids(&update->withdrawn_nlris, NULL);
+      check_path_ids(&update->announced_nlris, NULL);
+      without_ids++;
+    }
+  }
+  CHECK(with_ids > 0);
+  CHECK(without_ids > 0);
+  CHECK(next_id > 0x100);
+  parsebgp_destroy_msg(msg);
+  parsebgp_bmp_peers_destroy(peers);
+}
+
+// The ADD-PATH RIB capture is the plain one with a path ID added to each RIB
+// entry (numbered from 0x200 in each record)
+static void test_add_path_rib(void)
+{
+  const file_t *plain = get_file("rib.mrt");
+  const file_t *file = get_file("rib_addpath.mrt");
+  parsebgp_mrt_table_dump_v2_afi_safi_rib_t *rib, *plain_rib;
+  parsebgp_opts_t opts;
+  parsebgp_msg_t *msg, *plain_msg;
+  size_t off = 0, plain_off = 0, len, plain_len;
+  int i, records = 0;
+
+  init_opts(&opts);
+  msg = parsebgp_create_msg();
+  plain_msg = parsebgp_create_msg();
+  while (off < file->len && plain_off < plain->len) {
+    len = file->len - off;
+    plain_len = plain->len - plain_off;
+    parsebgp_clear_msg(msg);
+    parsebgp_clear_msg(plain_msg);
+    if (parsebgp_decode(opts, file->type, msg, file->buf + off, &len) !=
+          PARSEBGP_OK ||
+        parsebgp_decode(opts, plain->type, plain_msg, plain->buf + plain_off,
+                        &plain_len) != PARSEBGP_OK) {
+      CHECK(0);
+      break;
+    }
+    off += len;
+    plain_off += plain_len;
+    if (msg->types.mrt->subtype !=
+        PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_UNICAST_ADDPATH) {
+      continue;
+    }
+    CHECK(plain_msg->types.mrt->subtype ==
+          PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_UNICAST);
+    rib = &msg->types.mrt->types.table_dump_v2->afi_safi_rib;
+    plain_rib = &plain_msg->types.mrt->types.table_dump_v2->afi_safi_rib;
+    CHECK(rib->entry_count == plain_rib->entry_count);
+    CHECK(rib->prefix_len == plain_rib->prefix_len);
+    for (i = 0; i < rib->entry_count && i < plain_rib->entry_count; i++) {
+      CHECK(rib->entries[i].path_id == 0x200 + (uint32_t)i);
+      CHECK(plain_rib->entries[i].path_id == 0);
+      CHECK(rib->entries[i].peer_index == plain_rib->entries[i].peer_index);
+      CHECK(rib->entries[i].path_attrs.attrs_cnt ==
+            plain_rib->entries[i].path_attrs.attrs_cnt);
+    }
+    records++;
+  }
+  CHECK(records > 0);
+  parsebgp_destroy_msg(msg);
+  parsebgp_destroy_msg(plain_msg);
+}
+
+int main(void)
+{
+  int exceeded[PARSEBGP_BUDGET_BYTES + 1];
+  size_t i;
+
+  for (i = 0; i < FILES_CNT; i++) {
+    if (load_file(&files[i]) != 0) {
+      return -1;
+    }
+  }
+
+  test_zeroed_attrs();
+  memset(exceeded, 0, sizeof(exceeded));
+  for (i = 0; i < FILES_CNT; i++) {
+    // the ADD-PATH BMP capture needs a peer table to be decoded correctly
+    if (strcmp(files[i].name, "addpath.bmp") == 0) {
+      continue;
+    }
+    test_reuse(&files[i]);
+    test_flat(&files[i]);
+    test_budgets(&files[i], exceeded);
+  }
+  // every budget stopped some message
+  for (i = PARSEBGP_BUDGET_PREFIXES; i <= PARSEBGP_BUDGET_BYTES; i++) {
+    CHECK(exceeded[i] > 0);
+  }
+  test_as_path();
+  test_add_path_bmp();
+  test_add_path_rib();
+
+  for (i = 0; i < FILES_CNT; i++) {
+    free(files[i].buf);
+  }
+  if (failures > 0) {
+    fprintf(stderr, "%d check(s) failed\n", failures);
+    return 1;
+  }
+  return 0;
+}
@@ -26,9 +26,14 @@
 
 #include "parsebgp.h"
 #include "config.h"
+#include "parsebgp_elem.h"
+#include "parsebgp_elem_arrow.h"
+#include "parsebgp_elem_fmt.h"
 #include <assert.h>
 #include <errno.h>
 #include <inttypes.h>
+#include <pthread.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -39,6 +44,12 @@
 // Read 1MB of the file at a time
 #define BUFLEN (1024 * 1024)
 
+// Write formatted elems once 64kB of output is buffered
+#define OUT_FLUSH_LEN (64 * 1024)
+
+// Decode up to 32 messages per parsebgp_decode_batch call
+#define BATCH_LEN 32
+
 static const char *type_strs[] = {
   NULL,  // PARSEBGP_MSG_TYPE_INVALID
   "bgp", // PARSEBGP_MSG_TYPE_BGP
@@ -46,6 +57,52 @@ static const char *type_strs[] = {
   "mrt", // PARSEBGP_MSG_TYPE_MRT
 };
 
+// Number of per-type message counters (the type fields of all supported
+// message types fit in a byte)
+#define STATS_TYPES_CNT (UINT8_MAX + 1)
+
+/** Message counts for a file (or for all files) */
+typedef struct stats {
+
+  /** Number of messages parsed */
+  uint64_t msgs;
+
+  /** Number of bytes parsed */
+  uint64_t bytes;
+
+  /** Number of messages parsed, indexed by the type of the message (i.e., the
+      BGP, BMP or MRT message type) */
+  uint64_t types[STATS_TYPES_CNT];
+
+} stats_t;
+
+/** A file to be parsed */
+typedef struct job {
+
+  /** Type of the messages in the file */
+  parsebgp_msg_type_t type;
+
+  /** Name of the file */
+  char *fname;
+
+  /** Memory to free once done (fname points into this) */
+  char *freeme;
+
+  /** Result of parsing the file (0 if successful) */
+  int rc;
+
+  /** Message counts for the file */
+  stats_t stats;
+
+  /** Buffered dump output (only used in ordered parallel mode) */
+  char *out;
+  size_t out_len;
+
+  /** Set once the file has been parsed (protected by jobs_mutex) */
+  int done;
+
+} job_t;
+
 // should messages NOT be dumped to stdout after parsing
 //
 // normally the debug output would be the only reason you would run this tool,
@@ -53,6 +110,36 @@ static const char *type_strs[] = {
 // the printfs slowing things down.
 static int silent = 0;
 
+// format to write elems in (or zero to dump messages using parsebgp_dump_msg)
+static parsebgp_elem_fmt_t out_fmt = 0;
+
+// Arrow IPC file writer that all elems are added to (if -F arrow is given),
+// shared by all workers
+static parsebgp_elem_arrow_t *arrow_out = NULL;
+static pthread_mutex_t arrow_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// should per-file and aggregate message counts be written to stderr
+static int show_stats = 0;
+
+// should the output of files parsed in parallel be buffered so that it is
+// written in the order that the files were given
+static int ordered = 0;
+
+// files to parse, and the index of the next file to be handed to a worker
+static job_t *jobs = NULL;
+static int jobs_cnt = 0;
+static int jobs_next = 0;
+static pthread_mutex_t jobs_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t jobs_cond = PTHREAD_COND_INITIALIZER;
+
+// BMP station (if listening for BMP sessions), and the output state kept for
+// each router session
+static parsebgp_bmp_station_t *station = NULL;
+typedef struct station_router {
+  parsebgp_elem_gen_t *gen;
+  parsebgp_elem_fmt_buf_t out_buf;
+} station_router_t;
+
 static ssize_t refill_buffer(FILE *fp, uint8_t *buf, size_t buflen,
                              size_t remain)
 {
@@ -79,24 +166,133 @@ static ssize_t refill_buffer(FILE *fp, uint8_t *buf, size_t buflen,
   return len;
 }
 
-static int parse(parsebgp_opts_t *opts, parsebgp_msg_type_t type, char *fname)
+static int stats_type(const parsebgp_msg_t *msg)
+{
+  switch (msg->type) {
+  case PARSEBGP_MSG_TYPE_BGP:
+    return msg->types.bgp->type;
+
+  case PARSEBGP_MSG_TYPE_BMP:
+    return msg->types.bmp->type;
+
+  case PARSEBGP_MSG_TYPE_MRT:
+    return msg->types.mrt->type;
+
+  default:
+    return 0;
+  }
+}
+
+static void stats_merge(stats_t *dst, const stats_t *src)
+{
+  int i;
+
+  dst->msgs += src->msgs;
+  dst->bytes += src->bytes;
+  for (i = 0; i < STATS_TYPES_CNT; i++) {
+    dst->types[i] += src->types[i];
+  }
+}
+
+static void stats_dump(const char *name, const stats_t *stats)
+{
+  int i;
+
+  fprintf(stderr, "STATS: %s: %" PRIu64 " messages, %" PRIu64 " bytes\n", name,
+          stats->msgs, stats->bytes);
+  for (i = 0; i < STATS_TYPES_CNT; i++) {
+    if (stats->types[i] != 0) {
+      fprintf(stderr, "STATS: %s:   type %d: %" PRIu64 " messages\n", name, i,
+              stats->types[i]);
+    }
+  }
+}
+
+static void output_flush(parsebgp_elem_fmt_buf_t *out_buf, FILE *out)
+{
+  if (out_buf->len == 0) {
+    return;
+  }
+  // buffers only ever hold whole lines, so output of concurrent workers is
+  // interleaved line-by-line at worst
+  flockfile(out);
+  fwrite(out_buf->buf, 1, out_buf->len, out);
+  funlockfile(out);
+  parsebgp_elem_fmt_buf_clear(out_buf);
+}
+
+static int output_msg(parsebgp_elem_gen_t *gen,
+                      parsebgp_elem_fmt_buf_t *out_buf, FILE *out,
+                      const parsebgp_msg_t *msg)
+{
+  parsebgp_elem_t *elem;
+  parsebgp_error_t err;
+
+  if (out_fmt == 0 && arrow_out == NULL) {
+    // keep the output of concurrent workers from interleaving
+    flockfile(out);
+    parsebgp_dump_msg_fp(out, msg);
+    funlockfile(out);
+    return 0;
+  }
+
+  if ((err = parsebgp_elem_gen_reset(gen, msg)) != PARSEBGP_OK) {
+    fprintf(stderr, "ERROR: Failed to extract elems (%d:%s)\n", err,
+            parsebgp_strerror(err));
+    return -1;
+  }
+  if (arrow_out != NULL) {
+    // rows of a message are kept together
+    pthread_mutex_lock(&arrow_mutex);
+    while ((elem = parsebgp_elem_gen_next(gen)) != NULL) {
+      if (parsebgp_elem_arrow_add(arrow_out, elem) != 0) {
+        pthread_mutex_unlock(&arrow_mutex);
+        fprintf(stderr, "ERROR: Failed to write Arrow row\n");
+        return -1;
+      }
+    }
+    pthread_mutex_unlock(&arrow_mutex);
+    return 0;
+  }
+  while ((elem = parsebgp_elem_gen_next(gen)) != NULL) {
+    if (parsebgp_elem_fmt(out_buf, out_fmt, elem) != 0) {
+      fprintf(stderr, "ERROR: Failed to format elem\n");
+      return -1;
+    }
+  }
+  if (out_buf->len >= OUT_FLUSH_LEN) {
+    output_flush(out_buf, out);
+  }
+  return 0;
+}
+
+static int parse(parsebgp_opts_t *opts, job_t *job, parsebgp_msg_t **msgs,
+                 uint8_t *buf, FILE *out)
 {
-  uint8_t buf[BUFLEN];
   FILE *fp = NULL;
+  char *fname = job->fname;
+
+  // elem state is per-file since RIB dumps refer to their own peer index
+  parsebgp_elem_gen_t *gen = NULL;
+  parsebgp_elem_fmt_buf_t out_buf;
+
+  // BMP peer capabilities are also per-file (i.e., per-router), so they need
+  // their own copy of the options
+  parsebgp_bmp_peers_t *peers = NULL;
+  parsebgp_opts_t file_opts;
 
   ssize_t fill_len = 0, remain = 0;
-  size_t dec_len = 0;
+  size_t dec_len = 0, msg_len = 0;
   uint8_t *ptr;
 
-  parsebgp_msg_t *msg = NULL;
-  parsebgp_error_t err = PARSEBGP_OK;
+  parsebgp_error_t errs[BATCH_LEN];
+  int msgs_cnt, i;
 
   uint64_t cnt = 0;
 
-  if ((msg = parsebgp_create_msg()) == NULL) {
-    fprintf(stderr, "ERROR: Failed to create message structure\n");
-    goto err;
-  }
+  memset(&out_buf, 0, sizeof(out_buf));
+  memcpy(&file_opts, opts, sizeof(file_opts));
+  opts = &file_opts;
 
   if (strcmp(fname, "-") == 0) {
     fp = stdin;
@@ -105,6 +301,18 @@ static int parse(parsebgp_opts_t *opts, parsebgp_msg_type_t type, char *fname)
     goto err;
   }
 
+  if ((out_fmt != 0 || arrow_out != NULL) &&
+      (gen = parsebgp_elem_gen_create()) == NULL) {
+    fprintf(stderr, "ERROR: Failed to create elem generator\n");
+    goto err;
+  }
+
+  if (job->type == PARSEBGP_MSG_TYPE_BMP &&
+      (opts->bmp.peers = peers = parsebgp_bmp_peers_create()) == NULL) {
+    fprintf(stderr, "ERROR: Failed to create BMP peer table\n");
+    goto err;
+  }
+
   buf[0] = '\0';
 
   while ((fill_len = refill_buffer(fp, buf, BUFLEN, remain)) > 0) {
@@ -120,36 +328,52 @@ static int parse(parsebgp_opts_t *opts, parsebgp_msg_type_t type, char *fname)
     ptr = buf;
 
     while (remain > 0) {
-      dec_len = remain;
-      if ((err = parsebgp_decode(*opts, type, msg, ptr, &dec_len)) !=
-          PARSEBGP_OK) {
-        if (err == PARSEBGP_PARTIAL_MSG) {
-          // refill the buffer and try again
-          parsebgp_clear_msg(msg);
-          break;
-        } else if (err == PARSEBGP_TRUNCATED_MSG && opts->ignore_invalid) {
+      // decode the complete messages in the buffer
+      if ((msgs_cnt = parsebgp_decode_batch(*opts, job->type, msgs, errs,
+                                            BATCH_LEN, ptr, remain,
+                                            &dec_len)) < 0) {
+        fprintf(stderr, "ERROR: Failed to parse message (%d:%s)\n", msgs_cnt,
+                parsebgp_strerror(msgs_cnt));
+        goto err;
+      }
+
+      for (i = 0; i < msgs_cnt; i++) {
+        if (errs[i] == PARSEBGP_TRUNCATED_MSG && opts->ignore_invalid) {
           if (!(opts)->silence_invalid) {
             fprintf(stderr, "WARN: truncated message %" PRIu64 " in %s\n",
               cnt, fname);
           }
-        } else {
+        } else if (errs[i] != PARSEBGP_OK) {
           // else: its a fatal error
-          fprintf(stderr, "ERROR: Failed to parse message (%d:%s)\n", err,
-                  parsebgp_strerror(err));
+          fprintf(stderr, "ERROR: Failed to parse message (%d:%s)\n", errs[i],
+                  parsebgp_strerror(errs[i]));
+          goto err;
+        }
+        cnt++;
+
+        job->stats.msgs++;
+        job->stats.types[stats_type(msgs[i])]++;
+
+        if (!silent && output_msg(gen, &out_buf, out, msgs[i]) != 0) {
           goto err;
         }
       }
-      // else: successful read
-      assert(dec_len > 0);
       ptr += dec_len;
       remain -= dec_len;
-      cnt++;
+      job->stats.bytes += dec_len;
 
-      if (!silent) {
-        parsebgp_dump_msg(msg);
+      if (msgs_cnt == 0) {
+        // the next message is incomplete, so refill the buffer and try again
+        // (unless it could never fit)
+        msg_len = 0;
+        parsebgp_frame(opts, job->type, ptr, remain, &msg_len);
+        if (msg_len > BUFLEN) {
+          fprintf(stderr, "ERROR: Message %" PRIu64 " in %s is too long "
+                  "(%zu bytes)\n", cnt, fname, msg_len);
+          goto err;
+        }
+        break;
       }
-
-      parsebgp_clear_msg(msg);
     }
   }
 
@@ -164,19 +388,386 @@ static int parse(parsebgp_opts_t *opts, parsebgp_msg_type_t type, char *fname)
   if (fp != NULL && fp != stdin) {
     fclose(fp);
   }
-
-  parsebgp_destroy_msg(msg);
+  output_flush(&out_buf, out);
+  parsebgp_elem_fmt_buf_destroy(&out_buf);
+  parsebgp_elem_gen_destroy(gen);
+  parsebgp_bmp_peers_destroy(peers);
 
   return 0;
 
 err:
-  if (fp != NULL) {
+  if (fp != NULL && fp != stdin) {
     fclose(fp);
   }
-  parsebgp_destroy_msg(msg);
+  output_flush(&out_buf, out);
+  parsebgp_elem_fmt_buf_destroy(&out_buf);
+  parsebgp_elem_gen_destroy(gen);
+  parsebgp_bmp_peers_destroy(peers);
+  for (i = 0; i < BATCH_LEN; i++) {
+    parsebgp_clear_msg(msgs[i]);
+  }
   return -1;
 }
 
+static void destroy_msgs(parsebgp_msg_t **msgs)
+{
+  int i;
+
+  if (msgs == NULL) {
+    return;
+  }
+  for (i = 0; i < BATCH_LEN; i++) {
+    parsebgp_destroy_msg(msgs[i]);
+  }
+  free(msgs);
+}
+
+static parsebgp_msg_t **create_msgs(void)
+{
+  parsebgp_msg_t **msgs;
+  int i;
+
+  if ((msgs = calloc(BATCH_LEN, sizeof(*msgs))) == NULL) {
+    return NULL;
+  }
+  for (i = 0; i < BATCH_LEN; i++) {
+    if ((msgs[i] = parsebgp_create_msg()) == NULL) {
+      destroy_msgs(msgs);
+      return NULL;
+    }
+  }
+  return msgs;
+}
+
+static void run_job(parsebgp_opts_t *opts, job_t *job, parsebgp_msg_t **msgs,
+                    uint8_t *buf, FILE *out, int last)
+{
+  fprintf(stderr, "INFO: Parsing %s (Type: %s)\n", job->fname,
+          type_strs[job->type]);
+
+  if ((job->rc = parse(opts, job, msgs, buf, out)) != 0) {
+    fprintf(stderr, "WARNING: Failed to parse %s%s\n", job->fname,
+            last ? "" : ", moving on");
+  }
+}
+
+static void *worker(void *user)
+{
+  parsebgp_opts_t *opts = user;
+  parsebgp_msg_t **msgs = NULL;
+  uint8_t *buf = NULL;
+  job_t *job;
+  FILE *out;
+  int i, failed = 0;
+
+  if ((msgs = create_msgs()) == NULL ||
+      (buf = malloc(BUFLEN)) == NULL) {
+    fprintf(stderr, "ERROR: Failed to create worker state\n");
+    // still claim jobs (and fail them), so that the ordered writer is not
+    // left waiting for them
+    failed = 1;
+  }
+
+  while (1) {
+    pthread_mutex_lock(&jobs_mutex);
+    i = jobs_next++;
+    pthread_mutex_unlock(&jobs_mutex);
+    if (i >= jobs_cnt) {
+      break;
+    }
+    job = &jobs[i];
+
+    out = stdout;
+    if (failed) {
+      job->rc = -1;
+      out = NULL;
+    } else if (ordered && !silent &&
+               (out = open_memstream(&job->out, &job->out_len)) == NULL) {
+      fprintf(stderr, "ERROR: Could not buffer output for %s\n", job->fname);
+      job->rc = -1;
+    } else {
+      run_job(opts, job, msgs, buf, out, 0);
+    }
+    if (out != stdout && out != NULL) {
+      fclose(out);
+    }
+
+    pthread_mutex_lock(&jobs_mutex);
+    job->done = 1;
+    pthread_cond_broadcast(&jobs_cond);
+    pthread_mutex_unlock(&jobs_mutex);
+  }
+
+  destroy_msgs(msgs);
+  free(buf);
+  return NULL;
+}
+
+static int run_jobs_parallel(parsebgp_opts_t *opts, int workers_cnt)
+{
+  pthread_t *workers = NULL;
+  int i, started = 0;
+
+  if ((workers = malloc(sizeof(pthread_t) * workers_cnt)) == NULL) {
+    return -1;
+  }
+  for (i = 0; i < workers_cnt; i++) {
+    if (pthread_create(&workers[i], NULL, worker, opts) != 0) {
+      fprintf(stderr, "ERROR: Failed to start worker thread\n");
+      break;
+    }
+    started++;
+  }
+
+  // write buffered output in the order that files were given
+  if (started > 0 && ordered && !silent) {
+    for (i = 0; i < jobs_cnt; i++) {
+      pthread_mutex_lock(&jobs_mutex);
+      while (!jobs[i].done) {
+        pthread_cond_wait(&jobs_cond, &jobs_mutex);
+      }
+      pthread_mutex_unlock(&jobs_mutex);
+      if (jobs[i].out != NULL) {
+        fwrite(jobs[i].out, 1, jobs[i].out_len, stdout);
+        free(jobs[i].out);
+        jobs[i].out = NULL;
+      }
+    }
+  }
+
+  for (i = 0; i < started; i++) {
+    pthread_join(workers[i], NULL);
+  }
+  free(workers);
+
+  return (started > 0) ? 0 : -1;
+}
+
+static int run_jobs(parsebgp_opts_t *opts)
+{
+  parsebgp_msg_t **msgs = NULL;
+  uint8_t *buf = NULL;
+  int i;
+
+  if ((msgs = create_msgs()) == NULL || (buf = malloc(BUFLEN)) == NULL) {
+    fprintf(stderr, "ERROR: Failed to create message structures\n");
+    destroy_msgs(msgs);
+    return -1;
+  }
+
+  for (i = 0; i < jobs_cnt; i++) {
+    run_job(opts, &jobs[i], msgs, buf, stdout, i == jobs_cnt - 1);
+  }
+
+  destroy_msgs(msgs);
+  free(buf);
+  return 0;
+}
+
+static int run_merge(parsebgp_opts_t *opts, int background)
+{
+  parsebgp_mrt_merge_t *merge = NULL;
+  parsebgp_mrt_merge_rec_t *rec = NULL;
+  parsebgp_mrt_msg_t *mrt_msg = NULL;
+  parsebgp_msg_t msg;
+  parsebgp_error_t err;
+  // one elem generator per input, since RIB dumps refer to their own peer index
+  parsebgp_elem_gen_t **gens = NULL;
+  parsebgp_elem_fmt_buf_t out_buf;
+  job_t *job;
+  int i, rc = -1;
+
+  memset(&out_buf, 0, sizeof(out_buf));
+
+  if ((merge = parsebgp_mrt_merge_create(opts, background)) == NULL) {
+    fprintf(stderr, "ERROR: Failed to create merge reader\n");
+    return -1;
+  }
+
+  if (out_fmt != 0 || arrow_out != NULL) {
+    if ((gens = calloc(jobs_cnt, sizeof(parsebgp_elem_gen_t *))) == NULL) {
+      fprintf(stderr, "ERROR: Failed to create elem generators\n");
+      goto done;
+    }
+    for (i = 0; i < jobs_cnt; i++) {
+      if ((gens[i] = parsebgp_elem_gen_create()) == NULL) {
+        fprintf(stderr, "ERROR: Failed to create elem generators\n");
+        goto done;
+      }
+    }
+  }
+
+  for (i = 0; i < jobs_cnt; i++) {
+    if (jobs[i].type != PARSEBGP_MSG_TYPE_MRT) {
+      fprintf(stderr, "ERROR: Only MRT files can be merged (%s)\n",
+              jobs[i].fname);
+      goto done;
+    }
+    if (parsebgp_mrt_merge_add_file(merge, jobs[i].fname) != i) {
+      fprintf(stderr, "ERROR: Could not open %s (%s)\n", jobs[i].fname,
+              strerror(errno));
+      goto done;
+    }
+    fprintf(stderr, "INFO: Merging %s (Type: %s)\n", jobs[i].fname,
+            type_strs[jobs[i].type]);
+  }
+
+  memset(&msg, 0, sizeof(msg));
+  msg.type = PARSEBGP_MSG_TYPE_MRT;
+
+  while (1) {
+    if ((err = parsebgp_mrt_merge_next(merge, &rec)) != PARSEBGP_OK) {
+      fprintf(stderr, "ERROR: Failed to read the merged inputs (%d:%s)\n",
+              err, parsebgp_strerror(err));
+      output_flush(&out_buf, stdout);
+      goto done;
+    }
+    if (rec == NULL) {
+      break;
+    }
+
+    job = &jobs[rec->input];
+    job->stats.msgs++;
+    job->stats.bytes += rec->len;
+    // (the low byte of) the MRT type from the common header
+    job->stats.types[(uint8_t)rec->buf[5]]++;
+
+    if (silent) {
+      continue;
+    }
+    if ((err = parsebgp_mrt_merge_decode(merge, &mrt_msg)) != PARSEBGP_OK) {
+      fprintf(stderr, "ERROR: Failed to parse message from %s (%d:%s)\n",
+              job->fname, err, parsebgp_strerror(err));
+      job->rc = -1;
+      continue;
+    }
+    msg.types.mrt = mrt_msg;
+    if (output_msg((gens != NULL) ? gens[rec->input] : NULL, &out_buf, stdout,
+                   &msg) != 0) {
+      goto done;
+    }
+  }
+  output_flush(&out_buf, stdout);
+
+  for (i = 0; i < jobs_cnt; i++) {
+    fprintf(stderr, "INFO: Read %" PRIu64 " messages from %s\n",
+            jobs[i].stats.msgs, jobs[i].fname);
+  }
+  rc = 0;
+
+done:
+  if (gens != NULL) {
+    for (i = 0; i < jobs_cnt; i++) {
+      parsebgp_elem_gen_destroy(gens[i]);
+    }
+    free(gens);
+  }
+  parsebgp_elem_fmt_buf_destroy(&out_buf);
+  parsebgp_mrt_merge_destroy(merge);
+  return rc;
+}
+
+static void station_stop(int sig)
+{
+  (void)sig;
+  parsebgp_bmp_station_stop(station);
+}
+
+static void station_session(void *user, parsebgp_bmp_station_router_t *router,
+                            int up, parsebgp_error_t err)
+{
+  station_router_t *sr = router->user;
+  (void)user;
+
+  if (up) {
+    fprintf(stderr,
+            "INFO: Router %s:%d connected (session %" PRIu64 ", worker %d)\n",
+            router->addr, router->port, router->id, router->worker);
+    if ((sr = malloc(sizeof(station_router_t))) == NULL) {
+      fprintf(stderr, "ERROR: Failed to create router state\n");
+      return;
+    }
+    memset(sr, 0, sizeof(*sr));
+    if ((out_fmt != 0 || arrow_out != NULL) &&
+        (sr->gen = parsebgp_elem_gen_create()) == NULL) {
+      fprintf(stderr, "ERROR: Failed to create elem generator\n");
+      free(sr);
+      return;
+    }
+    router->user = sr;
+    return;
+  }
+
+  fprintf(stderr, "INFO: Router %s:%d disconnected (session %" PRIu64 ": %s)\n",
+          router->addr, router->port, router->id, parsebgp_strerror(err));
+  if (sr != NULL) {
+    output_flush(&sr->out_buf, stdout);
+    parsebgp_elem_fmt_buf_destroy(&sr->out_buf);
+    parsebgp_elem_gen_destroy(sr->gen);
+    free(sr);
+    router->user = NULL;
+  }
+}
+
+static void station_msg(void *user, parsebgp_bmp_station_router_t *router,
+                        parsebgp_bmp_msg_t *bmp_msg)
+{
+  station_router_t *sr = router->user;
+  parsebgp_msg_t msg;
+  (void)user;
+
+  if (silent || sr == NULL) {
+    return;
+  }
+  memset(&msg, 0, sizeof(msg));
+  msg.type = PARSEBGP_MSG_TYPE_BMP;
+  msg.types.bmp = bmp_msg;
+  output_msg(sr->gen, &sr->out_buf, stdout, &msg);
+  // sessions are live, so don't hold output back
+  output_flush(&sr->out_buf, stdout);
+}
+
+static int run_station(parsebgp_opts_t *opts, int workers_cnt, char *addr)
+{
+  char *host = NULL, *port = addr, *p;
+  int rc = -1;
+
+  // [host:]port, where an IPv6 host may be given in brackets
+  if ((p = strrchr(addr, ':')) != NULL) {
+    *p = '\0';
+    host = addr;
+    port = p + 1;
+    if (*host == '[' && (p = strchr(host, ']')) != NULL) {
+      *p = '\0';
+      host++;
+    }
+  }
+
+  if ((station = parsebgp_bmp_station_create(
+         opts, workers_cnt, station_msg, station_session, NULL)) == NULL) {
+    fprintf(stderr, "ERROR: Failed to create BMP station\n");
+    return -1;
+  }
+  if (parsebgp_bmp_station_listen(station, host, port) < 0) {
+    fprintf(stderr, "ERROR: Could not listen on %s:%s (%s)\n",
+            (host != NULL) ? host : "*", port, strerror(errno));
+    goto done;
+  }
+  fprintf(stderr, "INFO: Listening for BMP sessions on %s:%s\n",
+          (host != NULL) ? host : "*", port);
+
+  signal(SIGINT, station_stop);
+  signal(SIGTERM, station_stop);
+  rc = parsebgp_bmp_station_run(station);
+  signal(SIGINT, SIG_DFL);
+  signal(SIGTERM, SIG_DFL);
+
+done:
+  parsebgp_bmp_station_destroy(station);
+  station = NULL;
+  return rc;
+}
+
 static void usage(void)
 {
   fprintf(
@@ -187,13 +778,29 @@ static void usage(void)
     "       -4                 Force 4-byte ASN parsing\n"
     "       -b                 Perform shallow BMP parsing\n"
     "       -f <attr-type>     Filter to include given Path Attribute\n"
+    "       -F <format>        Write one line per prefix elem instead of\n"
+    "                            dumping messages, where 'format' is one of\n"
+    "                            'json' (JSON Lines) or 'bgpdump' (like\n"
+    "                            bgpdump -m), or write an Apache Arrow IPC\n"
+    "                            file of elems to stdout using 'arrow'\n"
     "       -i                 Ignore invalid messages and attributes\n"
     "                            (use multiple times to silence warnings)\n"
+    "       -j <workers>       Parse files in parallel using the given number\n"
+    "                            of worker threads\n"
+    "       -L <[host:]port>   Listen for BMP sessions instead of parsing\n"
+    "                            files (use -j to set the number of workers)\n"
+    "       -o                 Write the output of files parsed in parallel\n"
+    "                            in the order the files were given\n"
     "       -s                 Skip unknown messages and attributes\n"
     "                            (use multiple times to silence warnings)\n"
     "       -m                 BGP messages do not include the 16-octet marker\n"
+    "       -M                 Merge MRT files into a single stream ordered by\n"
+    "                            timestamp (use -j to read files in the\n"
+    "                            background)\n"
     "       -h                 Show this help message\n"
     "       -q                 Do not dump parsed messages (quiet mode)\n"
+    "       -S                 Write per-file and total message counts to\n"
+    "                            stderr\n"
     "       -v                 Show version of the libparsebgp library\n",
     NAME);
 }
@@ -203,11 +810,17 @@ int main(int argc, char **argv)
   int opt;
   int prevoptind;
   opterr = 0;
+  int workers_cnt = 1;
+  int merge = 0;
+  int out_arrow = 0;
+  char *listen_addr = NULL;
+  int rc = 0;
 
   parsebgp_opts_t opts;
+  parsebgp_bgp_path_attr_table_t attr_table;
   parsebgp_opts_init(&opts);
 
-  while (prevoptind = optind, (opt = getopt(argc, argv, ":f:t:i4bsmqvh?")) >= 0) {
+  while (prevoptind = optind, (opt = getopt(argc, argv, ":f:F:t:ij:L:o4bsmMqSvh?")) >= 0) {
     if (optind == prevoptind + 2 && (optarg == NULL || *optarg == '-')) {
       opt = ':';
       --optind;
@@ -228,6 +841,36 @@ int main(int argc, char **argv)
               (uint8_t)atoi(optarg));
       break;
 
+    case 'F':
+      if (strcmp(optarg, "json") == 0) {
+        out_fmt = PARSEBGP_ELEM_FMT_JSON;
+      } else if (strcmp(optarg, "bgpdump") == 0) {
+        out_fmt = PARSEBGP_ELEM_FMT_BGPDUMP;
+      } else if (strcmp(optarg, "arrow") == 0) {
+        out_arrow = 1;
+      } else {
+        fprintf(stderr, "ERROR: Invalid output format '%s'\n", optarg);
+        usage();
+        return -1;
+      }
+      break;
+
+    case 'j':
+      if ((workers_cnt = atoi(optarg)) < 1) {
+        fprintf(stderr, "ERROR: Invalid number of workers '%s'\n", optarg);
+        usage();
+        return -1;
+      }
+      break;
+
+    case 'L':
+      listen_addr = optarg;
+      break;
+
+    case 'o':
+      ordered = 1;
+      break;
+
     case 'i':
       // if this is the second (or more) time, silence the warnings
       if (opts.ignore_invalid) {
@@ -248,10 +891,18 @@ int main(int argc, char **argv)
       opts.bgp.marker_omitted = 1;
       break;
 
+    case 'M':
+      merge = 1;
+      break;
+
     case 'q':
       silent = 1;
       break;
 
+    case 'S':
+      show_stats = 1;
+      break;
+
     case 'h':
     case '?':
       usage();
@@ -271,11 +922,41 @@ int main(int argc, char **argv)
     }
   }
 
-  if (optind >= argc) {
+  // compile the attribute filter once, rather than for every UPDATE
+  if (opts.bgp.path_attr_filter_enabled) {
+    parsebgp_bgp_path_attr_table_init(&attr_table, &opts.bgp);
+    opts.bgp.path_attr_table = &attr_table;
+  }
+
+  if ((listen_addr == NULL && optind >= argc) ||
+      (listen_addr != NULL && (optind < argc || merge || ordered))) {
     usage();
     return -1;
   }
 
+  if (out_arrow && !silent) {
+    if (ordered) {
+      fprintf(stderr, "ERROR: Ordered output is not supported with Arrow\n");
+      usage();
+      return -1;
+    }
+    if ((arrow_out = parsebgp_elem_arrow_create(stdout, 0)) == NULL) {
+      fprintf(stderr, "ERROR: Failed to create Arrow writer\n");
+      return -1;
+    }
+  }
+
+  if (listen_addr != NULL) {
+    rc = run_station(&opts, workers_cnt, listen_addr);
+    goto stats;
+  }
+
+  if ((jobs = calloc(argc - optind, sizeof(job_t))) == NULL) {
+    fprintf(stderr, "ERROR: Failed to allocate file list\n");
+    parsebgp_elem_arrow_destroy(arrow_out);
+    return -1;
+  }
+
   int i, j;
   for (i = optind; i < argc; i++) {
     int type = 0; // undefined type
@@ -313,17 +994,57 @@ int main(int argc, char **argv)
               argv[i]);
       usage();
       free(freeme);
-      return -1;
+      rc = -1;
+      goto done;
     }
 
-    fprintf(stderr, "INFO: Parsing %s (Type: %s)\n", fname, type_strs[type]);
+    jobs[jobs_cnt].type = type;
+    jobs[jobs_cnt].fname = fname;
+    jobs[jobs_cnt].freeme = freeme;
+    jobs_cnt++;
+  }
+
+  if (merge) {
+    rc = run_merge(&opts, workers_cnt > 1);
+    goto stats;
+  }
 
-    if (parse(&opts, type, fname) != 0) {
-      fprintf(stderr, "WARNING: Failed to parse %s%s\n", fname,
-              (i == argc - 1) ? "" : ", moving on");
+  if (workers_cnt > jobs_cnt) {
+    workers_cnt = jobs_cnt;
+  }
+  if (workers_cnt > 1) {
+    rc = run_jobs_parallel(&opts, workers_cnt);
+  } else {
+    rc = run_jobs(&opts);
+  }
+
+stats:
+  if (arrow_out != NULL && parsebgp_elem_arrow_close(arrow_out) != 0) {
+    fprintf(stderr, "ERROR: Failed to write Arrow file\n");
+    rc = -1;
+  }
+
+  if (show_stats) {
+    stats_t total;
+    int failed = 0;
+    memset(&total, 0, sizeof(total));
+    for (i = 0; i < jobs_cnt; i++) {
+      stats_dump(jobs[i].fname, &jobs[i].stats);
+      stats_merge(&total, &jobs[i].stats);
+      if (jobs[i].rc != 0) {
+        failed++;
+      }
     }
-    free(freeme);
+    fprintf(stderr, "STATS: total: %d files (%d failed)\n", jobs_cnt, failed);
+    stats_dump("total", &total);
   }
 
-  return 0;
+done:
+  for (i = 0; i < jobs_cnt; i++) {
+    free(jobs[i].freeme);
+  }
+  free(jobs);
+  parsebgp_elem_arrow_destroy(arrow_out);
+
+  return rc;
 }
@@ -0,0 +1,760 @@
+/*
+ * Copyright (C) 2017 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "parsebgp.h"
+#include "config.h"
+#include <arpa/inet.h>
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#define NAME "parsebgp-filter"
+
+// Read 1MB of the file at a time
+#define BUFLEN (1024 * 1024)
+
+// Maximum number of pending output segments before we call writev
+#define IOV_BATCH 1024
+
+/** A peer address to filter on */
+typedef struct peer_ip {
+  parsebgp_bgp_afi_t afi;
+  uint8_t addr[16];
+} peer_ip_t;
+
+/** A peer from the most recent TABLE_DUMP_V2 Peer Index Table */
+typedef struct peer_entry {
+  parsebgp_bgp_afi_t afi;
+  uint8_t addr[16];
+  uint32_t asn;
+} peer_entry_t;
+
+// filters (records must match all given filter types, and any value within a
+// filter type)
+static uint32_t *peer_asns = NULL;
+static int peer_asns_cnt = 0;
+static peer_ip_t *peer_ips = NULL;
+static int peer_ips_cnt = 0;
+static parsebgp_bgp_prefix_t *prefixes = NULL;
+static int prefixes_cnt = 0;
+static uint32_t time_start = 0;
+static uint32_t time_end = UINT32_MAX;
+
+// peers from the most recent peer index table (used to apply peer filters to
+// TABLE_DUMP_V2 RIB records)
+static peer_entry_t *peer_index = NULL;
+static int peer_index_cnt = 0;
+
+// pending output (these point into the input buffer, so they must be flushed
+// before the buffer is refilled)
+static int out_fd = STDOUT_FILENO;
+static struct iovec iov[IOV_BATCH];
+static int iov_cnt = 0;
+
+static int flush_output(void)
+{
+  struct iovec *v = iov;
+  int cnt = iov_cnt;
+  ssize_t wlen;
+
+  while (cnt > 0) {
+    if ((wlen = writev(out_fd, v, cnt)) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      fprintf(stderr, "ERROR: Failed to write output (%s)\n", strerror(errno));
+      return -1;
+    }
+    // skip over the segments that were completely written
+    while (cnt > 0 && (size_t)wlen >= v->iov_len) {
+      wlen -= v->iov_len;
+      v++;
+      cnt--;
+    }
+    // and adjust a partially written segment
+    if (cnt > 0) {
+      v->iov_base = (uint8_t *)v->iov_base + wlen;
+      v->iov_len -= wlen;
+    }
+  }
+
+  iov_cnt = 0;
+  return 0;
+}
+
+static int queue_output(const uint8_t *ptr, size_t len)
+{
+  // records that are contiguous in the input buffer can share a segment
+  if (iov_cnt > 0 &&
+      (uint8_t *)iov[iov_cnt - 1].iov_base + iov[iov_cnt - 1].iov_len == ptr) {
+    iov[iov_cnt - 1].iov_len += len;
+    return 0;
+  }
+
+  if (iov_cnt == IOV_BATCH && flush_output() != 0) {
+    return -1;
+  }
+
+  iov[iov_cnt].iov_base = (void *)ptr;
+  iov[iov_cnt].iov_len = len;
+  iov_cnt++;
+  return 0;
+}
+
+static int peer_matches(parsebgp_bgp_afi_t afi, const uint8_t *addr,
+                        uint32_t asn)
+{
+  int i, addr_len = (afi == PARSEBGP_BGP_AFI_IPV4) ? 4 : 16;
+
+  if (peer_asns_cnt > 0) {
+    for (i = 0; i < peer_asns_cnt; i++) {
+      if (peer_asns[i] == asn) {
+        break;
+      }
+    }
+    if (i == peer_asns_cnt) {
+      return 0;
+    }
+  }
+
+  if (peer_ips_cnt > 0) {
+    for (i = 0; i < peer_ips_cnt; i++) {
+      if (peer_ips[i].afi == afi &&
+          memcmp(peer_ips[i].addr, addr, addr_len) == 0) {
+        break;
+      }
+    }
+    if (i == peer_ips_cnt) {
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+static int prefix_matches(parsebgp_bgp_afi_t afi, const uint8_t *addr,
+                          uint8_t len)
+{
+  int i, bytes, bits;
+  parsebgp_bgp_prefix_t *f;
+
+  // a prefix matches if it is equal to, or more specific than, any of the
+  // prefix filters
+  for (i = 0; i < prefixes_cnt; i++) {
+    f = &prefixes[i];
+    if (f->afi != afi || len < f->len) {
+      continue;
+    }
+    bytes = f->len / 8;
+    bits = f->len % 8;
+    if (memcmp(f->addr, addr, bytes) != 0) {
+      continue;
+    }
+    if (bits != 0 &&
+        ((f->addr[bytes] ^ addr[bytes]) & (uint8_t)(0xFF << (8 - bits))) != 0) {
+      continue;
+    }
+    return 1;
+  }
+  return 0;
+}
+
+static int prefixes_match(const parsebgp_bgp_prefix_t *pfxs, int cnt)
+{
+  int i;
+  for (i = 0; i < cnt; i++) {
+    if (prefix_matches(pfxs[i].afi, pfxs[i].addr, pfxs[i].len)) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static int update_matches(const parsebgp_bgp_msg_t *bgp)
+{
+  const parsebgp_bgp_update_t *update;
+  const parsebgp_bgp_update_path_attrs_t *attrs;
+  const parsebgp_bgp_update_path_attr_t *attr;
+
+  if (bgp == NULL || bgp->type != PARSEBGP_BGP_TYPE_UPDATE) {
+    return 0;
+  }
+  update = bgp->types.update;
+  attrs = &update->path_attrs;
+
+  if (prefixes_match(update->withdrawn_nlris.prefixes,
+                     update->withdrawn_nlris.prefixes_cnt) ||
+      prefixes_match(update->announced_nlris.prefixes,
+                     update->announced_nlris.prefixes_cnt)) {
+    return 1;
+  }
+
+  attr = &attrs->attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_MP_REACH_NLRI];
+  if (PARSEBGP_BGP_UPDATE_ATTR_PRESENT(
+        attrs, PARSEBGP_BGP_PATH_ATTR_TYPE_MP_REACH_NLRI) &&
+      prefixes_match(attr->data.mp_reach->nlris,
+                     attr->data.mp_reach->nlris_cnt)) {
+    return 1;
+  }
+
+  attr = &attrs->attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_MP_UNREACH_NLRI];
+  if (PARSEBGP_BGP_UPDATE_ATTR_PRESENT(
+        attrs, PARSEBGP_BGP_PATH_ATTR_TYPE_MP_UNREACH_NLRI) &&
+      prefixes_match(attr->data.mp_unreach->withdrawn_nlris,
+                     attr->data.mp_unreach->withdrawn_nlris_cnt)) {
+    return 1;
+  }
+
+  return 0;
+}
+
+static void save_peer_index(const parsebgp_mrt_table_dump_v2_peer_index_t *pi)
+{
+  int i;
+  peer_entry_t *tmp;
+
+  if ((tmp = realloc(peer_index, sizeof(peer_entry_t) * pi->peer_count)) ==
+        NULL &&
+      pi->peer_count > 0) {
+    fprintf(stderr, "ERROR: Could not allocate peer index table\n");
+    peer_index_cnt = 0;
+    return;
+  }
+  peer_index = tmp;
+  peer_index_cnt = pi->peer_count;
+
+  for (i = 0; i < pi->peer_count; i++) {
+    peer_index[i].afi = pi->peer_entries[i].ip_afi;
+    memcpy(peer_index[i].addr, pi->peer_entries[i].ip, 16);
+    peer_index[i].asn = pi->peer_entries[i].asn;
+  }
+}
+
+static int rib_matches(const parsebgp_mrt_table_dump_v2_afi_safi_rib_t *rib)
+{
+  int i;
+  const peer_entry_t *pe;
+
+  for (i = 0; i < rib->entry_count; i++) {
+    if (rib->entries[i].peer_index >= peer_index_cnt) {
+      continue;
+    }
+    pe = &peer_index[rib->entries[i].peer_index];
+    if (peer_matches(pe->afi, pe->addr, pe->asn)) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/**
+ * Check if the given record (already shallow-parsed into hdr) passes all the
+ * filters. Records that need more than their header fields to be checked are
+ * fully parsed into full.
+ *
+ * Returns 1 if the record matches, 0 if it does not
+ */
+static int record_matches(parsebgp_opts_t *opts, parsebgp_mrt_msg_t *hdr,
+                          parsebgp_msg_t *full, const uint8_t *ptr, size_t len)
+{
+  int peers = (peer_asns_cnt > 0 || peer_ips_cnt > 0);
+  parsebgp_bgp_afi_t afi;
+  parsebgp_error_t err;
+  size_t dec_len = len;
+  int rc = 0;
+
+  if (hdr->timestamp_sec < time_start || hdr->timestamp_sec >= time_end) {
+    return 0;
+  }
+
+  switch (hdr->type) {
+  case PARSEBGP_MRT_TYPE_TABLE_DUMP:
+    afi = hdr->subtype;
+    return (!peers || peer_matches(afi, hdr->types.table_dump->peer_ip,
+                                   hdr->types.table_dump->peer_asn)) &&
+           (prefixes_cnt == 0 ||
+            prefix_matches(afi, hdr->types.table_dump->prefix,
+                           hdr->types.table_dump->prefix_len));
+
+  case PARSEBGP_MRT_TYPE_TABLE_DUMP_V2:
+    switch (hdr->subtype) {
+    case PARSEBGP_MRT_TABLE_DUMP_V2_PEER_INDEX_TABLE:
+      // always needed by readers of the RIB records that follow
+      save_peer_index(&hdr->types.table_dump_v2->peer_index);
+      return 1;
+
+    case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_UNICAST:
+    case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_MULTICAST:
+    case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV6_UNICAST:
+    case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV6_MULTICAST:
+    case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_UNICAST_ADDPATH:
+    case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_MULTICAST_ADDPATH:
+    case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV6_UNICAST_ADDPATH:
+    case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV6_MULTICAST_ADDPATH:
+      afi = (hdr->subtype == PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_UNICAST ||
+             hdr->subtype == PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_MULTICAST ||
+             hdr->subtype ==
+               PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_UNICAST_ADDPATH ||
+             hdr->subtype ==
+               PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_MULTICAST_ADDPATH)
+              ? PARSEBGP_BGP_AFI_IPV4
+              : PARSEBGP_BGP_AFI_IPV6;
+      if (prefixes_cnt > 0 &&
+          !prefix_matches(afi, hdr->types.table_dump_v2->afi_safi_rib.prefix,
+                          hdr->types.table_dump_v2->afi_safi_rib.prefix_len)) {
+        return 0;
+      }
+      if (!peers) {
+        return 1;
+      }
+      // the record is kept if any of its entries is from a matching peer, so
+      // we need the (full) entries
+      break;
+
+    default:
+      return !peers && prefixes_cnt == 0;
+    }
+    break;
+
+  case PARSEBGP_MRT_TYPE_BGP4MP:
+  case PARSEBGP_MRT_TYPE_BGP4MP_ET:
+    if (peers && !peer_matches(hdr->types.bgp4mp->afi,
+                               hdr->types.bgp4mp->peer_ip,
+                               hdr->types.bgp4mp->peer_asn)) {
+      return 0;
+    }
+    if (prefixes_cnt == 0) {
+      return 1;
+    }
+    switch (hdr->subtype) {
+    case PARSEBGP_MRT_BGP4MP_MESSAGE:
+    case PARSEBGP_MRT_BGP4MP_MESSAGE_AS4:
+    case PARSEBGP_MRT_BGP4MP_MESSAGE_LOCAL:
+    case PARSEBGP_MRT_BGP4MP_MESSAGE_AS4_LOCAL:
+      // need the NLRIs from the (full) message
+      break;
+
+    default:
+      // state changes have no prefixes
+      return 0;
+    }
+    break;
+
+  default:
+    // no peer or prefix information available
+    return !peers && prefixes_cnt == 0;
+  }
+
+  // if we get here, we need to do a full parse of the record
+  opts->mrt.parse_headers_only = 0;
+  err = parsebgp_decode(*opts, PARSEBGP_MSG_TYPE_MRT, full, ptr, &dec_len);
+  opts->mrt.parse_headers_only = 1;
+  if (err != PARSEBGP_OK) {
+    if (!opts->silence_invalid) {
+      fprintf(stderr, "WARN: Failed to fully parse record (%d:%s), skipping\n",
+              err, parsebgp_strerror(err));
+    }
+    parsebgp_clear_msg(full);
+    return 0;
+  }
+
+  if (hdr->type == PARSEBGP_MRT_TYPE_TABLE_DUMP_V2) {
+    rc = rib_matches(&full->types.mrt->types.table_dump_v2->afi_safi_rib);
+  } else {
+    rc = update_matches(full->types.mrt->types.bgp4mp->data.bgp_msg);
+  }
+
+  parsebgp_clear_msg(full);
+  return rc;
+}
+
+static ssize_t refill_buffer(FILE *fp, uint8_t *buf, size_t buflen,
+                             size_t remain)
+{
+  size_t len = 0;
+
+  if (remain > 0) {
+    // need to move remaining data to start of buffer
+    memmove(buf, buf + buflen - remain, remain);
+    len += remain;
+  }
+
+  if (feof(fp) != 0) {
+    // nothing more to read
+    return len;
+  }
+
+  // do a read, we should get something at least
+  len += fread(buf + len, 1, buflen - len, fp);
+
+  if (ferror(fp) != 0) {
+    return -1;
+  }
+
+  return len;
+}
+
+static int filter(parsebgp_opts_t *opts, char *fname)
+{
+  static uint8_t buf[BUFLEN];
+  FILE *fp = NULL;
+
+  ssize_t fill_len = 0, remain = 0;
+  size_t dec_len = 0;
+  uint8_t *ptr;
+
+  parsebgp_msg_t *hdr = NULL, *full = NULL;
+  parsebgp_error_t err = PARSEBGP_OK;
+
+  uint64_t cnt = 0, match_cnt = 0;
+
+  if ((hdr = parsebgp_create_msg()) == NULL ||
+      (full = parsebgp_create_msg()) == NULL) {
+    fprintf(stderr, "ERROR: Failed to create message structure\n");
+    goto err;
+  }
+
+  if (strcmp(fname, "-") == 0) {
+    fp = stdin;
+  } else if ((fp = fopen(fname, "r")) == NULL) {
+    fprintf(stderr, "ERROR: Could not open %s (%s)\n", fname, strerror(errno));
+    goto err;
+  }
+
+  while ((fill_len = refill_buffer(fp, buf, BUFLEN, remain)) > 0) {
+    if (fill_len == remain) {
+      // failed to read anything new from the file, so give up
+      fprintf(stderr,
+              "ERROR: Possibly corrupt file encountered. Trailing garbage of "
+              "%ld bytes found\n",
+              remain);
+      break;
+    }
+    remain = fill_len;
+    ptr = buf;
+
+    while (remain > 0) {
+      dec_len = remain;
+      if ((err = parsebgp_decode(*opts, PARSEBGP_MSG_TYPE_MRT, hdr, ptr,
+                                 &dec_len)) != PARSEBGP_OK) {
+        if (err == PARSEBGP_PARTIAL_MSG) {
+          // refill the buffer and try again
+          parsebgp_clear_msg(hdr);
+          break;
+        }
+        fprintf(stderr, "ERROR: Failed to parse message (%d:%s)\n", err,
+                parsebgp_strerror(err));
+        goto err;
+      }
+      assert(dec_len > 0);
+      cnt++;
+
+      if (record_matches(opts, hdr->types.mrt, full, ptr, dec_len)) {
+        if (queue_output(ptr, dec_len) != 0) {
+          goto err;
+        }
+        match_cnt++;
+      }
+
+      ptr += dec_len;
+      remain -= dec_len;
+      parsebgp_clear_msg(hdr);
+    }
+
+    // the pending output points into the buffer we are about to refill
+    if (flush_output() != 0) {
+      goto err;
+    }
+  }
+
+  if (fill_len < 0) {
+    fprintf(stderr, "ERROR: Failed to read from %s (%s)\n", fname,
+            strerror(errno));
+    goto err;
+  }
+
+  fprintf(stderr, "INFO: Wrote %" PRIu64 " of %" PRIu64 " records from %s\n",
+          match_cnt, cnt, fname);
+
+  if (fp != NULL && fp != stdin) {
+    fclose(fp);
+  }
+
+  parsebgp_destroy_msg(hdr);
+  parsebgp_destroy_msg(full);
+
+  return 0;
+
+err:
+  flush_output();
+  if (fp != NULL && fp != stdin) {
+    fclose(fp);
+  }
+  parsebgp_destroy_msg(hdr);
+  parsebgp_destroy_msg(full);
+  return -1;
+}
+
+static int parse_ip(const char *str, parsebgp_bgp_afi_t *afi, uint8_t *addr)
+{
+  memset(addr, 0, 16);
+  if (inet_pton(AF_INET, str, addr) == 1) {
+    *afi = PARSEBGP_BGP_AFI_IPV4;
+    return 0;
+  }
+  if (inet_pton(AF_INET6, str, addr) == 1) {
+    *afi = PARSEBGP_BGP_AFI_IPV6;
+    return 0;
+  }
+  return -1;
+}
+
+static int add_peer_asn(const char *str)
+{
+  uint32_t *tmp;
+  unsigned long asn;
+  char *end = NULL;
+
+  errno = 0;
+  asn = strtoul(str, &end, 10);
+  if (*str == '\0' || *end != '\0' || errno == ERANGE || asn > UINT32_MAX) {
+    fprintf(stderr, "ERROR: Malformed peer ASN '%s'\n", str);
+    return -1;
+  }
+
+  if ((tmp = realloc(peer_asns, sizeof(uint32_t) * (peer_asns_cnt + 1))) ==
+      NULL) {
+    return -1;
+  }
+  peer_asns = tmp;
+  peer_asns[peer_asns_cnt++] = asn;
+  return 0;
+}
+
+static int add_peer_ip(const char *str)
+{
+  peer_ip_t *tmp;
+
+  if ((tmp = realloc(peer_ips, sizeof(peer_ip_t) * (peer_ips_cnt + 1))) ==
+      NULL) {
+    return -1;
+  }
+  peer_ips = tmp;
+  if (parse_ip(str, &peer_ips[peer_ips_cnt].afi,
+               peer_ips[peer_ips_cnt].addr) != 0) {
+    fprintf(stderr, "ERROR: Malformed peer IP '%s'\n", str);
+    return -1;
+  }
+  peer_ips_cnt++;
+  return 0;
+}
+
+static int add_prefix(const char *str)
+{
+  parsebgp_bgp_prefix_t *tmp, *pfx;
+  parsebgp_bgp_afi_t afi;
+  char *cpy, *len_str;
+  int max_len, rc = -1;
+
+  if ((tmp = realloc(prefixes,
+                     sizeof(parsebgp_bgp_prefix_t) * (prefixes_cnt + 1))) ==
+      NULL) {
+    return -1;
+  }
+  prefixes = tmp;
+  pfx = &prefixes[prefixes_cnt];
+  memset(pfx, 0, sizeof(*pfx));
+
+  if ((cpy = strdup(str)) == NULL) {
+    return -1;
+  }
+  if ((len_str = strchr(cpy, '/')) != NULL) {
+    *(len_str++) = '\0';
+  }
+  if (parse_ip(cpy, &afi, pfx->addr) != 0) {
+    goto done;
+  }
+  pfx->afi = afi;
+  max_len = (pfx->afi == PARSEBGP_BGP_AFI_IPV4) ? 32 : 128;
+  pfx->len = (len_str != NULL) ? atoi(len_str) : max_len;
+  if (len_str != NULL && (atoi(len_str) < 0 || atoi(len_str) > max_len)) {
+    goto done;
+  }
+  prefixes_cnt++;
+  rc = 0;
+
+done:
+  if (rc != 0) {
+    fprintf(stderr, "ERROR: Malformed prefix '%s'\n", str);
+  }
+  free(cpy);
+  return rc;
+}
+
+static int set_window(const char *str)
+{
+  char *end = NULL;
+
+  time_start = strtoul(str, &end, 10);
+  if (*end == ',') {
+    time_end = strtoul(end + 1, &end, 10);
+  }
+  if (*end != '\0' || time_end <= time_start) {
+    fprintf(stderr, "ERROR: Malformed time window '%s'\n", str);
+    return -1;
+  }
+  return 0;
+}
+
+static void usage(void)
+{
+  fprintf(
+    stderr,
+    "usage: %s [options] file [file...]\n"
+    "       Copy the MRT records that match all of the given filters\n"
+    "       (and any of the values given for a filter) to the output\n"
+    "       -a <asn>           Include records from the given peer ASN\n"
+    "       -p <ip>            Include records from the given peer IP\n"
+    "       -P <prefix>        Include records that contain a prefix equal\n"
+    "                            to, or more specific than, the given prefix\n"
+    "       -w <start>[,<end>] Include records with timestamps in the range\n"
+    "                            [start, end)\n"
+    "       -o <file>          Write records to the given file (default: "
+    "stdout)\n"
+    "       -i                 Silence warnings about records that could not\n"
+    "                            be fully parsed\n"
+    "       -h                 Show this help message\n"
+    "       -v                 Show version of the libparsebgp library\n",
+    NAME);
+}
+
+int main(int argc, char **argv)
+{
+  int opt;
+  int prevoptind;
+  opterr = 0;
+  char *out_fname = NULL;
+  int i, rc = 0;
+
+  parsebgp_opts_t opts;
+  parsebgp_opts_init(&opts);
+  opts.mrt.parse_headers_only = 1;
+
+  while (prevoptind = optind,
+         (opt = getopt(argc, argv, ":a:p:P:w:o:ivh?")) >= 0) {
+    if (optind == prevoptind + 2 && (optarg == NULL || *optarg == '-')) {
+      opt = ':';
+      --optind;
+    }
+    switch (opt) {
+    case 'a':
+      if (add_peer_asn(optarg) != 0) {
+        return -1;
+      }
+      break;
+
+    case 'p':
+      if (add_peer_ip(optarg) != 0) {
+        return -1;
+      }
+      break;
+
+    case 'P':
+      if (add_prefix(optarg) != 0) {
+        return -1;
+      }
+      break;
+
+    case 'w':
+      if (set_window(optarg) != 0) {
+        return -1;
+      }
+      break;
+
+    case 'o':
+      out_fname = optarg;
+      break;
+
+    case 'i':
+      opts.silence_invalid = 1;
+      break;
+
+    case 'h':
+    case '?':
+      usage();
+      return 0;
+      break;
+
+    case 'v':
+      fprintf(stderr, "libparsebgp version %d.%d.%d\n",
+              LIBPARSEBGP_MAJOR_VERSION, LIBPARSEBGP_MID_VERSION,
+              LIBPARSEBGP_MINOR_VERSION);
+      break;
+
+    default:
+      usage();
+      return -1;
+      break;
+    }
+  }
+
+  if (optind >= argc) {
+    usage();
+    return -1;
+  }
+
+  if (out_fname != NULL && strcmp(out_fname, "-") != 0 &&
+      (out_fd = open(out_fname, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0) {
+    fprintf(stderr, "ERROR: Could not open %s for writing (%s)\n", out_fname,
+            strerror(errno));
+    return -1;
+  }
+
+  for (i = optind; i < argc; i++) {
+    if (filter(&opts, argv[i]) != 0) {
+      fprintf(stderr, "WARNING: Failed to filter %s%s\n", argv[i],
+              (i == argc - 1) ? "" : ", moving on");
+      rc = -1;
+    }
+  }
+
+  if (out_fd != STDOUT_FILENO) {
+    close(out_fd);
+  }
+  free(peer_asns);
+  free(peer_ips);
+  free(prefixes);
+  free(peer_index);
+
+  return rc;
+}